@@ -0,0 +1,170 @@
+#! /usr/bin/perl -w
+#
+# classifier-bench.pl -- compare Classifier implementations
+#
+# ./classifier-bench.pl [-c CLICK] [-n PACKETS] [-b BURST] [-m MODES] [RULESETS...]
+#
+# Runs each rule set (default all of "ethernet", "ipclassifier", and
+# "firewall") with each classification mode (default "interp,fast,jit,simd"):
+#
+#   interp  the Classifier/IPFilter interpreter ("write ELEMENT.jit false")
+#   fast    code generated by click-fastclassifier and compiled into a
+#           dynamically loaded package (requires click-fastclassifier and
+#           click-buildtool on the PATH)
+#   jit     native code generated at initialization time (the default on
+#           x86-64 user-level drivers)
+#   simd    batches classified eight packets at a time with AVX2
+#           ("write ELEMENT.simd true")
+#
+# Each run pushes PACKETS packets (default 10000000), drawn round-robin from
+# several templates, through the classifier in batches of BURST packets
+# (default 32; set with -b).  The same sources feeding Discard directly are
+# timed first; the per-packet difference is reported as the classification
+# cost.
+
+use Time::HiRes qw(time);
+
+my($click) = "click";
+my($npackets) = 10000000;
+my($burst) = 32;
+my(@modes) = ("interp", "fast", "jit", "simd");
+
+while (@ARGV && $ARGV[0] =~ /^-/) {
+    my($opt) = shift @ARGV;
+    if ($opt eq "-c" && @ARGV) {
+	$click = shift @ARGV;
+    } elsif ($opt eq "-n" && @ARGV) {
+	$npackets = shift @ARGV;
+    } elsif ($opt eq "-b" && @ARGV) {
+	$burst = shift @ARGV;
+    } elsif ($opt eq "-m" && @ARGV) {
+	@modes = split(/,/, shift @ARGV);
+    } else {
+	print STDERR "usage: classifier-bench.pl [-c CLICK] [-n PACKETS] [-b BURST] [-m MODES] [RULESETS...]\n";
+	exit(1);
+    }
+}
+
+# packet templates
+
+sub ip_checksum ($) {
+    my($sum) = 0;
+    $sum += $_ foreach unpack("n*", $_[0]);
+    $sum = ($sum & 0xFFFF) + ($sum >> 16) while $sum > 0xFFFF;
+    return ~$sum & 0xFFFF;
+}
+
+sub packet ($$$$$) {
+    my($proto, $src, $dst, $sport, $dport) = @_;
+    my($l4) = ($proto == 6
+	       ? pack("nnNNnnnn", $sport, $dport, 1, 0, 0x5010, 8192, 0, 0)
+	       : pack("nnnn", $sport, $dport, 8 + 18, 0)) . ("\0" x 18);
+    my($ip) = pack("CCnnnCCna4a4", 0x45, 0, 20 + length($l4), 0, 0, 64,
+		   $proto, 0, pack("C4", split(/\./, $src)),
+		   pack("C4", split(/\./, $dst)));
+    substr($ip, 10, 2) = pack("n", ip_checksum($ip));
+    my($eth) = pack("H12H12n", "001122334455", "00aabbccddee", 0x0800);
+    return unpack("H*", $eth . $ip . $l4);
+}
+
+my($arp) = unpack("H*", pack("H12H12nnnCCnH12NH12N", "ffffffffffff",
+			     "00aabbccddee", 0x0806, 1, 0x0800, 6, 4, 1,
+			     "00aabbccddee", 0x0A000001, "000000000000",
+			     0x0A000002)) . ("00" x 18);
+
+# rule sets: [element declaration, number of outputs, needs IP header,
+#             templates]
+
+my(%rulesets);
+
+$rulesets{"ethernet"} = ["c :: Classifier(12/0806 20/0001, 12/0806 20/0002, 12/0800, -)",
+			 4, 0,
+			 [$arp, packet(6, "10.0.0.1", "10.0.0.2", 1024, 80),
+			  packet(17, "10.0.0.1", "10.0.0.2", 1024, 53)]];
+
+{
+    my(@r) = ("tcp dst port 80", "tcp dst port 443", "udp dst port 53",
+	      "tcp src port 80", "icmp type echo", "udp dst port 123",
+	      "tcp dst port 22", "tcp dst port 25", "udp port 161 or udp port 162",
+	      "src net 192.168.0.0/16", "dst net 172.16.0.0/12", "tcp opt syn",
+	      "ip frag", "udp dst port > 1023", "tcp", "-");
+    $rulesets{"ipclassifier"} = ["c :: IPClassifier(" . join(", ", @r) . ")",
+				 scalar(@r), 1,
+				 [packet(6, "10.0.0.1", "10.0.0.2", 1024, 80),
+				  packet(17, "10.0.0.1", "10.0.0.2", 1024, 53),
+				  packet(6, "10.0.0.1", "10.0.0.2", 1024, 8080),
+				  packet(17, "10.0.0.1", "10.0.0.2", 1024, 9999)]];
+}
+
+{
+    my(@r);
+    for (my $i = 0; $i < 48; $i++) {
+	push @r, "allow src net 10.$i.0.0/16 && dst host 10.200.0.$i && tcp dst port " . (1000 + $i);
+    }
+    push @r, "deny all";
+    $rulesets{"firewall"} = ["c :: IPFilter(" . join(", ", @r) . ")",
+			     1, 1,
+			     [packet(6, "10.47.1.1", "10.200.0.47", 1024, 1047),
+			      packet(6, "10.20.1.1", "10.200.0.20", 1024, 1020),
+			      packet(6, "10.99.1.1", "10.200.0.1", 1024, 1000),
+			      packet(17, "10.3.1.1", "10.200.0.3", 1024, 1003)]];
+}
+
+my(@rulesets) = (@ARGV ? @ARGV : ("ethernet", "ipclassifier", "firewall"));
+
+sub sources ($$) {
+    my($templates, $target) = @_;
+    my($n) = int(($npackets + @$templates - 1) / @$templates);
+    my($config) = "";
+    for (my $i = 0; $i < @$templates; $i++) {
+	$config .= "InfiniteSource(DATA \\<$templates->[$i]>, LIMIT $n, BURST $burst, STOP true) -> $target;\n";
+    }
+    return $config;
+}
+
+my($tmpfile) = "/tmp/classifier-bench.$$.click";
+
+sub run_config ($$) {
+    my($config, $fast) = @_;
+    open(F, ">$tmpfile") || die "$tmpfile: $!";
+    print F $config;
+    close(F);
+    if ($fast) {
+	# click-fastclassifier writes an archive, which click must read
+	# from a file
+	system("click-fastclassifier -u -f $tmpfile -o $tmpfile.fast 2>/dev/null") == 0
+	    || die "click-fastclassifier failed\n";
+	rename("$tmpfile.fast", $tmpfile);
+    }
+    my($start) = time;
+    system("$click $tmpfile") == 0 || die "$click failed\n";
+    my($elapsed) = time - $start;
+    unlink($tmpfile);
+    return $elapsed;
+}
+
+printf "%-14s %-8s %10s %12s %10s\n", "ruleset", "mode", "seconds", "packets/s", "ns/packet";
+foreach my $rs (@rulesets) {
+    die "unknown rule set '$rs'\n" if !exists $rulesets{$rs};
+    my($decl, $nout, $ip, $templates) = @{$rulesets{$rs}};
+    # Sources push batches straight into the classifier, or into
+    # CheckIPHeader, which forwards them intact.
+    my($head) = ($ip ? "in :: CheckIPHeader(OFFSET 14) -> " : "");
+    my($srcs) = sources($templates, $ip ? "in" : "c");
+
+    my($base) = run_config($head . "c :: Discard;\n" . $srcs, 0);
+    foreach my $mode (@modes) {
+	my($config) = $head . "$decl;\n" . $srcs;
+	$config .= "c [$_] -> Discard;\n" foreach (0 .. $nout - 1);
+	if ($mode eq "interp") {
+	    $config .= "Script(write c.jit false);\n";
+	} elsif ($mode eq "simd") {
+	    $config .= "Script(write c.simd true);\n";
+	} elsif ($mode ne "fast" && $mode ne "jit") {
+	    die "unknown mode '$mode'\n";
+	}
+	my($elapsed) = run_config($config, $mode eq "fast");
+	printf "%-14s %-8s %10.3f %12.0f %10.1f\n", $rs, $mode, $elapsed,
+	    $npackets / $elapsed, ($elapsed - $base) * 1e9 / $npackets;
+    }
+}
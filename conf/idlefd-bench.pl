@@ -0,0 +1,51 @@
+#! /usr/bin/perl -w
+#
+# idlefd-bench.pl -- measure how idle file descriptors slow the driver loop
+#
+# ./idlefd-bench.pl [-c CLICK] [-n PACKETS] [NFDS...]
+#
+# For each NFDS (default 0 16 64 256 512 960), runs a user-level Click
+# configuration with NFDS idle UDP Socket elements, each registered with
+# Master::add_select(), next to a task-driven InfiniteSource -> Discard path
+# of PACKETS packets (default 10000000).  The driver checks file descriptors
+# between task runs, so the packet rate shows the per-iteration cost of the
+# select backend.  With poll() the rate falls as NFDS grows; with epoll it
+# should stay flat.  Compare builds configured with and without
+# <sys/epoll.h> (e.g. "ac_cv_header_sys_epoll_h=no ./configure ...").
+# NFDS must stay below the process's file descriptor limit.
+
+use Time::HiRes qw(time);
+
+my($click) = "click";
+my($npackets) = 10000000;
+my($port) = 42000;
+
+while (@ARGV && $ARGV[0] =~ /^-/) {
+    my($opt) = shift @ARGV;
+    if ($opt eq "-c" && @ARGV) {
+	$click = shift @ARGV;
+    } elsif ($opt eq "-n" && @ARGV) {
+	$npackets = shift @ARGV;
+    } else {
+	print STDERR "usage: idlefd-bench.pl [-c CLICK] [-n PACKETS] [NFDS...]\n";
+	exit(1);
+    }
+}
+@ARGV = (0, 16, 64, 256, 512, 960) if !@ARGV;
+
+printf "%8s %10s %14s\n", "nfds", "seconds", "packets/s";
+foreach my $nfds (@ARGV) {
+    my($config) = "";
+    for (my $i = 0; $i < $nfds; $i++) {
+	$config .= "Socket(UDP, 0.0.0.0, " . ($port + $i) . ", CLIENT false) -> Discard;\n";
+    }
+    $config .= "InfiniteSource(LIMIT $npackets, BURST 1, STOP true) -> Discard;\n";
+
+    my($start) = time;
+    open(CLICK, "| $click") || die "$click: $!";
+    print CLICK $config;
+    close(CLICK) || die "$click failed\n";
+    my($elapsed) = time - $start;
+
+    printf "%8d %10.3f %14.0f\n", $nfds, $elapsed, $npackets / $elapsed;
+}
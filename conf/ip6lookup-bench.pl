@@ -0,0 +1,183 @@
+#! /usr/bin/perl -w
+#
+# ip6lookup-bench.pl -- measure LookupIP6Route table load and lookup speed
+#
+# ./ip6lookup-bench.pl [-c CLICK] [-n NPACKETS] [-f TABLE] [NROUTES...]
+#
+# For each NROUTES (default 1000, 10000, and 100000), builds an IPv6 routing
+# table, writes NPACKETS (default 2000000) Ethernet/IPv6/UDP packets whose
+# destinations fall inside the table's prefixes to a tcpdump file, and runs
+# three user-level Click configurations over that file:
+#
+#   FromDump -> Strip(14) -> GetIP6Address(24) -> Discard
+#
+# once with no table, once with the table loaded into an idle LookupIP6Route,
+# and once with the packets passing through the LookupIP6Route.  The
+# differences give the time taken to load the table and the lookup rate in
+# millions of lookups per second.
+#
+# Without -f, the table is synthetic: NROUTES random prefixes under 2000::/3
+# with a length distribution like the global IPv6 BGP table (mostly /48s,
+# then /32, /44, /40, /36, and so on).  With -f, prefixes are read from
+# TABLE instead; the first IPv6 prefix on each line is used, so a plain
+# prefix list or `bgpdump -m' output of a RouteViews or RIS snapshot both
+# work.  NROUTES then limits how many prefixes are used (0 means all).
+#
+# Pass -c with an older click binary to compare lookup implementations.
+
+use Time::HiRes qw(time);
+
+my($click) = "click";
+my($npackets) = 2000000;
+my($table);
+
+while (@ARGV && $ARGV[0] =~ /^-/) {
+    my($opt) = shift @ARGV;
+    if ($opt eq "-c" && @ARGV) {
+	$click = shift @ARGV;
+    } elsif ($opt eq "-n" && @ARGV) {
+	$npackets = shift @ARGV;
+    } elsif ($opt eq "-f" && @ARGV) {
+	$table = shift @ARGV;
+    } else {
+	print STDERR "usage: ip6lookup-bench.pl [-c CLICK] [-n NPACKETS] [-f TABLE] [NROUTES...]\n";
+	exit(1);
+    }
+}
+@ARGV = ($table ? (0) : (1000, 10000, 100000)) if !@ARGV;
+
+my($tmp) = "/tmp/ip6lookup-bench.$$";
+
+# prefix length => share of the table
+my(%lendist) = (16 => 1, 19 => 1, 20 => 2, 24 => 3, 28 => 10, 29 => 40,
+		30 => 10, 32 => 120, 33 => 10, 34 => 10, 35 => 10, 36 => 45,
+		38 => 10, 40 => 80, 42 => 15, 44 => 90, 45 => 10, 46 => 30,
+		47 => 25, 48 => 478);
+my(@lens);
+foreach my $len (sort { $a <=> $b } keys %lendist) {
+    push @lens, ($len) x $lendist{$len};
+}
+
+sub parse_ip6 ($) {
+    my($a) = @_;
+    my($hi, $lo) = split(/::/, $a, 2);
+    my(@hi) = (defined($hi) && $hi ne "" ? split(/:/, $hi) : ());
+    my(@lo) = (defined($lo) && $lo ne "" ? split(/:/, $lo) : ());
+    return undef if @hi + @lo > 8 || (!defined($lo) && @hi != 8);
+    my(@w) = (@hi, ("0") x (8 - @hi - @lo), @lo);
+    return map { hex($_) } @w;
+}
+
+sub unparse_ip6 (@) {
+    return join(":", map { sprintf("%x", $_) } @_);
+}
+
+# set the bits of @w after the first $len to random values
+sub fill_host_bits ($@) {
+    my($len, @w) = @_;
+    for (my $i = 0; $i < 8; $i++) {
+	my($keep) = $len - 16 * $i;
+	next if $keep >= 16;
+	$keep = 0 if $keep < 0;
+	my($mask) = (0xFFFF << (16 - $keep)) & 0xFFFF;
+	$w[$i] = ($w[$i] & $mask) | (int(rand(65536)) & ~$mask & 0xFFFF);
+    }
+    return @w;
+}
+
+sub mask_ip6 ($@) {
+    my($len, @w) = @_;
+    for (my $i = 0; $i < 8; $i++) {
+	my($keep) = $len - 16 * $i;
+	$keep = 0 if $keep < 0;
+	$w[$i] &= (0xFFFF << (16 - $keep)) & 0xFFFF if $keep < 16;
+    }
+    return @w;
+}
+
+sub make_table ($) {
+    my($nroutes) = @_;
+    my(@t, %seen);
+    if ($table) {
+	open(T, $table) || die "$table: $!";
+	while (<T>) {
+	    next if !/([0-9a-fA-F]*:[0-9a-fA-F:]*)\/(\d+)/;
+	    my($len) = $2;
+	    my(@w) = parse_ip6($1);
+	    next if !@w || $len > 128;
+	    @w = mask_ip6($len, @w);
+	    my($key) = unparse_ip6(@w) . "/$len";
+	    next if $seen{$key};
+	    $seen{$key} = 1;
+	    push @t, [$len, @w];
+	    last if $nroutes && @t >= $nroutes;
+	}
+	close(T);
+    } else {
+	while (@t < $nroutes) {
+	    my($len) = $lens[int(rand(@lens))];
+	    my(@w) = mask_ip6($len, fill_host_bits(3, 0x2000, (0) x 7));
+	    my($key) = unparse_ip6(@w) . "/$len";
+	    next if $seen{$key};
+	    $seen{$key} = 1;
+	    push @t, [$len, @w];
+	}
+    }
+    return @t;
+}
+
+sub write_dump ($@) {
+    my($file, @t) = @_;
+    open(D, ">$file") || die "$file: $!";
+    binmode(D);
+    print D pack("NnnNNNN", 0xA1B2C3D4, 2, 4, 0, 0, 65535, 1);
+    my($eth) = pack("H12H12n", "000000000002", "000000000001", 0x86DD);
+    my($src) = pack("n8", 0x2001, 0xdb8, 0, 0, 0, 0, 0, 1);
+    for (my $i = 0; $i < $npackets; $i++) {
+	my($r) = $t[int(rand(@t))];
+	my(@dst) = fill_host_bits($r->[0], @$r[1 .. 8]);
+	my($p) = $eth . pack("NnCC", 0x60000000, 8, 17, 64) . $src
+	    . pack("n8", @dst) . pack("nnnn", 1024, 9, 8, 0);
+	print D pack("NNNN", $i, 0, length($p), length($p)), $p;
+    }
+    close(D);
+}
+
+sub run_click ($$) {
+    my($routes, $through) = @_;
+    open(F, ">$tmp.click") || die "$tmp.click: $!";
+    print F "FromDump($tmp.dump, STOP true)\n",
+	"\t-> Strip(14) -> GetIP6Address(24)\n";
+    if ($through) {
+	print F "\t-> r :: LookupIP6Route($routes);\n",
+	    "r[0] -> d :: Discard; r[1] -> d; r[2] -> d; r[3] -> d;\n";
+    } else {
+	print F "\t-> Discard;\n";
+	print F "Idle -> r :: LookupIP6Route($routes);\n",
+	    "r[0] -> d :: Discard; r[1] -> d; r[2] -> d; r[3] -> d;\n"
+	    if $routes ne "";
+    }
+    close(F);
+    my($start) = time;
+    system("$click $tmp.click 2>/dev/null") == 0 || die "$click failed\n";
+    return time - $start;
+}
+
+printf "%10s %10s %10s %12s\n", "nroutes", "npackets", "load_s", "Mlookups/s";
+foreach my $nroutes (@ARGV) {
+    my(@t) = make_table($nroutes);
+    die "no routes\n" if !@t;
+    write_dump("$tmp.dump", @t);
+    my($port) = 0;
+    my($routes) = join(",\n", map {
+	    $port = ($port + 1) % 4;
+	    unparse_ip6(@$_[1 .. 8]) . "/$_->[0] $port"
+	} @t);
+
+    my($t0) = run_click("", 0);
+    my($t1) = run_click($routes, 0);
+    my($t2) = run_click($routes, 1);
+    my($rate) = ($t2 > $t1 ? $npackets / ($t2 - $t1) / 1000000 : 0);
+    printf "%10d %10d %10.3f %12.2f\n", scalar(@t), $npackets, $t1 - $t0, $rate;
+    unlink("$tmp.click", "$tmp.dump");
+}
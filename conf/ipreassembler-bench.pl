@@ -0,0 +1,85 @@
+#! /usr/bin/perl -w
+#
+# ipreassembler-bench.pl -- time IPReassembler under normal load and under a
+# fragment flood
+#
+# ./ipreassembler-bench.pl [-c CLICK] [-n NPACKETS] [-m MTU] [SIZE...]
+#
+# For each UDP payload SIZE in bytes (default 1400, 4000, and 16000), makes
+# NPACKETS (default 200000) packets, fragments them to MTU bytes (default
+# 576), and runs the fragments through IPReassembler:
+#
+#   whole      every fragment arrives; each packet is reassembled
+#   flood      last fragments are dropped, so every packet stays incomplete
+#              until HIMEM evicts it
+#   flood-16k  the same, with HIMEM 16K instead of the default 256K
+#
+# Reports the time per fragment in nanoseconds, less the time to generate and
+# fragment the packets.
+
+use Time::HiRes qw(time);
+
+my($click) = "click";
+my($npackets) = 200000;
+my($mtu) = 576;
+
+while (@ARGV && $ARGV[0] =~ /^-/) {
+    my($opt) = shift @ARGV;
+    if ($opt eq "-c" && @ARGV) {
+	$click = shift @ARGV;
+    } elsif ($opt eq "-n" && @ARGV) {
+	$npackets = shift @ARGV;
+    } elsif ($opt eq "-m" && @ARGV) {
+	$mtu = shift @ARGV;
+    } else {
+	print STDERR "usage: ipreassembler-bench.pl [-c CLICK] [-n NPACKETS] [-m MTU] [SIZE...]\n";
+	exit(1);
+    }
+}
+@ARGV = (1400, 4000, 16000) if !@ARGV;
+
+my($tmp) = "/tmp/ipreassembler-bench.$$";
+
+# each test is [filter, reassembler]
+my(%tests) = (
+    "whole" => ["", "IPReassembler"],
+    "flood" => ["Classifier(6/20%20) ->", "IPReassembler"],
+    "flood-16k" => ["Classifier(6/20%20) ->", "IPReassembler(HIMEM 16384)"]
+);
+my(@names) = ("whole", "flood", "flood-16k");
+
+sub run_click ($$$) {
+    my($size, $filter, $chain) = @_;
+    open(C, ">$tmp.click") || die "$tmp.click: $!";
+    print C <<"EOF";
+InfiniteSource(LENGTH $size, LIMIT $npackets, BURST 32, STOP true)
+	-> UDPIPEncap(1.0.0.1, 1, 2.0.0.2, 2)
+	-> IPFragmenter($mtu)
+	-> $filter c :: Counter
+	-> $chain -> Discard;
+DriverManager(wait_stop, print c.count);
+EOF
+    close(C);
+    my($t0) = time;
+    my($out) = scalar(`$click $tmp.click 2>&1`);
+    my($t) = time - $t0;
+    die "$click failed:\n$out" if $? || $out !~ /^(\d+)$/m;
+    return ($t, $1);
+}
+
+printf "%6s", "size";
+printf " %10s", $_ foreach @names;
+print "\n";
+
+foreach my $size (@ARGV) {
+    printf "%6d", $size;
+    foreach my $name (@names) {
+	my($filter, $chain) = @{$tests{$name}};
+	my($base, $n) = run_click($size, $filter, "Null");
+	my($t) = run_click($size, $filter, $chain);
+	printf " %10.1f", ($t - $base) * 1e9 / $n;
+    }
+    print "\n";
+}
+
+unlink("$tmp.click");
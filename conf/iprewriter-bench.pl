@@ -0,0 +1,100 @@
+#! /usr/bin/perl -w
+#
+# iprewriter-bench.pl -- measure packet delays caused by IPRewriter reaping
+#
+# ./iprewriter-bench.pl [-c CLICK] [-t TIMEOUT] [NFLOWS...]
+#
+# For each NFLOWS (default 10000000), runs a user-level Click configuration
+# that creates NFLOWS UDP mappings in an IPRewriter as fast as it can, then
+# leaves them idle until they time out (UDP_TIMEOUT TIMEOUT seconds, default
+# 2; REAP_UDP 1).  Meanwhile a probe flow of 1000 packets per second passes
+# through the same rewriter, and each probe packet's departure time is
+# recorded.  Reaping runs on the same thread as packet processing, so a long
+# reap shows up as a gap between probe packets.  The script reports the
+# largest gap while the mappings were being created (which includes hash
+# table growth), then the median, 99th and 99.9th percentile, and largest gap
+# afterwards, when reaping dominates, all in milliseconds.  It also prints
+# the rewriter's reap_stats when the driver has that handler.  Each mapping
+# pair takes a few hundred bytes, so large NFLOWS need several gigabytes.
+
+use Time::HiRes qw(time);
+
+my($click) = "click";
+my($timeout) = 2;
+
+while (@ARGV && $ARGV[0] =~ /^-/) {
+    my($opt) = shift @ARGV;
+    if ($opt eq "-c" && @ARGV) {
+	$click = shift @ARGV;
+    } elsif ($opt eq "-t" && @ARGV) {
+	$timeout = shift @ARGV;
+    } else {
+	print STDERR "usage: iprewriter-bench.pl [-c CLICK] [-t TIMEOUT] [NFLOWS...]\n";
+	exit(1);
+    }
+}
+@ARGV = (10000000) if !@ARGV;
+
+my($tmp) = "/tmp/iprewriter-bench.$$";
+
+sub percentile ($$) {
+    my($v, $p) = @_;
+    return $v->[int($p * (@$v - 1) + 0.5)];
+}
+
+printf "%10s %8s %8s %8s %8s %8s %8s  %s\n", "nflows", "fill_s",
+    "fill_max", "p50_ms", "p99_ms", "p999_ms", "max_ms", "reap_stats";
+foreach my $nflows (@ARGV) {
+    my($linger) = $timeout + 3 + int($nflows / 1000000);
+    open(F, ">$tmp.click") || die "$tmp.click: $!";
+    print F <<"EOF";
+rw :: IPRewriter(pattern 1.0.0.1 1024-65535 - - 0 0,
+		 UDP_TIMEOUT $timeout, REAP_UDP 1);
+RandomSource(28)
+	-> u :: Unqueue(LIMIT $nflows, BURST 64)
+	-> StoreData(0, \\<4500001c 00000000 4011>)
+	-> Paint(0)
+	-> MarkIPHeader
+	-> rw;
+RatedSource(\\<4500001c 00000000 40110000 0a000001 0a000002 00010002 00080000>, RATE 1000)
+	-> Paint(1)
+	-> MarkIPHeader
+	-> rw;
+rw -> ps :: PaintSwitch;
+ps[0] -> Discard;
+ps[1] -> SetTimestamp -> ToIPSummaryDump($tmp.dump, CONTENTS timestamp);
+DriverManager(label fill, wait 0.1s, goto fill \$(lt \$(u.count) $nflows),
+	print \$(now), print rw.nmappings, wait ${linger}s,
+	print rw.nmappings, print rw.reap_stats, stop);
+EOF
+    close(F);
+
+    my($start) = time;
+    my(@out) = `$click $tmp.click 2>/dev/null`;
+    die "$click failed\n" if !@out;
+    my($fill) = $out[0] - $start;
+
+    my(@t, @gap, $fill_max);
+    open(D, "$tmp.dump") || die "$tmp.dump: $!";
+    while (<D>) {
+	push @t, $1 if /^(\d+\.\d+)/;
+    }
+    close(D);
+    $fill_max = 0;
+    foreach my $i (1 .. $#t) {
+	my($g) = ($t[$i] - $t[$i - 1]) * 1000;
+	if ($t[$i] <= $out[0]) {
+	    $fill_max = $g if $g > $fill_max;
+	} else {
+	    push @gap, $g;
+	}
+    }
+    @gap = sort { $a <=> $b } @gap;
+
+    my($stats) = join(" ", map { chomp; $_ } @out[3 .. $#out]);
+    $stats =~ s/\b(\w+) (\d+)/$1=$2/g;
+    printf "%10d %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f  %s\n", $nflows, $fill,
+	$fill_max, percentile(\@gap, 0.5), percentile(\@gap, 0.99),
+	percentile(\@gap, 0.999), $gap[-1], $stats;
+    unlink("$tmp.click", "$tmp.dump");
+}
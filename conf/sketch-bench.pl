@@ -0,0 +1,171 @@
+#! /usr/bin/perl -w
+#
+# sketch-bench.pl -- compare sketch accuracy against AggregateCounter
+#
+# ./sketch-bench.pl [-c CLICK] [-n NPACKETS] [-k NKEYS] [-s SKEW] [-f TRACE]
+#                   [MEMORY...]
+#
+# Runs AggregateCounter over a trace to get the exact per-destination packet
+# counts, then, for each MEMORY budget in bytes (default 4096, 16384, 65536,
+# and 262144), runs CountMinSketch, SpaceSaving, and HyperLogLog with that
+# budget over the same trace:
+#
+#   FromIPSummaryDump -> AggregateIP(ip dst) -> SKETCH(MEMORY M) -> Discard
+#
+# and reports, next to AggregateCounter's time and key count:
+#
+#   cm-err     CountMinSketch's mean relative overestimate for the 100 largest
+#              keys, and its worst one
+#   ss-recall  the fraction of the 100 largest keys in SpaceSaving's top 100
+#   hll-err    HyperLogLog's relative error in the number of distinct keys
+#
+# and the run time of each configuration.
+#
+# Without -f, the trace is synthetic: NPACKETS (default 1000000) packets to
+# NKEYS (default 100000) destinations, drawn from a Zipf distribution with
+# exponent SKEW (default 1.1).  With -f, TRACE is a FromIPSummaryDump file
+# with an ip_dst field, such as the output of `ipsumdump -d'.
+
+use Time::HiRes qw(time);
+
+my($click) = "click";
+my($npackets) = 1000000;
+my($nkeys) = 100000;
+my($skew) = 1.1;
+my($trace);
+my($ntop) = 100;
+
+while (@ARGV && $ARGV[0] =~ /^-/) {
+    my($opt) = shift @ARGV;
+    if ($opt eq "-c" && @ARGV) {
+	$click = shift @ARGV;
+    } elsif ($opt eq "-n" && @ARGV) {
+	$npackets = shift @ARGV;
+    } elsif ($opt eq "-k" && @ARGV) {
+	$nkeys = shift @ARGV;
+    } elsif ($opt eq "-s" && @ARGV) {
+	$skew = shift @ARGV;
+    } elsif ($opt eq "-f" && @ARGV) {
+	$trace = shift @ARGV;
+    } else {
+	print STDERR "usage: sketch-bench.pl [-c CLICK] [-n NPACKETS] [-k NKEYS] [-s SKEW] [-f TRACE] [MEMORY...]\n";
+	exit(1);
+    }
+}
+@ARGV = (4096, 16384, 65536, 262144) if !@ARGV;
+
+my($tmp) = "/tmp/sketch-bench.$$";
+
+sub unparse_ip ($) {
+    my($a) = @_;
+    return join(".", ($a >> 24) & 255, ($a >> 16) & 255, ($a >> 8) & 255, $a & 255);
+}
+
+sub write_trace ($) {
+    my($file) = @_;
+    # cumulative Zipf weights
+    my(@cdf, $sum);
+    for (my $i = 1; $i <= $nkeys; $i++) {
+	$sum += 1 / ($i ** $skew);
+	push @cdf, $sum;
+    }
+    open(T, ">$file") || die "$file: $!";
+    print T "!data ip_dst\n";
+    for (my $p = 0; $p < $npackets; $p++) {
+	my($x) = rand($sum);
+	my($l, $r) = (0, $nkeys - 1);
+	while ($l < $r) {
+	    my($m) = ($l + $r) >> 1;
+	    if ($cdf[$m] < $x) {
+		$l = $m + 1;
+	    } else {
+		$r = $m;
+	    }
+	}
+	# spread the ranks over the address space
+	print T unparse_ip((($l + 1) * 2654435761) % 4294967296), "\n";
+    }
+    close(T);
+}
+
+sub run_click ($) {
+    my($config) = @_;
+    open(C, ">$tmp.click") || die "$tmp.click: $!";
+    print C $config;
+    close(C);
+    my($t0) = time;
+    my($out) = scalar(`$click $tmp.click 2>&1`);
+    my($t) = time - $t0;
+    die "$click failed:\n$out" if $?;
+    return ($out, $t);
+}
+
+if (!$trace) {
+    $trace = "$tmp.ipsum";
+    write_trace($trace);
+}
+
+# exact counts
+my($out, $actime) = run_click(<<"EOF");
+FromIPSummaryDump($trace, STOP true) -> AggregateIP(ip dst)
+	-> ac :: AggregateCounter -> Discard;
+DriverManager(wait_stop, print ac.nagg, write ac.write_text_file $tmp.exact);
+EOF
+my($ndistinct) = ($out =~ /^(\d+)/m);
+
+my(%exact);
+open(E, "$tmp.exact") || die "$tmp.exact: $!";
+while (<E>) {
+    $exact{$1} = $2 if /^(\d+)\s+(\d+)/;
+}
+close(E);
+my(@top) = sort { $exact{$b} <=> $exact{$a} || $a <=> $b } keys %exact;
+splice(@top, $ntop) if @top > $ntop;
+
+printf "%d distinct keys; AggregateCounter %.2fs\n", $ndistinct, $actime;
+printf "%8s  %8s %8s %6s  %9s %6s  %8s %6s\n",
+    "memory", "cm-err", "cm-max", "time", "ss-recall", "time", "hll-err", "time";
+
+foreach my $memory (@ARGV) {
+    # CountMinSketch
+    my($config) = "FromIPSummaryDump($trace, STOP true) -> AggregateIP(ip dst)\n"
+	. "\t-> cm :: CountMinSketch(MEMORY $memory) -> Discard;\n"
+	. "DriverManager(wait_stop";
+    $config .= ", print \$(cm.estimate $_)" foreach @top;
+    $config .= ");\n";
+    my($cmtime);
+    ($out, $cmtime) = run_click($config);
+    my(@est) = ($out =~ /^(\d+)$/mg);
+    my($err, $maxerr) = (0, 0);
+    for (my $i = 0; $i < @top; $i++) {
+	my($e) = ($est[$i] - $exact{$top[$i]}) / $exact{$top[$i]};
+	$err += $e / @top;
+	$maxerr = $e if $e > $maxerr;
+    }
+
+    # SpaceSaving
+    my($sstime);
+    ($out, $sstime) = run_click(<<"EOF");
+FromIPSummaryDump($trace, STOP true) -> AggregateIP(ip dst)
+	-> ss :: SpaceSaving(MEMORY $memory) -> Discard;
+DriverManager(wait_stop, read ss.topk $ntop);
+EOF
+    my(%found) = map { $_ => 1 } ($out =~ /^(\d+) \d+ \d+$/mg);
+    my($recall) = scalar(grep { $found{$_} } @top) / @top;
+
+    # HyperLogLog
+    my($hlltime);
+    ($out, $hlltime) = run_click(<<"EOF");
+FromIPSummaryDump($trace, STOP true) -> AggregateIP(ip dst)
+	-> hll :: HyperLogLog(MEMORY $memory) -> Discard;
+DriverManager(wait_stop, print hll.distinct);
+EOF
+    my($distinct) = ($out =~ /^(\d+)/m);
+    my($hllerr) = ($distinct - $ndistinct) / $ndistinct;
+
+    printf "%8d  %7.2f%% %7.2f%% %5.2fs  %8.1f%% %5.2fs  %7.2f%% %5.2fs\n",
+	$memory, 100 * $err, 100 * $maxerr, $cmtime, 100 * $recall, $sstime,
+	100 * $hllerr, $hlltime;
+}
+
+unlink("$tmp.click", "$tmp.exact", "$tmp.ipsum");
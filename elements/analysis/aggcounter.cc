@@ -23,10 +23,11 @@
 #include <click/packet_anno.hh>
 #include <click/integers.hh>	// for first_bit_set
 #include <click/router.hh>
+#include <click/master.hh>
 CLICK_DECLS
 
 AggregateCounter::AggregateCounter()
-    : _root(0), _free(0), _call_nnz_h(0), _call_count_h(0)
+    : _call_nnz_h(0), _call_count_h(0)
 {
 }
 
@@ -34,22 +35,93 @@ AggregateCounter::~AggregateCounter()
 {
 }
 
-AggregateCounter::Node *
-AggregateCounter::new_node_block()
+
+// TRIE
+
+uint32_t *
+AggregateCounter::Trie::insert(uint32_t a)
 {
-    assert(!_free);
-    int block_size = 1024;
-    Node *block = new Node[block_size];
-    if (!block)
+    uint32_t i = _n;
+    if (i >= 0x80000000U)
 	return 0;
-    _blocks.push_back(block);
-    for (int i = 1; i < block_size - 1; i++)
-	block[i].child[0] = &block[i+1];
-    block[block_size - 1].child[0] = 0;
-    _free = &block[1];
-    return &block[0];
+    if ((i >> BLOCK_SHIFT) == (uint32_t) _blocks.size()) {
+	Node *block = new Node[BLOCK_SIZE];
+	if (!block)
+	    return 0;
+	_blocks.push_back(block);
+    }
+    _n++;
+
+    Node &x = node(i);
+    x.aggregate = a;
+    x.count = 0;
+    if (i == 0) {
+	_root = 1;
+	return &x.count;
+    }
+
+    // find the first bit where 'a' differs from its closest neighbor
+    uint32_t r = _root;
+    while (!(r & 1)) {
+	const Node &n = node(r >> 1);
+	r = n.child[(a >> n.bit) & 1];
+    }
+    x.bit = 32 - ffs_msb(a ^ node(r >> 1).aggregate);
+
+    // then splice x in above the first subtree that branches below that bit
+    uint32_t *where = &_root;
+    while (!(*where & 1) && node(*where >> 1).bit > x.bit) {
+	Node &n = node(*where >> 1);
+	where = &n.child[(a >> n.bit) & 1];
+    }
+    int dir = (a >> x.bit) & 1;
+    x.child[dir] = (i << 1) | 1;
+    x.child[!dir] = *where;
+    *where = i << 1;
+    return &x.count;
+}
+
+bool
+AggregateCounter::Trie::add(uint32_t a, uint32_t amount)
+{
+    uint32_t *c = find(a);
+    if (!c && !(c = insert(a)))
+	return false;
+    if (amount && !*c)
+	_nnz++;
+    *c += amount;
+    _count += amount;
+    return true;
+}
+
+void
+AggregateCounter::Trie::clear()
+{
+    // keep the blocks for reuse
+    _n = _nnz = 0;
+    _count = 0;
 }
 
+void
+AggregateCounter::Trie::kill()
+{
+    for (int i = 0; i < _blocks.size(); i++)
+	delete[] _blocks[i];
+    _blocks.clear();
+    clear();
+}
+
+void
+AggregateCounter::Trie::swap(Trie &o)
+{
+    _blocks.swap(o._blocks);
+    click_swap(_n, o._n);
+    click_swap(_root, o._root);
+    click_swap(_nnz, o._nnz);
+    click_swap(_count, o._count);
+}
+
+
 int
 AggregateCounter::configure(Vector<String> &conf, ErrorHandler *errh)
 {
@@ -122,6 +194,14 @@ AggregateCounter::initialize(ErrorHandler *errh)
     if (_call_count_h && _call_count_h->initialize_write(this, errh) < 0)
 	return -1;
 
+    if (master()->nthreads() > 1)
+	for (int i = 0; i < master()->nthreads(); i++) {
+	    Slot *s = new Slot;
+	    if (!s)
+		return errh->error("out of memory!");
+	    _slots.push_back(s);
+	}
+
     if (clear(errh) < 0)
 	return -1;
 
@@ -133,84 +213,25 @@ AggregateCounter::initialize(ErrorHandler *errh)
 void
 AggregateCounter::cleanup(CleanupStage)
 {
-    for (int i = 0; i < _blocks.size(); i++)
-	delete[] _blocks[i];
-    _blocks.clear();
+    _trie.kill();
+    for (int i = 0; i < _slots.size(); i++)
+	delete _slots[i];
+    _slots.clear();
     delete _call_nnz_h;
     delete _call_count_h;
     _call_nnz_h = _call_count_h = 0;
 }
 
-AggregateCounter::Node *
-AggregateCounter::make_peer(uint32_t a, Node *n, bool frozen)
+inline AggregateCounter::Slot *
+AggregateCounter::current_slot()
 {
-    /*
-     * become a peer
-     * algo: create two nodes, the two peers.  leave orig node as
-     * the parent of the two new ones.
-     */
-
-    if (frozen)
-	return 0;
-
-    Node *down[2];
-    if (!(down[0] = new_node()))
-	return 0;
-    if (!(down[1] = new_node())) {
-	free_node(down[0]);
+    if (!_slots.size())
 	return 0;
-    }
-
-    // swivel is first bit 'a' and 'old->input' differ
-    int swivel = ffs_msb(a ^ n->aggregate);
-    // bitvalue is the value of that bit of 'a'
-    int bitvalue = (a >> (32 - swivel)) & 1;
-    // mask masks off all bits before swivel
-    uint32_t mask = (swivel == 1 ? 0 : (0xFFFFFFFFU << (33 - swivel)));
-
-    down[bitvalue]->aggregate = a;
-    down[bitvalue]->count = 0;
-    down[bitvalue]->child[0] = down[bitvalue]->child[1] = 0;
-
-    *down[1 - bitvalue] = *n;	/* copy orig node down one level */
-
-    n->aggregate = (down[0]->aggregate & mask);
-    if (down[0]->aggregate == n->aggregate) {
-	n->count = down[0]->count;
-	down[0]->count = 0;
-    } else
-	n->count = 0;
-    n->child[0] = down[0];	/* point to children */
-    n->child[1] = down[1];
-
-    return (n->aggregate == a ? n : down[bitvalue]);
-}
-
-AggregateCounter::Node *
-AggregateCounter::find_node(uint32_t a, bool frozen)
-{
-    // straight outta tcpdpriv
-    Node *n = _root;
-    while (n) {
-	if (n->aggregate == a)
-	    return (n->count || !frozen ? n : 0);
-	if (!n->child[0])
-	    n = make_peer(a, n, frozen);
-	else {
-	    // swivel is the first bit in which the two children differ
-	    int swivel = ffs_msb(n->child[0]->aggregate ^ n->child[1]->aggregate);
-	    if (ffs_msb(a ^ n->aggregate) < swivel) // input differs earlier
-		n = make_peer(a, n, frozen);
-	    else if (a & (1 << (32 - swivel)))
-		n = n->child[1];
-	    else
-		n = n->child[0];
-	}
-    }
-
-    if (!frozen)
-	click_chatter("AggregateCounter: out of memory!");
-    return 0;
+    // handlers and other non-driver threads share thread 0's slot
+    for (int i = 1; i < _slots.size(); i++)
+	if (master()->thread(i)->current_thread_is_running())
+	    return _slots[i];
+    return _slots[0];
 }
 
 inline bool
@@ -221,9 +242,6 @@ AggregateCounter::update(Packet *p, bool frozen)
 
     // AGGREGATE_ANNO is already in host byte order!
     uint32_t agg = AGGREGATE_ANNO(p);
-    Node *n = find_node(agg, frozen);
-    if (!n)
-	return false;
 
     uint32_t amount;
     if (!_bytes)
@@ -234,23 +252,55 @@ AggregateCounter::update(Packet *p, bool frozen)
 	    amount -= p->network_header_offset();
     }
 
-    // update _num_nonzero; possibly call handler
-    if (amount && !n->count) {
-	if (_num_nonzero >= _call_nnz) {
-	    _call_nnz = (uint32_t)(-1);
+    Slot *s = current_slot();
+    Trie &t = (s ? s->trie : _trie);
+    if (s)
+	s->lock.acquire();
+
+    uint32_t *c = t.find(agg);
+    if (!c || !*c) {
+	// The main trie only changes with every slot locked, so it is safe
+	// to look at while we hold our own.
+	bool fresh = !s || !_trie.nonzero(agg);
+	if (frozen && fresh) {
+	    if (s)
+		s->lock.release();
+	    return false;
+	}
+
+	// possibly call the AGGREGATE_CALL handler
+	if (fresh && amount && _call_nnz != (uint32_t)(-1)
+	    && nnz_bound() >= _call_nnz) {
+	    if (s)
+		s->lock.release();
+	    if (!claim_nnz_call(agg))
+		return update(p, frozen);
 	    _call_nnz_h->call_write();
 	    // handler may have changed our state; reupdate
 	    return update(p, frozen || _frozen);
 	}
-	_num_nonzero++;
+
+	if (!c && !(c = t.insert(agg))) {
+	    if (s)
+		s->lock.release();
+	    click_chatter("AggregateCounter: out of memory!");
+	    return false;
+	}
+	if (amount) {
+	    t._nnz++;
+	    if (s && fresh)
+		s->fresh++;
+	}
     }
 
-    n->count += amount;
-    _count += amount;
-    if (_count >= _call_count) {
-	_call_count = (uint64_t)(-1);
+    *c += amount;
+    t._count += amount;
+    if (s)
+	s->lock.release();
+
+    if (_call_count != (uint64_t)(-1) && total_count() >= _call_count
+	&& claim_count_call())
 	_call_count_h->call_write();
-    }
     return true;
 }
 
@@ -271,65 +321,126 @@ AggregateCounter::pull(int port)
 }
 
 
-// CLEAR, REAGGREGATE
+// MERGE, CLEAR, REAGGREGATE
 
 void
-AggregateCounter::clear_node(Node *n)
+AggregateCounter::lock_slots()
 {
-    if (n->child[0]) {
-	clear_node(n->child[0]);
-	clear_node(n->child[1]);
-    }
-    free_node(n);
+    for (int i = 0; i < _slots.size(); i++)
+	_slots[i]->lock.acquire();
 }
 
-int
-AggregateCounter::clear(ErrorHandler *errh)
+void
+AggregateCounter::unlock_slots()
 {
-    if (_root)
-	clear_node(_root);
+    for (int i = _slots.size() - 1; i >= 0; i--)
+	_slots[i]->lock.release();
+}
 
-    if (!(_root = new_node())) {
-	if (errh)
-	    errh->error("out of memory!");
-	return -1;
+void
+AggregateCounter::merge_slots()
+{
+    for (int i = 0; i < _slots.size(); i++) {
+	Trie &t = _slots[i]->trie;
+	for (uint32_t j = 0; j < t._n; j++) {
+	    const Trie::Node &n = t.node(j);
+	    if (n.count && !_trie.add(n.aggregate, n.count))
+		click_chatter("AggregateCounter: out of memory!");
+	}
+	t.clear();
+	_slots[i]->fresh = 0;
     }
-    _root->aggregate = 0;
-    _root->count = 0;
-    _root->child[0] = _root->child[1] = 0;
-    _num_nonzero = 0;
-    _count = 0;
-    return 0;
 }
 
-
 void
-AggregateCounter::reaggregate_node(Node *n)
+AggregateCounter::merge()
 {
-    Node *l = n->child[0], *r = n->child[1];
-    uint32_t count = n->count;
-    free_node(n);
-
-    if ((n = find_node(count, false))) {
-	if (!n->count)
-	    _num_nonzero++;
-	n->count++;
-	_count++;
+    if (_slots.size()) {
+	lock_slots();
+	merge_slots();
+	unlock_slots();
     }
+}
 
-    if (l) {
-	reaggregate_node(l);
-	reaggregate_node(r);
+uint32_t
+AggregateCounter::nnz_bound() const
+{
+    uint32_t nnz = _trie._nnz;
+    for (int i = 0; i < _slots.size(); i++)
+	nnz += _slots[i]->fresh;
+    return nnz;
+}
+
+uint64_t
+AggregateCounter::total_count() const
+{
+    uint64_t count = _trie._count;
+    for (int i = 0; i < _slots.size(); i++)
+	count += _slots[i]->trie._count;
+    return count;
+}
+
+bool
+AggregateCounter::claim_nnz_call(uint32_t agg)
+{
+    // nnz_bound() may count an aggregate once per thread; merge to get the
+    // exact number, and make sure only one thread makes the call
+    lock_slots();
+    merge_slots();
+    bool call = _call_nnz != (uint32_t)(-1) && _trie._nnz >= _call_nnz
+	&& !_trie.nonzero(agg);
+    if (call)
+	_call_nnz = (uint32_t)(-1);
+    unlock_slots();
+    return call;
+}
+
+bool
+AggregateCounter::claim_count_call()
+{
+    _call_lock.acquire();
+    bool call = _call_count != (uint64_t)(-1) && total_count() >= _call_count;
+    if (call)
+	_call_count = (uint64_t)(-1);
+    _call_lock.release();
+    return call;
+}
+
+bool
+AggregateCounter::empty() const
+{
+    for (int i = 0; i < _slots.size(); i++)
+	if (_slots[i]->trie._nnz)
+	    return false;
+    return _trie._nnz == 0;
+}
+
+int
+AggregateCounter::clear(ErrorHandler *)
+{
+    lock_slots();
+    _trie.clear();
+    for (int i = 0; i < _slots.size(); i++) {
+	_slots[i]->trie.clear();
+	_slots[i]->fresh = 0;
     }
+    unlock_slots();
+    return 0;
 }
 
 void
 AggregateCounter::reaggregate_counts()
 {
-    Node *old_root = _root;
-    _root = 0;
-    clear();
-    reaggregate_node(old_root);
+    lock_slots();
+    merge_slots();
+    Trie t;
+    for (uint32_t i = 0; i < _trie._n; i++) {
+	const Trie::Node &n = _trie.node(i);
+	if (n.count && !t.add(n.count, 1))
+	    click_chatter("AggregateCounter: out of memory!");
+    }
+    _trie.swap(t);
+    unlock_slots();
 }
 
 
@@ -353,28 +464,27 @@ write_batch(FILE *f, AggregateCounter::WriteFormat format,
 }
 
 void
-AggregateCounter::write_nodes(Node *n, FILE *f, WriteFormat format,
+AggregateCounter::write_nodes(uint32_t r, FILE *f, WriteFormat format,
 			      uint32_t *buffer, int &pos, int len,
 			      ErrorHandler *errh) const
 {
-    if (n->count > 0) {
-	buffer[pos++] = n->aggregate;
-	buffer[pos++] = n->count;
+    const Trie::Node &n = _trie.node(r >> 1);
+    if (!(r & 1)) {
+	write_nodes(n.child[0], f, format, buffer, pos, len, errh);
+	write_nodes(n.child[1], f, format, buffer, pos, len, errh);
+    } else if (n.count > 0) {
+	buffer[pos++] = n.aggregate;
+	buffer[pos++] = n.count;
 	if (pos == len) {
-	    write_batch(f, format, buffer, pos, _count, errh);
+	    write_batch(f, format, buffer, pos, _trie._count, errh);
 	    pos = 0;
 	}
     }
-
-    if (n->child[0])
-	write_nodes(n->child[0], f, format, buffer, pos, len, errh);
-    if (n->child[1])
-	write_nodes(n->child[1], f, format, buffer, pos, len, errh);
 }
 
 int
 AggregateCounter::write_file(String where, WriteFormat format,
-			     ErrorHandler *errh) const
+			     ErrorHandler *errh)
 {
     FILE *f;
     if (where == "-")
@@ -384,11 +494,16 @@ AggregateCounter::write_file(String where, WriteFormat format,
     if (!f)
 	return errh->error("%s: %s", where.c_str(), strerror(errno));
 
+    // claim_nnz_call() merges into _trie from the data path, so keep the
+    // slots locked until the walk is done
+    lock_slots();
+    merge_slots();
+
     fprintf(f, "!IPAggregate 1.0\n");
     ignore_result(fwrite(_output_banner.data(), 1, _output_banner.length(), f));
     if (_output_banner.length() && _output_banner.back() != '\n')
 	fputc('\n', f);
-    fprintf(f, "!num_nonzero %u\n", _num_nonzero);
+    fprintf(f, "!num_nonzero %u\n", _trie._nnz);
     if (format == WR_BINARY) {
 #if CLICK_BYTE_ORDER == CLICK_BIG_ENDIAN
 	fprintf(f, "!packed_be\n");
@@ -402,9 +517,11 @@ AggregateCounter::write_file(String where, WriteFormat format,
 
     uint32_t buf[1024];
     int pos = 0;
-    write_nodes(_root, f, format, buf, pos, 1024, errh);
+    if (_trie._n)
+	write_nodes(_trie._root, f, format, buf, pos, 1024, errh);
     if (pos)
-	write_batch(f, format, buf, pos, _count, errh);
+	write_batch(f, format, buf, pos, _trie._count, errh);
+    unlock_slots();
 
     bool had_err = ferror(f);
     if (f != stdout)
@@ -449,9 +566,11 @@ AggregateCounter::read_handler(Element *e, void *thunk)
 	else
 	    return String(ac->_call_count) + " " + ac->_call_count_h->unparse();
       case AC_COUNT:
-	return String(ac->_count);
+	ac->merge();
+	return String(ac->_trie._count);
       case AC_NAGG:
-	return String(ac->_num_nonzero);
+	ac->merge();
+	return String(ac->_trie._nnz);
       default:
 	return "<error>";
     }
@@ -468,6 +587,9 @@ AggregateCounter::write_handler(const String &data, Element *e, void *thunk, Err
 	  if (!cp_bool(s, &val))
 	      return errh->error("argument to 'frozen' should be bool");
 	  ac->_frozen = val;
+	  // frozen updates look for existing aggregates in the main trie
+	  if (val)
+	      ac->merge();
 	  return 0;
       }
       case AC_ACTIVE: {
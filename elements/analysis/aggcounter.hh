@@ -1,6 +1,7 @@
 #ifndef CLICK_AGGCOUNTER_HH
 #define CLICK_AGGCOUNTER_HH
 #include <click/element.hh>
+#include <click/sync.hh>
 CLICK_DECLS
 class HandlerCall;
 
@@ -25,6 +26,13 @@ keyword arguments, can put AggregateCounter in a frozen state. Frozen
 AggregateCounters only update existing counters; they do not create new
 counters for previously unseen aggregate values.
 
+Counts are kept in a path-compressed binary trie that costs about 20 bytes per
+aggregate. In a multithreaded router, each thread counts into its own trie,
+so threads do not contend for the counts; the per-thread tries are merged
+whenever a handler needs the totals (C<nagg>, C<count>, the C<write_*_file>
+handlers, C<counts_pdf>), when AGGREGATE_CALL's limit is reached, and when
+AggregateCounter is frozen.
+
 AggregateCounter may have one or two inputs. The optional second input is
 always frozen. (It is only useful when the element is push.) It may also have
 two outputs. If so, and the element is push, then packets that were counted
@@ -168,6 +176,11 @@ Returns the number of aggregates that have been seen so far.
 The aggregate identifier is stored in host byte order. Thus, the aggregate ID
 corresponding to IP address 128.0.0.0 is 2147483648.
 
+In a multithreaded router, a frozen update (including any packet on the second
+input) counts an aggregate that its own thread has seen since the last merge,
+or that was seen before it, but not one seen only by another thread since the
+last merge.
+
 Only available in user-level processes.
 
 =e
@@ -207,18 +220,65 @@ class AggregateCounter : public Element { public:
     void push(int, Packet *);
     Packet *pull(int);
 
-    bool empty() const			{ return _num_nonzero == 0; }
+    bool empty() const;
     int clear(ErrorHandler * = 0);
     enum WriteFormat { WR_TEXT = 0, WR_BINARY = 1, WR_TEXT_IP = 2, WR_TEXT_PDF = 3 };
-    int write_file(String, WriteFormat, ErrorHandler *) const;
+    int write_file(String, WriteFormat, ErrorHandler *);
     void reaggregate_counts();
 
   private:
 
-    struct Node {
-	uint32_t aggregate;
-	uint32_t count;
-	Node *child[2];
+    // A crit-bit trie from aggregates to counts.  Node i is both the leaf
+    // for the i'th aggregate inserted and the interior node added along
+    // with it, which branches on bit 'bit' (node 0's interior part is
+    // unused).  Children are node indexes shifted left by one, with the low
+    // bit set for a leaf.  In-order traversal visits aggregates in
+    // increasing order.
+    struct Trie {
+
+	struct Node {
+	    uint32_t aggregate;
+	    uint32_t count;
+	    uint32_t child[2];
+	    uint32_t bit;
+	};
+
+	enum { BLOCK_SHIFT = 10, BLOCK_SIZE = 1 << BLOCK_SHIFT };
+
+	Vector<Node *> _blocks;
+	uint32_t _n;
+	uint32_t _root;
+	uint32_t _nnz;
+	uint64_t _count;
+
+	Trie()			: _n(0), _nnz(0), _count(0) { }
+	~Trie()			{ kill(); }
+
+	Node &node(uint32_t i) const {
+	    return _blocks[i >> BLOCK_SHIFT][i & (BLOCK_SIZE - 1)];
+	}
+	inline uint32_t *find(uint32_t a) const;
+	bool nonzero(uint32_t a) const {
+	    uint32_t *c = find(a);
+	    return c && *c;
+	}
+	uint32_t *insert(uint32_t a);
+	bool add(uint32_t a, uint32_t amount);
+	void clear();
+	void kill();
+	void swap(Trie &);
+
+    };
+
+    // Each router thread's counts since the last merge.  'fresh' counts
+    // this thread's aggregates that were not in the main trie when first
+    // seen, so the main trie's nnz plus every slot's 'fresh' bounds the
+    // number of distinct aggregates.
+    struct Slot {
+	Spinlock lock;
+	Trie trie;
+	uint32_t fresh;
+	Slot()			: fresh(0) { }
     };
 
     bool _bytes : 1;
@@ -228,11 +288,9 @@ class AggregateCounter : public Element { public:
     bool _frozen;
     bool _active;
 
-    Node *_root;
-    Node *_free;
-    Vector<Node *> _blocks;
-    uint32_t _num_nonzero;
-    uint64_t _count;
+    Trie _trie;
+    Vector<Slot *> _slots;
+    Spinlock _call_lock;
 
     uint32_t _call_nnz;
     HandlerCall *_call_nnz_h;
@@ -241,38 +299,35 @@ class AggregateCounter : public Element { public:
 
     String _output_banner;
 
-    Node *new_node();
-    Node *new_node_block();
-    void free_node(Node *);
-
-    Node *make_peer(uint32_t, Node *, bool frozen);
-    Node *find_node(uint32_t, bool frozen = false);
-    void reaggregate_node(Node *);
-    void clear_node(Node *);
-
-    void write_nodes(Node *, FILE *, WriteFormat, uint32_t *, int &, int, ErrorHandler *) const;
+    inline Slot *current_slot();
+    void lock_slots();
+    void unlock_slots();
+    void merge_slots();
+    void merge();
+    uint32_t nnz_bound() const;
+    uint64_t total_count() const;
+    bool claim_nnz_call(uint32_t);
+    bool claim_count_call();
+
+    void write_nodes(uint32_t, FILE *, WriteFormat, uint32_t *, int &, int, ErrorHandler *) const;
     static int write_file_handler(const String &, Element *, void *, ErrorHandler *);
     static String read_handler(Element *, void *);
     static int write_handler(const String &, Element *, void *, ErrorHandler *);
 
 };
 
-inline AggregateCounter::Node *
-AggregateCounter::new_node()
-{
-    if (_free) {
-	Node *n = _free;
-	_free = n->child[0];
-	return n;
-    } else
-	return new_node_block();
-}
-
-inline void
-AggregateCounter::free_node(Node *n)
+inline uint32_t *
+AggregateCounter::Trie::find(uint32_t a) const
 {
-    n->child[0] = _free;
-    _free = n;
+    if (!_n)
+	return 0;
+    uint32_t r = _root;
+    while (!(r & 1)) {
+	const Node &n = node(r >> 1);
+	r = n.child[(a >> n.bit) & 1];
+    }
+    Node &l = node(r >> 1);
+    return (l.aggregate == a ? &l.count : 0);
 }
 
 CLICK_ENDDECLS
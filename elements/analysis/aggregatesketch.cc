@@ -0,0 +1,298 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * aggregatesketch.{cc,hh} -- fixed-memory aggregate statistics superclass
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "aggregatesketch.hh"
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/packet_anno.hh>
+#include <click/ipflowid.hh>
+#include <clicknet/ip.h>
+#include <clicknet/udp.h>
+CLICK_DECLS
+
+AggregateSketch::AggregateSketch()
+    : _flow_key(false), _memory(0), _seed(0), _count(0)
+{
+}
+
+AggregateSketch::~AggregateSketch()
+{
+}
+
+void *
+AggregateSketch::cast(const char *name)
+{
+    if (strcmp(name, "AggregateSketch") == 0)
+	return this;
+    else
+	return Element::cast(name);
+}
+
+int
+AggregateSketch::configure_keywords(Vector<String> &conf, ErrorHandler *errh)
+{
+    String key = "AGGREGATE";
+    bool bytes = false;
+    bool ip_bytes = false;
+    bool packet_count = true;
+    bool extra_length = true;
+    uint32_t memory = 0;
+    uint32_t seed = 0;
+
+    if (cp_va_kparse_remove_keywords(conf, this, errh,
+		     "KEY", 0, cpWord, &key,
+		     "BYTES", 0, cpBool, &bytes,
+		     "IP_BYTES", 0, cpBool, &ip_bytes,
+		     "MULTIPACKET", 0, cpBool, &packet_count,
+		     "EXTRA_LENGTH", 0, cpBool, &extra_length,
+		     "MEMORY", 0, cpUnsigned, &memory,
+		     "SEED", 0, cpUnsigned, &seed,
+		     cpEnd) < 0)
+	return -1;
+
+    key = key.upper();
+    if (key == "AGGREGATE")
+	_flow_key = false;
+    else if (key == "FLOW")
+	_flow_key = true;
+    else
+	return errh->error("'KEY' should be 'AGGREGATE' or 'FLOW'");
+
+    _bytes = bytes;
+    _ip_bytes = ip_bytes;
+    _use_packet_count = packet_count;
+    _use_extra_length = extra_length;
+    _memory = memory;
+    _seed = seed;
+    return 0;
+}
+
+inline bool
+AggregateSketch::update(Packet *p)
+{
+    Key k;
+    if (!_flow_key) {
+	// AGGREGATE_ANNO is already in host byte order!
+	k.a[0] = AGGREGATE_ANNO(p);
+	k.a[1] = k.a[2] = 0;
+    } else {
+	const click_ip *iph = p->ip_header();
+	if (!p->has_network_header() || iph->ip_v != 4)
+	    return false;
+	k.a[0] = iph->ip_src.s_addr;
+	k.a[1] = iph->ip_dst.s_addr;
+	k.a[2] = 0;
+	if (IP_FIRSTFRAG(iph)
+	    && (iph->ip_p == IP_PROTO_TCP || iph->ip_p == IP_PROTO_UDP
+		|| iph->ip_p == IP_PROTO_DCCP)
+	    && p->transport_length() >= 4) {
+	    const click_udp *udph = p->udp_header();
+	    k.a[2] = udph->uh_sport | (udph->uh_dport << 16);
+	}
+    }
+
+    uint32_t amount;
+    if (!_bytes)
+	amount = 1 + (_use_packet_count ? EXTRA_PACKETS_ANNO(p) : 0);
+    else {
+	amount = p->length() + (_use_extra_length ? EXTRA_LENGTH_ANNO(p) : 0);
+	if (_ip_bytes && p->has_network_header())
+	    amount -= p->network_header_offset();
+    }
+
+    add(k, hash(k), amount);
+    _count += amount;
+    return true;
+}
+
+void
+AggregateSketch::push(int, Packet *p)
+{
+    update(p);
+    output(0).push(p);
+}
+
+Packet *
+AggregateSketch::pull(int)
+{
+    Packet *p = input(0).pull();
+    if (p)
+	update(p);
+    return p;
+}
+
+
+// KEYS
+
+String
+AggregateSketch::unparse_key(const Key &k) const
+{
+    if (!_flow_key)
+	return String(k.a[0]);
+    else
+	return IPFlowID(IPAddress(k.a[0]), k.a[2] & 0xFFFF,
+			IPAddress(k.a[1]), k.a[2] >> 16).unparse();
+}
+
+bool
+AggregateSketch::parse_key(const String &str, Key &k) const
+{
+    k.a[0] = k.a[1] = k.a[2] = 0;
+    if (!_flow_key) {
+	IPAddress a;
+	if (cp_integer(str, &k.a[0]))
+	    return true;
+	else if (cp_ip_address(str, &a)) {
+	    k.a[0] = ntohl(a.addr());
+	    return true;
+	} else
+	    return false;
+    }
+
+    // accept either "SRC SPORT DST DPORT" or IPFlowID's "(SRC, SPORT, DST, DPORT)"
+    StringAccum sa;
+    for (const char *s = str.begin(); s != str.end(); s++)
+	sa << (*s == '(' || *s == ')' || *s == ',' ? ' ' : *s);
+    Vector<String> words;
+    cp_spacevec(sa.take_string(), words);
+    IPAddress src, dst;
+    uint32_t sport, dport;
+    if (words.size() != 4
+	|| !cp_ip_address(words[0], &src) || !cp_integer(words[1], &sport)
+	|| !cp_ip_address(words[2], &dst) || !cp_integer(words[3], &dport)
+	|| sport > 0xFFFF || dport > 0xFFFF)
+	return false;
+    k.a[0] = src.addr();
+    k.a[1] = dst.addr();
+    k.a[2] = htons(sport) | (htons(dport) << 16);
+    return true;
+}
+
+
+// SERIALIZED FORM
+
+String
+AggregateSketch::unparse() const
+{
+    StringAccum sa;
+    sa << '!' << class_name() << " 1.0\n"
+       << "!key " << (_flow_key ? "flow" : "aggregate") << '\n'
+       << "!seed " << _seed << '\n'
+       << "!count " << _count << '\n';
+    unparse_sketch(sa);
+    return sa.take_string();
+}
+
+String
+AggregateSketch::header_value(const Vector<String> &lines, const char *name)
+{
+    int len = strlen(name);
+    for (int i = 0; i < lines.size(); i++) {
+	const String &l = lines[i];
+	if (l.length() > len + 1 && l[0] == '!'
+	    && memcmp(l.data() + 1, name, len) == 0 && l[len + 1] == ' ')
+	    return l.substring(len + 2);
+    }
+    return String();
+}
+
+int
+AggregateSketch::merge(const String &str, ErrorHandler *errh)
+{
+    Vector<String> lines;
+    for (int pos = 0; pos < str.length(); ) {
+	int nl = str.find_left('\n', pos);
+	if (nl < 0)
+	    nl = str.length();
+	String l = str.substring(pos, nl - pos).trim_space();
+	if (l)
+	    lines.push_back(l);
+	pos = nl + 1;
+    }
+
+    uint32_t seed;
+    uint64_t count;
+    if (!lines.size() || lines[0] != "!" + String(class_name()) + " 1.0")
+	return errh->error("not a %s sketch", class_name());
+    else if (header_value(lines, "key") != (_flow_key ? "flow" : "aggregate"))
+	return errh->error("sketch has a different KEY");
+    else if (!cp_integer(header_value(lines, "seed"), &seed) || seed != _seed)
+	return errh->error("sketch has a different SEED");
+    else if (!cp_integer(header_value(lines, "count"), &count))
+	return errh->error("sketch has no count");
+    else if (merge_sketch(lines, errh) < 0)
+	return -1;
+    _count += count;
+    return 0;
+}
+
+void
+AggregateSketch::clear()
+{
+    clear_sketch();
+    _count = 0;
+}
+
+
+// HANDLERS
+
+enum { H_COUNT, H_MEMORY, H_SKETCH, H_MERGE, H_CLEAR };
+
+String
+AggregateSketch::read_handler(Element *e, void *thunk)
+{
+    AggregateSketch *as = static_cast<AggregateSketch *>(e);
+    switch ((intptr_t) thunk) {
+      case H_COUNT:
+	return String(as->_count);
+      case H_MEMORY:
+	return String(as->memory());
+      case H_SKETCH:
+	return as->unparse();
+      default:
+	return "<error>";
+    }
+}
+
+int
+AggregateSketch::write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh)
+{
+    AggregateSketch *as = static_cast<AggregateSketch *>(e);
+    switch ((intptr_t) thunk) {
+      case H_MERGE:
+	return as->merge(str, errh);
+      case H_CLEAR:
+	as->clear();
+	return 0;
+      default:
+	return errh->error("internal error");
+    }
+}
+
+void
+AggregateSketch::add_handlers()
+{
+    add_read_handler("count", read_handler, (void *) H_COUNT);
+    add_read_handler("memory", read_handler, (void *) H_MEMORY);
+    add_read_handler("sketch", read_handler, (void *) H_SKETCH);
+    add_write_handler("merge", write_handler, (void *) H_MERGE, Handler::RAW);
+    add_write_handler("clear", write_handler, (void *) H_CLEAR, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel int64)
+ELEMENT_PROVIDES(AggregateSketch)
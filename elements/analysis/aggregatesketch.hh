@@ -0,0 +1,187 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+#ifndef CLICK_AGGREGATESKETCH_HH
+#define CLICK_AGGREGATESKETCH_HH
+#include <click/element.hh>
+CLICK_DECLS
+class StringAccum;
+
+/*
+=c
+
+AggregateSketch
+
+=s aggregates
+
+fixed-memory aggregate statistics superclass
+
+=d
+
+AggregateSketch is the superclass for CountMinSketch, SpaceSaving, and
+HyperLogLog. These elements summarize the aggregates or flows in a packet
+stream approximately, in a fixed amount of memory chosen at configuration
+time. AggregateCounter and AggregateIPFlows keep exact state for every
+aggregate or flow, so their memory grows without bound on traffic with many
+sources, like a DDoS attack; a sketch's does not.
+
+AggregateSketch elements have one input and one output, and are agnostic.
+Every packet is reduced to a key, which is hashed and added to the sketch.
+Keyword arguments common to all sketches are:
+
+=over 8
+
+=item KEY
+
+Either C<AGGREGATE> or C<FLOW>. With C<AGGREGATE>, the key is the aggregate
+annotation, as set by AggregateIP, AggregateIPFlows, and so forth. With
+C<FLOW>, the key is the packet's IP flow ID: its source and destination
+addresses and, for first fragments of TCP, UDP, and DCCP packets, its source
+and destination ports. Non-IP packets are passed through uncounted. Default
+is C<AGGREGATE>.
+
+=item BYTES
+
+Boolean. If true, then count bytes, not packets. Default is false.
+
+=item IP_BYTES
+
+Boolean. If true, then do not count bytes from the link header. Default is
+false.
+
+=item MULTIPACKET
+
+Boolean. If true, and BYTES is false, then use packets' packet count
+annotations to add to the number of packets seen. Default is true.
+
+=item EXTRA_LENGTH
+
+Boolean. If true, and BYTES is true, then include packets' extra length
+annotations in the byte counts. Default is true.
+
+=item MEMORY
+
+Unsigned. The sketch's memory budget in bytes. Each sketch chooses its size
+parameters so that its state fits in MEMORY bytes; see the individual
+elements. MEMORY may not be given together with those size parameters.
+
+=item SEED
+
+Unsigned. Seed for the sketch's hash function. Sketches can only be merged
+if they have the same SEED. Default is 0.
+
+=back
+
+=h count read-only
+
+Returns the total count (of packets or bytes) summarized by the sketch.
+
+=h memory read-only
+
+Returns the number of bytes of sketch state. This does not change as packets
+arrive.
+
+=h sketch read-only
+
+Returns the sketch in a text form suitable for the C<merge> handler. The
+first line names the element class, followed by parameter lines that start
+with 'C<!>', followed by the sketch's contents.
+
+=h merge write-only
+
+Argument is the C<sketch> text of another sketch of the same class, KEY,
+SEED, and size. Merges that sketch into this one, so that this sketch
+summarizes both streams. This lets sketches from several routers, or several
+time intervals, be combined.
+
+=h clear write-only
+
+Resets the sketch to empty.
+
+=n
+
+The aggregate identifier is stored in host byte order, as in AggregateCounter.
+Flow keys are printed as IPFlowID does.
+
+=a
+
+CountMinSketch, SpaceSaving, HyperLogLog, AggregateCounter, AggregateIP,
+AggregateIPFlows */
+
+class AggregateSketch : public Element { public:
+
+    AggregateSketch();
+    ~AggregateSketch();
+
+    void *cast(const char *);
+    const char *port_count() const	{ return PORTS_1_1; }
+    const char *processing() const	{ return AGNOSTIC; }
+
+    void add_handlers();
+
+    void push(int, Packet *);
+    Packet *pull(int);
+
+    struct Key {
+	uint32_t a[3];
+    };
+
+    String unparse() const;
+    int merge(const String &, ErrorHandler *);
+    void clear();
+
+  protected:
+
+    bool _flow_key;
+    uint32_t _memory;
+    uint32_t _seed;
+    uint64_t _count;
+
+    int configure_keywords(Vector<String> &, ErrorHandler *);
+
+    static inline uint64_t mix(uint64_t);
+    inline uint64_t hash(const Key &) const;
+    String unparse_key(const Key &) const;
+    bool parse_key(const String &, Key &) const;
+    static String header_value(const Vector<String> &lines, const char *name);
+
+    // subclass interface
+    virtual void add(const Key &, uint64_t hash, uint32_t amount) = 0;
+    virtual void unparse_sketch(StringAccum &) const = 0;
+    virtual int merge_sketch(const Vector<String> &lines, ErrorHandler *) = 0;
+    virtual void clear_sketch() = 0;
+    virtual size_t memory() const = 0;
+
+  private:
+
+    bool _bytes : 1;
+    bool _ip_bytes : 1;
+    bool _use_packet_count : 1;
+    bool _use_extra_length : 1;
+
+    inline bool update(Packet *);
+
+    static String read_handler(Element *, void *);
+    static int write_handler(const String &, Element *, void *, ErrorHandler *);
+
+};
+
+inline uint64_t
+AggregateSketch::mix(uint64_t x)
+{
+    // MurmurHash3's 64-bit finalizer
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDULL;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+inline uint64_t
+AggregateSketch::hash(const Key &k) const
+{
+    uint64_t x = mix(((uint64_t) k.a[0] << 32 | k.a[1]) ^ _seed);
+    return mix(x ^ k.a[2]);
+}
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,199 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * countminsketch.{cc,hh} -- estimate per-aggregate counts in fixed memory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "countminsketch.hh"
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/integers.hh>
+CLICK_DECLS
+
+CountMinSketch::CountMinSketch()
+    : _counters(0)
+{
+}
+
+CountMinSketch::~CountMinSketch()
+{
+}
+
+int
+CountMinSketch::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    uint32_t width = 2048, depth = 4;
+    bool have_width, conservative = false;
+    if (configure_keywords(conf, errh) < 0
+	|| cp_va_kparse(conf, this, errh,
+			"WIDTH", cpkC, &have_width, cpUnsigned, &width,
+			"DEPTH", 0, cpUnsigned, &depth,
+			"CONSERVATIVE", 0, cpBool, &conservative,
+			cpEnd) < 0)
+	return -1;
+
+    if (depth < 1 || depth > MAX_DEPTH)
+	return errh->error("'DEPTH' must be between 1 and %d", MAX_DEPTH);
+    if (_memory && have_width)
+	return errh->error("'MEMORY' and 'WIDTH' are mutually exclusive");
+    else if (_memory) {
+	// the largest power of two that fits
+	uint32_t n = _memory / (depth * sizeof(uint64_t));
+	if (n == 0)
+	    return errh->error("'MEMORY' too small for %u rows", depth);
+	width = 1U << (32 - ffs_msb(n));
+	if (width > 0x1000000)
+	    width = 0x1000000;
+    } else if (width < 1 || width > 0x1000000)
+	return errh->error("'WIDTH' must be between 1 and 2^24");
+    else if (width & (width - 1))
+	width = 1U << (33 - ffs_msb(width));
+
+    _width = width;
+    _depth = depth;
+    _conservative = conservative;
+    return 0;
+}
+
+int
+CountMinSketch::initialize(ErrorHandler *errh)
+{
+    if (!(_counters = new uint64_t[_width * _depth]))
+	return errh->error("out of memory!");
+    clear_sketch();
+    return 0;
+}
+
+void
+CountMinSketch::cleanup(CleanupStage)
+{
+    delete[] _counters;
+    _counters = 0;
+}
+
+void
+CountMinSketch::add(const Key &, uint64_t h, uint32_t amount)
+{
+    if (!_conservative)
+	for (uint32_t r = 0; r < _depth; r++)
+	    _counters[index(h, r)] += amount;
+    else {
+	uint32_t idx[MAX_DEPTH];
+	uint64_t est = ~(uint64_t) 0;
+	for (uint32_t r = 0; r < _depth; r++) {
+	    idx[r] = index(h, r);
+	    if (_counters[idx[r]] < est)
+		est = _counters[idx[r]];
+	}
+	est += amount;
+	for (uint32_t r = 0; r < _depth; r++)
+	    if (_counters[idx[r]] < est)
+		_counters[idx[r]] = est;
+    }
+}
+
+uint64_t
+CountMinSketch::estimate(const Key &k) const
+{
+    uint64_t h = hash(k), est = ~(uint64_t) 0;
+    for (uint32_t r = 0; r < _depth; r++)
+	if (_counters[index(h, r)] < est)
+	    est = _counters[index(h, r)];
+    return est;
+}
+
+void
+CountMinSketch::clear_sketch()
+{
+    memset(_counters, 0, sizeof(uint64_t) * _width * _depth);
+}
+
+size_t
+CountMinSketch::memory() const
+{
+    return sizeof(uint64_t) * _width * _depth;
+}
+
+void
+CountMinSketch::unparse_sketch(StringAccum &sa) const
+{
+    sa << "!width " << _width << '\n'
+       << "!depth " << _depth << '\n';
+    for (uint32_t r = 0; r < _depth; r++) {
+	const uint64_t *row = _counters + r * _width;
+	for (uint32_t i = 0; i < _width; i++)
+	    sa << row[i] << (i == _width - 1 ? '\n' : ' ');
+    }
+}
+
+int
+CountMinSketch::merge_sketch(const Vector<String> &lines, ErrorHandler *errh)
+{
+    uint32_t width, depth;
+    if (!cp_integer(header_value(lines, "width"), &width) || width != _width
+	|| !cp_integer(header_value(lines, "depth"), &depth) || depth != _depth)
+	return errh->error("sketch has a different WIDTH or DEPTH");
+
+    // parse everything before changing anything
+    Vector<uint64_t> counters;
+    Vector<String> words;
+    for (int i = 0; i < lines.size(); i++)
+	if (lines[i][0] != '!') {
+	    words.clear();
+	    cp_spacevec(lines[i], words);
+	    for (int j = 0; j < words.size(); j++) {
+		uint64_t c;
+		if (!cp_integer(words[j], &c))
+		    return errh->error("bad counter %<%s%>", words[j].c_str());
+		counters.push_back(c);
+	    }
+	}
+    if ((uint32_t) counters.size() != _width * _depth)
+	return errh->error("sketch has %d counters, expected %u", counters.size(), _width * _depth);
+
+    for (uint32_t i = 0; i < _width * _depth; i++)
+	_counters[i] += counters[i];
+    return 0;
+}
+
+String
+CountMinSketch::read_handler(Element *e, void *)
+{
+    CountMinSketch *cm = static_cast<CountMinSketch *>(e);
+    // e/WIDTH times the total count, rounded up
+    return String((uint64_t) (2.718281828459045 * cm->_count / cm->_width + 0.999999));
+}
+
+int
+CountMinSketch::estimate_handler(int, String &s, Element *e, const Handler *, ErrorHandler *errh)
+{
+    CountMinSketch *cm = static_cast<CountMinSketch *>(e);
+    Key k;
+    if (!cm->parse_key(cp_uncomment(s), k))
+	return errh->error("bad key");
+    s = String(cm->estimate(k));
+    return 0;
+}
+
+void
+CountMinSketch::add_handlers()
+{
+    AggregateSketch::add_handlers();
+    add_read_handler("error", read_handler, 0);
+    set_handler("estimate", Handler::OP_READ | Handler::READ_PARAM, estimate_handler, 0);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(AggregateSketch userlevel int64)
+EXPORT_ELEMENT(CountMinSketch)
@@ -0,0 +1,122 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+#ifndef CLICK_COUNTMINSKETCH_HH
+#define CLICK_COUNTMINSKETCH_HH
+#include "aggregatesketch.hh"
+CLICK_DECLS
+
+/*
+=c
+
+CountMinSketch([I<KEYWORDS>])
+
+=s aggregates
+
+estimates per-aggregate counts in fixed memory
+
+=d
+
+CountMinSketch estimates how many packets or bytes it has seen for each
+aggregate or flow, using a Count-Min sketch: DEPTH rows of WIDTH counters,
+where each key adds its count to one counter per row. A key's estimate is the
+smallest of its counters. Estimates never fall below the true count, and with
+probability 1 - e^-DEPTH they exceed it by at most e/WIDTH times the total
+count. So CountMinSketch is accurate for heavy hitters, which are most of the
+count, and imprecise for small aggregates.
+
+CountMinSketch is an AggregateSketch; it accepts AggregateSketch's keywords
+and handlers as well as these:
+
+=over 8
+
+=item WIDTH
+
+Unsigned. Number of counters per row, rounded up to a power of two. Default
+is 2048.
+
+=item DEPTH
+
+Unsigned, between 1 and 16. Number of rows. Default is 4.
+
+=item MEMORY
+
+Unsigned. If given, WIDTH is the largest power of two such that the sketch
+takes at most MEMORY bytes (8 bytes per counter).
+
+=item CONSERVATIVE
+
+Boolean. If true, use conservative update: a key only raises the counters
+that would otherwise fall below its new estimate. This reduces
+overestimation for small aggregates. Default is false.
+
+=back
+
+=h estimate I<KEY> read-only
+
+Returns the estimated count for I<KEY>. For KEY AGGREGATE, I<KEY> is an
+aggregate number (or an IP address, which is converted to an aggregate as by
+AggregateIP); for KEY FLOW, I<KEY> is 'I<SRC> I<SPORT> I<DST> I<DPORT>'.
+
+=h error read-only
+
+Returns the estimates' error bound, e/WIDTH times the total count.
+
+=e
+
+  FromDump(-, STOP true, FORCE_IP true)
+	-> AggregateIP(ip dst)
+	-> cm :: CountMinSketch(MEMORY 65536)
+	-> Discard;
+
+  DriverManager(wait_stop, read cm.estimate 10.0.0.1);
+
+=a
+
+AggregateSketch, SpaceSaving, HyperLogLog, AggregateCounter */
+
+class CountMinSketch : public AggregateSketch { public:
+
+    CountMinSketch();
+    ~CountMinSketch();
+
+    const char *class_name() const	{ return "CountMinSketch"; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+    uint64_t estimate(const Key &) const;
+
+  private:
+
+    enum { MAX_DEPTH = 16 };
+
+    uint32_t _width;
+    uint32_t _depth;
+    bool _conservative;
+    uint64_t *_counters;
+
+    // counter index of row r for a key with hash h
+    inline uint32_t index(uint64_t h, uint32_t r) const;
+
+    void add(const Key &, uint64_t, uint32_t);
+    void unparse_sketch(StringAccum &) const;
+    int merge_sketch(const Vector<String> &, ErrorHandler *);
+    void clear_sketch();
+    size_t memory() const;
+
+    static String read_handler(Element *, void *);
+    static int estimate_handler(int, String &, Element *, const Handler *, ErrorHandler *);
+
+};
+
+inline uint32_t
+CountMinSketch::index(uint64_t h, uint32_t r) const
+{
+    // double hashing, h1 + r*h2, with an odd h2
+    uint32_t h1 = h, h2 = (h >> 32) | 1;
+    return r * _width + ((h1 + r * h2) & (_width - 1));
+}
+
+CLICK_ENDDECLS
+#endif
@@ -37,12 +37,14 @@ C<SYN>, C<DAT>, and C<ACK> lines have the following fields: packet type,
 direction, timestamp (in seconds past the epoch), unique packet number, packet
 sequence number, packet IP length, payload length, and optional flags.
 
-The file may be compressed with gzip(1) or bzip2(1); FromCapDump will
-run zcat(1) or bzcat(1) to uncompress it.
+The file may be compressed with gzip(1), bzip2(1), or zstd(1).  FromCapDump
+uncompresses it in-process if Click was built with the corresponding library
+(zlib, libbz2, or libzstd), and otherwise runs zcat(1), bzcat(1), or
+zstdcat(1).
 
 FromCapDump reads from the file named FILENAME unless FILENAME is a
-single dash `C<->', in which case it reads from the standard input. It will
-not uncompress the standard input, however.
+single dash `C<->', in which case it reads from the standard input. It
+uncompresses the standard input only in-process.
 
 Output packets have timestamp, aggregate, paint, and packet number
 annotations.  The paint annotation is 0 for data packets and 1 for
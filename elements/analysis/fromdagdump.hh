@@ -22,8 +22,8 @@ Reads packets from a file in ERF format, produced by the University of
 Waikato's DAG tools. Pushes them out the output, and optionally stops the
 driver when there are no more packets.
 
-FromDAGDump also transparently reads gzip- and bzip2-compressed files, if you
-have zcat(1) and bzcat(1) installed.
+FromDAGDump also transparently reads gzip-, bzip2-, and zstd-compressed files,
+uncompressing them in-process or with zcat(1), bzcat(1), or zstdcat(1).
 
 Keyword arguments are:
 
@@ -75,6 +75,8 @@ FromIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
     _sampling_prob = (1 << SAMPLING_SHIFT);
     String default_contents, default_flowid;
 
+    if (_ff.configure_keywords(conf, this, errh) < 0)
+	return -1;
     if (cp_va_kparse(conf, this, errh,
 		     "FILENAME", cpkP+cpkM, cpFilename, &_ff.filename(),
 		     "STOP", 0, cpBool, &stop,
@@ -176,9 +178,28 @@ FromIPSummaryDump::initialize(ErrorHandler *errh)
 	}
     }
 
+    // if partitioned, read the header lines, then find our piece
+    if (_ff.partitioned()) {
+	off_t data_start;
+	while (1) {
+	    data_start = _ff.file_pos();
+	    if (_ff.read_line(line, errh, true) <= 0
+		|| (line[0] != '!' && line[0] != '#'))
+		break;
+	    else if (line[0] == '!')
+		bang_line(line, errh);
+	    if (_binary)
+		return _ff.error(errh, "PARTITION does not support binary dumps");
+	}
+	if (_ff.set_partition_range(data_start, FromFile::resync_line, 0, errh) < 0)
+	    return -1;
+    }
+
     _format_complaint = false;
-    if (output_is_push(0))
+    if (output_is_push(0)) {
 	ScheduleInfo::initialize_task(this, &_task, _active, errh);
+	_nonfull_signal = Notifier::downstream_full_signal(this, 0, &_task);
+    }
     return 0;
 }
 
@@ -338,6 +359,24 @@ set_checksums(WritablePacket *q, click_ip *iph)
     }
 }
 
+void
+FromIPSummaryDump::bang_line(const String &line, ErrorHandler *errh)
+{
+    const char *data = line.begin(), *end = line.end();
+    if (data + 6 <= end && memcmp(data, "!data", 5) == 0 && isspace((unsigned char) data[5]))
+	bang_data(line, errh);
+    else if (data + 8 <= end && memcmp(data, "!flowid", 7) == 0 && isspace((unsigned char) data[7]))
+	bang_flowid(line, errh);
+    else if (data + 7 <= end && memcmp(data, "!proto", 6) == 0 && isspace((unsigned char) data[6]))
+	bang_proto(line, "!proto", errh);
+    else if (data + 11 <= end && memcmp(data, "!aggregate", 10) == 0 && isspace((unsigned char) data[10]))
+	bang_aggregate(line, errh);
+    else if (data + 8 <= end && memcmp(data, "!binary", 7) == 0 && isspace((unsigned char) data[7]))
+	bang_binary(line, errh);
+    else if (data + 10 <= end && memcmp(data, "!contents", 9) == 0 && isspace((unsigned char) data[9]))
+	bang_data(line, errh);
+}
+
 Packet *
 FromIPSummaryDump::read_packet(ErrorHandler *errh)
 {
@@ -354,7 +393,8 @@ FromIPSummaryDump::read_packet(ErrorHandler *errh)
 		goto eof;
 	    else
 		binary = (result == 1);
-	} else if (_ff.read_line(line, errh, true) <= 0) {
+	} else if (_ff.partition_done()
+		   || _ff.read_line(line, errh, true) <= 0) {
 	  eof:
 	    _ff.cleanup();
 	    return 0;
@@ -370,20 +410,8 @@ FromIPSummaryDump::read_packet(ErrorHandler *errh)
 	    break;
 
 	// parse bang lines
-	if (data[0] == '!') {
-	    if (data + 6 <= end && memcmp(data, "!data", 5) == 0 && isspace((unsigned char) data[5]))
-		bang_data(line, errh);
-	    else if (data + 8 <= end && memcmp(data, "!flowid", 7) == 0 && isspace((unsigned char) data[7]))
-		bang_flowid(line, errh);
-	    else if (data + 7 <= end && memcmp(data, "!proto", 6) == 0 && isspace((unsigned char) data[6]))
-		bang_proto(line, "!proto", errh);
-	    else if (data + 11 <= end && memcmp(data, "!aggregate", 10) == 0 && isspace((unsigned char) data[10]))
-		bang_aggregate(line, errh);
-	    else if (data + 8 <= end && memcmp(data, "!binary", 7) == 0 && isspace((unsigned char) data[7]))
-		bang_binary(line, errh);
-	    else if (data + 10 <= end && memcmp(data, "!contents", 9) == 0 && isspace((unsigned char) data[9]))
-		bang_data(line, errh);
-	}
+	if (data[0] == '!')
+	    bang_line(line, errh);
     }
 
     // read packet data
@@ -674,7 +702,7 @@ FromIPSummaryDump::check_timing(Packet *p)
 bool
 FromIPSummaryDump::run_task(Task *)
 {
-    if (!_active)
+    if (!_active || !_nonfull_signal)
 	return false;
     Packet *p;
 
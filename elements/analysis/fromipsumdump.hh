@@ -13,7 +13,7 @@ CLICK_DECLS
 /*
 =c
 
-FromIPSummaryDump(FILENAME [, I<keywords> STOP, TIMING, ACTIVE, ZERO, CHECKSUM, PROTO, MULTIPACKET, SAMPLE, CONTENTS, FLOWID])
+FromIPSummaryDump(FILENAME [, I<keywords> STOP, TIMING, ACTIVE, ZERO, CHECKSUM, PROTO, MULTIPACKET, SAMPLE, CONTENTS, FLOWID, MMAP, PARTITION])
 
 =s traces
 
@@ -25,12 +25,14 @@ Reads IP packet descriptors from a file produced by ToIPSummaryDump, then
 creates packets containing info from the descriptors and pushes them out the
 output. Optionally stops the driver when there are no more packets.
 
-The file may be compressed with gzip(1) or bzip2(1); FromIPSummaryDump will
-run zcat(1) or bzcat(1) to uncompress it.
+The file may be compressed with gzip(1), bzip2(1), or zstd(1).  FromIPSummaryDump
+uncompresses it in-process if Click was built with the corresponding library
+(zlib, libbz2, or libzstd), and otherwise runs zcat(1), bzcat(1), or
+zstdcat(1).
 
 FromIPSummaryDump reads from the file named FILENAME unless FILENAME is a
-single dash 'C<->', in which case it reads from the standard input. It will
-not uncompress the standard input, however.
+single dash 'C<->', in which case it reads from the standard input. It
+uncompresses the standard input only in-process.
 
 Keyword arguments are:
 
@@ -100,6 +102,22 @@ destination address, destination port, and, optionally, protocol). Defines the
 IP addresses and ports used by default. Any flow information in the input file
 will override this setting.
 
+=item MMAP
+
+Boolean. If true, then FromIPSummaryDump will use mmap(2) to access the file.
+Default is true on most operating systems, but false on Linux.
+
+=item PARTITION
+
+Argument has the form `I<I>/I<N>', where 0 E<lt>= I<I> E<lt> I<N>.  If
+supplied, FromIPSummaryDump divides the records following the file's header
+lines into I<N> pieces of roughly equal size, each beginning at a line
+boundary, and emits only the records in piece I<I>.  Several
+FromIPSummaryDump elements with different PARTITION arguments can thus read
+one large dump in parallel; see FromDump for an example.  The file must be an
+uncompressed regular file in text format, and any `C<!>' lines after the
+header are ignored.
+
 =back
 
 Only available in user-level processes.
@@ -113,7 +131,9 @@ set by the dump. Generated packets will usually have short lengths, but the
 extra header length annotations are set correctly.
 
 FromIPSummaryDump is a notifier signal, active when the element is active and
-the dump contains more packets.
+the dump contains more packets.  In push mode, FromIPSummaryDump waits while a
+downstream full notifier, such as a full Queue, says there is no room for more
+packets.
 
 =h sampling_prob read-only
 
@@ -136,6 +156,12 @@ length cannot be determined.
 
 Returns FromIPSummaryDump's position in the file, in bytes.
 
+=h partition read-only
+
+Returns `I<I>/I<N> I<start> I<end>', where I<start> and I<end> are the file
+offsets of this element's piece of the file.  I<End> is `-' for the last
+piece.  Only present if PARTITION was supplied.
+
 =h stop write-only
 
 When written, sets 'active' to false and stops the driver.
@@ -195,6 +221,7 @@ class FromIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
 
     Task _task;
     ActiveNotifier _notifier;
+    NotifierSignal _nonfull_signal;
     Timer _timer;
 
     int _minor_version;
@@ -208,6 +235,7 @@ class FromIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
     void bang_flowid(const String &, ErrorHandler *);
     void bang_aggregate(const String &, ErrorHandler *);
     void bang_binary(const String &, ErrorHandler *);
+    void bang_line(const String &, ErrorHandler *);
     void check_defaults();
     bool check_timing(Packet *p);
     Packet *read_packet(ErrorHandler *);
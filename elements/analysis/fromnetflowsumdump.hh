@@ -24,8 +24,10 @@ summary format described below, then creates packets containing info from the
 descriptors and pushes them out the output. Optionally stops the driver when
 there are no more packets.
 
-FILE may be compressed with gzip(1) or bzip2(1); FromNetFlowSummaryDump will
-run zcat(1) or bzcat(1) to uncompress it.
+FILE may be compressed with gzip(1), bzip2(1), or zstd(1).
+FromNetFlowSummaryDump uncompresses it in-process if Click was built with the
+corresponding library (zlib, libbz2, or libzstd), and otherwise runs zcat(1),
+bzcat(1), or zstdcat(1).
 
 Keyword arguments are:
 
@@ -23,8 +23,8 @@ Reads IP packets from a file in a format used for NLANR traces: either FR,
 FR+, or TSH. Pushes them out the output, and optionally stops the driver when
 there are no more packets.
 
-FromNLANRDump also transparently reads gzip- and bzip2-compressed files, if
-you have zcat(1) and bzcat(1) installed.
+FromNLANRDump also transparently reads gzip-, bzip2-, and zstd-compressed
+files, uncompressing them in-process or with zcat(1), bzcat(1), or zstdcat(1).
 
 Keyword arguments are:
 
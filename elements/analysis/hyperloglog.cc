@@ -0,0 +1,208 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * hyperloglog.{cc,hh} -- estimate the number of distinct aggregates
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "hyperloglog.hh"
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/integers.hh>
+#include <math.h>
+CLICK_DECLS
+
+HyperLogLog::HyperLogLog()
+    : _registers(0)
+{
+}
+
+HyperLogLog::~HyperLogLog()
+{
+}
+
+int
+HyperLogLog::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    uint32_t precision = 12;
+    bool have_precision;
+    if (configure_keywords(conf, errh) < 0
+	|| cp_va_kparse(conf, this, errh,
+			"PRECISION", cpkC, &have_precision, cpUnsigned, &precision,
+			cpEnd) < 0)
+	return -1;
+
+    if (_memory && have_precision)
+	return errh->error("'MEMORY' and 'PRECISION' are mutually exclusive");
+    else if (_memory) {
+	precision = 32 - ffs_msb(_memory);
+	if (precision > MAX_PRECISION)
+	    precision = MAX_PRECISION;
+    }
+    if (precision < MIN_PRECISION || precision > MAX_PRECISION)
+	return errh->error("'PRECISION' must be between %d and %d", MIN_PRECISION, MAX_PRECISION);
+
+    _precision = precision;
+    return 0;
+}
+
+int
+HyperLogLog::initialize(ErrorHandler *errh)
+{
+    if (!(_registers = new uint8_t[1 << _precision]))
+	return errh->error("out of memory!");
+    clear_sketch();
+    return 0;
+}
+
+void
+HyperLogLog::cleanup(CleanupStage)
+{
+    delete[] _registers;
+    _registers = 0;
+}
+
+void
+HyperLogLog::add(const Key &, uint64_t h, uint32_t)
+{
+    // The top PRECISION bits pick a register, which records the longest
+    // run of leading zeros seen in the rest.  The sentinel bit caps the run.
+    uint32_t i = h >> (64 - _precision);
+    uint64_t rest = (h << _precision) | ((uint64_t) 1 << (_precision - 1));
+    uint8_t rank = ffs_msb(rest);
+    if (rank > _registers[i])
+	_registers[i] = rank;
+}
+
+double
+HyperLogLog::estimate() const
+{
+    uint32_t m = 1 << _precision, zeros = 0;
+    double sum = 0;
+    for (uint32_t i = 0; i < m; i++) {
+	sum += ldexp(1.0, -_registers[i]);
+	if (_registers[i] == 0)
+	    zeros++;
+    }
+
+    double alpha;
+    if (m == 16)
+	alpha = 0.673;
+    else if (m == 32)
+	alpha = 0.697;
+    else if (m == 64)
+	alpha = 0.709;
+    else
+	alpha = 0.7213 / (1 + 1.079 / m);
+    double e = alpha * m * m / sum;
+
+    // linear counting is more accurate for small cardinalities; 64-bit
+    // hashes make the large-range correction unnecessary
+    if (e <= 2.5 * m && zeros)
+	e = m * log((double) m / zeros);
+    return e;
+}
+
+void
+HyperLogLog::clear_sketch()
+{
+    memset(_registers, 0, 1 << _precision);
+}
+
+size_t
+HyperLogLog::memory() const
+{
+    return 1 << _precision;
+}
+
+void
+HyperLogLog::unparse_sketch(StringAccum &sa) const
+{
+    static const char hexdigits[] = "0123456789abcdef";
+    sa << "!precision " << _precision << '\n';
+    uint32_t m = 1 << _precision;
+    for (uint32_t i = 0; i < m; i++) {
+	sa << hexdigits[_registers[i] >> 4] << hexdigits[_registers[i] & 15];
+	if ((i & 63) == 63 || i == m - 1)
+	    sa << '\n';
+    }
+}
+
+static inline int
+xvalue(char c)
+{
+    if (c >= '0' && c <= '9')
+	return c - '0';
+    else if (c >= 'a' && c <= 'f')
+	return c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F')
+	return c - 'A' + 10;
+    else
+	return -1;
+}
+
+int
+HyperLogLog::merge_sketch(const Vector<String> &lines, ErrorHandler *errh)
+{
+    uint32_t precision;
+    if (!cp_integer(header_value(lines, "precision"), &precision)
+	|| precision != _precision)
+	return errh->error("sketch has a different PRECISION");
+
+    StringAccum sa;
+    for (int i = 0; i < lines.size(); i++)
+	if (lines[i][0] != '!')
+	    sa << lines[i];
+    uint32_t m = 1 << _precision;
+    if ((uint32_t) sa.length() != 2 * m)
+	return errh->error("sketch has %d registers, expected %u", sa.length() / 2, m);
+    for (int i = 0; i < sa.length(); i++)
+	if (xvalue(sa[i]) < 0)
+	    return errh->error("bad register data");
+
+    // the union of two streams has the larger of each register
+    for (uint32_t i = 0; i < m; i++) {
+	uint8_t r = xvalue(sa[2*i]) * 16 + xvalue(sa[2*i + 1]);
+	if (r > _registers[i])
+	    _registers[i] = r;
+    }
+    return 0;
+}
+
+enum { H_DISTINCT, H_ERROR };
+
+String
+HyperLogLog::read_handler(Element *e, void *thunk)
+{
+    HyperLogLog *hll = static_cast<HyperLogLog *>(e);
+    switch ((intptr_t) thunk) {
+      case H_DISTINCT:
+	return String((uint64_t) (hll->estimate() + 0.5));
+      case H_ERROR:
+	return String(1.04 / sqrt((double) (1 << hll->_precision)));
+      default:
+	return "<error>";
+    }
+}
+
+void
+HyperLogLog::add_handlers()
+{
+    AggregateSketch::add_handlers();
+    add_read_handler("distinct", read_handler, (void *) H_DISTINCT);
+    add_read_handler("error", read_handler, (void *) H_ERROR);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(AggregateSketch userlevel int64)
+EXPORT_ELEMENT(HyperLogLog)
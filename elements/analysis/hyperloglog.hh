@@ -0,0 +1,93 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+#ifndef CLICK_HYPERLOGLOG_HH
+#define CLICK_HYPERLOGLOG_HH
+#include "aggregatesketch.hh"
+CLICK_DECLS
+
+/*
+=c
+
+HyperLogLog([I<KEYWORDS>])
+
+=s aggregates
+
+estimates the number of distinct aggregates in fixed memory
+
+=d
+
+HyperLogLog estimates how many distinct aggregates or flows it has seen,
+using the HyperLogLog algorithm with 2^PRECISION one-byte registers. The
+estimate's relative standard error is about 1.04/sqrt(2^PRECISION): 1.6% at
+the default PRECISION of 12, which takes 4 kB. Small counts are estimated by
+linear counting, which is nearly exact.
+
+HyperLogLog is an AggregateSketch; it accepts AggregateSketch's keywords and
+handlers as well as these:
+
+=over 8
+
+=item PRECISION
+
+Unsigned, between 4 and 20. Log base 2 of the number of registers. Default is
+12.
+
+=item MEMORY
+
+Unsigned. If given, PRECISION is the largest such that the 2^PRECISION
+registers fit in MEMORY bytes.
+
+=back
+
+=h distinct read-only
+
+Returns the estimated number of distinct keys.
+
+=h error read-only
+
+Returns the estimate's relative standard error.
+
+=e
+
+  FromDump(-, STOP true, FORCE_IP true)
+	-> hll :: HyperLogLog(KEY FLOW)
+	-> Discard;
+
+  DriverManager(wait_stop, read hll.distinct);
+
+=a
+
+AggregateSketch, CountMinSketch, SpaceSaving, AggregateCounter */
+
+class HyperLogLog : public AggregateSketch { public:
+
+    HyperLogLog();
+    ~HyperLogLog();
+
+    const char *class_name() const	{ return "HyperLogLog"; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+    double estimate() const;
+
+  private:
+
+    enum { MIN_PRECISION = 4, MAX_PRECISION = 20 };
+
+    uint32_t _precision;
+    uint8_t *_registers;
+
+    void add(const Key &, uint64_t, uint32_t);
+    void unparse_sketch(StringAccum &) const;
+    int merge_sketch(const Vector<String> &, ErrorHandler *);
+    void clear_sketch();
+    size_t memory() const;
+
+    static String read_handler(Element *, void *);
+
+};
+
+CLICK_ENDDECLS
+#endif
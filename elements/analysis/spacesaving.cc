@@ -0,0 +1,310 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * spacesaving.{cc,hh} -- find the top aggregates in fixed memory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "spacesaving.hh"
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+// bytes per tracked key: an Entry, a heap slot, and up to two buckets
+#define SPACESAVING_KEY_BYTES	(sizeof(Entry) + 3 * sizeof(int))
+
+SpaceSaving::SpaceSaving()
+    : _n(0), _e(0), _heap(0), _buckets(0)
+{
+}
+
+SpaceSaving::~SpaceSaving()
+{
+}
+
+int
+SpaceSaving::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    uint32_t capacity = 1000;
+    bool have_capacity;
+    if (configure_keywords(conf, errh) < 0
+	|| cp_va_kparse(conf, this, errh,
+			"CAPACITY", cpkC, &have_capacity, cpUnsigned, &capacity,
+			cpEnd) < 0)
+	return -1;
+
+    if (_memory && have_capacity)
+	return errh->error("'MEMORY' and 'CAPACITY' are mutually exclusive");
+    else if (_memory)
+	capacity = _memory / SPACESAVING_KEY_BYTES;
+    if (capacity < 1 || capacity > 0x1000000)
+	return errh->error("'CAPACITY' must be between 1 and 2^24");
+
+    _capacity = capacity;
+    for (_nbuckets = 1; _nbuckets < _capacity; _nbuckets *= 2)
+	/* nada */;
+    return 0;
+}
+
+int
+SpaceSaving::initialize(ErrorHandler *errh)
+{
+    if (!(_e = new Entry[_capacity])
+	|| !(_heap = new int[_capacity])
+	|| !(_buckets = new int[_nbuckets]))
+	return errh->error("out of memory!");
+    clear_sketch();
+    return 0;
+}
+
+void
+SpaceSaving::cleanup(CleanupStage)
+{
+    delete[] _e;
+    delete[] _heap;
+    delete[] _buckets;
+    _e = 0;
+    _heap = _buckets = 0;
+}
+
+void
+SpaceSaving::clear_sketch()
+{
+    _n = 0;
+    for (uint32_t i = 0; i < _nbuckets; i++)
+	_buckets[i] = -1;
+}
+
+size_t
+SpaceSaving::memory() const
+{
+    return _capacity * (sizeof(Entry) + sizeof(int)) + _nbuckets * sizeof(int);
+}
+
+void
+SpaceSaving::link(int i, uint64_t h)
+{
+    int &b = _buckets[h & (_nbuckets - 1)];
+    _e[i].next = b;
+    b = i;
+}
+
+void
+SpaceSaving::unlink(int i)
+{
+    int *pprev = &_buckets[hash(_e[i].key) & (_nbuckets - 1)];
+    while (*pprev != i)
+	pprev = &_e[*pprev].next;
+    *pprev = _e[i].next;
+}
+
+void
+SpaceSaving::sift_up(int pos)
+{
+    int i = _heap[pos];
+    while (pos > 0) {
+	int parent = (pos - 1) / 2;
+	if (_e[_heap[parent]].count <= _e[i].count)
+	    break;
+	_heap[pos] = _heap[parent];
+	_e[_heap[pos]].heap = pos;
+	pos = parent;
+    }
+    _heap[pos] = i;
+    _e[i].heap = pos;
+}
+
+void
+SpaceSaving::sift_down(int pos)
+{
+    int i = _heap[pos], n = _n;
+    while (1) {
+	int child = 2 * pos + 1;
+	if (child >= n)
+	    break;
+	if (child + 1 < n && _e[_heap[child + 1]].count < _e[_heap[child]].count)
+	    child++;
+	if (_e[i].count <= _e[_heap[child]].count)
+	    break;
+	_heap[pos] = _heap[child];
+	_e[_heap[pos]].heap = pos;
+	pos = child;
+    }
+    _heap[pos] = i;
+    _e[i].heap = pos;
+}
+
+void
+SpaceSaving::add(const Key &k, uint64_t h, uint32_t amount)
+{
+    int i = find(k, h);
+    if (i < 0) {
+	if (_n < _capacity) {
+	    i = _n++;
+	    _e[i].count = _e[i].error = 0;
+	    _heap[i] = i;
+	    sift_up(i);
+	} else {
+	    // replace the smallest key, which stays on top of the heap
+	    i = _heap[0];
+	    unlink(i);
+	    _e[i].error = _e[i].count;
+	}
+	_e[i].key = k;
+	link(i, h);
+    }
+    _e[i].count += amount;
+    sift_down(_e[i].heap);
+}
+
+uint64_t
+SpaceSaving::min_count() const
+{
+    return (_n == _capacity ? _e[_heap[0]].count : 0);
+}
+
+static int
+entry_compar(const void *ap, const void *bp, void *)
+{
+    const SpaceSaving::Entry *a = static_cast<const SpaceSaving::Entry *>(ap);
+    const SpaceSaving::Entry *b = static_cast<const SpaceSaving::Entry *>(bp);
+    // decreasing count, then increasing key, so output is deterministic
+    if (a->count != b->count)
+	return (a->count > b->count ? -1 : 1);
+    return memcmp(&a->key, &b->key, sizeof(a->key));
+}
+
+void
+SpaceSaving::sorted(Vector<Entry> &v) const
+{
+    v.clear();
+    for (uint32_t i = 0; i < _n; i++)
+	v.push_back(_e[i]);
+    click_qsort(v.begin(), v.size(), sizeof(Entry), entry_compar);
+}
+
+void
+SpaceSaving::unparse_sketch(StringAccum &sa) const
+{
+    sa << "!capacity " << _capacity << '\n';
+    Vector<Entry> v;
+    sorted(v);
+    for (int i = 0; i < v.size(); i++)
+	sa << v[i].key.a[0] << ' ' << v[i].key.a[1] << ' ' << v[i].key.a[2]
+	   << ' ' << v[i].count << ' ' << v[i].error << '\n';
+}
+
+int
+SpaceSaving::merge_sketch(const Vector<String> &lines, ErrorHandler *errh)
+{
+    uint32_t capacity;
+    if (!cp_integer(header_value(lines, "capacity"), &capacity)
+	|| capacity != _capacity)
+	return errh->error("sketch has a different CAPACITY");
+
+    Vector<Entry> other;
+    Vector<String> words;
+    for (int i = 0; i < lines.size(); i++)
+	if (lines[i][0] != '!') {
+	    Entry e;
+	    words.clear();
+	    cp_spacevec(lines[i], words);
+	    if (words.size() != 5
+		|| !cp_integer(words[0], &e.key.a[0])
+		|| !cp_integer(words[1], &e.key.a[1])
+		|| !cp_integer(words[2], &e.key.a[2])
+		|| !cp_integer(words[3], &e.count)
+		|| !cp_integer(words[4], &e.error)
+		|| (uint32_t) other.size() == _capacity)
+		return errh->error("bad sketch line %<%s%>", lines[i].c_str());
+	    other.push_back(e);
+	}
+
+    // A key missing from a full summary may have occurred up to that
+    // summary's minimum count times, so it is charged that much in both
+    // count and error.  Then keep the CAPACITY largest.
+    uint64_t my_min = min_count();
+    uint64_t other_min = ((uint32_t) other.size() == _capacity ? (uint64_t) -1 : 0);
+    for (int i = 0; i < other.size(); i++)
+	if (other[i].count < other_min)
+	    other_min = other[i].count;
+
+    Vector<Entry> all;
+    for (uint32_t i = 0; i < _n; i++) {
+	all.push_back(_e[i]);
+	all[i].count += other_min;
+	all[i].error += other_min;
+    }
+    for (int i = 0; i < other.size(); i++) {
+	int j = find(other[i].key, hash(other[i].key));
+	if (j >= 0) {
+	    all[j].count += other[i].count - other_min;
+	    all[j].error += other[i].error - other_min;
+	} else {
+	    all.push_back(other[i]);
+	    all.back().count += my_min;
+	    all.back().error += my_min;
+	}
+    }
+    click_qsort(all.begin(), all.size(), sizeof(Entry), entry_compar);
+
+    clear_sketch();
+    _n = (all.size() < (int) _capacity ? all.size() : _capacity);
+    for (uint32_t i = 0; i < _n; i++) {
+	_e[i] = all[i];
+	link(i, hash(_e[i].key));
+	// 'all' is in decreasing order, so filling the heap from the back
+	// gives a valid min-heap
+	_heap[_n - 1 - i] = i;
+	_e[i].heap = _n - 1 - i;
+    }
+    return 0;
+}
+
+int
+SpaceSaving::query_handler(int, String &s, Element *e, const Handler *h, ErrorHandler *errh)
+{
+    SpaceSaving *ss = static_cast<SpaceSaving *>(e);
+    String str = cp_uncomment(s);
+    if (h->user_data1() == 0) {
+	uint32_t n = ss->_capacity;
+	if (str && !cp_integer(str, &n))
+	    return errh->error("syntax error");
+	Vector<Entry> v;
+	ss->sorted(v);
+	StringAccum sa;
+	for (int i = 0; i < v.size() && (uint32_t) i < n; i++)
+	    sa << ss->unparse_key(v[i].key) << ' ' << v[i].count << ' '
+	       << v[i].error << '\n';
+	s = sa.take_string();
+    } else {
+	Key k;
+	if (!ss->parse_key(str, k))
+	    return errh->error("bad key");
+	int i = ss->find(k, ss->hash(k));
+	s = String(i >= 0 ? ss->_e[i].count : ss->min_count());
+    }
+    return 0;
+}
+
+void
+SpaceSaving::add_handlers()
+{
+    AggregateSketch::add_handlers();
+    set_handler("topk", Handler::OP_READ | Handler::READ_PARAM, query_handler, 0);
+    set_handler("estimate", Handler::OP_READ | Handler::READ_PARAM, query_handler, 1);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(AggregateSketch userlevel int64)
+EXPORT_ELEMENT(SpaceSaving)
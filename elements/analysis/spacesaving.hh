@@ -0,0 +1,125 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+#ifndef CLICK_SPACESAVING_HH
+#define CLICK_SPACESAVING_HH
+#include "aggregatesketch.hh"
+CLICK_DECLS
+
+/*
+=c
+
+SpaceSaving([I<KEYWORDS>])
+
+=s aggregates
+
+finds the top aggregates in fixed memory
+
+=d
+
+SpaceSaving finds the aggregates or flows with the largest packet or byte
+counts using the Space-Saving algorithm. It tracks at most CAPACITY keys, each
+with a count and an error. When a new key arrives and the table is full, it
+replaces the key with the smallest count, inheriting that count as its error.
+A tracked key's true count is between its count minus its error and its count;
+every key whose true count exceeds the total count divided by CAPACITY is
+tracked.
+
+SpaceSaving is an AggregateSketch; it accepts AggregateSketch's keywords and
+handlers as well as these:
+
+=over 8
+
+=item CAPACITY
+
+Unsigned. Number of keys to track. Default is 1000.
+
+=item MEMORY
+
+Unsigned. If given, CAPACITY is the largest that fits in MEMORY bytes. Each
+tracked key takes about 50 bytes.
+
+=back
+
+=h topk [I<N>] read-only
+
+Returns the I<N> tracked keys with the largest counts, one per line, in
+decreasing order of count. Each line contains the key, its count, and its
+error. I<N> defaults to CAPACITY.
+
+=h estimate I<KEY> read-only
+
+Returns the count for I<KEY>. For an untracked key, this is an upper bound:
+the smallest tracked count, or 0 if the table is not full. I<KEY> is as for
+CountMinSketch's C<estimate> handler.
+
+=e
+
+  FromDump(-, STOP true, FORCE_IP true)
+	-> AggregateIP(ip src)
+	-> ss :: SpaceSaving(CAPACITY 100, BYTES true)
+	-> Discard;
+
+  DriverManager(wait_stop, read ss.topk 10);
+
+=a
+
+AggregateSketch, CountMinSketch, HyperLogLog, AggregateCounter */
+
+class SpaceSaving : public AggregateSketch { public:
+
+    SpaceSaving();
+    ~SpaceSaving();
+
+    const char *class_name() const	{ return "SpaceSaving"; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+    struct Entry {
+	Key key;
+	uint64_t count;
+	uint64_t error;
+	int heap;		// position in _heap
+	int next;		// next entry in hash bucket
+    };
+
+  private:
+
+    uint32_t _capacity;
+    uint32_t _n;
+    Entry *_e;
+    int *_heap;			// min-heap of _e indexes by count
+    int *_buckets;
+    uint32_t _nbuckets;		// a power of two
+
+    inline int find(const Key &, uint64_t) const;
+    void link(int, uint64_t);
+    void unlink(int);
+    void sift_up(int);
+    void sift_down(int);
+    uint64_t min_count() const;
+    void sorted(Vector<Entry> &) const;
+
+    void add(const Key &, uint64_t, uint32_t);
+    void unparse_sketch(StringAccum &) const;
+    int merge_sketch(const Vector<String> &, ErrorHandler *);
+    void clear_sketch();
+    size_t memory() const;
+
+    static int query_handler(int, String &, Element *, const Handler *, ErrorHandler *);
+
+};
+
+inline int
+SpaceSaving::find(const Key &k, uint64_t h) const
+{
+    for (int i = _buckets[h & (_nbuckets - 1)]; i >= 0; i = _e[i].next)
+	if (_e[i].key.a[0] == k.a[0] && _e[i].key.a[1] == k.a[1]
+	    && _e[i].key.a[2] == k.a[2])
+	    return i;
+    return -1;
+}
+
+CLICK_ENDDECLS
+#endif
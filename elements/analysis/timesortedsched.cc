@@ -25,7 +25,8 @@
 CLICK_DECLS
 
 TimeSortedSched::TimeSortedSched()
-    : _vec(0), _signals(0), _notifier(Notifier::SEARCH_CONTINUE_WAKE)
+    : _vec(0), _signals(0), _finished(0), _exhausted(0),
+      _notifier(Notifier::SEARCH_CONTINUE_WAKE)
 {
 }
 
@@ -46,9 +47,10 @@ int
 TimeSortedSched::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     _notifier.initialize(Notifier::EMPTY_NOTIFIER, router());
-    _stop = false;
+    _stop = _strict = false;
     return cp_va_kparse(conf, this, errh,
 			"STOP", 0, cpBool, &_stop,
+			"STRICT", 0, cpBool, &_strict,
 		       cpEnd);
 }
 
@@ -57,10 +59,14 @@ TimeSortedSched::initialize(ErrorHandler *errh)
 {
     _vec = new Packet*[ninputs()];
     _signals = new NotifierSignal[ninputs()];
-    if (!_vec || !_signals)
+    _finished = new atomic_uint32_t[ninputs()];
+    _exhausted = new bool[ninputs()];
+    if (!_vec || !_signals || !_finished || !_exhausted)
 	return errh->error("out of memory!");
     for (int i = 0; i < ninputs(); i++) {
 	_vec[i] = 0;
+	_finished[i] = 0;
+	_exhausted[i] = false;
 	_signals[i] = Notifier::upstream_empty_signal(this, i, 0, &_notifier);
     }
     return 0;
@@ -75,11 +81,59 @@ TimeSortedSched::cleanup(CleanupStage)
 		_vec[i]->kill();
     delete[] _vec;
     delete[] _signals;
+    delete[] _finished;
+    delete[] _exhausted;
+}
+
+Packet *
+TimeSortedSched::pull_strict()
+{
+    int which = -1;
+    Timestamp *tv = 0;
+    bool waiting = false, live = false;
+
+    for (int i = 0; i < ninputs(); i++) {
+	if (!_vec[i] && !_exhausted[i]) {
+	    // Check the finished flag before pulling, so an input is
+	    // exhausted only if it was empty after it finished.
+	    bool finished = _finished[i].value();
+	    if (!(_vec[i] = input(i).pull())) {
+		if (finished)
+		    _exhausted[i] = true;
+		else
+		    waiting = true;
+	    }
+	}
+	if (_vec[i]) {
+	    live = true;
+	    Timestamp *this_tv = &_vec[i]->timestamp_anno();
+	    if (!tv || *this_tv < *tv) {
+		which = i;
+		tv = this_tv;
+	    }
+	}
+    }
+
+    // An input that is empty but not finished might yet produce a packet
+    // earlier than any we have, so wait for it.
+    _notifier.set_active(waiting || live);
+    if (which >= 0 && !waiting) {
+	Packet *p = _vec[which];
+	_vec[which] = 0;
+	return p;
+    } else {
+	if (_stop && !waiting && !live)
+	    router()->please_stop_driver();
+	return 0;
+    }
 }
 
 Packet*
 TimeSortedSched::pull(int)
 {
+    if (_strict)
+	return pull_strict();
+
     int which = -1;
     Timestamp* tv = 0;
     bool signals_on = false;
@@ -110,5 +164,23 @@ TimeSortedSched::pull(int)
     }
 }
 
+int
+TimeSortedSched::write_handler(const String &s, Element *e, void *, ErrorHandler *errh)
+{
+    TimeSortedSched *tss = static_cast<TimeSortedSched *>(e);
+    int port;
+    if (!cp_integer(cp_uncomment(s), &port) || port < 0 || port >= tss->ninputs())
+	return errh->error("expected input port number");
+    tss->_finished[port] = 1;
+    tss->_notifier.wake();
+    return 0;
+}
+
+void
+TimeSortedSched::add_handlers()
+{
+    add_write_handler("finished", write_handler, 0);
+}
+
 CLICK_ENDDECLS
 EXPORT_ELEMENT(TimeSortedSched)
@@ -3,6 +3,7 @@
 #define CLICK_TIMESORTEDSCHED_HH
 #include <click/element.hh>
 #include <click/notifier.hh>
+#include <click/atomic.hh>
 CLICK_DECLS
 
 /*
@@ -36,12 +37,27 @@ Boolean. If true, stop the driver when there are no packets available (and the
 upstream notifiers indicate that no packets will become available soon).
 Default is false.
 
+=item STRICT
+
+Boolean. If true, TimeSortedSched never emits a packet while an input might
+still produce an earlier one.  It waits until every input has a packet
+available or has been declared finished by a write to the C<finished>
+handler, and stops the driver (if STOP is true) once all inputs are finished
+and empty.  This preserves timestamp order when the inputs are fed by
+elements running on other threads, which may fall behind.  Default is false.
+
 =back
 
 =n
 
 TimeSortedSched is a notifier signal, active iff any of the upstream notifiers
-are active.
+are active.  In STRICT mode, it stays active while it is waiting for an input.
+
+=h finished write-only
+
+Write an input port number to declare that input finished: once it is empty,
+it will produce no more packets.  Used in STRICT mode, generally from an
+upstream element's END_CALL.
 
 =e
 
@@ -55,6 +71,17 @@ stream, and stops the driver when all the files are exhausted.
   // ...
   tss -> ...;
 
+This example reads one large tcpdump file on two threads and restores
+timestamp order.
+
+  tss :: TimeSortedSched(STRICT true, STOP true);
+  fd0 :: FromDump(FILE, PARTITION 0/2, END_CALL tss.finished 0);
+  fd1 :: FromDump(FILE, PARTITION 1/2, END_CALL tss.finished 1);
+  fd0 -> ThreadSafeQueue -> [0] tss;
+  fd1 -> ThreadSafeQueue -> [1] tss;
+  tss -> ...;
+  StaticThreadSched(fd0 1, fd1 2);
+
 =a
 
 FromDump
@@ -75,14 +102,22 @@ class TimeSortedSched : public Element { public:
     int initialize(ErrorHandler *);
     void cleanup(CleanupStage);
 
+    void add_handlers();
+
     Packet *pull(int);
 
   private:
 
     Packet **_vec;
     NotifierSignal *_signals;
+    atomic_uint32_t *_finished;
+    bool *_exhausted;
     Notifier _notifier;
     bool _stop;
+    bool _strict;
+
+    Packet *pull_strict();
+    static int write_handler(const String &, Element *, void *, ErrorHandler *);
 
 };
 
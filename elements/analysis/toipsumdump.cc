@@ -23,6 +23,7 @@
 #include <click/confparse.hh>
 #include <click/error.hh>
 #include <click/packet_anno.hh>
+#include <click/master.hh>
 #include <clicknet/ip.h>
 #include <clicknet/udp.h>
 #include <clicknet/tcp.h>
@@ -52,6 +53,8 @@ ToIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
     bool header = true;
     bool extra_length = true;
 
+    if (_aw.configure_keywords(conf, this, errh) < 0)
+	return -1;
     if (cp_va_kparse(conf, this, errh,
 		     "FILENAME", cpkP+cpkM, cpFilename, &_filename,
 		     "CONTENTS", 0, cpArgument, &save,
@@ -125,6 +128,8 @@ ToIPSummaryDump::initialize(ErrorHandler *errh)
 	_f = stdout;
 	_filename = "<stdout>";
     }
+    if (_aw.initialize(_f, this, errh) < 0)
+	return -1;
 
     if (input_is_pull(0)) {
 	ScheduleInfo::join_scheduler(this, &_task, errh);
@@ -166,7 +171,9 @@ ToIPSummaryDump::initialize(ErrorHandler *errh)
 	sa << "!binary\n";
 
     // print output
-    if (_header)
+    if (_header && _aw.enabled())
+	_aw.write(sa.data(), sa.length());
+    else if (_header)
 	ignore_result(fwrite(sa.data(), 1, sa.length(), _f));
 
     return 0;
@@ -175,6 +182,7 @@ ToIPSummaryDump::initialize(ErrorHandler *errh)
 void
 ToIPSummaryDump::cleanup(CleanupStage)
 {
+    _aw.cleanup();
     if (_f && _f != stdout)
 	fclose(_f);
     _f = 0;
@@ -252,12 +260,26 @@ ToIPSummaryDump::write_packet(Packet* p, int multipacket)
 
 	if (_bad_packets && _bad_sa)
 	    write_line(_bad_sa.take_string());
+	if (_aw.enabled()) {
+	    if (_aw.write(_sa.data(), _sa.length()))
+		_output_count++;
+	    if (_aw.error())
+		write_error(_aw.error());
+	    return;
+	}
 	ignore_result(fwrite(_sa.data(), 1, _sa.length(), _f));
 
 	_output_count++;
     }
 }
 
+void
+ToIPSummaryDump::write_error(int err)
+{
+    _active = false;
+    click_chatter("ToIPSummaryDump(%s): %s", _filename.c_str(), strerror(err));
+}
+
 void
 ToIPSummaryDump::push(int, Packet *p)
 {
@@ -288,10 +310,16 @@ ToIPSummaryDump::write_line(const String& s)
 {
     if (s.length()) {
 	assert(s.back() == '\n');
-	if (_binary) {
-	    uint32_t marker = htonl(s.length() | 0x80000000U);
-	    ignore_result(fwrite(&marker, 4, 1, _f));
+	uint32_t marker = htonl(s.length() | 0x80000000U);
+	if (_aw.enabled()) {
+	    if (_binary)
+		_aw.write(&marker, 4, s.data(), s.length());
+	    else
+		_aw.write(s.data(), s.length());
+	    return;
 	}
+	if (_binary)
+	    ignore_result(fwrite(&marker, 4, 1, _f));
 	ignore_result(fwrite(s.data(), 1, s.length(), _f));
     }
 }
@@ -301,6 +329,18 @@ ToIPSummaryDump::add_note(const String &s)
 {
     if (s.length()) {
 	int extra = 1 + (s.back() == '\n' ? 0 : 1);
+	if (_aw.enabled()) {
+	    StringAccum sa;
+	    if (_binary) {
+		uint32_t marker = htonl((s.length() + extra) | 0x80000000U);
+		sa.append(reinterpret_cast<const char *>(&marker), 4);
+	    }
+	    sa << '#' << s;
+	    if (extra > 1)
+		sa << '\n';
+	    _aw.write(sa.data(), sa.length());
+	    return;
+	}
 	if (_binary) {
 	    uint32_t marker = htonl((s.length() + extra) | 0x80000000U);
 	    ignore_result(fwrite(&marker, 4, 1, _f));
@@ -316,7 +356,9 @@ int
 ToIPSummaryDump::flush_handler(const String &, Element *e, void *, ErrorHandler *)
 {
     ToIPSummaryDump *tod = (ToIPSummaryDump *) e;
-    if (tod->_f)
+    if (tod->_aw.enabled())
+	tod->_aw.flush();
+    else if (tod->_f)
 	fflush(tod->_f);
     return 0;
 }
@@ -327,8 +369,9 @@ ToIPSummaryDump::add_handlers()
     if (input_is_pull(0))
 	add_task_handlers(&_task);
     add_write_handler("flush", flush_handler, 0);
+    _aw.add_handlers(this);
 }
 
-ELEMENT_REQUIRES(userlevel IPSummaryDump IPSummaryDump_Anno IPSummaryDump_IP IPSummaryDump_TCP IPSummaryDump_UDP IPSummaryDump_ICMP IPSummaryDump_Payload IPSummaryDump_Link)
+ELEMENT_REQUIRES(userlevel AsyncWriter IPSummaryDump IPSummaryDump_Anno IPSummaryDump_IP IPSummaryDump_TCP IPSummaryDump_UDP IPSummaryDump_ICMP IPSummaryDump_Payload IPSummaryDump_Link)
 EXPORT_ELEMENT(ToIPSummaryDump)
 CLICK_ENDDECLS
@@ -5,6 +5,7 @@
 #include <click/task.hh>
 #include <click/straccum.hh>
 #include <click/notifier.hh>
+#include "elements/userlevel/asyncwriter.hh"
 #include "ipsumdumpinfo.hh"
 CLICK_DECLS
 
@@ -157,6 +158,18 @@ Actual packet output immediately follows the 'C<!bad>' line.  Default is true.
 
 Boolean.  If false, then ignore extra length annotations.  Defaults to true.
 
+=item ASYNC
+
+Boolean.  If true, then formatted records are copied into buffers that a
+separate writer thread writes to the file, so a slow disk does not delay
+packet processing.  If the writer falls behind and no buffer is free, the
+record is dropped and counted in the C<drops> handler.  Requires a
+multithreaded Click.  Default is false.
+
+=item ASYNC_BUFFER, ASYNC_NBUFFERS, DIRECT
+
+Control the ASYNC buffers and writer thread, as for ToDump.
+
 =back
 
 =e
@@ -335,6 +348,11 @@ example, are stored this way.
 
 Flush all internal buffers to disk.
 
+=h drops read-only
+
+Returns the number of records dropped because the ASYNC writer thread fell
+behind.  Only present if ASYNC is true.
+
 =a
 
 FromIPSummaryDump, FromDump, ToDump */
@@ -383,11 +401,13 @@ class ToIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
 
     StringAccum _sa;
     StringAccum _bad_sa;
+    AsyncWriter _aw;
 
     String _banner;
 
     bool summary(Packet* p, StringAccum& sa, StringAccum* bad_sa) const;
     void write_packet(Packet* p, int multipacket);
+    void write_error(int err);
     static int flush_handler(const String &, Element *, void *, ErrorHandler *);
 
 };
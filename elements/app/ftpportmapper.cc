@@ -180,16 +180,11 @@ FTPPortMapper::simple_action(Packet *p)
 	 buflen);
 
   // set IP length field, incrementally update IP checksum according to RFC1624
-  // new_sum = ~(~old_sum + ~old_halfword + new_halfword)
   click_ip *wp_iph = wp->ip_header();
   unsigned short old_ip_hw = ((unsigned short *)wp_iph)[1];
   wp_iph->ip_len = htons(wp->length() - wp->ip_header_offset());
   unsigned short new_ip_hw = ((unsigned short *)wp_iph)[1];
-  unsigned ip_sum =
-    (~wp_iph->ip_sum & 0xFFFF) + (~old_ip_hw & 0xFFFF) + new_ip_hw;
-  while (ip_sum >> 16)		// XXX necessary?
-    ip_sum = (ip_sum & 0xFFFF) + (ip_sum >> 16);
-  wp_iph->ip_sum = ~ip_sum;
+  click_update_in_cksum(&wp_iph->ip_sum, old_ip_hw, new_ip_hw);
 
   // set TCP checksum
   // XXX should check old TCP checksum first!!!
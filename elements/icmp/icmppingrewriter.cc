@@ -130,21 +130,10 @@ ICMPPingRewriter::Mapping::initialize(const IPFlowID &in, const IPFlowID &out,
   _is_reverse = is_reverse;
   _reverse = reverse;
 
-  // set checksum deltas
-  const unsigned short *source_words = (const unsigned short *)&in;
-  const unsigned short *dest_words = (const unsigned short *)&_mapto;
-  unsigned delta = 0;
-  for (int i = 0; i < 4; i++) {
-    delta += ~source_words[i] & 0xFFFF;
-    delta += dest_words[i];
-  }
-  delta = (delta & 0xFFFF) + (delta >> 16);
-  _ip_csum_delta = delta + (delta >> 16);
-
-  delta = ~source_words[4] & 0xFFFF;
-  delta += dest_words[4];
-  delta = (delta & 0xFFFF) + (delta >> 16);
-  _icmp_csum_delta = delta + (delta >> 16);
+  // set checksum deltas: addresses for IP, identifier for ICMP
+  _ip_csum_delta = click_in_cksum_delta(&in, &_mapto, 8);
+  _icmp_csum_delta = click_in_cksum_delta((const uint16_t *) &in + 4,
+					  (const uint16_t *) &_mapto + 4, 2);
 }
 
 void
@@ -167,17 +156,13 @@ ICMPPingRewriter::Mapping::apply(WritablePacket *p)
   if (_dst_anno)
     p->set_dst_ip_anno(_mapto.daddr());
 
-  unsigned sum = (~iph->ip_sum & 0xFFFF) + _ip_csum_delta;
-  sum = (sum & 0xFFFF) + (sum >> 16);
-  iph->ip_sum = ~(sum + (sum >> 16));
+  click_update_in_cksum_delta(&iph->ip_sum, _ip_csum_delta);
 
   // ICMP header
   click_icmp_echo *icmph = reinterpret_cast<click_icmp_echo *>(p->icmp_header());
   icmph->icmp_identifier = _mapto.sport();
 
-  unsigned sum2 = (~icmph->icmp_cksum & 0xFFFF) + _icmp_csum_delta;
-  sum2 = (sum2 & 0xFFFF) + (sum2 >> 16);
-  icmph->icmp_cksum = ~(sum2 + (sum2 >> 16));
+  click_update_in_cksum_delta(&icmph->icmp_cksum, _icmp_csum_delta);
 
   // The above incremental algorithm is sufficient for IP headers, because it
   // is always the case that IP headers have at least one nonzero byte (and
@@ -258,6 +258,13 @@ CheckIPHeader::simple_action(Packet *p)
   return(p);
 }
 
+void
+CheckIPHeader::push_batch(int, PacketBatch &batch)
+{
+  simple_action_batch(batch);
+  output(0).push_batch(batch);
+}
+
 String
 CheckIPHeader::read_handler(Element *e, void *)
 {
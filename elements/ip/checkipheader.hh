@@ -120,6 +120,7 @@ class CheckIPHeader : public Element { public:
   void add_handlers();
 
   Packet *simple_action(Packet *);
+  void push_batch(int, PacketBatch &);
 
  private:
 
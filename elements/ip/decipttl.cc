@@ -54,13 +54,19 @@ DecIPTTL::simple_action(Packet *p)
 	//         = ~(~old_sum + ~old_halfword + old_halfword + ~0x0100)
 	//         = ~(~old_sum + ~0 + ~0x0100)
 	//         = ~(~old_sum + 0xFEFF)
-	unsigned long sum = (~ntohs(ip->ip_sum) & 0xFFFF) + 0xFEFF;
-	ip->ip_sum = ~htons(sum + (sum >> 16));
+	click_update_in_cksum_delta(&ip->ip_sum, htons(0xFEFF));
 
 	return q;
     }
 }
 
+void
+DecIPTTL::push_batch(int, PacketBatch &batch)
+{
+    simple_action_batch(batch);
+    output(0).push_batch(batch);
+}
+
 void
 DecIPTTL::add_handlers()
 {
@@ -41,6 +41,7 @@ class DecIPTTL : public Element { public:
     void add_handlers();
 
     Packet *simple_action(Packet *);
+    void push_batch(int, PacketBatch &);
 
   private:
 
@@ -41,7 +41,12 @@ DirectIPLookup::Table::initialize()
     _tbl_24_31_capacity = 4096;
     _vport_capacity = 1024;
     _rtable_capacity = 2048;
+    return allocate();
+}
 
+int
+DirectIPLookup::Table::allocate()
+{
     if ((_tbl_0_23 = (uint16_t *) CLICK_LALLOC((sizeof(uint16_t) + sizeof(uint8_t)) * (1 << 24)))
 	&& (_tbl_24_31 = (uint16_t *) CLICK_LALLOC((sizeof(uint16_t) + sizeof(uint8_t)) * _tbl_24_31_capacity))
 	&& (_vport = (VirtualPort *) CLICK_LALLOC(sizeof(VirtualPort) * _vport_capacity))
@@ -50,8 +55,36 @@ DirectIPLookup::Table::initialize()
 	_tbl_0_23_plen = (uint8_t *) (_tbl_0_23 + (1 << 24));
 	_tbl_24_31_plen = (uint8_t *) (_tbl_24_31 + _tbl_24_31_capacity);
 	return 0;
-    } else
+    } else {
+	cleanup();
 	return -ENOMEM;
+    }
+}
+
+int
+DirectIPLookup::Table::copy(const Table &t)
+{
+    cleanup();
+    _tbl_24_31_capacity = t._tbl_24_31_capacity;
+    _vport_capacity = t._vport_capacity;
+    _rtable_capacity = t._rtable_capacity;
+    if (allocate() < 0)
+	return -ENOMEM;
+
+    memcpy(_tbl_0_23, t._tbl_0_23, (sizeof(uint16_t) + sizeof(uint8_t)) * (1 << 24));
+    memcpy(_tbl_24_31, t._tbl_24_31, (sizeof(uint16_t) + sizeof(uint8_t)) * _tbl_24_31_capacity);
+    memcpy(_vport, t._vport, sizeof(VirtualPort) * _vport_capacity);
+    memcpy(_rtable, t._rtable, sizeof(CleartextEntry) * _rtable_capacity);
+    memcpy(_rt_hashtbl, t._rt_hashtbl, sizeof(int) * PREF_HASHSIZE);
+
+    _rtable_size = t._rtable_size;
+    _tbl_24_31_size = t._tbl_24_31_size;
+    _vport_size = t._vport_size;
+    _rt_empty_head = t._rt_empty_head;
+    _tbl_24_31_empty_head = t._tbl_24_31_empty_head;
+    _vport_head = t._vport_head;
+    _vport_empty_head = t._vport_empty_head;
+    return 0;
 }
 
 void
@@ -499,16 +532,23 @@ int
 DirectIPLookup::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     int r;
-    if ((r = _t.initialize()) < 0)
+    if ((r = _tables.shadow().initialize()) < 0)
 	return r;
-    _t.flush();
+    _tables.shadow().flush();
     return IPRouteTable::configure(conf, errh);
 }
 
+int
+DirectIPLookup::initialize(ErrorHandler *)
+{
+    _tables.activate(this);
+    return 0;
+}
+
 void
 DirectIPLookup::cleanup(CleanupStage)
 {
-    _t.cleanup();
+    _tables.cleanup();
 }
 
 void
@@ -528,41 +568,111 @@ DirectIPLookup::push(int, Packet *p)
 int
 DirectIPLookup::lookup_route(IPAddress dest, IPAddress &gw) const
 {
+    const Table *t = _tables.current();
     uint32_t ip_addr = ntohl(dest.addr());
-    uint16_t vport_i = _t._tbl_0_23[ip_addr >> 8];
+    uint16_t vport_i = t->_tbl_0_23[ip_addr >> 8];
 
     if (vport_i & 0x8000)
-        vport_i = _t._tbl_24_31[((vport_i & 0x7fff) << 8) | (ip_addr & 0xff)];
+        vport_i = t->_tbl_24_31[((vport_i & 0x7fff) << 8) | (ip_addr & 0xff)];
 
-    gw = _t._vport[vport_i].gw;
-    return _t._vport[vport_i].port;
+    gw = t->_vport[vport_i].gw;
+    return t->_vport[vport_i].port;
+}
+
+void
+DirectIPLookup::lookup_route_batch(const IPAddress *dest, IPAddress *gw,
+				   int *port, int n) const
+{
+    const Table *t = _tables.current();
+    uint32_t idx[LOOKUP_BATCH];
+    while (n > 0) {
+	int k = (n < LOOKUP_BATCH ? n : LOOKUP_BATCH);
+
+	// Fetch every first-level entry before using any of them...
+	for (int i = 0; i < k; i++) {
+	    idx[i] = ntohl(dest[i].addr());
+	    click_prefetch(&t->_tbl_0_23[idx[i] >> 8]);
+	}
+	// ...then every second-level entry we need...
+	for (int i = 0; i < k; i++) {
+	    uint16_t vport_i = t->_tbl_0_23[idx[i] >> 8];
+	    if (vport_i & 0x8000) {
+		idx[i] = ((vport_i & 0x7fff) << 8) | (idx[i] & 0xff);
+		click_prefetch(&t->_tbl_24_31[idx[i]]);
+		idx[i] |= 0x80000000U;
+	    } else
+		idx[i] = vport_i;
+	}
+	// ...and finally resolve them.
+	for (int i = 0; i < k; i++) {
+	    uint16_t vport_i = idx[i];
+	    if (idx[i] & 0x80000000U)
+		vport_i = t->_tbl_24_31[idx[i] & 0x7fffffff];
+	    gw[i] = t->_vport[vport_i].gw;
+	    port[i] = t->_vport[vport_i].port;
+	}
+
+	dest += k;
+	gw += k;
+	port += k;
+	n -= k;
+    }
 }
 
 int
 DirectIPLookup::add_route(const IPRoute& route, bool allow_replace, IPRoute* old_route, ErrorHandler *errh)
 {
-    return _t.add_route(route, allow_replace, old_route, errh);
+    int r;
+    if ((r = begin_update(errh)) < 0)
+	return r;
+    if ((r = _tables.shadow().add_route(route, allow_replace, old_route, errh)) >= 0)
+	_tables.log(route, allow_replace ? _tables.SET : _tables.ADD);
+    commit_update();
+    return r;
 }
 
 int
 DirectIPLookup::remove_route(const IPRoute& route, IPRoute* old_route, ErrorHandler *errh)
 {
-    return _t.remove_route(route, old_route, errh);
+    int r;
+    if ((r = begin_update(errh)) < 0)
+	return r;
+    if ((r = _tables.shadow().remove_route(route, old_route, errh)) >= 0)
+	_tables.log(route, _tables.REMOVE);
+    commit_update();
+    return r;
+}
+
+int
+DirectIPLookup::begin_update(ErrorHandler *errh)
+{
+    return _tables.begin(master(), errh);
+}
+
+void
+DirectIPLookup::commit_update()
+{
+    _tables.commit(master());
 }
 
 int
 DirectIPLookup::flush_handler(const String &, Element *e, void *,
-				ErrorHandler *)
+				ErrorHandler *errh)
 {
     DirectIPLookup *t = static_cast<DirectIPLookup *>(e);
-    t->_t.flush();
+    int r;
+    if ((r = t->begin_update(errh)) < 0)
+	return r;
+    t->_tables.shadow().flush();
+    t->_tables.log(IPRoute(), t->_tables.FLUSH);
+    t->commit_update();
     return 0;
 }
 
 String
 DirectIPLookup::dump_routes()
 {
-    return _t.dump();
+    return _tables.current()->dump();
 }
 
 void
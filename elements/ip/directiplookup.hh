@@ -33,6 +33,17 @@ relatively low CPU overhead, allowing for high update rates.
 DirectIPLookup implements the I<DIR-24-8-BASIC> lookup scheme described by
 Gupta, Lin, and McKeown in the paper cited below.
 
+Packets that arrive in a batch are looked up 16 at a time.  DirectIPLookup
+prefetches every packet's first-level table entry, then every needed
+second-level entry, before resolving any of them, so the DRAM accesses for a
+burst overlap instead of stalling one after another.  Packets are then
+forwarded to each output as a batch.
+
+Route updates never stop lookups, even in a multithreaded router: they are
+made to a second copy of the tables and published all at once (see
+IPRouteTable).  The second copy, another 48 MB, is allocated by the first
+update after the router starts.
+
 =h table read-only
 
 Outputs a human-readable version of the current routing table.
@@ -94,6 +105,7 @@ class DirectIPLookup : public IPRouteTable { public:
     const char *processing() const	{ return PUSH; }
 
     int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
     void cleanup(CleanupStage stage);
     void add_handlers();
 
@@ -102,7 +114,10 @@ class DirectIPLookup : public IPRouteTable { public:
     int add_route(const IPRoute&, bool, IPRoute*, ErrorHandler *);
     int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
     int lookup_route(IPAddress, IPAddress&) const;
+    void lookup_route_batch(const IPAddress *, IPAddress *, int *, int) const;
     String dump_routes();
+    int begin_update(ErrorHandler *errh);
+    void commit_update();
 
     static int flush_handler(const String &, Element *, void *, ErrorHandler *);
 
@@ -165,7 +180,9 @@ class DirectIPLookup : public IPRouteTable { public:
 	}
 
 	int initialize();
+	int copy(const Table &);
 	void cleanup();
+	void finish()		{ }
 
 	static inline uint32_t prefix_hash(uint32_t, uint32_t);
 
@@ -179,11 +196,15 @@ class DirectIPLookup : public IPRouteTable { public:
 	int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
 	void flush();
 
+      private:
+
+	int allocate();
+
     };
 
   protected:
 
-    Table _t;
+    IPRouteTableRCU<Table> _tables;
 
     friend class RangeIPLookup;
 
@@ -41,9 +41,7 @@ IPAddrRewriter::IPAddrMapping::apply(WritablePacket *p)
 	    p->set_dst_ip_anno(_mapto.daddr());
     }
 
-    uint32_t sum = (~iph->ip_sum & 0xFFFF) + _ip_csum_delta;
-    sum = (sum & 0xFFFF) + (sum >> 16);
-    iph->ip_sum = ~(sum + (sum >> 16));
+    click_update_in_cksum_delta(&iph->ip_sum, _ip_csum_delta);
 
     mark_used();
 }
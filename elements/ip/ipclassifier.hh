@@ -223,6 +223,14 @@ is using to classify packets. At each step in the program, four bytes
 of packet data are ANDed with a mask and compared against four bytes of
 classifier pattern.
 
+=h jit read/write
+Boolean. Returns true if the program has been compiled into native code.
+See IPFilter.
+
+=h simd read/write
+Boolean. If true, and the CPU supports AVX2, batches of packets are
+classified eight at a time with vector instructions. See IPFilter.
+
 =a Classifier, IPFilter, CheckIPHeader, MarkIPHeader, CheckIPHeader2,
 tcpdump(1) */
 
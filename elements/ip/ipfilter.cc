@@ -18,6 +18,7 @@
 
 #include <click/config.h>
 #include "ipfilter.hh"
+#include "elements/standard/classifiersimd.hh"
 #include <click/glue.hh>
 #include <click/error.hh>
 #include <click/confparse.hh>
@@ -1157,6 +1158,14 @@ IPFilter::configure(Vector<String> &conf, ErrorHandler *errh)
   return (errh->nerrors() == before_nerrors ? 0 : -1);
 }
 
+int
+IPFilter::initialize(ErrorHandler *)
+{
+  // transport-header offsets are stored relative to TRANSP_FAKE_OFFSET
+  compile_programs(TRANSP_FAKE_OFFSET);
+  return 0;
+}
+
 #if CLICK_USERLEVEL
 String
 IPFilter::compressed_program_string(Element *e, void *)
@@ -1202,8 +1211,8 @@ IPFilter::add_handlers()
 // RUNNING
 //
 
-void
-IPFilter::length_checked_push(Packet *p)
+int
+IPFilter::length_checked_match(const Packet *p) const
 {
   const unsigned char *neth_data = p->network_header();
   const unsigned char *transph_data = p->transport_header();
@@ -1247,10 +1256,8 @@ IPFilter::length_checked_push(Packet *p)
     failure:
       off = pr[1];
     gotit:
-      if (off <= 0) {
-	  checked_output_push(-off, p);
-	  return;
-      }
+      if (off <= 0)
+	  return -off;
       pr += off;
       continue;
 
@@ -1267,22 +1274,21 @@ IPFilter::length_checked_push(Packet *p)
   }
 }
 
-void
-IPFilter::push(int, Packet *p)
+inline int
+IPFilter::match(const Packet *p) const
 {
   const unsigned char *neth_data = p->network_header();
   const unsigned char *transph_data = p->transport_header();
 
-  if (_output_everything >= 0) {
-    // must use checked_output_push because the output number might be
-    // out of range
-    checked_output_push(_output_everything, p);
-    return;
-  } else if (p->length() + TRANSP_FAKE_OFFSET - p->transport_header_offset() < _safe_length) {
+  if (_output_everything >= 0)
+    // the output number might be out of range; callers must use
+    // checked_output_push
+    return _output_everything;
+  else if (p->length() + TRANSP_FAKE_OFFSET - p->transport_header_offset() < _safe_length)
     // common case never checks packet length
-    length_checked_push(p);
-    return;
-  }
+    return length_checked_match(p);
+  else if (_jit_match)
+    return _jit_match(neth_data, transph_data);
 
   const uint32_t *pr = _prog.begin();
   const uint32_t *pp;
@@ -1317,14 +1323,67 @@ IPFilter::push(int, Packet *p)
       }
       off = pr[1];
     gotit:
-      if (off <= 0) {
-	  checked_output_push(-off, p);
-	  return;
-      }
+      if (off <= 0)
+	  return -off;
       pr += off;
   }
 }
 
+void
+IPFilter::push(int, Packet *p)
+{
+  checked_output_push(match(p), p);
+}
+
+int
+IPFilter::match_burst(PacketBatch &batch, Packet **p, int *port) const
+{
+  // See Classifier::match_burst.
+  if (!_simd_match) {
+    p[0] = batch.pop_front();
+    port[0] = match(p[0]);
+    return 1;
+  }
+
+  const unsigned char *neth[ClassifierSIMD::width], *transph[ClassifierSIMD::width];
+  int lane[ClassifierSIMD::width], lane_port[ClassifierSIMD::width];
+  int n = 0, nlanes = 0;
+  for (; n < ClassifierSIMD::width && (p[n] = batch.pop_front()); n++)
+    if (p[n]->length() + TRANSP_FAKE_OFFSET - p[n]->transport_header_offset() < _safe_length)
+      port[n] = length_checked_match(p[n]);
+    else {
+      neth[nlanes] = p[n]->network_header();
+      transph[nlanes] = p[n]->transport_header();
+      lane[nlanes++] = n;
+    }
+  if (nlanes) {
+    _simd_match->match(neth, transph, nlanes, lane_port);
+    for (int i = 0; i < nlanes; i++)
+      port[lane[i]] = lane_port[i];
+  }
+  return n;
+}
+
+void
+IPFilter::push_batch(int, PacketBatch &batch)
+{
+  // See Classifier::push_batch.
+  PacketBatch run;
+  int run_port = -1;
+  while (!batch.empty()) {
+    Packet *p[ClassifierSIMD::width];
+    int port[ClassifierSIMD::width];
+    int n = match_burst(batch, p, port);
+    for (int i = 0; i < n; i++) {
+      if (port[i] != run_port && !run.empty())
+	checked_output_push_batch(run_port, run);
+      run_port = port[i];
+      run.push_back(p[i]);
+    }
+  }
+  checked_output_push_batch(run_port, run);
+}
+
 CLICK_ENDDECLS
 ELEMENT_REQUIRES(Classifier)
 EXPORT_ELEMENT(IPFilter)
@@ -107,6 +107,17 @@ is using to classify packets. At each step in the program, four bytes
 of packet data are ANDed with a mask and compared against four bytes of
 classifier pattern.
 
+=h jit read/write
+Boolean. At user level on x86-64, IPFilter compiles its program into native
+code when the router is initialized. Returns true if the compiled program is
+in use. Write false to fall back to the interpreter, or true to switch back.
+See Classifier.
+
+=h simd read/write
+Boolean. If true, and the CPU supports AVX2, batches of packets are
+classified eight at a time with vector instructions. Default is false. See
+Classifier.
+
 =a
 
 IPClassifier, Classifier, CheckIPHeader, MarkIPHeader, CheckIPHeader2,
@@ -127,9 +138,11 @@ class IPFilter : public Classifier { public:
   const char *flags() const			{ return ""; }
 
     int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
     void add_handlers();
 
     void push(int port, Packet *);
+    void push_batch(int port, PacketBatch &);
 
     static String compressed_program_string(Element *, void *);
 
@@ -254,7 +267,9 @@ class IPFilter : public Classifier { public:
   int parse_factor(const Vector<String> &, int, Vector<int> &, Primitive &,
 		 bool negated, ErrorHandler *);
 
-  void length_checked_push(Packet *);
+  inline int match(const Packet *) const;
+  int length_checked_match(const Packet *) const;
+  int match_burst(PacketBatch &, Packet **, int *) const;
 
 };
 
@@ -189,8 +189,7 @@ IPOutputCombo::push(int, Packet *p_in)
     ip->ip_ttl--;
     // 19.Aug.1999 - incrementally update IP checksum as suggested by SOSP
     // reviewers, according to RFC1141 and RFC1624
-    unsigned long sum = (~ntohs(ip->ip_sum) & 0xFFFF) + 0xFEFF;
-    ip->ip_sum = ~htons(sum + (sum >> 16));
+    click_update_in_cksum_delta(&ip->ip_sum, htons(0xFEFF));
   }
 
   // Fragmenter
@@ -23,7 +23,6 @@
 #include "ipreassembler.hh"
 #include <click/ipaddress.hh>
 #include <click/confparse.hh>
-#include <click/bitvector.hh>
 #include <click/error.hh>
 #include <click/glue.hh>
 #include <click/packet_anno.hh>
@@ -36,8 +35,6 @@ CLICK_DECLS
 
 IPReassembler::IPReassembler()
 {
-    for (int i = 0; i < NMAP; i++)
-	_map[i] = 0;
     static_assert(sizeof(ChunkLink) == IPREASSEMBLER_ANNO_SIZE);
 }
 
@@ -61,33 +58,41 @@ int
 IPReassembler::initialize(ErrorHandler *)
 {
     _mem_used = 0;
-    _reap_time = 0;
+    // Size the table for HIMEM's worth of small fragments, each from a
+    // different packet, as in a fragment flood.
+    uint32_t n = _mem_high_thresh / (2 * (IPH_MEM_USED + 8));
+    _table.rehash(n < 256 ? 256 : (n > 65536 ? 65536 : n));
     return 0;
 }
 
 void
 IPReassembler::cleanup(CleanupStage)
 {
-    for (int i = 0; i < NMAP; i++)
-	while (_map[i]) {
-	    WritablePacket *next = (WritablePacket *)(_map[i]->next());
-	    _map[i]->kill();
-	    _map[i] = next;
+    for (Table::iterator it = _table.begin(); it; ) {
+	Datagram *d = _table.erase(it);
+	while (Packet *p = d->_head) {
+	    d->_head = p->next();
+	    p->kill();
 	}
+	d->~Datagram();
+	_alloc.deallocate(d);
+    }
+    _lru.__clear();
+    _mem_used = 0;
 }
 
 void
-IPReassembler::check_error(ErrorHandler *errh, int bucket, const Packet *p, const char *format, ...)
+IPReassembler::check_error(ErrorHandler *errh, const Datagram *d, const Packet *p, const char *format, ...)
 {
     va_list val;
     va_start(val, format);
     StringAccum sa;
-    sa << "buck " << bucket << ": ";
-    if (p->has_network_header()) {
+    sa << IPAddress(d->_key.src) << " > " << IPAddress(d->_key.dst) << " [" << ntohs(d->_key.id) << ']';
+    if (p && p->has_network_header()) {
 	const click_ip *iph = p->ip_header();
-	sa << iph->ip_src << " > " << iph->ip_dst << " [" << ntohs(iph->ip_id) << ':' << PACKET_DLEN(p) << ((iph->ip_off & htons(IP_MF)) ? "+]: " : "]: ");
+	sa << " [" << IP_BYTE_OFF(iph) << ':' << PACKET_DLEN(p) << ((iph->ip_off & htons(IP_MF)) ? "+]" : "]");
     }
-    sa << format;
+    sa << ": " << format;
     errh->xmessage(ErrorHandler::e_error, sa.c_str(), val);
     va_end(val);
 }
@@ -98,125 +103,202 @@ IPReassembler::check(ErrorHandler *errh)
     if (!errh)
 	errh = ErrorHandler::default_handler();
     uint32_t mem_used = 0;
-    for (int b = 0; b < NMAP; b++)
-	for (WritablePacket *q = _map[b]; q; q = (WritablePacket *)(q->next()))
-	    if (q->has_network_header()) {
-		const click_ip *qip = q->ip_header();
-		if (bucketno(qip) != b)
-		    check_error(errh, b, q, "in wrong bucket");
-		mem_used += IPH_MEM_USED + q->transport_length();
-		ChunkLink *chunk = &PACKET_CHUNK(q);
-		int off = 0;
-#if VERBOSE_DEBUG
-		check_error(errh, b, q, "");
-		StringAccum sa;
-		while (chunk && (!off || off < q->transport_length())) {
-		    sa << " (" << chunk->off << ',' << chunk->lastoff << ')';
-		    off = chunk->lastoff;
-		    chunk = next_chunk(q, chunk);
-		}
-		errh->message("  %s", sa.c_str());
-		chunk = &PACKET_CHUNK(q);
-		off = 0;
-#endif
-		while (chunk) {
-		    if (chunk->off >= chunk->lastoff
-			|| chunk->lastoff > q->transport_length()
-			|| (off != 0 && chunk->off < off + 8)) {
-			check_error(errh, b, q, "bad chunk (%d, %d) at %d", chunk->off, chunk->lastoff, off);
-			break;
-		    }
-		    off = chunk->lastoff;
-		    chunk = next_chunk(q, chunk);
-		}
-	    } else
-		errh->error("buck %d: missing IP header", b);
+    int ndatagrams = 0;
+    for (Table::iterator it = _table.begin(); it; ++it) {
+	const Datagram *d = it.get();
+	ndatagrams++;
+	if (!d->_head)
+	    check_error(errh, d, 0, "no fragments");
+	uint32_t d_mem_used = 0;
+	for (const Packet *p = d->_head; p; p = p->next()) {
+	    if (!p->has_network_header()) {
+		check_error(errh, d, 0, "missing IP header");
+		continue;
+	    }
+	    if (!(FragKey(p->ip_header()) == d->_key))
+		check_error(errh, d, p, "in wrong datagram");
+	    const ChunkLink &chunk = PACKET_CHUNK(p);
+	    int p_off = IP_BYTE_OFF(p->ip_header());
+	    if (chunk.off >= chunk.lastoff
+		|| chunk.lastoff > d->_maxoff
+		|| chunk.off < p_off
+		|| chunk.lastoff > p_off + PACKET_DLEN(p))
+		check_error(errh, d, p, "bad chunk (%d, %d)", chunk.off, chunk.lastoff);
+	    if (!p->next() && p != d->_tail)
+		check_error(errh, d, p, "bad tail");
+	    d_mem_used += IPH_MEM_USED + chunk.lastoff - chunk.off;
+	}
+	if (d_mem_used != d->_mem_used)
+	    check_error(errh, d, 0, "bad mem_used: have %u, claim %u", d_mem_used, d->_mem_used);
+	for (int i = 0; i < d->_nholes; i++) {
+	    const ChunkLink &hole = d->_holes[i];
+	    if (hole.off >= hole.lastoff
+		|| (i > 0 && hole.off <= d->_holes[i - 1].lastoff)
+		|| (d->_final >= 0 && hole.lastoff > d->_final))
+		check_error(errh, d, 0, "bad hole (%d, %d)", hole.off, hole.lastoff);
+	}
+	mem_used += d_mem_used;
+    }
+    if (ndatagrams != (int) _lru.size())
+	errh->error("bad LRU list: have %d, claim %d", (int) _lru.size(), ndatagrams);
     if (mem_used != _mem_used)
 	errh->error("bad mem_used: have %u, claim %u", mem_used, _mem_used);
     return 0;
 }
 
-WritablePacket *
-IPReassembler::find_queue(Packet *p, WritablePacket ***store_pprev)
+// Adds fragment p, holding bytes [off, lastoff), to d. Earlier fragments'
+// data wins, so p keeps only the pieces that fill holes, one packet per
+// piece. Returns false if p was inconsistent with d's earlier fragments or d
+// was discarded, in which case p is gone.
+bool
+IPReassembler::add_fragment(Datagram *d, Packet *p, int off, int lastoff, bool more)
 {
-    const click_ip *iph = p->ip_header();
-    int bucket = bucketno(iph);
-    WritablePacket **pprev = &_map[bucket];
-    WritablePacket *q;
-    for (q = *pprev; q; pprev = (WritablePacket **)&q->next(), q = *pprev) {
-	const click_ip *qiph = q->ip_header();
-	if (same_segment(iph, qiph)) {
-	    *store_pprev = pprev;
-	    return q;
+    // a packet's end cannot move once its last fragment arrives
+    if (more ? d->_final >= 0 && lastoff > d->_final
+	: (d->_final >= 0 && lastoff != d->_final) || lastoff < d->_maxoff) {
+	p->kill();
+	return false;
+    }
+
+    // fill holes (RFC 815)
+    ChunkLink holes[Datagram::MAX_HOLES + 1];
+    ChunkLink fills[Datagram::MAX_HOLES];
+    int nholes = 0, nfills = 0;
+    for (int i = 0; i < d->_nholes; i++) {
+	ChunkLink hole = d->_holes[i];
+	if (!more) {
+	    if (hole.off >= lastoff)
+		continue;
+	    if (hole.lastoff > lastoff)
+		hole.lastoff = lastoff;
+	}
+	if (lastoff <= hole.off || off >= hole.lastoff) {
+	    holes[nholes++] = hole;
+	    continue;
+	}
+	fills[nfills].off = (hole.off < off ? off : hole.off);
+	fills[nfills++].lastoff = (hole.lastoff > lastoff ? lastoff : hole.lastoff);
+	if (hole.off < off) {
+	    holes[nholes].off = hole.off;
+	    holes[nholes++].lastoff = off;
+	}
+	if (lastoff < hole.lastoff) {
+	    holes[nholes].off = lastoff;
+	    holes[nholes++].lastoff = hole.lastoff;
 	}
     }
-    *store_pprev = &_map[bucket];
-    return 0;
+    if (nholes > Datagram::MAX_HOLES) {
+	p->kill();
+	expire(d);
+	return false;
+    }
+
+    // pieces after the first share p's data
+    Packet *pieces[Datagram::MAX_HOLES];
+    if (nfills)
+	pieces[0] = p;
+    for (int i = 1; i < nfills; i++)
+	if (!(pieces[i] = p->clone())) {
+	    while (--i >= 0)
+		pieces[i]->kill();
+	    click_chatter("out of memory");
+	    return true;
+	}
+
+    memcpy(d->_holes, holes, sizeof(ChunkLink) * nholes);
+    d->_nholes = nholes;
+    if (!more)
+	d->_final = lastoff;
+    if (lastoff > d->_maxoff)
+	d->_maxoff = lastoff;
+
+    // keep p only if it brings new data, so repeated fragments cost nothing
+    if (!nfills) {
+	p->kill();
+	return true;
+    }
+    for (int i = 0; i < nfills; i++) {
+	Packet *q = pieces[i];
+	PACKET_CHUNK(q) = fills[i];
+	q->set_next(0);
+	if (d->_tail)
+	    d->_tail->set_next(q);
+	else
+	    d->_head = q;
+	d->_tail = q;
+	uint32_t mem = IPH_MEM_USED + fills[i].lastoff - fills[i].off;
+	d->_mem_used += mem;
+	_mem_used += mem;
+    }
+    return true;
 }
 
+// Returns a packet containing d's fragments at their proper offsets. Each
+// holds only the bytes it was first to supply, so none overlap. The header
+// comes from the first fragment, if it has arrived.
 Packet *
-IPReassembler::emit_whole_packet(WritablePacket *q, WritablePacket **q_pprev,
-				 Packet *p_in)
+IPReassembler::assemble(Datagram *d, bool complete)
 {
-    *q_pprev = (WritablePacket *)q->next();
-
+    const Packet *first = 0;
+    for (const Packet *p = d->_head; p; p = p->next())
+	if (PACKET_CHUNK(p).off == 0)
+	    first = p;
+    const Packet *hp = (first ? first : d->_head);
+    const click_ip *hiph = hp->ip_header();
+    int hl = (first ? hiph->ip_hl << 2 : sizeof(click_ip));
+    int len = (complete ? d->_final : d->_maxoff);
+
+    WritablePacket *q = Packet::make(Packet::default_headroom, 0, hl + len, 0);
+    if (!q) {
+	click_chatter("out of memory");
+	return 0;
+    }
+    q->set_ip_header((click_ip *)q->data(), hl);
     click_ip *q_iph = q->ip_header();
-    q_iph->ip_len = htons(q->network_length());
+    memcpy(q_iph, hiph, hl);
+    if (!complete)
+	memset(q->transport_header(), 0, len);
+    for (const Packet *p = d->_head; p; p = p->next()) {
+	const ChunkLink &chunk = PACKET_CHUNK(p);
+	int p_off = IP_BYTE_OFF(p->ip_header());
+	memcpy(q->transport_header() + chunk.off, p->transport_header() + chunk.off - p_off, chunk.lastoff - chunk.off);
+    }
+
+    q_iph->ip_off = hiph->ip_off & ~htons(IP_OFFMASK | IP_MF); // leave DF, RF
+    if (d->_final < 0)
+	q_iph->ip_off |= htons(IP_MF);
+    q_iph->ip_len = htons(hl + len);
     q_iph->ip_sum = 0;
-    q_iph->ip_sum = click_in_cksum((const unsigned char *)q_iph, q_iph->ip_hl << 2);
+    q_iph->ip_sum = click_in_cksum((const unsigned char *)q_iph, hl);
 
+    q->copy_annotations(hp);
     // zero out the annotations we used
     memset(&PACKET_CHUNK(q), 0, sizeof(ChunkLink));
-    q->set_timestamp_anno(p_in->timestamp_anno());
-    q->set_next(0);
-
-    p_in->kill();
-    _mem_used -= IPH_MEM_USED + q->transport_length();
+    q->set_timestamp_anno(d->_tail->timestamp_anno());
     return q;
 }
 
 void
-IPReassembler::make_queue(Packet *p, WritablePacket **q_pprev)
+IPReassembler::destroy(Datagram *d)
 {
-    const click_ip *iph = p->ip_header();
-    int p_off = IP_BYTE_OFF(iph);
-    int p_lastoff = p_off + PACKET_DLEN(p);
-
-    int hl = (p_off == 0 ? iph->ip_hl << 2 : 20);
-    WritablePacket *q = Packet::make(60 - hl, 0, hl + p_lastoff, 0);
-    if (!q) {
-	click_chatter("out of memory");
-	return;
+    _table.erase(d->_key);
+    _lru.erase(d);
+    while (Packet *p = d->_head) {
+	d->_head = p->next();
+	p->kill();
     }
-    _mem_used += IPH_MEM_USED + p_lastoff;
-
-    // copy IP header and annotations if appropriate
-    q->set_ip_header((click_ip *)q->data(), hl);
-    memcpy(q->ip_header(), iph, hl);
-    click_ip *q_iph = q->ip_header();
-    q_iph->ip_off = (iph->ip_off & ~htons(IP_OFFMASK)); // leave MF, DF, RF
-    if (p_off == 0)
-	q->copy_annotations(p);
-
-    // copy data
-    memcpy(q->transport_header() + p_off, p->transport_header(), PACKET_DLEN(p));
-    PACKET_CHUNK(q).off = p_off;
-    PACKET_CHUNK(q).lastoff = p_lastoff;
-
-    // link it up
-    q->set_next(*q_pprev);
-    *q_pprev = q;
-
-    check();
+    _mem_used -= d->_mem_used;
+    d->~Datagram();
+    _alloc.deallocate(d);
 }
 
-IPReassembler::ChunkLink *
-IPReassembler::next_chunk(WritablePacket *q, ChunkLink *chunk)
+void
+IPReassembler::expire(Datagram *d)
 {
-    if (chunk->lastoff >= q->transport_length())
-	return 0;
-    else
-	return (ChunkLink *)(q->transport_header() + chunk->lastoff);
+    Packet *q = (noutputs() > 1 && d->_head ? assemble(d, false) : 0);
+    destroy(d);
+    if (q)
+	output(1).push(q);
 }
 
 Packet *
@@ -234,17 +316,17 @@ IPReassembler::simple_action(Packet *p)
 	p->timestamp_anno().set_now();
 	now = p->timestamp_anno().sec();
     }
-    if (now >= _reap_time)
-	reap(now);
+    reap(now);
 
     // calculate packet edges
     int p_off = IP_BYTE_OFF(iph);
     int p_lastoff = p_off + ntohs(iph->ip_len) - (iph->ip_hl << 2);
+    bool more = (iph->ip_off & htons(IP_MF)) != 0;
 
     // check uncommon, but annoying, case: bad length, bad length + offset,
     // or middle fragment length not a multiple of 8 bytes
     if (p_lastoff > 0xFFFF || p_lastoff <= p_off
-	|| ((p_lastoff & 7) != 0 && (iph->ip_off & htons(IP_MF)) != 0)
+	|| ((p_lastoff & 7) != 0 && more)
 	|| PACKET_DLEN(p) < p_lastoff - p_off) {
 	p->kill();
 	return 0;
@@ -255,151 +337,60 @@ IPReassembler::simple_action(Packet *p)
 
     // clean up memory if necessary
     if (_mem_used > _mem_high_thresh)
-	reap_overfull(now);
-
-    // get its Packet queue
-    WritablePacket **q_pprev;
-    WritablePacket *q = find_queue(p, &q_pprev);
-    if (!q) {			// make a new queue
-	make_queue(p, q_pprev);
-	p->kill();
-	return 0;
-    }
-    WritablePacket *q_bucket_next = (WritablePacket *)(q->next());
-
-    // extend the packet if necessary
-    if (p_lastoff > q->transport_length()) {
-	// error if packet already completed
-	if (!(q->ip_header()->ip_off & htons(IP_MF))) {
-	    p->kill();
-	    return 0;
-	}
-	// Figure out how much space to request. Add 8 extra bytes to ensure
-	// room for a ChunkLink, and request extra space if this packet has MF
-	// set. XXX This algorithm could result in a number of intermediate
-	// packet copies linear in the final packet length.
-	int old_transport_length = q->transport_length();
-	assert((old_transport_length & 7) == 0);
-	int want_space = p_lastoff - old_transport_length + 8;
-	if (iph->ip_off & htons(IP_MF))
-	    want_space += (p_lastoff - p_off);
-	// request space
-	if (!(q = q->put(want_space))) {
+	reap_overfull();
+
+    // find its datagram, making one if necessary
+    FragKey key(iph);
+    Table::iterator it = _table.find(key);
+    Datagram *d = it.get();
+    if (!d) {
+	void *x = _alloc.allocate();
+	if (!x) {
 	    click_chatter("out of memory");
-	    *q_pprev = q_bucket_next;
-	    _mem_used -= IPH_MEM_USED + old_transport_length;
 	    p->kill();
 	    return 0;
 	}
-	// get rid of extra space
-	q->take(q->transport_length() - p_lastoff);
-	// hook up packet, and add final chunk
-	*q_pprev = q;
-	ChunkLink *last_chunk = (ChunkLink *)(q->transport_header() + old_transport_length);
-	last_chunk->off = last_chunk->lastoff = p_lastoff;
-	_mem_used += p_lastoff - old_transport_length;
-    }
-
-    // find chunks before and after p
-    ChunkLink *chunk = &PACKET_CHUNK(q);
-    while (chunk->lastoff < p_off)
-	chunk = next_chunk(q, chunk);
-    ChunkLink *last = chunk;
-    while (last && last->lastoff < p_lastoff)
-	last = next_chunk(q, last);
-
-    // patch chunks
-    assert(chunk && last);
-    if (p_lastoff < last->off) {
-	ChunkLink *new_chunk = (ChunkLink *)(q->transport_header() + p_lastoff);
-	*new_chunk = *last;
-	chunk->lastoff = p_lastoff;
-    } else
-	chunk->lastoff = last->lastoff;
-    if (p_off < chunk->off)
-	chunk->off = p_off;
-
-    // copy p's data into q
-    memcpy(q->transport_header() + p_off, p->transport_header(), p_lastoff - p_off);
-
-    // copy p's annotations and IP header if it is the first packet
-    if (p_off == 0) {
-	int old_ip_off = q->ip_header()->ip_off;
-	int hl = iph->ip_hl << 2;
-	if (hl > (int) q->network_header_length())
-	    q = q->push(hl - q->network_header_length());
-	else
-	    q->pull(q->network_header_length() - hl);
-	q->set_ip_header((click_ip *)(q->transport_header() - hl), hl);
-	memcpy(q->ip_header(), p->ip_header(), hl);
-	q->ip_header()->ip_off = old_ip_off;
-	//q->copy_annotations(p); XXX
-	q->set_device_anno(p->device_anno());
+	d = new(x) Datagram(key);
+	_table.set(it, d);
+	_table.balance();
+	_lru.push_back(d);
+    } else if (d->_lru_link.next()) {
+	_lru.erase(d);
+	_lru.push_back(d);
     }
+    d->_active = now;
 
-    // clear MF if incoming packet has it cleared
-    if (!(iph->ip_off & htons(IP_MF)))
-	q->ip_header()->ip_off &= ~htons(IP_MF);
+    if (!add_fragment(d, p, p_off, p_lastoff, more))
+	return 0;
 
     // Are we done with this packet?
-    if ((q->ip_header()->ip_off & htons(IP_MF)) == 0
-	&& PACKET_CHUNK(q).off == 0
-	&& PACKET_CHUNK(q).lastoff == q->transport_length())
-	return emit_whole_packet(q, q_pprev, p);
-
-    // Otherwise, done for now
-    //check();
-    p->kill();
+    if (d->_nholes == 0) {
+	Packet *q = assemble(d, true);
+	destroy(d);
+	return q;
+    }
     return 0;
 }
 
 void
-IPReassembler::reap_overfull(int now)
+IPReassembler::reap_overfull()
 {
-    check();
-
-    // First throw away fragments at least 10 seconds old, then at least 5
-    // seconds old, then any fragments.
-    for (int delta = 10; delta >= 0; delta -= 5)
-	for (int bucket = 0; bucket < NMAP; bucket++) {
-	    WritablePacket **pprev = &_map[bucket];
-	    for (WritablePacket *q = *pprev; q; q = *pprev)
-		if (q->timestamp_anno().sec() < now - delta) {
-		    *pprev = (WritablePacket *)q->next();
-		    _mem_used -= IPH_MEM_USED + q->transport_length();
-		    q->set_next(0);
-		    checked_output_push(1, q);
-		    if (_mem_used <= _mem_low_thresh)
-			return;
-		} else
-		    pprev = (WritablePacket **)&q->next();
-	}
-
-    click_chatter("IPReassembler: cannot free enough memory!");
+    // throw away the packets that have gone longest without a new fragment
+    while (_mem_used > _mem_low_thresh && _lru.front())
+	expire(_lru.front());
 }
 
 void
 IPReassembler::reap(int now)
 {
-    // look at all queues. If no activity for 30 seconds, kill that queue
-
+    // each packet expires REAP_TIMEOUT seconds after its latest fragment;
+    // the oldest are at the front of the LRU list
     int kill_time = now - REAP_TIMEOUT;
-
-    for (int i = 0; i < NMAP; i++) {
-	WritablePacket **q_pprev = &_map[i];
-	for (WritablePacket *q = *q_pprev; q; ) {
-	    if (q->timestamp_anno().sec() < kill_time) {
-		*q_pprev = (WritablePacket *)q->next();
-		q->set_next(0);
-		_mem_used -= IPH_MEM_USED + q->transport_length();
-		checked_output_push(1, q);
-	    } else
-		q_pprev = (WritablePacket **)&q->next();
-	    q = *q_pprev;
-	}
+    while (Datagram *d = _lru.front()) {
+	if (d->_active >= kill_time)
+	    break;
+	expire(d);
     }
-
-    _reap_time = now + REAP_INTERVAL;
 }
 
 CLICK_ENDDECLS
@@ -4,7 +4,9 @@
 #include <click/element.hh>
 #include <click/glue.hh>
 #include <clicknet/ip.h>
-#include <click/timer.hh>
+#include <click/hashcontainer.hh>
+#include <click/hashallocator.hh>
+#include <click/list.hh>
 CLICK_DECLS
 
 /*
@@ -27,8 +29,16 @@ outputs, however, a single packet containing all the received fragments at
 their proper offsets is pushed onto output 1.
 
 IPReassembler's memory usage is bounded. When memory consumption rises above
-HIMEM bytes, IPReassembler throws away old fragments until memory consumption
-drops below 3/4*HIMEM bytes. Default HIMEM is 256K.
+HIMEM bytes, IPReassembler throws away the least recently extended packets'
+fragments until memory consumption drops below 3/4*HIMEM bytes. Default HIMEM
+is 256K. Fragments are found through a hash table keyed by source,
+destination, protocol, and IP ID, and are held unchanged until their packet
+is complete, so a fragment flood costs constant time per fragment.
+
+Where fragments overlap, the data that arrived first wins: a fragment
+contributes only the bytes no earlier fragment supplied. A packet whose
+fragments leave more than 16 separate holes is discarded as though it had
+timed out.
 
 Output packets have no MAC headers, and input MAC headers are ignored.
 
@@ -77,47 +87,83 @@ class IPReassembler : public Element { public:
 	uint16_t lastoff;
     };
 
+    struct FragKey {
+	uint32_t src;
+	uint32_t dst;
+	uint16_t id;
+	uint8_t proto;
+	FragKey(const click_ip *iph)
+	    : src(iph->ip_src.s_addr), dst(iph->ip_dst.s_addr),
+	      id(iph->ip_id), proto(iph->ip_p) {
+	}
+	inline hashcode_t hashcode() const;
+	bool operator==(const FragKey &x) const {
+	    return src == x.src && dst == x.dst && id == x.id && proto == x.proto;
+	}
+    };
+
+    // A packet being reassembled. Its fragments stay in arrival order, each
+    // trimmed to the bytes it supplied first; holes lists the byte ranges
+    // still missing, RFC 815-style.
+    struct Datagram {
+	FragKey _key;
+	Datagram *_hashnext;
+	List_member<Datagram> _lru_link;
+	Packet *_head;
+	Packet *_tail;
+	int _active;		// last arrival, in seconds
+	uint32_t _mem_used;
+	int _final;		// data length, or -1 until the last fragment
+	int _maxoff;		// end of the furthest fragment
+	enum { MAX_HOLES = 16 };
+	int _nholes;
+	ChunkLink _holes[MAX_HOLES];
+	typedef FragKey key_type;
+	typedef const FragKey &key_const_reference;
+	key_const_reference hashkey() const {
+	    return _key;
+	}
+	Datagram(const FragKey &key)
+	    : _key(key), _hashnext(), _head(), _tail(), _mem_used(0),
+	      _final(-1), _maxoff(0), _nholes(1) {
+	    _holes[0].off = 0;
+	    _holes[0].lastoff = 0xFFFF;
+	}
+    };
+
   private:
 
     enum { REAP_TIMEOUT = 30, // seconds
-	   REAP_INTERVAL = 10, // seconds
 	   IPH_MEM_USED = 40 };
 
-    enum { NMAP = 256 };
-    WritablePacket *_map[NMAP];
-
-    int _reap_time;
+    typedef HashContainer<Datagram> Table;
+    Table _table;
+    typedef List<Datagram, &Datagram::_lru_link> LRUList;
+    LRUList _lru;		// least recently extended first
+    SizedHashAllocator<sizeof(Datagram)> _alloc;
 
     uint32_t _mem_used;
     uint32_t _mem_high_thresh;	// defaults to 256K
     uint32_t _mem_low_thresh;	// defaults to 3/4 * _mem_high_thresh
 
-    static inline int bucketno(const click_ip *);
-    static inline bool same_segment(const click_ip *, const click_ip *);
-
-    WritablePacket *find_queue(Packet *, WritablePacket ***);
-    void make_queue(Packet *, WritablePacket **);
-    static ChunkLink *next_chunk(WritablePacket *, ChunkLink *);
-    Packet *emit_whole_packet(WritablePacket *, WritablePacket **, Packet *);
-    void reap_overfull(int);
+    bool add_fragment(Datagram *, Packet *, int off, int lastoff, bool more);
+    Packet *assemble(Datagram *, bool complete);
+    void destroy(Datagram *);
+    void expire(Datagram *);
+    void reap_overfull();
     void reap(int);
-    static void check_error(ErrorHandler *, int, const Packet *, const char *, ...);
+    static void check_error(ErrorHandler *, const Datagram *, const Packet *, const char *, ...);
 
 };
 
 
-inline int
-IPReassembler::bucketno(const click_ip *h)
-{
-    return (h->ip_id % NMAP);
-}
-
-inline bool
-IPReassembler::same_segment(const click_ip *h, const click_ip *h2)
+inline hashcode_t
+IPReassembler::FragKey::hashcode() const
 {
-    return h->ip_id == h2->ip_id && h->ip_p == h2->ip_p
-	&& h->ip_src.s_addr == h2->ip_src.s_addr
-	&& h->ip_dst.s_addr == h2->ip_dst.s_addr;
+    // the ID varies most in a flood, so let it reach every bit
+    uint32_t h = src ^ ((dst << 13) | (dst >> 19)) ^ (id << 16) ^ id ^ (proto << 8);
+    h *= 0x9E3779B1U;
+    return h ^ (h >> 16);
 }
 
 CLICK_ENDDECLS
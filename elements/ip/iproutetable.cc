@@ -145,6 +145,17 @@ IPRouteTable::dump_routes()
     return String();
 }
 
+int
+IPRouteTable::begin_update(ErrorHandler *)
+{
+    return 0;
+}
+
+void
+IPRouteTable::commit_update()
+{
+}
+
 
 void
 IPRouteTable::push(int, Packet *p)
@@ -164,6 +175,48 @@ IPRouteTable::push(int, Packet *p)
     }
 }
 
+void
+IPRouteTable::lookup_route_batch(const IPAddress *addr, IPAddress *gw, int *port, int n) const
+{
+    for (int i = 0; i < n; i++)
+	port[i] = lookup_route(addr[i], gw[i]);
+}
+
+void
+IPRouteTable::push_batch(int, PacketBatch &batch)
+{
+    while (!batch.empty()) {
+	Packet *p[LOOKUP_BATCH];
+	IPAddress addr[LOOKUP_BATCH], gw[LOOKUP_BATCH];
+	int port[LOOKUP_BATCH];
+	int n;
+	for (n = 0; n < LOOKUP_BATCH && (p[n] = batch.pop_front()); n++)
+	    addr[n] = p[n]->dst_ip_anno();
+	lookup_route_batch(addr, gw, port, n);
+
+	// Hand packets with no route to push(), which reports them.
+	for (int i = 0; i < n; i++)
+	    if (port[i] < 0) {
+		push(0, p[i]);
+		p[i] = 0;
+	    }
+
+	// Forward all packets for each output in one batch.
+	for (int i = 0; i < n; i++)
+	    if (p[i]) {
+		PacketBatch out;
+		for (int j = i; j < n; j++)
+		    if (p[j] && port[j] == port[i]) {
+			if (gw[j])
+			    p[j]->set_dst_ip_anno(gw[j]);
+			out.push_back(p[j]);
+			p[j] = 0;
+		    }
+		checked_output_push_batch(port[i], out);
+	    }
+    }
+}
+
 
 int
 IPRouteTable::run_command(int command, const String &str, Vector<IPRoute>* old_routes, ErrorHandler *errh)
@@ -225,11 +278,14 @@ IPRouteTable::ctrl_handler(const String &conf_in, Element *e, void *, ErrorHandl
     const char* s = conf.begin(), *end = conf.end();
 
     Vector<IPRoute> old_routes;
-    int r = 0;
+    int r = table->begin_update(errh);
+    if (r < 0)
+	return r;
 
     while (s < end) {
 	const char* nl = find(s, end, '\n');
 	String line = conf.substring(s, nl);
+	s = nl + 1;
 
 	String first_word = cp_shift_spacevec(line);
 	int command;
@@ -248,9 +304,8 @@ IPRouteTable::ctrl_handler(const String &conf_in, Element *e, void *, ErrorHandl
 
 	if ((r = table->run_command(command, line, &old_routes, errh)) < 0)
 	    goto rollback;
-
-	s = nl + 1;
     }
+    table->commit_update();
     return 0;
 
   rollback:
@@ -264,6 +319,7 @@ IPRouteTable::ctrl_handler(const String &conf_in, Element *e, void *, ErrorHandl
 	    table->add_route(rt, true, 0, errh);
 	old_routes.pop_back();
     }
+    table->commit_update();
     return r;
 }
 
@@ -3,6 +3,10 @@
 #define CLICK_IPROUTETABLE_HH
 #include <click/glue.hh>
 #include <click/element.hh>
+#include <click/master.hh>
+#include <click/timer.hh>
+#include <click/error.hh>
+#include <click/sync.hh>
 CLICK_DECLS
 
 /*
@@ -72,9 +76,21 @@ should be preferred for almost all purposes.
 A Click script containing the 167000-route dump is available at
 http://www.read.cs.ucla.edu/click/routetabletest-167k.click.gz
 
+=head1 CONCURRENT UPDATES
+
+RadixIPLookup, DirectIPLookup, and RangeIPLookup never lock during lookups,
+even in a multithreaded router whose routes change under traffic.  They keep
+two copies of their tables.  Updates go to the copy that lookups aren't
+using, which is then published with a single pointer store; a `C<ctrl>'
+transaction is published as a whole, so lookups see all of its changes or
+none of them.  The old copy is brought up to date, and used for the next
+update, once every thread has finished the driver iteration in which it might
+have been reading it.  The second copy is only allocated at the first update
+after initialization, so static tables cost no extra memory.
+
 =head1 INTERFACE
 
-These four IPRouteTable virtual functions should generally be overridden by
+These IPRouteTable virtual functions should generally be overridden by
 particular routing table elements.
 
 =over 4
@@ -108,11 +124,27 @@ Looks up the route associated with address C<dst>. Should set C<gw_return> to
 the resulting gateway and return the relevant output port (or negative if
 there is no route). The default implementation returns -1.
 
+=item C<void B<lookup_route_batch>(const IPAddress *dst, IPAddress *gw_return, int *port_return, int n) const>
+
+Looks up the routes for the C<n> addresses C<dst[0]> through C<dst[n-1]>,
+storing each result's gateway in C<gw_return[i]> and output port (or negative
+if there is no route) in C<port_return[i]>.  Elements whose lookups miss in
+cache can override this to issue prefetches for all C<n> addresses before
+resolving any of them, overlapping the misses.  The default implementation
+calls B<lookup_route> C<n> times.
+
 =item C<String B<dump_routes>()>
 
 Returns a textual description of the current routing table. The default
 implementation returns an empty string.
 
+=item C<int B<begin_update>(ErrorHandler *errh)>, C<void B<commit_update>()>
+
+Bracket a group of B<add_route> and B<remove_route> calls that lookups should
+see all at once.  Calls may nest; B<begin_update> returns negative if it
+fails, in which case B<commit_update> must not be called.  The defaults do
+nothing.
+
 =back
 
 The following functions, overridden by IPRouteTable, are available for use by
@@ -132,6 +164,15 @@ The default implementation of B<push> uses B<lookup_route> to perform IP
 routing lookup. Normally, subclasses implement their own B<push> methods,
 avoiding virtual function call overhead.
 
+=item C<void B<push_batch>(int port, PacketBatch &batch)>
+
+Looks up a batch of packets with B<lookup_route_batch>, up to 16 at a time,
+then forwards each group's packets for one output as a single batch.
+Packets bound for the same output stay in order.  Packets with no route are
+passed to B<push>, which reports or drops them.  Subclasses whose B<push>
+does more than B<lookup_route> and forward, such as LinearIPLookup, should
+override B<push_batch> to call B<push> for each packet.
+
 =item C<static int B<add_route_handler>(const String &, Element *, void *, ErrorHandler *)>
 
 This write handler callback parses its input as an add-route request
@@ -194,9 +235,16 @@ class IPRouteTable : public Element { public:
     virtual int add_route(const IPRoute& route, bool allow_replace, IPRoute* replaced_route, ErrorHandler* errh);
     virtual int remove_route(const IPRoute& route, IPRoute* removed_route, ErrorHandler* errh);
     virtual int lookup_route(IPAddress addr, IPAddress& gw) const = 0;
+    virtual void lookup_route_batch(const IPAddress *addr, IPAddress *gw, int *port, int n) const;
     virtual String dump_routes();
 
+    virtual int begin_update(ErrorHandler* errh);
+    virtual void commit_update();
+
     void push(int port, Packet* p);
+    void push_batch(int port, PacketBatch &batch);
+
+    enum { LOOKUP_BATCH = 16 };
 
     static int add_route_handler(const String&, Element*, void*, ErrorHandler*);
     static int remove_route_handler(const String&, Element*, void*, ErrorHandler*);
@@ -211,6 +259,81 @@ class IPRouteTable : public Element { public:
 
 };
 
+/* IPRouteTableRCU<T> keeps copies of a routing table structure T so that
+ * lookups never lock.  Lookups read current(), which never changes under
+ * them.  Between begin() and commit(), updates modify shadow() and record
+ * themselves with log(); commit() publishes the shadow with one pointer store.
+ * The old table becomes the next shadow once every RouterThread has finished
+ * the driver iteration in which it might have been reading it (see
+ * Master::rcu_snapshot), and the next begin() replays the log on it.  Writers
+ * never wait for that.  The first time the old table is still in use at
+ * begin(), the current table is copied into a private writer table, and from
+ * then on updates modify that and keep appending to the log.  The log is
+ * replayed on the old table, and the result published, at commit() or from a
+ * timer, as soon as the old table is quiescent; until then lookups see the
+ * previous routes.  Until activate(), nothing is looking, and shadow() is the
+ * current table.
+ *
+ * T provides add_route(), remove_route(), flush(), and cleanup() like
+ * DirectIPLookup::Table, plus copy(const T&), returning 0 or -ENOMEM, and
+ * finish(), called just before T is published. */
+template <typename T> class IPRouteTableRCU { public:
+
+    enum { ADD, SET, REMOVE, FLUSH };
+
+    IPRouteTableRCU()
+	: _current(&_t), _spare(0), _writer(0), _npublished(0), _depth(0),
+	  _active(false), _publish_timer(publish_hook, this) {
+    }
+
+    const T *current() const		{ return _current; }
+    T &shadow() {
+	return *(!_depth ? _current : _writer ? _writer : _spare);
+    }
+
+    inline void activate(Element *owner);
+    inline void cleanup();
+
+    inline int begin(Master *master, ErrorHandler *errh);
+    inline void log(const IPRoute &route, int op);
+    inline void commit(Master *master);
+
+  private:
+
+    T * volatile _current;
+    T _t;
+    T *_spare;			// the previous table, or null
+    T *_writer;			// private table for updates, or null
+    Vector<uint32_t> _grace;	// _spare's grace period
+    Vector<IPRoute> _log;	// updates _spare lacks
+    int _npublished;		// how many of them _current has
+    Spinlock _lock;
+    int _depth;
+    bool _active;
+    Timer _publish_timer;
+
+    enum { publish_msec = 1 };
+
+    static T *clone(const T *t) {
+	T *x = new T;
+	if (x && x->copy(*t) < 0) {
+	    delete x;
+	    x = 0;
+	}
+	return x;
+    }
+    static void free_table(T *t, T *embedded) {
+	if (t == embedded)
+	    t->cleanup();
+	else
+	    delete t;
+    }
+    inline void replay();
+    inline void publish(Master *master);
+    static void publish_hook(Timer *timer, void *user_data);
+
+};
+
 inline StringAccum&
 operator<<(StringAccum& sa, const IPRoute& route)
 {
@@ -248,5 +371,132 @@ IPRoute::match(const IPRoute& r) const
 	&& (port < 0 || (gw == r.gw && port == r.port));
 }
 
+template <typename T> inline void
+IPRouteTableRCU<T>::activate(Element *owner)
+{
+    _current->finish();
+    _publish_timer.initialize(owner);
+    _active = true;
+}
+
+template <typename T> inline void
+IPRouteTableRCU<T>::cleanup()
+{
+    _publish_timer.unschedule();
+    if (_writer)
+	free_table(_writer, &_t);
+    if (_spare)
+	free_table(_spare, &_t);
+    if (_current != &_t)
+	free_table(_current, &_t);
+    _t.cleanup();
+    _current = &_t;
+    _spare = _writer = 0;
+    _grace.clear();
+    _log.clear();
+    _npublished = 0;
+    _active = false;
+}
+
+template <typename T> inline void
+IPRouteTableRCU<T>::replay()
+{
+    ErrorHandler *silent = ErrorHandler::silent_handler();
+    for (const IPRoute *r = _log.begin(); r != _log.end(); r++)
+	if (r->extra == FLUSH)
+	    _spare->flush();
+	else if (r->extra == REMOVE)
+	    (void) _spare->remove_route(*r, 0, silent);
+	else
+	    (void) _spare->add_route(*r, r->extra == SET, 0, silent);
+}
+
+template <typename T> inline void
+IPRouteTableRCU<T>::publish(Master *master)
+{
+    // must be called with _lock held outside any update
+    if (_writer) {
+	if (!master->rcu_quiescent(_grace)) {
+	    if (!_publish_timer.scheduled())
+		_publish_timer.schedule_after_msec(publish_msec);
+	    return;
+	}
+	replay();
+    }
+    T *t = _spare;
+    t->finish();
+    click_fence();
+    _spare = _current;
+    _current = t;
+    master->rcu_snapshot(_grace);
+    // the new spare lacks whatever the old current table did
+    _log.erase(_log.begin(), _log.begin() + _npublished);
+    _npublished = _log.size();
+}
+
+template <typename T> void
+IPRouteTableRCU<T>::publish_hook(Timer *timer, void *user_data)
+{
+    IPRouteTableRCU<T> *rcu = static_cast<IPRouteTableRCU<T> *>(user_data);
+    // don't wait for a writer; its commit() publishes, or try again later
+    if (rcu->_lock.attempt()) {
+	if (!rcu->_depth && rcu->_npublished != rcu->_log.size())
+	    rcu->publish(timer->router()->master());
+	rcu->_lock.release();
+    } else
+	timer->schedule_after_msec(publish_msec);
+}
+
+template <typename T> inline int
+IPRouteTableRCU<T>::begin(Master *master, ErrorHandler *errh)
+{
+    if (!_active)
+	return 0;
+    _lock.acquire();
+    if (_depth++)
+	return 0;
+    // Without a writer table, every commit() published, so _current is up
+    // to date.
+    if (!_spare) {
+	if (!(_spare = clone(_current)))
+	    goto out_of_memory;
+	_grace.clear();		// never published
+	_log.clear();
+	_npublished = 0;
+    } else if (!_writer && !master->rcu_quiescent(_grace)
+	       && !(_writer = clone(_current)))
+	goto out_of_memory;
+    if (!_writer) {
+	replay();
+	_log.clear();
+	_npublished = 0;
+    }
+    return 0;
+
+  out_of_memory:
+    _depth = 0;
+    _lock.release();
+    return errh->error("out of memory"), -ENOMEM;
+}
+
+template <typename T> inline void
+IPRouteTableRCU<T>::log(const IPRoute &route, int op)
+{
+    if (_active) {
+	_log.push_back(route);
+	_log.back().extra = op;
+    }
+}
+
+template <typename T> inline void
+IPRouteTableRCU<T>::commit(Master *master)
+{
+    if (!_active)
+	return;
+    if (--_depth == 0 && _npublished != _log.size())
+	publish(master);
+    _lock.release();
+}
+
 CLICK_ENDDECLS
 #endif
@@ -46,7 +46,8 @@ CLICK_DECLS
 //
 
 IPRw::Mapping::Mapping(bool dst_anno)
-  : _flags(dst_anno ? F_DST_ANNO : 0), _ip_p(0), _pat(0), _free_next(0)
+  : _flags(dst_anno ? F_DST_ANNO : 0), _ip_p(0), _used(click_jiffies()),
+    _pat(0), _free_next(0)
 {
 }
 
@@ -62,23 +63,10 @@ IPRw::Mapping::initialize(int ip_p, const IPFlowID &in, const IPFlowID &out,
     _flags |= flags;
     _reverse = reverse;
 
-    // set checksum deltas
-    const unsigned short* source_words = (const unsigned short*)&in;
-    const unsigned short* dest_words = (const unsigned short*)&_mapto;
-    unsigned delta = 0;
-    for (int i = 0; i < 4; i++) {
-	delta += ~source_words[i] & 0xFFFF;
-	delta += dest_words[i];
-    }
-    delta = (delta & 0xFFFF) + (delta >> 16);
-    _ip_csum_delta = delta + (delta >> 16);
-
-    for (int i = 4; i < 6; i++) {
-	delta += ~source_words[i] & 0xFFFF;
-	delta += dest_words[i];
-    }
-    delta = (delta & 0xFFFF) + (delta >> 16);
-    _udp_csum_delta = delta + (delta >> 16);
+    // set checksum deltas: addresses for IP, addresses and ports for
+    // TCP/UDP, whose pseudoheader covers the addresses
+    _ip_csum_delta = click_in_cksum_delta(&in, &_mapto, 8);
+    _udp_csum_delta = click_in_cksum_delta(&in, &_mapto, 12);
 }
 
 void
@@ -102,9 +90,7 @@ IPRw::Mapping::apply(WritablePacket *p)
     if (_flags & F_DST_ANNO)
 	p->set_dst_ip_anno(_mapto.daddr());
 
-    unsigned sum = (~iph->ip_sum & 0xFFFF) + _ip_csum_delta;
-    sum = (sum & 0xFFFF) + (sum >> 16);
-    iph->ip_sum = ~(sum + (sum >> 16));
+    click_update_in_cksum_delta(&iph->ip_sum, _ip_csum_delta);
 
     mark_used();
 
@@ -118,7 +104,7 @@ IPRw::Mapping::apply(WritablePacket *p)
 	click_tcp *tcph = p->tcp_header();
 	tcph->th_sport = _mapto.sport();
 	tcph->th_dport = _mapto.dport();
-	click_update_in_cksum(&tcph->th_sum, 0xFFFF, _udp_csum_delta);
+	click_update_in_cksum_delta(&tcph->th_sum, _udp_csum_delta);
 
 	// check for session ending flags
 	if (tcph->th_flags & TH_RST)
@@ -134,7 +120,7 @@ IPRw::Mapping::apply(WritablePacket *p)
 	udph->uh_sport = _mapto.sport();
 	udph->uh_dport = _mapto.dport();
 	if (udph->uh_sum)	// 0 checksum is no checksum
-	    click_update_in_cksum(&udph->uh_sum, 0xFFFF, _udp_csum_delta);
+	    click_update_in_cksum_delta(&udph->uh_sum, _udp_csum_delta);
 
     }
 }
@@ -155,9 +141,11 @@ IPRw::Pattern::Pattern(const IPAddress &saddr, int sport,
 		       const IPAddress &daddr, int dport,
 		       bool is_napt, bool sequential, uint32_t variation_top)
     : _saddr(saddr), _sport(sport), _daddr(daddr), _dport(dport),
-      _variation_top(variation_top), _next_variation(0), _is_napt(is_napt),
-      _sequential(sequential), _refcount(0), _nmappings(0)
+      _variation_top(variation_top), _is_napt(is_napt),
+      _sequential(sequential), _refcount(0)
 {
+    _next_variation = 0;
+    _nmappings = 0;
     if (_variation_top > 0)
 	for (_variation_mask = 1; _variation_mask < _variation_top; )
 	    _variation_mask = (_variation_mask << 1) | 1;
@@ -339,7 +327,7 @@ bool
 IPRw::Pattern::create_mapping(int ip_p, const IPFlowID& in,
 			      int fport, int rport,
 			      Mapping* fmap, Mapping* rmap,
-			      const Map& rev_map)
+			      const Map& rev_map, int nshards, int shard)
 {
     IPFlowID out(in);
     if (_saddr)
@@ -352,7 +340,7 @@ IPRw::Pattern::create_mapping(int ip_p, const IPFlowID& in,
 	out.set_dport(_dport);
 
     if (_variation_top) {
-	uint32_t val = (_sequential ? _next_variation : click_random() & _variation_mask);
+	uint32_t val = (_sequential ? _next_variation.value() : click_random() & _variation_mask);
 	uint32_t step = (_sequential ? 1 : click_random() | 1);
 	uint32_t base = (_is_napt ? ntohs(_sport) : ntohl(_saddr.addr()));
 	IPFlowID lookup = out.reverse();
@@ -362,7 +350,9 @@ IPRw::Pattern::create_mapping(int ip_p, const IPFlowID& in,
 		    lookup.set_dport(htons(base + val));
 		else
 		    lookup.set_daddr(htonl(base + val));
-		if (!rev_map.find(lookup)) {
+		// In a sharded rewriter, only accept ports whose reply mapping
+		// lands in the same shard as the forward mapping.
+		if (flow_shard(lookup, nshards) == shard && !rev_map.find(lookup)) {
 		    if (_is_napt)
 			out.set_sport(lookup.dport());
 		    else
@@ -426,7 +416,7 @@ IPRw::Pattern::unparse() const
     else
 	sa << ' ' << ntohs(_dport);
 
-    sa << " [" << _nmappings << ']';
+    sa << " [" << _nmappings.value() << ']';
 
     return sa.take_string();
 }
@@ -542,6 +532,8 @@ IPRw::Mapping::free_from_list(Map &map, bool notify)
     Mapping *next = _free_next;
     if (notify && _pat)
 	_pat->mapping_freed(primary());
+    expiry_unlink();
+    reverse()->expiry_unlink();
     map.erase(reverse()->flow_id().reverse());
     map.erase(flow_id().reverse());
     delete reverse();
@@ -672,6 +664,109 @@ IPRw::incr_clean_map_free_tracked(Map &table,
     }
 }
 
+
+//
+// IPRw::ExpiryWheel
+//
+
+IPRw::ExpiryWheel::ExpiryWheel()
+    : _buckets(0), _nbuckets(0), _cursor(0), _base(0), _interval(1),
+      _timeout(0), _nexamined(0), _nfreed(0)
+{
+}
+
+IPRw::ExpiryWheel::~ExpiryWheel()
+{
+    delete[] _buckets;
+}
+
+int
+IPRw::ExpiryWheel::initialize(uint32_t timeout, uint32_t interval)
+{
+    if (interval == 0)
+	interval = 1;
+    // enough buckets that a new mapping never wraps past the cursor
+    int nbuckets = timeout / interval + 2;
+    ExpiryLink *buckets = new ExpiryLink[nbuckets];
+    if (!buckets)
+	return -ENOMEM;
+    delete[] _buckets;
+    _buckets = buckets;
+    _nbuckets = nbuckets;
+    _cursor = 0;
+    _base = click_jiffies();
+    _interval = interval;
+    _timeout = timeout;
+    return 0;
+}
+
+void
+IPRw::ExpiryWheel::reset()
+{
+    // The mappings may already have been deleted, so don't touch them.
+    for (int i = 0; i < _nbuckets; i++)
+	_buckets[i]._expiry_next = _buckets[i]._expiry_prev = &_buckets[i];
+}
+
+void
+IPRw::ExpiryWheel::insert(Mapping *m, uint32_t expiry, int min_offset)
+{
+    int32_t delta = expiry - _base;
+    int offset = (delta <= 0 ? 0 : delta / _interval);
+    if (offset < min_offset)
+	offset = min_offset;
+    if (offset >= _nbuckets)
+	offset = _nbuckets - 1;
+    offset += _cursor;
+    if (offset >= _nbuckets)
+	offset -= _nbuckets;
+    m->expiry_unlink();
+    m->expiry_link_before(&_buckets[offset]);
+}
+
+void
+IPRw::ExpiryWheel::rebuild(Map &map)
+{
+    // Used after taking another rewriter's mappings; unlinking removes each
+    // mapping from the old rewriter's wheel.
+    for (Map::iterator iter = map.begin(); iter.live(); iter++) {
+	Mapping *m = iter.value();
+	if (m->is_primary())
+	    insert(m);
+    }
+}
+
+bool
+IPRw::ExpiryWheel::expire(Map &map, uint32_t now, int slice)
+{
+    if (!_nbuckets)
+	return true;
+
+    // Visit every bucket whose period has begun.  Mappings that have not yet
+    // expired move to a later bucket.
+    uint32_t last_jif = now - _timeout;
+    while ((int32_t)(now - _base) >= 0) {
+	ExpiryLink *bucket = &_buckets[_cursor];
+	while (bucket->expiry_linked()) {
+	    if (slice-- <= 0)
+		return false;
+	    Mapping *m = static_cast<Mapping *>(bucket->_expiry_next);
+	    _nexamined++;
+	    if (m->used_since(last_jif) || m->free_tracked())
+		insert(m, m->last_used() + _timeout, 1);
+	    else {
+		_nfreed++;
+		m->free_from_list(map, true);
+	    }
+	}
+	_base += _interval;
+	if (++_cursor == _nbuckets)
+	    _cursor = 0;
+    }
+    return true;
+}
+
+
 void
 IPRw::clear_map(Map &table)
 {
@@ -5,6 +5,7 @@
 #include <click/timer.hh>
 #include <click/hashtable.hh>
 #include <click/ipflowid.hh>
+#include <click/atomic.hh>
 #include <clicknet/ip.h>
 CLICK_DECLS
 class IPMapper;
@@ -13,6 +14,8 @@ class IPRw : public Element { public:
 
     class Pattern;
     class Mapping;
+    class ExpiryLink;
+    class ExpiryWheel;
     typedef HashTable<IPFlowID, Mapping*> Map;
     enum InputSpecName {
 	INPUT_SPEC_NOCHANGE, INPUT_SPEC_KEEP, INPUT_SPEC_DROP,
@@ -49,11 +52,13 @@ class IPRw : public Element { public:
     virtual Mapping* apply_pattern(Pattern*, int ip_p, const IPFlowID&, int, int) = 0;
     virtual Mapping* get_mapping(int ip_p, const IPFlowID&) const = 0;
 
+    static inline int flow_shard(const IPFlowID&, int nshards);
+
   protected:
 
     Vector<Pattern*> _all_patterns;
 
-    enum { GC_INTERVAL_SEC = 3600 };
+    enum { GC_INTERVAL_SEC = 3600, GC_SLICE = 1024 };
 
     void take_state_map(Map&, Mapping** free_head, Mapping** free_tail,
 			const Vector<Pattern*>&, const Vector<Pattern*>&);
@@ -67,7 +72,29 @@ class IPRw : public Element { public:
 };
 
 
-class IPRw::Mapping { public:
+class IPRw::ExpiryLink { public:
+
+    // A ring link; an unlinked ExpiryLink points to itself.
+    ExpiryLink()			: _expiry_next(this), _expiry_prev(this) { }
+
+    bool expiry_linked() const		{ return _expiry_next != this; }
+    inline void expiry_link_before(ExpiryLink *x);
+    inline void expiry_unlink();
+
+  private:
+
+    ExpiryLink *_expiry_next;
+    ExpiryLink *_expiry_prev;
+
+    ExpiryLink(const ExpiryLink &);
+    ExpiryLink &operator=(const ExpiryLink &);
+
+    friend class IPRw::ExpiryWheel;
+
+};
+
+
+class IPRw::Mapping : public IPRw::ExpiryLink { public:
 
     enum { F_REVERSE = 1, F_MARKED = 2, F_FLOW_OVER = 4, F_FREE_TRACKED = 8,
 	   F_DST_ANNO = 16 };
@@ -87,6 +114,7 @@ class IPRw::Mapping { public:
     Mapping* reverse() const		{ return _reverse; }
 
     inline bool used_since(uint32_t) const;
+    inline uint32_t last_used() const;
     void mark_used()			{ _used = click_jiffies(); }
 
     bool marked() const			{ return (_flags & F_MARKED); }
@@ -132,6 +160,7 @@ class IPRw::Mapping { public:
 
     friend class IPRw;
     friend class IPRw::Pattern;
+    friend class IPRw::ExpiryWheel;
 
     inline Mapping* free_from_list(Map&, bool notify);
     inline void append_to_free(Mapping*& head, Mapping*& tail);
@@ -156,7 +185,7 @@ class IPRw::Pattern { public:
     void use()			{ _refcount++; }
     void unuse()		{ if (--_refcount <= 0) delete this; }
 
-    int nmappings() const	{ return _nmappings; }
+    int nmappings() const	{ return _nmappings.value(); }
 
     operator bool() const	{ return _saddr || _sport || _daddr || _dport; }
     IPAddress daddr() const	{ return _daddr; }
@@ -165,7 +194,7 @@ class IPRw::Pattern { public:
 
     bool can_accept_from(const Pattern&) const;
 
-    bool create_mapping(int ip_p, const IPFlowID&, int fport, int rport, Mapping*, Mapping*, const Map&);
+    bool create_mapping(int ip_p, const IPFlowID&, int fport, int rport, Mapping*, Mapping*, const Map&, int nshards = 1, int shard = 0);
     void accept_mapping(Mapping*);
     inline void mapping_freed(Mapping*);
 
@@ -180,13 +209,13 @@ class IPRw::Pattern { public:
 
     uint32_t _variation_top;
     uint32_t _variation_mask;
-    uint32_t _next_variation;
+    atomic_uint32_t _next_variation;	// shards may update concurrently
 
     bool _is_napt;
     bool _sequential;
 
     int _refcount;
-    int _nmappings;
+    atomic_uint32_t _nmappings;	// shards may update concurrently
 
     Pattern(const Pattern&);
     Pattern& operator=(const Pattern&);
@@ -198,6 +227,60 @@ class IPRw::Pattern { public:
 };
 
 
+/*
+ * IPRw::ExpiryWheel: time-ordered buckets of primary mappings
+ *
+ * Instead of scanning a whole Map for idle mappings, a rewriter inserts each
+ * new primary mapping into the wheel bucket for its expiry time.  expire()
+ * visits only the buckets that have come due.  A mapping that was used since
+ * it was inserted moves to the bucket for its new expiry time, and an idle
+ * one is freed.  Marking a mapping used does not touch the wheel.  Each
+ * bucket covers one reaping interval, so mappings are freed at the first
+ * reap after they time out, as with IPRw::clean_map().
+ *
+ * expire() examines at most a given number of mappings per call and returns
+ * false if due mappings remain, so the caller can continue shortly rather
+ * than stall packet processing.  Free-tracked mappings are never freed here;
+ * they stay in the wheel so that they time out normally if their session is
+ * revived.
+ */
+class IPRw::ExpiryWheel { public:
+
+    ExpiryWheel();
+    ~ExpiryWheel();
+
+    int initialize(uint32_t timeout_jiffies, uint32_t interval_jiffies);
+    void reset();
+
+    uint32_t timeout() const		{ return _timeout; }
+
+    void insert(Mapping *m)	{ insert(m, m->last_used() + _timeout, 0); }
+    void rebuild(Map &map);
+    bool expire(Map &map, uint32_t now, int slice);
+
+    uint32_t nexamined() const		{ return _nexamined; }
+    uint32_t nfreed() const		{ return _nfreed; }
+
+  private:
+
+    ExpiryLink *_buckets;
+    int _nbuckets;
+    int _cursor;		// bucket covering [_base, _base + _interval)
+    uint32_t _base;
+    uint32_t _interval;
+    uint32_t _timeout;
+
+    uint32_t _nexamined;
+    uint32_t _nfreed;
+
+    void insert(Mapping *m, uint32_t expiry, int min_offset);
+
+    ExpiryWheel(const ExpiryWheel &);
+    ExpiryWheel &operator=(const ExpiryWheel &);
+
+};
+
+
 class IPMapper { public:
 
     IPMapper()				{ }
@@ -245,5 +328,42 @@ IPRw::Mapping::used_since(uint32_t t) const
     return ((int32_t)(_used - t)) >= 0 || ((int32_t)(_reverse->_used - t)) >= 0;
 }
 
+inline uint32_t
+IPRw::Mapping::last_used() const
+{
+    return ((int32_t)(_used - _reverse->_used) >= 0 ? _used : _reverse->_used);
+}
+
+/** @brief Return the shard, in [0, nshards), that owns flow ID @a flow.
+ *
+ * The hash is symmetric, so a flow and its reverse share a shard. */
+inline int
+IPRw::flow_shard(const IPFlowID &flow, int nshards)
+{
+    if (nshards <= 1)
+	return 0;
+    uint32_t x = flow.saddr().addr() ^ flow.daddr().addr();
+    uint32_t y = flow.sport() ^ flow.dport();
+    x = (x ^ (x >> 16) ^ (y << 16) ^ y) * 0x9E3779B1U;
+    return (x >> 16) % nshards;
+}
+
+inline void
+IPRw::ExpiryLink::expiry_link_before(ExpiryLink *x)
+{
+    _expiry_next = x;
+    _expiry_prev = x->_expiry_prev;
+    _expiry_prev->_expiry_next = this;
+    x->_expiry_prev = this;
+}
+
+inline void
+IPRw::ExpiryLink::expiry_unlink()
+{
+    _expiry_prev->_expiry_next = _expiry_next;
+    _expiry_next->_expiry_prev = _expiry_prev;
+    _expiry_next = _expiry_prev = this;
+}
+
 CLICK_ENDDECLS
 #endif
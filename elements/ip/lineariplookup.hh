@@ -91,6 +91,10 @@ class LinearIPLookup : public IPRouteTable { public:
     int initialize(ErrorHandler *);
 
     void push(int port, Packet *p);
+    // push() keeps a last-address cache; subclasses override it too
+    void push_batch(int port, PacketBatch &batch) {
+	Element::push_batch(port, batch);
+    }
 
     int add_route(const IPRoute&, bool, IPRoute*, ErrorHandler *);
     int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
@@ -57,13 +57,10 @@ MarkIPCE::smaction(Packet *p)
     //         = ~(~old_sum + ~old_halfword + old_halfword + 0x0001)
     //         = ~(~old_sum + ~0 + 0x0001)
     //         = ~(~old_sum + 0x0001)
-    if ((q_iph->ip_tos & IP_ECNMASK) == IP_ECN_ECT2) {
-      unsigned sum = (~ntohs(q_iph->ip_sum) & 0xFFFF) + 0x0001;
-      q_iph->ip_sum = ~htons(sum + (sum >> 16));
-    } else {
-      unsigned sum = (~ntohs(q_iph->ip_sum) & 0xFFFF) + 0x0002;
-      q_iph->ip_sum = ~htons(sum + (sum >> 16));
-    }
+    if ((q_iph->ip_tos & IP_ECNMASK) == IP_ECN_ECT2)
+      click_update_in_cksum_delta(&q_iph->ip_sum, htons(0x0001));
+    else
+      click_update_in_cksum_delta(&q_iph->ip_sum, htons(0x0002));
 
     q_iph->ip_tos |= IP_ECN_CE;
 
@@ -44,6 +44,26 @@ RadixIPLookup::Radix::make_radix(int bitshift, int n)
 	return 0;
 }
 
+RadixIPLookup::Radix*
+RadixIPLookup::Radix::copy_radix(const Radix* r)
+{
+    Radix* x = make_radix(r->_bitshift, r->_n);
+    if (!x)
+	return 0;
+    x->_route_index = r->_route_index;
+    x->_nchildren = r->_nchildren;
+    for (int i = 0; i < r->_n; i++) {
+	x->_children[i].key = r->_children[i].key;
+	x->_children[i].key_priority = r->_children[i].key_priority;
+	if (r->_children[i].child
+	    && !(x->_children[i].child = copy_radix(r->_children[i].child))) {
+	    free_radix(x);
+	    return 0;
+	}
+    }
+    return x;
+}
+
 void
 RadixIPLookup::Radix::free_radix(Radix* r)
 {
@@ -93,40 +113,58 @@ RadixIPLookup::Radix::change(uint32_t addr, uint32_t naddr, int key, uint32_t ke
 }
 
 
-RadixIPLookup::RadixIPLookup()
+RadixIPLookup::Table::Table()
     : _vfree(-1), _default_key(-1), _radix(Radix::make_radix(24, 256))
 {
 }
 
-RadixIPLookup::~RadixIPLookup()
+int
+RadixIPLookup::Table::copy(const Table& t)
 {
+    Radix* r = Radix::copy_radix(t._radix);
+    if (!r)
+	return -ENOMEM;
+    cleanup();
+    _v = t._v;
+    _vfree = t._vfree;
+    _default_key = t._default_key;
+    _radix = r;
+    return 0;
 }
 
-
 void
-RadixIPLookup::cleanup(CleanupStage)
+RadixIPLookup::Table::cleanup()
 {
     _v.clear();
-    Radix::free_radix(_radix);
+    if (_radix)
+	Radix::free_radix(_radix);
     _radix = 0;
 }
 
+void
+RadixIPLookup::Table::flush()
+{
+    cleanup();
+    _vfree = _default_key = -1;
+    _radix = Radix::make_radix(24, 256);
+}
 
 String
-RadixIPLookup::dump_routes()
+RadixIPLookup::Table::dump() const
 {
     StringAccum sa;
+    Vector<uint8_t> unused(_v.size(), 0);
     for (int j = _vfree; j >= 0; j = _v[j].extra)
-	_v[j].kill();
+	unused[j] = 1;
     for (int i = 0; i < _v.size(); i++)
-	if (_v[i].real())
+	if (!unused[i] && _v[i].real())
 	    _v[i].unparse(sa, true) << '\n';
     return sa.take_string();
 }
 
 
 int
-RadixIPLookup::add_route(const IPRoute& route, bool set, IPRoute* old_route, ErrorHandler *)
+RadixIPLookup::Table::add_route(const IPRoute& route, bool set, IPRoute* old_route, ErrorHandler *)
 {
     int found;
     if (_vfree < 0) {
@@ -173,7 +211,7 @@ RadixIPLookup::add_route(const IPRoute& route, bool set, IPRoute* old_route, Err
 }
 
 int
-RadixIPLookup::remove_route(const IPRoute& route, IPRoute* old_route, ErrorHandler*)
+RadixIPLookup::Table::remove_route(const IPRoute& route, IPRoute* old_route, ErrorHandler*)
 {
     int32_t* pprev;
     uint32_t hmask = ntohl(route.mask.addr());
@@ -203,13 +241,79 @@ RadixIPLookup::remove_route(const IPRoute& route, IPRoute* old_route, ErrorHandl
     return r;
 }
 
+
+
+RadixIPLookup::RadixIPLookup()
+{
+}
+
+RadixIPLookup::~RadixIPLookup()
+{
+}
+
+int
+RadixIPLookup::initialize(ErrorHandler *)
+{
+    _tables.activate(this);
+    return 0;
+}
+
+void
+RadixIPLookup::cleanup(CleanupStage)
+{
+    _tables.cleanup();
+}
+
+String
+RadixIPLookup::dump_routes()
+{
+    return _tables.current()->dump();
+}
+
+int
+RadixIPLookup::add_route(const IPRoute& route, bool set, IPRoute* old_route, ErrorHandler *errh)
+{
+    int r;
+    if ((r = begin_update(errh)) < 0)
+	return r;
+    if ((r = _tables.shadow().add_route(route, set, old_route, errh)) >= 0)
+	_tables.log(route, set ? _tables.SET : _tables.ADD);
+    commit_update();
+    return r;
+}
+
+int
+RadixIPLookup::remove_route(const IPRoute& route, IPRoute* old_route, ErrorHandler *errh)
+{
+    int r;
+    if ((r = begin_update(errh)) < 0)
+	return r;
+    if ((r = _tables.shadow().remove_route(route, old_route, errh)) >= 0)
+	_tables.log(route, _tables.REMOVE);
+    commit_update();
+    return r;
+}
+
+int
+RadixIPLookup::begin_update(ErrorHandler *errh)
+{
+    return _tables.begin(master(), errh);
+}
+
+void
+RadixIPLookup::commit_update()
+{
+    _tables.commit(master());
+}
+
 int
 RadixIPLookup::lookup_route(IPAddress addr, IPAddress &gw) const
 {
-    int key = Radix::lookup(_radix, _default_key, ntohl(addr.addr()));
-    if (key >= 0 && _v[key].contains(addr)) {
-	gw = _v[key].gw;
-	return _v[key].port;
+    const Table *t = _tables.current();
+    int key = Radix::lookup(t->_radix, t->_default_key, ntohl(addr.addr()));
+    if (key >= 0 && t->_v[key].contains(addr)) {
+	gw = t->_v[key].gw;
+	return t->_v[key].port;
     } else {
 	gw = 0;
 	return -1;
@@ -31,6 +31,9 @@ gateway IP address, and an output port.
 
 Uses the IPRouteTable interface; see IPRouteTable for description.
 
+Route updates are made to a second copy of the trie and published all at
+once, so they never stop lookups (see IPRouteTable).
+
 =h table read-only
 
 Outputs a human-readable version of the current routing table.
@@ -77,23 +80,42 @@ class RadixIPLookup : public IPRouteTable { public:
     const char *port_count() const		{ return "1/-"; }
     const char *processing() const		{ return PUSH; }
 
+    int initialize(ErrorHandler *);
     void cleanup(CleanupStage);
 
     int add_route(const IPRoute&, bool, IPRoute*, ErrorHandler *);
     int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
     int lookup_route(IPAddress, IPAddress&) const;
     String dump_routes();
+    int begin_update(ErrorHandler *);
+    void commit_update();
 
   private:
 
     class Radix;
 
-    // Simple routing table
-    Vector<IPRoute> _v;
-    int _vfree;
+    struct Table {
+	// Simple routing table
+	Vector<IPRoute> _v;
+	int _vfree;
+
+	int32_t _default_key;
+	Radix* _radix;
+
+	Table();
+	~Table()		{ cleanup(); }
+
+	int copy(const Table &);
+	void cleanup();
+
+	int add_route(const IPRoute&, bool, IPRoute*, ErrorHandler *);
+	int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
+	void flush();
+	void finish()		{ }
+	String dump() const;
+    };
 
-    int32_t _default_key;
-    Radix* _radix;
+    IPRouteTableRCU<Table> _tables;
 
 };
 
@@ -102,6 +124,7 @@ class RadixIPLookup : public IPRouteTable { public:
 class RadixIPLookup::Radix { public:
 
     static Radix* make_radix(int bitshift, int n);
+    static Radix* copy_radix(const Radix*);
     static void free_radix(Radix*);
 
     Radix* change(uint32_t addr, uint32_t naddr, int key, uint32_t key_priority);
@@ -123,6 +146,7 @@ class RadixIPLookup::Radix { public:
     ~Radix()			{ }
 
     friend class RadixIPLookup;
+    friend struct RadixIPLookup::Table;
 
 };
 
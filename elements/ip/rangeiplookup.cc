@@ -26,43 +26,100 @@
 #include <click/error.hh>
 CLICK_DECLS
 
-RangeIPLookup::RangeIPLookup()
-    : _range_base((uint32_t *) CLICK_LALLOC((1 << KICKSTART_BITS) * sizeof(uint32_t))),
-      _range_len((uint32_t *) CLICK_LALLOC((1 << KICKSTART_BITS) * sizeof(uint32_t))),
-      _range_t((uint32_t *) CLICK_LALLOC(RANGES_MAX * sizeof(uint32_t))),
-      _active(false)
+// RANGEIPLOOKUP::TABLE
+
+int
+RangeIPLookup::Table::initialize()
 {
+    if ((_range_base = (uint32_t *) CLICK_LALLOC((1 << KICKSTART_BITS) * sizeof(uint32_t)))
+	&& (_range_len = (uint32_t *) CLICK_LALLOC((1 << KICKSTART_BITS) * sizeof(uint32_t)))
+	&& (_range_t = (uint32_t *) CLICK_LALLOC(RANGES_MAX * sizeof(uint32_t))))
+	return _helper.initialize();
+    else
+	return -ENOMEM;
 }
 
-RangeIPLookup::~RangeIPLookup()
+int
+RangeIPLookup::Table::copy(const Table &t)
+{
+    cleanup();
+    int r;
+    if ((r = initialize()) < 0 || (r = _helper.copy(t._helper)) < 0)
+	return r;
+    memcpy(_range_base, t._range_base, (1 << KICKSTART_BITS) * sizeof(uint32_t));
+    memcpy(_range_len, t._range_len, (1 << KICKSTART_BITS) * sizeof(uint32_t));
+    memcpy(_range_t, t._range_t, RANGES_MAX * sizeof(uint32_t));
+    _dirty = t._dirty;
+    return 0;
+}
+
+void
+RangeIPLookup::Table::cleanup()
 {
     CLICK_LFREE(_range_base, (1 << KICKSTART_BITS) * sizeof(uint32_t));
     CLICK_LFREE(_range_len, (1 << KICKSTART_BITS) * sizeof(uint32_t));
     CLICK_LFREE(_range_t, RANGES_MAX * sizeof(uint32_t));
+    _range_base = _range_len = _range_t = 0;
+    _helper.cleanup();
+}
+
+int
+RangeIPLookup::Table::add_route(const IPRoute& route, bool allow_replace, IPRoute* old_route, ErrorHandler *errh)
+{
+    int error = _helper.add_route(route, allow_replace, old_route, errh);
+    if (error == 0)
+	_dirty = true;
+    return error;
+}
+
+int
+RangeIPLookup::Table::remove_route(const IPRoute& route, IPRoute* old_route, ErrorHandler *errh)
+{
+    int error = _helper.remove_route(route, old_route, errh);
+    if (error == 0)
+	_dirty = true;
+    return error;
+}
+
+void
+RangeIPLookup::Table::flush()
+{
+    _helper.flush();
+    _dirty = true;
+}
+
+
+// RANGEIPLOOKUP
+
+RangeIPLookup::RangeIPLookup()
+{
+}
+
+RangeIPLookup::~RangeIPLookup()
+{
 }
 
 int
 RangeIPLookup::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     int r;
-    if ((r = _helper.initialize()) < 0)
+    if ((r = _tables.shadow().initialize()) < 0)
 	return r;
-    flush_table();
+    _tables.shadow().flush();
     return IPRouteTable::configure(conf, errh);
 }
 
 int
 RangeIPLookup::initialize(ErrorHandler *)
 {
-    expand();
-    _active = true;
+    _tables.activate(this);
     return 0;
 }
 
 void
 RangeIPLookup::cleanup(CleanupStage)
 {
-    _helper.cleanup();
+    _tables.cleanup();
 }
 
 void
@@ -74,7 +131,7 @@ RangeIPLookup::push(int, Packet *p)
 #ifdef RANGEIPLOOKUP_VERBOSE
     // Consistency check - does directiplookup yied the same result?
     IPAddress gw1;
-    int port1 = _helper.lookup_route(p->dst_ip_anno(), gw1);
+    int port1 = _tables.current()->_helper.lookup_route(p->dst_ip_anno(), gw1);
     if (port != port1 || gw != gw1)
 	click_chatter("RangeIPLookup: consistency check failed!");
 #endif
@@ -87,17 +144,12 @@ RangeIPLookup::push(int, Packet *p)
         p->kill();
 }
 
-int
-RangeIPLookup::lookup_route(IPAddress dest, IPAddress &gw) const
+inline uint16_t
+RangeIPLookup::Table::range_lookup(uint32_t ip_addr, uint32_t lowerbound,
+				  uint32_t upperbound) const
 {
-    uint32_t ip_addr = ntohl(dest.addr());
-    uint32_t lowerbound, upperbound, middle;
-    uint32_t i = ip_addr >> RANGE_SHIFT; // kickstart table index = MS bits
-    uint16_t vport_i;
-
-    lowerbound = _range_base[i];
-    upperbound = lowerbound + _range_len[i];
-    i = ip_addr & RANGE_MASK;		// Compare only masked LS bits
+    uint32_t middle;
+    uint32_t i = ip_addr & RANGE_MASK;	// Compare only masked LS bits
 
     // Binary search for a matching range
     while (upperbound > lowerbound) {
@@ -112,9 +164,51 @@ RangeIPLookup::lookup_route(IPAddress dest, IPAddress &gw) const
     }
 
     // MS bits of the found range contain an index into the output port table
-    vport_i = _range_t[lowerbound] >> RANGE_SHIFT;
-    gw = _helper._vport[vport_i].gw;
-    return _helper._vport[vport_i].port;
+    return _range_t[lowerbound] >> RANGE_SHIFT;
+}
+
+int
+RangeIPLookup::lookup_route(IPAddress dest, IPAddress &gw) const
+{
+    const Table *t = _tables.current();
+    uint32_t ip_addr = ntohl(dest.addr());
+    uint32_t i = ip_addr >> RANGE_SHIFT; // kickstart table index = MS bits
+    uint16_t vport_i = t->range_lookup(ip_addr, t->_range_base[i],
+				       t->_range_base[i] + t->_range_len[i]);
+    gw = t->_helper._vport[vport_i].gw;
+    return t->_helper._vport[vport_i].port;
+}
+
+void
+RangeIPLookup::lookup_route_batch(const IPAddress *dest, IPAddress *gw,
+				  int *port, int n) const
+{
+    const Table *t = _tables.current();
+    uint32_t ip_addr[LOOKUP_BATCH], lowerbound[LOOKUP_BATCH];
+    while (n > 0) {
+	int k = (n < LOOKUP_BATCH ? n : LOOKUP_BATCH);
+
+	// The kickstart table is small and stays cached; prefetch the first
+	// range each binary search will probe before starting any of them.
+	for (int j = 0; j < k; j++) {
+	    ip_addr[j] = ntohl(dest[j].addr());
+	    uint32_t i = ip_addr[j] >> RANGE_SHIFT;
+	    lowerbound[j] = t->_range_base[i];
+	    click_prefetch(&t->_range_t[lowerbound[j] + (t->_range_len[i] >> 1)]);
+	}
+	for (int j = 0; j < k; j++) {
+	    uint32_t i = ip_addr[j] >> RANGE_SHIFT;
+	    uint16_t vport_i = t->range_lookup(ip_addr[j], lowerbound[j],
+					       lowerbound[j] + t->_range_len[i]);
+	    gw[j] = t->_helper._vport[vport_i].gw;
+	    port[j] = t->_helper._vport[vport_i].port;
+	}
+
+	dest += k;
+	gw += k;
+	port += k;
+	n -= k;
+    }
 }
 
 void
@@ -127,23 +221,41 @@ RangeIPLookup::add_handlers()
 int
 RangeIPLookup::add_route(const IPRoute& route, bool allow_replace, IPRoute* old_route, ErrorHandler *errh)
 {
-    int error = _helper.add_route(route, allow_replace, old_route, errh);
-    if (error == 0 && _active)
-	expand();
-    return error;
+    int r;
+    if ((r = begin_update(errh)) < 0)
+	return r;
+    if ((r = _tables.shadow().add_route(route, allow_replace, old_route, errh)) >= 0)
+	_tables.log(route, allow_replace ? _tables.SET : _tables.ADD);
+    commit_update();
+    return r;
 }
 
 int
 RangeIPLookup::remove_route(const IPRoute& route, IPRoute* old_route, ErrorHandler *errh)
 {
-    int error = _helper.remove_route(route, old_route, errh);
-    if (error == 0 && _active)
-	expand();
-    return error;
+    int r;
+    if ((r = begin_update(errh)) < 0)
+	return r;
+    if ((r = _tables.shadow().remove_route(route, old_route, errh)) >= 0)
+	_tables.log(route, _tables.REMOVE);
+    commit_update();
+    return r;
+}
+
+int
+RangeIPLookup::begin_update(ErrorHandler *errh)
+{
+    return _tables.begin(master(), errh);
+}
+
+void
+RangeIPLookup::commit_update()
+{
+    _tables.commit(master());
 }
 
 /*
- * On each routing table update, we distill the address range based lookup
+ * On each routing table update or transaction, we distill the address range based lookup
  * table from the structures provided by the DirectIPLookup class.
  * The main cost of this operation is associated with traversing through
  * 32 + 16 = 48 MBytes of directiplookup tables.  We should implement a
@@ -151,7 +263,7 @@ RangeIPLookup::remove_route(const IPRoute& route, IPRoute* old_route, ErrorHandl
  * the future, which would not depend on huge directiplookup tables.
  */
 void
-RangeIPLookup::expand()
+RangeIPLookup::Table::expand()
 {
     uint32_t range_t_index = 0;
     uint32_t tbl_0_23_index = 0;
@@ -198,6 +310,7 @@ RangeIPLookup::expand()
 	}
 	_range_len[range_base] = range_len - 1;
     }
+    _dirty = false;
 
 #ifdef RANGEIPLOOKUP_VERBOSE
     click_chatter("Range expansion done: %d ranges using %d + %d bytes",
@@ -206,28 +319,24 @@ RangeIPLookup::expand()
 #endif
 }
 
-void
-RangeIPLookup::flush_table()
-{
-    _helper.flush();
-    memset(_range_base, 0, sizeof(_range_base));
-    memset(_range_len, 0, sizeof(_range_len));
-    memset(_range_t, 0, sizeof(_range_t));
-}
-
 int
 RangeIPLookup::flush_handler(const String &, Element *e, void *,
-                                ErrorHandler *)
+                                ErrorHandler *errh)
 {
     RangeIPLookup *t = static_cast<RangeIPLookup *>(e);
-    t->flush_table();
+    int r;
+    if ((r = t->begin_update(errh)) < 0)
+	return r;
+    t->_tables.shadow().flush();
+    t->_tables.log(IPRoute(), t->_tables.FLUSH);
+    t->commit_update();
     return 0;
 }
 
 String
 RangeIPLookup::dump_routes()
 {
-    return _helper.dump();
+    return _tables.current()->_helper.dump();
 }
 
 CLICK_ENDDECLS
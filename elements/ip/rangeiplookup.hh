@@ -38,6 +38,16 @@ RangeIPLookup maintains a large DirectIPLookup table as well as its own
 tables.  Although this subsidiary table is only accessed during route updates,
 it significantly adds to RangeIPLookup's total memory footprint.
 
+Route updates are made to a second copy of both tables, and published all at
+once, so they never stop lookups (see IPRouteTable).  The compact table is
+rebuilt once per update or `C<ctrl>' transaction.  The second copy is
+allocated by the first update after the router starts.
+
+Packets that arrive in a batch are looked up 16 at a time: RangeIPLookup
+prefetches the first range each lookup's binary search will probe before
+starting any of the searches, then forwards packets to each output as a
+batch.
+
 =h table read-only
 
 Outputs a human-readable version of the current routing table.
@@ -98,26 +108,55 @@ class RangeIPLookup : public IPRouteTable { public:
     int add_route(const IPRoute&, bool, IPRoute*, ErrorHandler *);
     int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
     int lookup_route(IPAddress, IPAddress&) const;
+    void lookup_route_batch(const IPAddress *, IPAddress *, int *, int) const;
     String dump_routes();
+    int begin_update(ErrorHandler *errh);
+    void commit_update();
 
     static int flush_handler(const String &, Element *, void *, ErrorHandler *);
 
   protected:
 
-    void flush_table();
-    void expand();
-
     enum { KICKSTART_BITS = 12 };
     enum { RANGES_MAX = 256 * 1024 };
     enum { RANGE_MASK = 0xffffffff >> KICKSTART_BITS };
     enum { RANGE_SHIFT = 32 - KICKSTART_BITS };
 
-    uint32_t *_range_base;
-    uint32_t *_range_len;
-    uint32_t *_range_t;
-    bool _active;
+    struct Table {
+	uint32_t *_range_base;
+	uint32_t *_range_len;
+	uint32_t *_range_t;
+	bool _dirty;
+
+	DirectIPLookup::Table _helper;
+
+	Table()
+	    : _range_base(0), _range_len(0), _range_t(0), _dirty(false) {
+	}
+
+	~Table() {
+	    cleanup();
+	}
+
+	int initialize();
+	int copy(const Table &);
+	void cleanup();
+
+	int add_route(const IPRoute&, bool, IPRoute*, ErrorHandler *);
+	int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
+	void flush();
+	void finish() {
+	    if (_dirty)
+		expand();
+	}
+
+	void expand();
+	inline uint16_t range_lookup(uint32_t ip_addr, uint32_t lowerbound,
+				     uint32_t upperbound) const;
+
+    };
 
-    DirectIPLookup::Table _helper;
+    IPRouteTableRCU<Table> _tables;
 
 };
 
@@ -58,10 +58,7 @@ SetIPDSCP::smaction(Packet *p_in)
   uint16_t new_hw = (reinterpret_cast<uint16_t *>(ip))[0];
 
   // 19.Aug.1999 - incrementally update IP checksum according to RFC1624.
-  // new_sum = ~(~old_sum + ~old_halfword + new_halfword)
-  uint32_t sum = (~ip->ip_sum & 0xFFFF) + (~old_hw & 0xFFFF) + new_hw;
-  sum = (sum & 0xFFFF) + (sum >> 16);
-  ip->ip_sum = ~(sum + (sum >> 16));
+  click_update_in_cksum(&ip->ip_sum, old_hw, new_hw);
 
   return p;
 }
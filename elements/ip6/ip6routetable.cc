@@ -51,6 +51,12 @@ IP6RouteTable::remove_route(IP6Address, IP6Address, ErrorHandler *errh)
     return errh->error("cannot delete routes from this routing table");
 }
 
+int
+IP6RouteTable::lookup_route(IP6Address, IP6Address &) const
+{
+    return -1;
+}
+
 String
 IP6RouteTable::dump_routes()
 {
@@ -125,5 +131,32 @@ IP6RouteTable::table_handler(Element *e, void *)
     return r->dump_routes();
 }
 
+int
+IP6RouteTable::lookup_handler(int, String& s, Element* e, const Handler*, ErrorHandler* errh)
+{
+    IP6RouteTable *table = static_cast<IP6RouteTable*>(e);
+    IP6Address a;
+    if (cp_ip6_address(s, &a, table)) {
+	IP6Address gw;
+	int port = table->lookup_route(a, gw);
+	if (gw)
+	    s = String(port) + " " + gw.unparse();
+	else
+	    s = String(port);
+	return 0;
+    } else
+	return errh->error("expected IP6 address");
+}
+
+void
+IP6RouteTable::add_handlers()
+{
+    add_write_handler("add", add_route_handler, 0);
+    add_write_handler("remove", remove_route_handler, 0);
+    add_write_handler("ctrl", ctrl_handler, 0);
+    add_read_handler("table", table_handler, 0, Handler::EXPENSIVE);
+    set_handler("lookup", Handler::OP_READ | Handler::READ_PARAM, lookup_handler);
+}
+
 CLICK_ENDDECLS
 ELEMENT_PROVIDES(IP6RouteTable)
@@ -81,12 +81,18 @@ LookupIP6Route::configure(Vector<String> &conf, ErrorHandler *errh)
 
 int
 LookupIP6Route::initialize(ErrorHandler *)
+{
+  flush_cache();
+  return 0;
+}
+
+void
+LookupIP6Route::flush_cache()
 {
   _last_addr = IP6Address();
-  #ifdef IP_RT_CACHE2
+#ifdef IP_RT_CACHE2
   _last_addr2 = _last_addr;
 #endif
-  return 0;
 }
 
 void
@@ -134,7 +140,7 @@ LookupIP6Route::push(int, Packet *p)
     _last_addr = a;
     _last_gw = gw;
     _last_output = ifi;
-    if (gw != IP6Address("::0")) {
+    if (gw) {
 	SET_DST_IP6_ANNO(p, IP6Address(gw));
     }
     output(ifi).push(p);
@@ -148,10 +154,11 @@ int
 LookupIP6Route::add_route(IP6Address addr, IP6Address mask, IP6Address gw,
                           int output, ErrorHandler *errh)
 {
-  if (output < 0 && output >= noutputs())
+  if (output < 0 || output >= noutputs())
     return errh->error("port number out of range"); // Can't happen...
 
   _t.add(addr, mask, gw, output);
+  flush_cache();
   return 0;
 }
 
@@ -160,16 +167,18 @@ LookupIP6Route::remove_route(IP6Address addr, IP6Address mask,
 			     ErrorHandler *)
 {
   _t.del(addr, mask);
+  flush_cache();
   return 0;
 }
 
-void
-LookupIP6Route::add_handlers()
+int
+LookupIP6Route::lookup_route(IP6Address addr, IP6Address &gw) const
 {
-    add_write_handler("add", add_route_handler, 0);
-    add_write_handler("remove", remove_route_handler, 0);
-    add_write_handler("ctrl", ctrl_handler, 0);
-    add_read_handler("table", table_handler, 0);
+  int ifi;
+  if (_t.lookup(addr, gw, ifi))
+    return ifi;
+  else
+    return -1;
 }
 
 CLICK_ENDDECLS
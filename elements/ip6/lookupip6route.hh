@@ -21,6 +21,26 @@ CLICK_DECLS
  * a destination and mask, a gateway (zero means none),
  * and an output index.
  *
+ * Routes are stored in a compressed multibit trie, so lookup cost depends
+ * on the prefix length, not the number of routes.
+ *
+ * =h table read-only
+ * Outputs a human-readable version of the current routing table.
+ *
+ * =h lookup read-only
+ * Reports the OUTput port and GW corresponding to an address.
+ *
+ * =h add write-only
+ * Adds a route to the table.  Format should be `C<DST/MASK [GW] OUT>'.
+ * Replaces any existing route with the same DST/MASK.
+ *
+ * =h remove write-only
+ * Removes a route from the table.  Format should be `C<DST/MASK>'.
+ *
+ * =h ctrl write-only
+ * Adds or removes routes.  Write `C<add DST/MASK [GW] OUT>' to add a route,
+ * and `C<remove DST/MASK>' to remove a route.
+ *
  * =e
  *
  *   ... -> GetIP6Address(24) -> rt;
@@ -50,12 +70,12 @@ public:
 
   int configure(Vector<String> &, ErrorHandler *);
   int initialize(ErrorHandler *);
-  void add_handlers();
 
   void push(int port, Packet *p);
 
   int add_route(IP6Address, IP6Address, IP6Address, int, ErrorHandler *);
   int remove_route(IP6Address, IP6Address, ErrorHandler *);
+  int lookup_route(IP6Address, IP6Address &) const;
   String dump_routes()				{ return _t.dump(); };
 
 private:
@@ -72,6 +92,8 @@ private:
   int _last_output2;
 #endif
 
+  void flush_cache();
+
 };
 
 CLICK_ENDDECLS
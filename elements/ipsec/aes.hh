@@ -6,34 +6,27 @@ CLICK_DECLS
 
 /*
  * =c
- * IPsecAES(ENCRYPT)
+ * IPsecAES(ENCRYPT [, HARDWARE, I<keywords> ICV])
  * =s ipsec
- * encrypt packet using DES-CBC
+ * encrypt packet using AES-CBC
  * =d
  *
- * Encrypts or decrypts packet using DES-CBC. If the first argument is 0,
+ * Encrypts or decrypts packet using AES-CBC. If the first argument is 0,
  * IPsecAES will decrypt. If the first argument is 1, IPsecAES will encrypt.
- * KEY is the DES secret key. Gets IV value from ESP header. IGNORE is the
- * number of bytes at the end of the payload to ignore. By default, IGNORE is
- * 12, which is the number of SHA1 authentication digest bytes for ESP or AH.
+ * The key is the 128-bit encryption key of the packet's security association,
+ * found through the IPsec SA data annotation; its schedules are expanded once,
+ * when the SA is created. Gets IV value from ESP header. The last ICV bytes
+ * of the payload, the authentication digest for ESP or AH, are not encrypted
+ * unless needed to fill the last 16-byte block. ICV defaults to 12, the
+ * length of IPsecAuthHMACSHA1's digest; use 16 with IPsecAuthHMACSHA256.
  *
- * =a IPsecESPEncap, IPsecESPUnencap, IPsecAuthSHA1
+ * If HARDWARE is true, which is the default, IPsecAES uses the AES-NI
+ * instructions on CPUs that have them. Setting it to false forces the portable
+ * implementation.
+ *
+ * =a IPsecESPEncap, IPsecESPUnencap, IPsecAuthHMACSHA1, IPsecAESGCM
  */
 
-# define GETU32(pt) (((unsigned long)(pt)[0] << 24) ^ ((unsigned long)(pt)[1] << 16) ^ ((unsigned long)(pt)[2] <<  8) ^ ((unsigned long)(pt)[3]))
-# define PUTU32(ct, st) { (ct)[0] = (char)((st) >> 24); (ct)[1] = (char)((st) >> 16); (ct)[2] = (char)((st) >>  8); (ct)[3] = (char)(st); }
-/*#endif*/
-
-#define AES_MAXNR 14
-#define AES_BLOCK_SIZE 16
-
-struct aes_key_st {
-    unsigned long rd_key[4 *(AES_MAXNR + 1)];
-    int rounds;
-};
-typedef struct aes_key_st AES_KEY;
-
-
 class Address;
 
 
@@ -55,13 +48,9 @@ class Aes : public Element {
    enum { AES_DECRYPT = 0, AES_ENCRYPT = 1 };
 
  private:
-   int AES_set_encrypt_key(const unsigned char *userKey, const int bits, AES_KEY *key);
-   int AES_set_decrypt_key(const unsigned char *userKey, const int bits, AES_KEY *key);
-   void AES_encrypt(const unsigned char *in, unsigned char *out,const AES_KEY *key);
-   void AES_decrypt(const unsigned char *in, unsigned char *out,const AES_KEY *key);
    unsigned _op;
    int _ignore;
-   AES_KEY _key;
+   bool _hardware;
 };
 
 CLICK_ENDDECLS
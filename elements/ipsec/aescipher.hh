@@ -0,0 +1,107 @@
+#ifndef CLICK_IPSEC_AESCIPHER_HH
+#define CLICK_IPSEC_AESCIPHER_HH
+#include <click/glue.hh>
+CLICK_DECLS
+
+/*
+ * aescipher.{cc,hh} -- AES block cipher and GCM mode for the IPsec elements
+ *
+ * AESCipher holds an AES key expanded once into its encryption and
+ * decryption schedules, so per-packet code never repeats key expansion.
+ * Blocks are processed with AES-NI instructions when the CPU has them and the
+ * caller allows it, and with the portable table-driven implementation
+ * otherwise; both give identical results.
+ *
+ * AESGCM adds the GHASH key for AES-GCM (NIST SP 800-38D) with a 96-bit nonce,
+ * as used by ESP (RFC 4106). seal() and open() run the CTR keystream and
+ * GHASH over the data in a single pass, using PCLMULQDQ for GHASH when
+ * available.
+ *
+ * SADataTuple keeps one of each per security association.
+ */
+
+# define GETU32(pt) (((unsigned long)(pt)[0] << 24) ^ ((unsigned long)(pt)[1] << 16) ^ ((unsigned long)(pt)[2] <<  8) ^ ((unsigned long)(pt)[3]))
+# define PUTU32(ct, st) { (ct)[0] = (char)((st) >> 24); (ct)[1] = (char)((st) >> 16); (ct)[2] = (char)((st) >>  8); (ct)[3] = (char)(st); }
+
+#define AES_MAXNR 14
+#define AES_BLOCK_SIZE 16
+
+struct aes_key_st {
+    unsigned long rd_key[4 *(AES_MAXNR + 1)];
+    int rounds;
+};
+typedef struct aes_key_st AES_KEY;
+
+class AESCipher { public:
+
+    // Expands a 128-, 192-, or 256-bit key. Returns 0 on success, -2 on a bad
+    // key length.
+    int set_key(const unsigned char *key, int bits);
+
+    // Single blocks; in and out may overlap. The hardware argument allows
+    // AES-NI if the CPU supports it.
+    void encrypt(const unsigned char *in, unsigned char *out, bool hardware = true) const;
+    void decrypt(const unsigned char *in, unsigned char *out, bool hardware = true) const;
+
+    // Decrypts n independent blocks (ECB); with AES-NI, four are in flight at
+    // once. in and out must not partially overlap.
+    void decrypt_blocks(const unsigned char *in, unsigned char *out, int n, bool hardware = true) const;
+
+    int rounds() const			{ return _ekey.rounds; }
+    bool hardware() const		{ return _hardware; }
+
+    // Returns true if this CPU supports AES-NI and PCLMULQDQ.
+    static bool hardware_available();
+
+  private:
+
+    AES_KEY _ekey;
+    AES_KEY _dkey;
+    // the same schedules, as bytes, for the AES-NI instructions
+    unsigned char _hw_ekey[AES_BLOCK_SIZE * (AES_MAXNR + 1)];
+    unsigned char _hw_dkey[AES_BLOCK_SIZE * (AES_MAXNR + 1)];
+    bool _hardware;
+
+    friend class AESGCM;
+
+};
+
+class AESGCM { public:
+
+    enum { NONCE_SIZE = 12, TAG_SIZE = 16 };
+
+    // Derives the GHASH key from aes, which must already be keyed.
+    void set_key(const AESCipher &aes);
+
+    // Encrypts len bytes at data in place under aes and nonce, and writes the
+    // TAG_SIZE-byte authentication tag over aad and the ciphertext to tag.
+    void seal(const AESCipher &aes, const unsigned char *nonce,
+	      const unsigned char *aad, int aadlen,
+	      unsigned char *data, int len, unsigned char *tag,
+	      bool hardware = true) const;
+
+    // Decrypts len bytes at data in place, and writes the tag computed over
+    // aad and the ciphertext to tag; the caller compares it with the
+    // received one.
+    void open(const AESCipher &aes, const unsigned char *nonce,
+	      const unsigned char *aad, int aadlen,
+	      unsigned char *data, int len, unsigned char *tag,
+	      bool hardware = true) const;
+
+  private:
+
+    // H = E_K(0^128); _hl and _hh are its 4-bit multiplication table
+    unsigned char _h[AES_BLOCK_SIZE];
+    uint64_t _hl[16];
+    uint64_t _hh[16];
+
+    void crypt(const AESCipher &aes, const unsigned char *nonce,
+	       const unsigned char *aad, int aadlen,
+	       unsigned char *data, int len, unsigned char *tag,
+	       bool encrypt, bool hardware) const;
+    void gmult(unsigned char *x) const;
+
+};
+
+CLICK_ENDDECLS
+#endif
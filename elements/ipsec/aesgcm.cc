@@ -0,0 +1,152 @@
+/*
+ * aesgcm.{cc,hh} -- element implements IPsec ESP encryption and
+ * authentication using AES-GCM
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#ifndef HAVE_IPSEC
+# error "Must #define HAVE_IPSEC in config.h"
+#endif
+#include "aesgcm.hh"
+#include "esp.hh"
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/glue.hh>
+#include <click/packet_anno.hh>
+#include "sadatatuple.hh"
+CLICK_DECLS
+
+IPsecAESGCM::IPsecAESGCM()
+{
+}
+
+IPsecAESGCM::~IPsecAESGCM()
+{
+}
+
+int
+IPsecAESGCM::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+  _icv = AESGCM::TAG_SIZE;
+  _hardware = true;
+  if (cp_va_kparse(conf, this, errh,
+		   "ENCRYPT", cpkP+cpkM, cpInteger, &_op,
+		   "ICV", 0, cpUnsigned, &_icv,
+		   "HARDWARE", 0, cpBool, &_hardware,
+		   cpEnd) < 0)
+    return -1;
+  if (_icv != 8 && _icv != 12 && _icv != 16)
+    return errh->error("ICV must be 8, 12, or 16");
+  return 0;
+}
+
+int
+IPsecAESGCM::initialize(ErrorHandler *)
+{
+  _drops = 0;
+  return 0;
+}
+
+Packet *
+IPsecAESGCM::drop(Packet *p)
+{
+  _drops++;
+  if (noutputs() > 1)
+    output(1).push(p);
+  else
+    p->kill();
+  return 0;
+}
+
+Packet *
+IPsecAESGCM::simple_action(Packet *p_in)
+{
+  SADataTuple *sa_data = (SADataTuple *)IPSEC_SA_DATA_REFERENCE_ANNO(p_in);
+  unsigned char nonce[AESGCM::NONCE_SIZE], tag[AESGCM::TAG_SIZE];
+
+  if (sa_data == NULL) {
+    click_chatter("AESGCM: No SADataTuple annotation. This module is not properly placed check man page\n");
+    p_in->kill();
+    return 0;
+  }
+  if (p_in->length() < sizeof(esp_new) + (_op == GCM_DECRYPT ? _icv : 0)) {
+    click_chatter("AESGCM: packet too short");
+    return drop(p_in);
+  }
+
+  if (_op == GCM_ENCRYPT) {
+    WritablePacket *p = p_in->put(_icv);
+    if (!p)
+      return 0;
+    struct esp_new *esp = (struct esp_new *)p->data();
+    int len = p->length() - sizeof(esp_new) - _icv;
+    // GCM must never reuse a nonce under one key, so replace the ESP
+    // header's random IV with the SA's counter
+    uint64_t iv = sa_data->next_gcm_iv();
+    for (int i = sizeof(esp->esp_iv) - 1; i >= 0; i--, iv >>= 8)
+      esp->esp_iv[i] = iv;
+    memcpy(nonce, sa_data->gcm_salt, GCM_SALT_SIZE);
+    memcpy(nonce + GCM_SALT_SIZE, esp->esp_iv, sizeof(esp->esp_iv));
+    // AAD is the SPI and sequence number
+    sa_data->gcm.seal(sa_data->aes, nonce, p->data(), 8,
+		      p->data() + sizeof(esp_new), len, tag, _hardware);
+    memcpy(p->data() + p->length() - _icv, tag, _icv);
+    return p;
+  } else {
+    WritablePacket *p = p_in->uniqueify();
+    if (!p)
+      return 0;
+    struct esp_new *esp = (struct esp_new *)p->data();
+    unsigned char *data = p->data() + sizeof(esp_new);
+    int len = p->length() - sizeof(esp_new) - _icv;
+    memcpy(nonce, sa_data->gcm_salt, GCM_SALT_SIZE);
+    memcpy(nonce + GCM_SALT_SIZE, esp->esp_iv, sizeof(esp->esp_iv));
+    sa_data->gcm.open(sa_data->aes, nonce, p->data(), 8,
+		      data, len, tag, _hardware);
+
+    // compare without an early exit, so timing reveals nothing
+    const unsigned char *icv = data + len;
+    unsigned char diff = 0;
+    for (unsigned i = 0; i < _icv; i++)
+      diff |= icv[i] ^ tag[i];
+    if (diff) {
+      if (_drops == 0)
+	click_chatter("Invalid AES-GCM integrity check value");
+      // restore the ciphertext; CTR mode is its own inverse
+      sa_data->gcm.seal(sa_data->aes, nonce, p->data(), 8,
+			data, len, tag, _hardware);
+      return drop(p);
+    }
+    //remove ICV
+    p->take(_icv);
+    return p;
+  }
+}
+
+String
+IPsecAESGCM::drop_handler(Element *e, void *)
+{
+  IPsecAESGCM *a = (IPsecAESGCM *)e;
+  return String(a->_drops);
+}
+
+void
+IPsecAESGCM::add_handlers()
+{
+  add_read_handler("drops", drop_handler, 0);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPsecAESCipher)
+EXPORT_ELEMENT(IPsecAESGCM)
+ELEMENT_MT_SAFE(IPsecAESGCM)
@@ -0,0 +1,94 @@
+#ifndef CLICK_IPSECAESGCM_HH
+#define CLICK_IPSECAESGCM_HH
+#include <click/element.hh>
+#include <click/atomic.hh>
+#include <click/glue.hh>
+CLICK_DECLS
+
+/*
+ * =c
+ * IPsecAESGCM(ENCRYPT [, I<keywords> ICV, HARDWARE])
+ * =s ipsec
+ * encrypt and authenticate ESP packets using AES-GCM
+ * =d
+ *
+ * Encrypts and authenticates, or verifies and decrypts, ESP packets using
+ * AES-GCM (RFC 4106) in a single pass over the payload. It replaces the
+ * IPsecAES and IPsecAuthHMACSHA1 pair. If the first argument is 1, IPsecAESGCM
+ * encrypts the payload following the ESP header and appends the integrity
+ * check value (ICV). If the first argument is 0, it verifies the ICV, decrypts
+ * the payload, and removes the ICV.
+ *
+ * The key is the 128-bit encryption key of the packet's security association,
+ * found through the IPsec SA data annotation; its AES and GHASH schedules are
+ * expanded once, when the SA is created. The nonce is a 4-byte salt followed
+ * by the 8-byte IV from the ESP header. As in RFC 4106, the salt is the last
+ * four bytes of a 20-byte encryption key; an SA with a 16-byte key has a zero
+ * salt. When encrypting, IPsecAESGCM replaces the IV set by IPsecESPEncap
+ * with a 64-bit counter kept per SA, so no nonce repeats under one key. The
+ * ESP header's SPI and sequence number are authenticated but not encrypted.
+ *
+ * Packets that fail verification are counted and emitted unchanged on output
+ * 1, if it exists, or dropped.
+ *
+ * Keyword arguments are:
+ *
+ * =over 8
+ *
+ * =item ICV
+ *
+ * Unsigned, 8, 12, or 16. Length of the ICV in bytes. Default is 16.
+ *
+ * =item HARDWARE
+ *
+ * Boolean. If true, use the AES-NI and PCLMULQDQ instructions on CPUs that
+ * have them. Setting it to false forces the portable implementation. Default
+ * is true.
+ *
+ * =back
+ *
+ * =h drops read-only
+ *
+ * Returns the number of packets that failed verification.
+ *
+ * =e
+ *
+ *   rt[1] -> IPsecESPEncap() -> IPsecAESGCM(1) -> IPsecEncap(50) -> ...
+ *
+ *   ... -> StripIPHeader() -> IPsecAESGCM(0) -> IPsecESPUnencap() -> ...
+ *
+ * =a IPsecESPEncap, IPsecESPUnencap, IPsecAES, IPsecAuthHMACSHA1
+ */
+
+class IPsecAESGCM : public Element {
+
+public:
+  IPsecAESGCM();
+  ~IPsecAESGCM();
+
+  const char *class_name() const	{ return "IPsecAESGCM"; }
+  const char *port_count() const	{ return "1/1-2"; }
+  const char *processing() const	{ return AGNOSTIC; }
+
+  int configure(Vector<String> &, ErrorHandler *);
+  int initialize(ErrorHandler *);
+
+  Packet *simple_action(Packet *);
+  void add_handlers();
+
+  static String drop_handler(Element *e, void *thunk);
+
+private:
+
+  int _op;
+  unsigned _icv;
+  bool _hardware;
+  atomic_uint32_t _drops;
+
+  enum { GCM_DECRYPT = 0, GCM_ENCRYPT = 1 };
+
+  Packet *drop(Packet *);
+};
+
+CLICK_ENDDECLS
+#endif
@@ -27,16 +27,17 @@
 #include <click/error.hh>
 #include <click/glue.hh>
 #include <click/packet_anno.hh>
+#include <click/master.hh>
+#include <click/routerthread.hh>
 
 #include "elements/ipsec/hmac.hh"
 #include "satable.hh"
 #include "sadatatuple.hh"
+#include "multisha.hh"
 CLICK_DECLS
 
-#define SHA_DIGEST_LEN 20
-#define KEY_SIZE 16
-
 IPsecAuthHMACSHA1::IPsecAuthHMACSHA1()
+  : _alg(MultiSHA::SHA1), _icv(12)
 {
 }
 
@@ -47,55 +48,170 @@ IPsecAuthHMACSHA1::~IPsecAuthHMACSHA1()
 int
 IPsecAuthHMACSHA1::configure(Vector<String> &conf, ErrorHandler *errh)
 {
+  _burst = 8;
+  _lanes = MultiSHA::MAX_LANES;
   if (cp_va_kparse(conf, this, errh,
-		   "VERIFY", cpkP+cpkM, cpInteger, &_op, cpEnd) < 0)
+		   "VERIFY", cpkP+cpkM, cpInteger, &_op,
+		   "BURST", 0, cpUnsigned, &_burst,
+		   "LANES", 0, cpUnsigned, &_lanes,
+		   cpEnd) < 0)
     return -1;
+  if (_burst < 1 || _burst > MAX_BURST)
+    return errh->error("BURST must be between 1 and %d", (int) MAX_BURST);
+  if (_lanes < 1)
+    return errh->error("LANES must be positive");
   return 0;
 }
 
 int
-IPsecAuthHMACSHA1::initialize(ErrorHandler *)
+IPsecAuthHMACSHA1::initialize(ErrorHandler *errh)
 {
   _drops = 0;
+  for (int i = 0; i < master()->nthreads() || i == 0; i++) {
+    Stash *s = new Stash;
+    if (!s)
+      return errh->error("out of memory!");
+    _stashes.push_back(s);
+  }
   return 0;
 }
 
+void
+IPsecAuthHMACSHA1::cleanup(CleanupStage)
+{
+  for (int i = 0; i < _stashes.size(); i++) {
+    Stash *s = _stashes[i];
+    while (s->head < s->tail)
+      s->p[s->head++]->kill();
+    delete s;
+  }
+  _stashes.clear();
+}
 
-Packet *
-IPsecAuthHMACSHA1::simple_action(Packet *p)
+inline IPsecAuthHMACSHA1::Stash *
+IPsecAuthHMACSHA1::current_stash()
 {
-  SADataTuple * sa_data=(SADataTuple *)IPSEC_SA_DATA_REFERENCE_ANNO(p);
-  unsigned int len;
-  // compute HMAC
-  len = SHA_DIGEST_LEN;
-
-  if (_op == COMPUTE_AUTH) {
-    unsigned char digest [SHA_DIGEST_LEN];
-    HMAC(sa_data->Authentication_key,KEY_SIZE,(u_char*) p->data(),p->length(),digest,&len);
-    WritablePacket *q = p->put(12);
-    u_char *ah = ((u_char*)q->data())+q->length()-12;
-    memmove(ah, digest, 12);
-    return q;
+  // handlers and other non-driver threads share thread 0's stash
+  for (int i = 1; i < _stashes.size(); i++)
+    if (master()->thread(i)->current_thread_is_running())
+      return _stashes[i];
+  return _stashes[0];
+}
+
+void
+IPsecAuthHMACSHA1::drop(Packet *p)
+{
+  _drops++;
+  if (noutputs() > 1)
+    output(1).push(p);
+  else
+    p->kill();
+}
+
+// Computes or verifies the digests of the n packets in p, hashing up to
+// lanes of them in parallel. Leaves the packets that survive at the front of
+// p and returns their number.
+int
+IPsecAuthHMACSHA1::process(Packet **p, int n, int lanes)
+{
+  const HMACKey *key[MAX_BURST];
+  const unsigned char *data[MAX_BURST];
+  int len[MAX_BURST];
+  unsigned char digest_buf[MAX_BURST][MultiSHA::MAX_DIGEST_SIZE];
+  unsigned char *digest[MAX_BURST];
+  int m = 0;
+
+  for (int i = 0; i < n; i++) {
+    Packet *q = p[i];
+    SADataTuple *sa_data = (SADataTuple *)IPSEC_SA_DATA_REFERENCE_ANNO(q);
+    if (sa_data == NULL) {
+      click_chatter("%s: No SADataTuple annotation", class_name());
+      q->kill();
+      continue;
+    }
+    if (_op == COMPUTE_AUTH) {
+      if (!(q = q->put(_icv)))
+	continue;
+    } else if (q->length() < _icv) {
+      drop(q);
+      continue;
+    }
+    key[m] = (_alg == MultiSHA::SHA1 ? &sa_data->hmac_sha1 : &sa_data->hmac_sha256);
+    data[m] = q->data();
+    len[m] = q->length() - _icv;
+    digest[m] = digest_buf[m];
+    p[m++] = q;
   }
-  else {
-    const u_char *ah = p->data()+p->length()-12;
-    unsigned char digest [SHA_DIGEST_LEN];
+  if (m == 0)
+    return 0;
 
-    HMAC(sa_data->Authentication_key,KEY_SIZE,(u_char*) p->data(),p->length()-12,digest,&len);
-    if (memcmp(ah, digest, 12)) {
+  HMACKey::compute(key, data, len, digest, m, lanes);
+
+  int k = 0;
+  for (int i = 0; i < m; i++) {
+    Packet *q = p[i];
+    if (_op == COMPUTE_AUTH) {
+      // q was returned by put(), so it is writable
+      memcpy(static_cast<WritablePacket *>(q)->data() + len[i], digest[i], _icv);
+      p[k++] = q;
+      continue;
+    }
+    // compare without an early exit, so timing reveals nothing
+    const unsigned char *ah = q->data() + len[i];
+    unsigned char diff = 0;
+    for (unsigned j = 0; j < _icv; j++)
+      diff |= ah[j] ^ digest[i][j];
+    if (diff) {
       if (_drops == 0)
-	click_chatter("Invalid SHA1 authentication digest");
-      _drops++;
-      if (noutputs() > 1)
-	output(1).push(p);
-      else
-	p->kill();
-      return 0;
+	click_chatter("Invalid %s authentication digest", _alg == MultiSHA::SHA1 ? "SHA1" : "SHA256");
+      drop(q);
+      continue;
     }
     //remove digest
-    p->take(12);
-    return p;
+    q->take(_icv);
+    p[k++] = q;
+  }
+  return k;
+}
+
+Packet *
+IPsecAuthHMACSHA1::simple_action(Packet *p)
+{
+  return process(&p, 1, 1) ? p : 0;
+}
+
+void
+IPsecAuthHMACSHA1::push_batch(int, PacketBatch &batch)
+{
+  Packet *p[MAX_BURST];
+  PacketBatch out;
+  while (!batch.empty()) {
+    int n = 0;
+    while (n < (int) _burst && !batch.empty())
+      p[n++] = batch.pop_front();
+    n = process(p, n, _lanes);
+    for (int i = 0; i < n; i++)
+      out.push_back(p[i]);
+  }
+  output(0).push_batch(out);
+}
+
+Packet *
+IPsecAuthHMACSHA1::pull(int)
+{
+  Stash *s = current_stash();
+  if (s->head == s->tail) {
+    int n = 0;
+    while (n < (int) _burst) {
+      Packet *p = input(0).pull();
+      if (!p)
+	break;
+      s->p[n++] = p;
+    }
+    s->head = 0;
+    s->tail = process(s->p, n, _lanes);
   }
+  return s->head < s->tail ? s->p[s->head++] : 0;
 }
 
 String
@@ -111,9 +227,11 @@ IPsecAuthHMACSHA1::add_handlers()
   add_read_handler("drops", drop_handler, 0);
 }
 
+// IPsecAuthSHA1 and the HMAC regression test still use these
 #include "sha1_impl.cc"
 #include "hmac.cc"
 
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPsecMultiSHA)
 EXPORT_ELEMENT(IPsecAuthHMACSHA1)
 ELEMENT_MT_SAFE(IPsecAuthHMACSHA1)
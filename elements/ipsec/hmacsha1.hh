@@ -3,11 +3,12 @@
 #include <click/element.hh>
 #include <click/atomic.hh>
 #include <click/glue.hh>
+#include <click/vector.hh>
 CLICK_DECLS
 
 /*
  * =c
- * IPsecAuthHMACSHA1(VERIFY)
+ * IPsecAuthHMACSHA1(VERIFY [, I<keywords> BURST, LANES])
  * =s ipsec
  * verify SHA1 authentication digest.
  * =d
@@ -16,7 +17,46 @@ CLICK_DECLS
  * per RFC 2404, 2406. If first argument is 1, verify SHA1 digest and remove
  * authentication bits.
  *
- * =a IPsecESPEncap, IPsecDES
+ * The key is the 128-bit authentication key of the packet's security
+ * association. This element's HMAC XORs only the first 16 bytes of the key
+ * into the inner and outer pads, rather than a whole 64-byte block, so it
+ * interoperates only with other Click IPsec routers. The pads are prepared
+ * once, when the SA is created.
+ *
+ * When pulled, IPsecAuthHMACSHA1 pulls up to BURST packets from its input at
+ * once and hashes them together, several packets per SIMD register (see
+ * MultiSHA). Batches pushed to it are hashed the same way, BURST packets at
+ * a time. Packets pushed singly are hashed one at a time.
+ *
+ * Packets that fail verification are counted and emitted on output 1, if it
+ * exists, or dropped.
+ *
+ * Keyword arguments are:
+ *
+ * =over 8
+ *
+ * =item BURST
+ *
+ * Unsigned, at most 64. Maximum number of packets to pull or take from a
+ * pushed batch and hash at once.
+ * Default is 8.
+ *
+ * =item LANES
+ *
+ * Unsigned. Maximum number of packets to hash in parallel, up to 8 on CPUs
+ * with AVX2 and 4 otherwise. 1 disables the multi-buffer code. Default is 8.
+ *
+ * =back
+ *
+ * =h drops read-only
+ *
+ * Returns the number of packets that failed verification.
+ *
+ * =e
+ *
+ *   ... -> IPsecAES(1) -> Queue -> IPsecAuthHMACSHA1(0, BURST 16) -> Unqueue -> ...
+ *
+ * =a IPsecESPEncap, IPsecDES, IPsecAuthHMACSHA256
  */
 
 class IPsecAuthHMACSHA1 : public Element {
@@ -27,22 +67,48 @@ public:
 
   const char *class_name() const	{ return "IPsecAuthHMACSHA1"; }
   const char *port_count() const	{ return "1/-"; }
-  const char *processing() const	{ return AGNOSTIC; }
+  const char *processing() const	{ return "a/ah"; }
 
   int configure(Vector<String> &, ErrorHandler *);
   int initialize(ErrorHandler *);
+  void cleanup(CleanupStage);
 
   Packet *simple_action(Packet *);
+  void push_batch(int, PacketBatch &);
+  Packet *pull(int);
   void add_handlers();
 
   static String drop_handler(Element *e, void *thunk);
 
-private:
+protected:
 
   int _op;
-  atomic_uint32_t _drops;
+  int _alg;
+  unsigned _icv;
 
   enum { COMPUTE_AUTH = 0, VERIFY_AUTH = 1 };
+
+private:
+
+  enum { MAX_BURST = 64 };
+
+  atomic_uint32_t _drops;
+  unsigned _burst;
+  unsigned _lanes;
+
+  // Each router thread's packets pulled and hashed, waiting to be returned
+  struct Stash {
+    Packet *p[MAX_BURST];
+    int head;
+    int tail;
+    Stash()			: head(0), tail(0) { }
+  };
+
+  Vector<Stash *> _stashes;
+
+  inline Stash *current_stash();
+  int process(Packet **, int n, int lanes);
+  void drop(Packet *);
 };
 
 CLICK_ENDDECLS
@@ -0,0 +1,37 @@
+/*
+ * hmacsha256.{cc,hh} -- element implements IPsec HMAC authentication using
+ * SHA-256
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#ifndef HAVE_IPSEC
+# error "Must #define HAVE_IPSEC in config.h"
+#endif
+#include "hmacsha256.hh"
+#include "multisha.hh"
+CLICK_DECLS
+
+IPsecAuthHMACSHA256::IPsecAuthHMACSHA256()
+{
+  _alg = MultiSHA::SHA256;
+  _icv = 16;
+}
+
+IPsecAuthHMACSHA256::~IPsecAuthHMACSHA256()
+{
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPsecAuthHMACSHA1)
+EXPORT_ELEMENT(IPsecAuthHMACSHA256)
+ELEMENT_MT_SAFE(IPsecAuthHMACSHA256)
@@ -0,0 +1,44 @@
+#ifndef CLICK_IPSECAUTHHMACSHA256_HH
+#define CLICK_IPSECAUTHHMACSHA256_HH
+#include "hmacsha1.hh"
+CLICK_DECLS
+
+/*
+ * =c
+ * IPsecAuthHMACSHA256(VERIFY [, I<keywords> BURST, LANES])
+ * =s ipsec
+ * compute or verify HMAC-SHA-256 authentication digest.
+ * =d
+ *
+ * If first argument is 0, computes the HMAC-SHA-256-128 digest of an ESP
+ * packet (RFC 4868) and appends it. If first argument is 1, verifies the
+ * digest and removes it.
+ *
+ * The key is the packet's security association's 128-bit authentication key.
+ * Unlike IPsecAuthHMACSHA1, IPsecAuthHMACSHA256 implements standard HMAC
+ * (RFC 2104): the inner and outer pads each fill a block, so their hash
+ * states are computed once, when the SA is created, and each packet costs
+ * only the blocks of its own data plus one more. RFC 4868 calls for 256-bit
+ * keys; peers must be configured with the 128-bit key.
+ *
+ * Keyword arguments and batching behave as in IPsecAuthHMACSHA1.
+ *
+ * =h drops read-only
+ *
+ * Returns the number of packets that failed verification.
+ *
+ * =a IPsecAuthHMACSHA1, IPsecESPEncap, IPsecAES
+ */
+
+class IPsecAuthHMACSHA256 : public IPsecAuthHMACSHA1 {
+
+public:
+  IPsecAuthHMACSHA256();
+  ~IPsecAuthHMACSHA256();
+
+  const char *class_name() const	{ return "IPsecAuthHMACSHA256"; }
+
+};
+
+CLICK_ENDDECLS
+#endif
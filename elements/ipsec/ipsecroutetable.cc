@@ -46,7 +46,7 @@ cp_ipsec_route(String s, IPsecRoute *r_store, bool remove_route, Element *contex
     IPsecRoute r;
     //Data to initialize the SADataTuple
     unsigned int replay;
-    uint8_t  oowin;
+    unsigned int oowin;
 
     SADataTuple * sa_data;
 
@@ -89,13 +89,16 @@ cp_ipsec_route(String s, IPsecRoute *r_store, bool remove_route, Element *contex
 		     "OOSIZE", cpkP+cpkM, cpUnsigned, &oowin,
 		     cpEnd) < 0)
 	return false;
-    if (enc_key.length() != 16 || auth_key.length() != 16) {
+    // A 20-byte encryption key carries AES-GCM's 4-byte salt (RFC 4106).
+    if ((enc_key.length() != KEY_SIZE && enc_key.length() != KEY_SIZE + GCM_SALT_SIZE)
+	|| auth_key.length() != KEY_SIZE) {
 	click_chatter("key has bad length");
 	return false;
     }
 
     // Create new Security Association Table entry
-    sa_data = new SADataTuple(enc_key.data(), auth_key.data(), replay, oowin);
+    sa_data = new SADataTuple(enc_key.data(), auth_key.data(), replay, oowin,
+			      enc_key.length() > KEY_SIZE ? enc_key.data() + KEY_SIZE : 0);
     ((IPsecRouteTable*)context)->_sa_table.insert(SPI(r.spi),*sa_data);
     //Set Tuple reference in the Routing entry
     r.sa_data = sa_data;
@@ -212,8 +215,7 @@ IPsecRouteTable::push(int, Packet *p)
 	       click_chatter("No Ipsec tunnel for %s. Wrong tunnel setup", p->dst_ip_anno().unparse().c_str());
 	   }
 	   SET_IPSEC_SPI_ANNO(p,(uint32_t)spi);
-	   //ISSUE: This is 32-bit architecture specific passing a pointer to next module through annotations!!
-	   SET_IPSEC_SA_DATA_REFERENCE_ANNO(p,(uint32_t)sa_data);
+	   SET_IPSEC_SA_DATA_REFERENCE_ANNO(p,(uintptr_t)sa_data);
 	   break;
 	 }
 	 case 0: {
@@ -226,7 +228,6 @@ IPsecRouteTable::push(int, Packet *p)
             }
             // This is an ipsec packet and belongs to a tunneled connection
 	    // so we set the proper annotation with reference to Security Data Table to be used by IPsec modules
-            // Careful this enhancement is 32-bit architecture specific!!
             struct esp_new * esp =(struct esp_new *)(p->data()+sizeof(click_ip));
             sa_data = _sa_table.lookup(SPI(ntohl(esp->esp_spi)));
 	    if(sa_data == NULL) {
@@ -234,7 +235,7 @@ IPsecRouteTable::push(int, Packet *p)
 	p->kill();
                 return;
            }
-	   SET_IPSEC_SA_DATA_REFERENCE_ANNO(p,(uint32_t)sa_data);
+	   SET_IPSEC_SA_DATA_REFERENCE_ANNO(p,(uintptr_t)sa_data);
 	   break;
 	 }
 	}; //end of switch
@@ -389,4 +390,5 @@ IPsecRouteTable::add_handlers()
 }
 
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPsecAESCipher IPsecMultiSHA)
 ELEMENT_PROVIDES(IPsecRouteTable)
@@ -0,0 +1,467 @@
+/*
+ * multisha.{cc,hh} -- multi-buffer SHA-1, SHA-256, and HMAC for the IPsec
+ * elements
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#ifndef HAVE_IPSEC
+# error "Must #define HAVE_IPSEC in config.h"
+#endif
+#include "multisha.hh"
+
+#if CLICK_USERLEVEL && defined(__x86_64__) \
+    && (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+# define CLICK_MULTISHA_SIMD 1
+#endif
+
+CLICK_DECLS
+
+#define MULTISHA_INLINE inline __attribute__((always_inline))
+
+/*
+ * The hash functions are written once, over a type V holding one 32-bit word
+ * per lane: uint32_t for one lane, or a GCC vector type for four or eight.
+ * They are always inlined, so each instantiation is compiled for its
+ * caller's instruction set.
+ */
+
+#if CLICK_MULTISHA_SIMD
+typedef uint32_t multisha_v4 __attribute__((vector_size(16)));
+typedef uint32_t multisha_v8 __attribute__((vector_size(32)));
+#endif
+
+static MULTISHA_INLINE uint32_t
+get_lane(const uint32_t &v, int)
+{
+    return v;
+}
+
+static MULTISHA_INLINE void
+set_lane(uint32_t &v, int, uint32_t x)
+{
+    v = x;
+}
+
+template <typename V> static MULTISHA_INLINE uint32_t
+get_lane(const V &v, int i)
+{
+    return v[i];
+}
+
+template <typename V> static MULTISHA_INLINE void
+set_lane(V &v, int i, uint32_t x)
+{
+    v[i] = x;
+}
+
+template <typename V> static MULTISHA_INLINE V
+rotl(V x, int n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+template <typename V> static MULTISHA_INLINE V
+rotr(V x, int n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+static const uint32_t sha1_iv[5] = {
+    0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
+};
+
+static const uint32_t sha256_iv[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+template <typename V> static MULTISHA_INLINE V
+sha1_expand(V *w, int t)
+{
+    return w[t & 15] = rotl(w[(t - 3) & 15] ^ w[(t - 8) & 15] ^ w[(t - 14) & 15] ^ w[t & 15], 1);
+}
+
+template <typename V> static MULTISHA_INLINE void
+sha1_round(V &a, V &b, V &c, V &d, V &e, V f, uint32_t k, V w)
+{
+    V tmp = rotl(a, 5) + f + e + k + w;
+    e = d;
+    d = c;
+    c = rotl(b, 30);
+    b = a;
+    a = tmp;
+}
+
+// The four groups of rounds get loops of their own, so that no round
+// branches on its number.
+template <typename V> static MULTISHA_INLINE void
+sha1_compress(V *s, V *w)
+{
+    V a = s[0], b = s[1], c = s[2], d = s[3], e = s[4];
+    int t;
+    for (t = 0; t < 16; t++)
+	sha1_round(a, b, c, d, e, d ^ (b & (c ^ d)), 0x5a827999, w[t]);
+    for (; t < 20; t++)
+	sha1_round(a, b, c, d, e, d ^ (b & (c ^ d)), 0x5a827999, sha1_expand(w, t));
+    for (; t < 40; t++)
+	sha1_round(a, b, c, d, e, b ^ c ^ d, 0x6ed9eba1, sha1_expand(w, t));
+    for (; t < 60; t++)
+	sha1_round(a, b, c, d, e, (b & c) | (d & (b | c)), 0x8f1bbcdc, sha1_expand(w, t));
+    for (; t < 80; t++)
+	sha1_round(a, b, c, d, e, b ^ c ^ d, 0xca62c1d6, sha1_expand(w, t));
+    s[0] += a;
+    s[1] += b;
+    s[2] += c;
+    s[3] += d;
+    s[4] += e;
+}
+
+template <typename V> static MULTISHA_INLINE void
+sha256_round(V *r, uint32_t k, V w)
+{
+    V a = r[0], e = r[4];
+    V t1 = r[7] + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25))
+	+ (r[6] ^ (e & (r[5] ^ r[6]))) + k + w;
+    V t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22))
+	+ ((a & r[1]) | (r[2] & (a | r[1])));
+    r[7] = r[6];
+    r[6] = r[5];
+    r[5] = e;
+    r[4] = r[3] + t1;
+    r[3] = r[2];
+    r[2] = r[1];
+    r[1] = a;
+    r[0] = t1 + t2;
+}
+
+template <typename V> static MULTISHA_INLINE void
+sha256_compress(V *s, V *w)
+{
+    V r[8];
+    for (int i = 0; i < 8; i++)
+	r[i] = s[i];
+    int t;
+    for (t = 0; t < 16; t++)
+	sha256_round(r, sha256_k[t], w[t]);
+    for (; t < 64; t++) {
+	V w15 = w[(t - 15) & 15], w2 = w[(t - 2) & 15];
+	w[t & 15] += (rotr(w15, 7) ^ rotr(w15, 18) ^ (w15 >> 3))
+	    + w[(t - 7) & 15]
+	    + (rotr(w2, 17) ^ rotr(w2, 19) ^ (w2 >> 10));
+	sha256_round(r, sha256_k[t], w[t & 15]);
+    }
+    for (int i = 0; i < 8; i++)
+	s[i] += r[i];
+}
+
+static inline uint32_t
+load_be32(const unsigned char *p)
+{
+    uint32_t x;
+    memcpy(&x, p, 4);
+    return ntohl(x);
+}
+
+static inline void
+store_be32(unsigned char *p, uint32_t x)
+{
+    x = htonl(x);
+    memcpy(p, &x, 4);
+}
+
+// Returns the number of blocks in job's padded message.
+static inline int
+job_blocks(const MultiSHA::Job &job)
+{
+    return (job.prefix_len + job.len + 8) / MultiSHA::BLOCK_SIZE + 1;
+}
+
+// Stores block b of job's padded message, as words, in lane of w.
+template <typename V> static MULTISHA_INLINE void
+fetch_block(const MultiSHA::Job &job, int b, V *w, int lane)
+{
+    int off = b * MultiSHA::BLOCK_SIZE, total = job.prefix_len + job.len;
+    if (off >= job.prefix_len && off + MultiSHA::BLOCK_SIZE <= total) {
+	const unsigned char *p = job.data + off - job.prefix_len;
+	for (int t = 0; t < 16; t++)
+	    set_lane(w[t], lane, load_be32(p + 4 * t));
+	return;
+    }
+
+    unsigned char buf[MultiSHA::BLOCK_SIZE];
+    for (int i = 0; i < MultiSHA::BLOCK_SIZE; i++, off++)
+	if (off < job.prefix_len)
+	    buf[i] = job.prefix[off];
+	else if (off < total)
+	    buf[i] = job.data[off - job.prefix_len];
+	else if (off == total)
+	    buf[i] = 0x80;
+	else
+	    buf[i] = 0;
+    if (b == job_blocks(job) - 1) {
+	uint64_t bits = (job.prior + total) * 8;
+	store_be32(buf + 56, bits >> 32);
+	store_be32(buf + 60, bits);
+    }
+    for (int t = 0; t < 16; t++)
+	set_lane(w[t], lane, load_be32(buf + 4 * t));
+}
+
+/*
+ * Runs jobs through L = sizeof(V) / 4 lanes. Each round fetches the next
+ * block of every busy lane and compresses them together; when a lane's job
+ * finishes, the next job takes its place. Idle lanes compress garbage.
+ */
+template <typename V> static MULTISHA_INLINE void
+run_lanes(int alg, MultiSHA::Job *jobs, int n)
+{
+    enum { L = sizeof(V) / sizeof(uint32_t) };
+    const int nwords = (alg == MultiSHA::SHA1 ? 5 : 8);
+    V s[8], w[16];
+    MultiSHA::Job *job[L];
+    int block[L], nblocks[L];
+    int next = 0, busy = 0;
+
+    memset(s, 0, sizeof(s));
+    memset(w, 0, sizeof(w));
+    for (int l = 0; l < L; l++) {
+	job[l] = 0;
+	if (next < n) {
+	    job[l] = &jobs[next++];
+	    block[l] = 0;
+	    nblocks[l] = job_blocks(*job[l]);
+	    for (int i = 0; i < nwords; i++)
+		set_lane(s[i], l, job[l]->state[i]);
+	    busy++;
+	}
+    }
+
+    while (busy) {
+	for (int l = 0; l < L; l++)
+	    if (job[l])
+		fetch_block(*job[l], block[l], w, l);
+	if (alg == MultiSHA::SHA1)
+	    sha1_compress(s, w);
+	else
+	    sha256_compress(s, w);
+
+	for (int l = 0; l < L; l++)
+	    if (job[l] && ++block[l] == nblocks[l]) {
+		MultiSHA::Job *j = job[l];
+		for (int i = 0; i < nwords; i++) {
+		    j->state[i] = get_lane(s[i], l);
+		    store_be32(j->digest + 4 * i, j->state[i]);
+		}
+		if (next < n) {
+		    job[l] = &jobs[next++];
+		    block[l] = 0;
+		    nblocks[l] = job_blocks(*job[l]);
+		    for (int i = 0; i < nwords; i++)
+			set_lane(s[i], l, job[l]->state[i]);
+		} else {
+		    job[l] = 0;
+		    busy--;
+		}
+	    }
+    }
+}
+
+static void
+run_scalar(int alg, MultiSHA::Job *jobs, int n)
+{
+    run_lanes<uint32_t>(alg, jobs, n);
+}
+
+#if CLICK_MULTISHA_SIMD
+__attribute__((target("sse2"))) static void
+run_sse2(int alg, MultiSHA::Job *jobs, int n)
+{
+    run_lanes<multisha_v4>(alg, jobs, n);
+}
+
+__attribute__((target("avx2"))) static void
+run_avx2(int alg, MultiSHA::Job *jobs, int n)
+{
+    run_lanes<multisha_v8>(alg, jobs, n);
+}
+#endif
+
+int
+MultiSHA::lanes_available()
+{
+#if CLICK_MULTISHA_SIMD
+    static int lanes = 0;
+    if (!lanes) {
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+	    lanes = 8;
+	else if (__builtin_cpu_supports("sse2"))
+	    lanes = 4;
+	else
+	    lanes = 1;
+    }
+    return lanes;
+#else
+    return 1;
+#endif
+}
+
+void
+MultiSHA::init(int alg, Job &job)
+{
+    if (alg == SHA1)
+	memcpy(job.state, sha1_iv, sizeof(sha1_iv));
+    else
+	memcpy(job.state, sha256_iv, sizeof(sha256_iv));
+    job.prior = 0;
+    job.prefix = 0;
+    job.prefix_len = 0;
+}
+
+void
+MultiSHA::run(int alg, Job *jobs, int n, int lanes)
+{
+    if (lanes > lanes_available())
+	lanes = lanes_available();
+#if CLICK_MULTISHA_SIMD
+    if (lanes >= 8 && n > 4) {
+	run_avx2(alg, jobs, n);
+	return;
+    } else if (lanes >= 4 && n > 1) {
+	run_sse2(alg, jobs, n);
+	return;
+    }
+#endif
+    run_scalar(alg, jobs, n);
+}
+
+void
+HMACKey::set_key(int alg, const unsigned char *key, int keylen, int pad_len)
+{
+    unsigned char hashed_key[MultiSHA::MAX_DIGEST_SIZE];
+    if (keylen > pad_len) {
+	MultiSHA::Job job;
+	MultiSHA::init(alg, job);
+	job.data = key;
+	job.len = keylen;
+	job.digest = hashed_key;
+	MultiSHA::run(alg, &job, 1, 1);
+	key = hashed_key;
+	keylen = MultiSHA::digest_size(alg);
+    }
+
+    _alg = alg;
+    _pad_len = pad_len;
+    memset(_ipad, 0, sizeof(_ipad));
+    memcpy(_ipad, key, keylen);
+    memcpy(_opad, _ipad, sizeof(_opad));
+    for (int i = 0; i < pad_len; i++) {
+	_ipad[i] ^= 0x36;
+	_opad[i] ^= 0x5c;
+    }
+
+    // absorb whole-block pads now
+    MultiSHA::Job job;
+    MultiSHA::init(alg, job);
+    memcpy(_istate, job.state, sizeof(_istate));
+    memcpy(_ostate, job.state, sizeof(_ostate));
+    if (pad_len == MultiSHA::BLOCK_SIZE) {
+	uint32_t w[16];
+	for (int t = 0; t < 16; t++)
+	    w[t] = load_be32(_ipad + 4 * t);
+	if (alg == MultiSHA::SHA1)
+	    sha1_compress(_istate, w);
+	else
+	    sha256_compress(_istate, w);
+	for (int t = 0; t < 16; t++)
+	    w[t] = load_be32(_opad + 4 * t);
+	if (alg == MultiSHA::SHA1)
+	    sha1_compress(_ostate, w);
+	else
+	    sha256_compress(_ostate, w);
+    }
+}
+
+void
+HMACKey::compute(const HMACKey * const *keys,
+		 const unsigned char * const *data, const int *len,
+		 unsigned char * const *digest, int n, int lanes)
+{
+    enum { BATCH = 16 };
+    MultiSHA::Job jobs[BATCH];
+    unsigned char inner[BATCH][MultiSHA::MAX_DIGEST_SIZE];
+    unsigned char outer[BATCH][MultiSHA::MAX_DIGEST_SIZE];
+
+    for (int base = 0; base < n; base += BATCH) {
+	int m = (n - base < BATCH ? n - base : BATCH);
+	int alg = keys[base]->_alg;
+	int dsize = MultiSHA::digest_size(alg);
+
+	// inner hash: H(ipad || data)
+	for (int i = 0; i < m; i++) {
+	    const HMACKey *k = keys[base + i];
+	    MultiSHA::Job &j = jobs[i];
+	    memcpy(j.state, k->_istate, sizeof(j.state));
+	    if (k->_pad_len == MultiSHA::BLOCK_SIZE) {
+		j.prior = MultiSHA::BLOCK_SIZE;
+		j.prefix = 0;
+		j.prefix_len = 0;
+	    } else {
+		j.prior = 0;
+		j.prefix = k->_ipad;
+		j.prefix_len = k->_pad_len;
+	    }
+	    j.data = data[base + i];
+	    j.len = len[base + i];
+	    j.digest = inner[i];
+	}
+	MultiSHA::run(alg, jobs, m, lanes);
+
+	// outer hash: H(opad || inner)
+	for (int i = 0; i < m; i++) {
+	    const HMACKey *k = keys[base + i];
+	    MultiSHA::Job &j = jobs[i];
+	    memcpy(j.state, k->_ostate, sizeof(j.state));
+	    if (k->_pad_len == MultiSHA::BLOCK_SIZE) {
+		j.prior = MultiSHA::BLOCK_SIZE;
+		j.prefix = 0;
+		j.prefix_len = 0;
+	    } else {
+		j.prior = 0;
+		j.prefix = k->_opad;
+		j.prefix_len = k->_pad_len;
+	    }
+	    j.data = inner[i];
+	    j.len = dsize;
+	    j.digest = outer[i];
+	}
+	MultiSHA::run(alg, jobs, m, lanes);
+
+	for (int i = 0; i < m; i++)
+	    memcpy(digest[base + i], outer[i], dsize);
+    }
+}
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(IPsecMultiSHA)
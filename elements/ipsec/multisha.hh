@@ -0,0 +1,91 @@
+#ifndef CLICK_IPSEC_MULTISHA_HH
+#define CLICK_IPSEC_MULTISHA_HH
+#include <click/glue.hh>
+CLICK_DECLS
+
+/*
+ * multisha.{cc,hh} -- multi-buffer SHA-1, SHA-256, and HMAC for the IPsec
+ * elements
+ *
+ * MultiSHA hashes several independent messages at once, one per 32-bit lane
+ * of a vector register: four lanes with SSE2 and eight with AVX2, chosen at
+ * run time. A lane whose message ends picks up the next one, so messages of
+ * different lengths keep every lane busy. A single message uses the scalar
+ * code.
+ *
+ * HMACKey holds an HMAC key's inner and outer pads. For standard HMAC
+ * (RFC 2104) the pads fill a whole block, which is absorbed ahead of time:
+ * each packet then costs only the blocks of its own data plus one outer
+ * block. SADataTuple keeps one HMACKey per algorithm.
+ */
+
+class MultiSHA { public:
+
+    enum Algorithm { SHA1 = 0, SHA256 = 1 };
+    enum { BLOCK_SIZE = 64, MAX_LANES = 8, MAX_DIGEST_SIZE = 32 };
+
+    // One message: prefix, then data, hashed from the chaining value in
+    // state, which has already absorbed prior bytes.
+    struct Job {
+	uint32_t state[8];
+	uint64_t prior;
+	const unsigned char *prefix;
+	int prefix_len;
+	const unsigned char *data;
+	int len;
+	unsigned char *digest;
+    };
+
+    // Sets job's state to alg's initial value, with no prior bytes and no
+    // prefix.
+    static void init(int alg, Job &job);
+
+    // Hashes n jobs with at most lanes parallel lanes, writing each job's
+    // digest_size(alg)-byte digest and final state.
+    static void run(int alg, Job *jobs, int n, int lanes = MAX_LANES);
+
+    static int digest_size(int alg)	{ return alg == SHA1 ? 20 : 32; }
+
+    // Returns the largest number of lanes this CPU supports.
+    static int lanes_available();
+
+};
+
+class HMACKey { public:
+
+    // Prepares key for HMAC with alg. pad_len is the length of the inner
+    // and outer pads: MultiSHA::BLOCK_SIZE for RFC 2104 HMAC. Shorter pads
+    // reproduce HMAC variants that hash the key only up to pad_len bytes;
+    // keys longer than pad_len are hashed first, as in RFC 2104.
+    void set_key(int alg, const unsigned char *key, int keylen,
+		 int pad_len = MultiSHA::BLOCK_SIZE);
+
+    int algorithm() const		{ return _alg; }
+
+    // Computes the HMAC of data[i], len[i] under *keys[i] into digest[i],
+    // for i < n. Every key must use the same algorithm.
+    static void compute(const HMACKey * const *keys,
+			const unsigned char * const *data, const int *len,
+			unsigned char * const *digest, int n,
+			int lanes = MultiSHA::MAX_LANES);
+
+    void compute(const unsigned char *data, int len, unsigned char *digest) const {
+	const HMACKey *k = this;
+	compute(&k, &data, &len, &digest, 1, 1);
+    }
+
+  private:
+
+    int _alg;
+    int _pad_len;
+    // chaining values after the pads, for block-sized pads
+    uint32_t _istate[8];
+    uint32_t _ostate[8];
+    // the pads themselves, hashed as a prefix, for shorter ones
+    unsigned char _ipad[MultiSHA::BLOCK_SIZE];
+    unsigned char _opad[MultiSHA::BLOCK_SIZE];
+
+};
+
+CLICK_ENDDECLS
+#endif
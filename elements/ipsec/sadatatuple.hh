@@ -5,6 +5,8 @@
 #include <click/etheraddress.hh>
 #include <click/bighashmap.hh>
 #include <click/glue.hh>
+#include "aescipher.hh"
+#include "multisha.hh"
 CLICK_DECLS
 
 /*
@@ -27,6 +29,7 @@ CLICK_DECLS
  */
 
 #define KEY_SIZE 16
+#define GCM_SALT_SIZE 4
 
 /* Security Parameter Index (SPI) Class*/
 
@@ -74,26 +77,49 @@ class SADataTuple {
     //SA Data must be added here...
     uint8_t Encryption_key[KEY_SIZE]; // The Data key
     uint8_t Authentication_key[KEY_SIZE];//The Authentication key
+    uint8_t gcm_salt[GCM_SALT_SIZE]; // AES-GCM nonce salt, after Encryption_key in the keying material
+    uint64_t gcm_iv;	// next AES-GCM IV; never repeats under one key
     /*These fields below deal with replay protection*/
     uint32_t replay_start_counter;
     uint32_t cur_rpl;
     uint8_t  ooowin;	/* out-of-order window size */
     uint32_t bitmap;	/* Support out-of-order receive support */
     uint32_t lastseq;	/* in host order */
+    /*Key schedules expanded from Encryption_key, shared by every packet of the SA*/
+    AESCipher aes;
+    AESGCM gcm;
+    /*HMAC pads from Authentication_key; see IPsecAuthHMACSHA1 for why SHA-1's are short*/
+    HMACKey hmac_sha1;
+    HMACKey hmac_sha256;
 
     SADataTuple() {
 	memset(this, 0, sizeof(*this));
     }
 
-    SADataTuple(const void * enc_key , const void * Auth_key, uint32_t counter, uint8_t o_oowin)
+    SADataTuple(const void * enc_key , const void * Auth_key, uint32_t counter, uint8_t o_oowin, const void *salt = 0)
      {
 		memset(this, 0, sizeof(*this));
 		memcpy(Encryption_key, enc_key, KEY_SIZE);
 		memcpy(Authentication_key, Auth_key, KEY_SIZE);
+		if (salt)
+		    memcpy(gcm_salt, salt, GCM_SALT_SIZE);
 		replay_start_counter = counter;
 		ooowin = o_oowin;
 	        bitmap=0;
 		lastseq=cur_rpl=counter;
+		aes.set_key(Encryption_key, KEY_SIZE * 8);
+		gcm.set_key(aes);
+		hmac_sha1.set_key(MultiSHA::SHA1, Authentication_key, KEY_SIZE, KEY_SIZE);
+		hmac_sha256.set_key(MultiSHA::SHA256, Authentication_key, KEY_SIZE);
+     }
+
+     uint64_t next_gcm_iv()
+     {
+#if HAVE_MULTITHREAD || CLICK_LINUXMODULE
+	 return __sync_fetch_and_add(&gcm_iv, 1);
+#else
+	 return gcm_iv++;
+#endif
      }
 
      operator bool() const
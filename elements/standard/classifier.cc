@@ -19,6 +19,8 @@
 
 #include <click/config.h>
 #include "classifier.hh"
+#include "classifierjit.hh"
+#include "classifiersimd.hh"
 #include <click/glue.hh>
 #include <click/error.hh>
 #include <click/confparse.hh>
@@ -150,12 +152,15 @@ Classifier::Expr::s() const
 //
 
 Classifier::Classifier()
-    : _output_everything(-1)
+    : _output_everything(-1), _jit(0), _jit_match(0), _jit_wanted(true),
+      _simd(0), _simd_match(0), _simd_wanted(false)
 {
 }
 
 Classifier::~Classifier()
 {
+    delete _jit;
+    delete _simd;
 }
 
 //
@@ -964,6 +969,41 @@ Classifier::configure(Vector<String> &conf, ErrorHandler *errh)
   return (errh->nerrors() == before ? 0 : -1);
 }
 
+void
+Classifier::compile_programs(int split)
+{
+  // Compile lazily and keep the results until the element is destroyed, so
+  // switching back to the interpreter never frees code or tables another
+  // thread might be using.
+  if (_jit_wanted && !_jit && _output_everything < 0
+      && ClassifierJIT::available()) {
+    _jit = new ClassifierJIT;
+    if (_jit && _jit->compile(_exprs, split) < 0) {
+      delete _jit;
+      _jit = 0;
+    }
+  }
+  _jit_match = (_jit_wanted && _jit ? _jit->function() : 0);
+
+  if (_simd_wanted && !_simd && _output_everything < 0
+      && ClassifierSIMD::available()) {
+    _simd = new ClassifierSIMD;
+    if (_simd && _simd->compile(_exprs, split) < 0) {
+      delete _simd;
+      _simd = 0;
+    }
+  }
+  _simd_match = (_simd_wanted ? _simd : 0);
+}
+
+int
+Classifier::initialize(ErrorHandler *)
+{
+  // offsets are relative to the start of the data; there is no second base
+  compile_programs(0x7FFFFFFF);
+  return 0;
+}
+
 String
 Classifier::program_string(Element *element, void *)
 {
@@ -981,10 +1021,41 @@ Classifier::program_string(Element *element, void *)
   return sa.take_string();
 }
 
+String
+Classifier::read_engine(Element *element, void *thunk)
+{
+  Classifier *c = (Classifier *)element;
+  if (thunk)
+    return cp_unparse_bool(c->_simd_match != 0);
+  else
+    return cp_unparse_bool(c->_jit_match != 0);
+}
+
+int
+Classifier::write_engine(const String &str, Element *element, void *thunk, ErrorHandler *errh)
+{
+  Classifier *c = (Classifier *)element;
+  bool on;
+  if (!cp_bool(str, &on))
+    return errh->error("syntax error");
+  (thunk ? c->_simd_wanted : c->_jit_wanted) = on;
+  // initialize() calls compile_programs() with the right offset split
+  if (c->initialize(errh) < 0)
+    return -1;
+  if (on && !(thunk ? c->_simd_match != 0 : c->_jit_match != 0))
+    return errh->error(thunk ? "vector classification not available"
+		       : "native code generation not available");
+  return 0;
+}
+
 void
 Classifier::add_handlers()
 {
     add_read_handler("program", Classifier::program_string, 0, Handler::CALM);
+    add_read_handler("jit", read_engine, 0);
+    add_write_handler("jit", write_engine, 0);
+    add_read_handler("simd", read_engine, (void *) 1);
+    add_write_handler("simd", write_engine, (void *) 1);
 }
 
 //
@@ -1075,12 +1146,12 @@ Classifier::compress_exprs(Vector<uint32_t> &prog, bool perform_binary_search,
 // RUNNING
 //
 
-void
-Classifier::length_checked_push(Packet *p)
+int
+Classifier::length_checked_match(const Packet *p) const
 {
   const unsigned char *packet_data = p->data() - _align_offset;
   int packet_length = p->length() + _align_offset; // XXX >= MAXINT?
-  Expr *ex = &_exprs[0];	// avoid bounds checking
+  const Expr *ex = &_exprs[0];	// avoid bounds checking
   int pos = 0;
   uint32_t data;
 
@@ -1105,26 +1176,25 @@ Classifier::length_checked_push(Packet *p)
     pos = ex[pos].no();
   } while (pos > 0);
 
-  checked_output_push(-pos, p);
+  return -pos;
 }
 
-void
-Classifier::push(int, Packet *p)
+inline int
+Classifier::match(const Packet *p) const
 {
   const unsigned char *packet_data = p->data() - _align_offset;
-  Expr *ex = &_exprs[0];	// avoid bounds checking
+  const Expr *ex = &_exprs[0];	// avoid bounds checking
   int pos = 0;
 
-  if (_output_everything >= 0) {
-    // must use checked_output_push because the output number might be
-    // out of range
-    pos = -_output_everything;
-    goto found;
-  } else if (p->length() < _safe_length) {
+  if (_output_everything >= 0)
+    // the output number might be out of range; callers must use
+    // checked_output_push
+    return _output_everything;
+  else if (p->length() < _safe_length)
     // common case never checks packet length
-    length_checked_push(p);
-    return;
-  }
+    return length_checked_match(p);
+  else if (_jit_match)
+    return _jit_match(packet_data, 0);
 
   do {
       uint32_t data = *((const uint32_t *)(packet_data + ex[pos].offset));
@@ -1132,11 +1202,66 @@ Classifier::push(int, Packet *p)
       pos = ex[pos].j[data == ex[pos].value.u];
   } while (pos > 0);
 
- found:
-  checked_output_push(-pos, p);
+  return -pos;
+}
+
+void
+Classifier::push(int, Packet *p)
+{
+  checked_output_push(match(p), p);
+}
+
+int
+Classifier::match_burst(PacketBatch &batch, Packet **p, int *port) const
+{
+  // Remove up to ClassifierSIMD::width packets from batch into p, and their
+  // outputs into port.  Returns the number of packets removed.
+  if (!_simd_match) {
+    p[0] = batch.pop_front();
+    port[0] = match(p[0]);
+    return 1;
+  }
+
+  const unsigned char *data[ClassifierSIMD::width];
+  int lane[ClassifierSIMD::width], lane_port[ClassifierSIMD::width];
+  int n = 0, nlanes = 0;
+  for (; n < ClassifierSIMD::width && (p[n] = batch.pop_front()); n++)
+    if (p[n]->length() < _safe_length)
+      port[n] = length_checked_match(p[n]);
+    else {
+      data[nlanes] = p[n]->data() - _align_offset;
+      lane[nlanes++] = n;
+    }
+  if (nlanes) {
+    _simd_match->match(data, data, nlanes, lane_port);
+    for (int i = 0; i < nlanes; i++)
+      port[lane[i]] = lane_port[i];
+  }
+  return n;
+}
+
+void
+Classifier::push_batch(int, PacketBatch &batch)
+{
+  // Forward each run of consecutive packets bound for the same output as one
+  // batch.  This preserves the order in which outputs see packets.
+  PacketBatch run;
+  int run_port = -1;
+  while (!batch.empty()) {
+    Packet *p[ClassifierSIMD::width];
+    int port[ClassifierSIMD::width];
+    int n = match_burst(batch, p, port);
+    for (int i = 0; i < n; i++) {
+      if (port[i] != run_port && !run.empty())
+	checked_output_push_batch(run_port, run);
+      run_port = port[i];
+      run.push_back(p[i]);
+    }
+  }
+  checked_output_push_batch(run_port, run);
 }
 
 CLICK_ENDDECLS
-ELEMENT_REQUIRES(AlignmentInfo)
+ELEMENT_REQUIRES(AlignmentInfo ClassifierJIT ClassifierSIMD)
 EXPORT_ELEMENT(Classifier)
 ELEMENT_MT_SAFE(Classifier)
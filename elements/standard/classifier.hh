@@ -2,6 +2,8 @@
 #define CLICK_CLASSIFIER_HH
 #include <click/element.hh>
 CLICK_DECLS
+class ClassifierJIT;
+class ClassifierSIMD;
 
 /*
  * =c
@@ -69,6 +71,20 @@ CLICK_DECLS
  *   safe length 22
  *   alignment offset 0
  *
+ * =h jit read/write
+ * Boolean.  At user level on x86-64, Classifier compiles its program into
+ * native code when the router is initialized, and uses the interpreter only
+ * for packets shorter than the safe length.  Returns true if the compiled
+ * program is in use.  Write false to fall back to the interpreter, or true
+ * to switch back.
+ *
+ * =h simd read/write
+ * Boolean.  If true, and the CPU supports AVX2, Classifier classifies
+ * packets that arrive in batches eight at a time, evaluating its program for
+ * all eight packets in lockstep with vector instructions.  Packets pushed one
+ * at a time are unaffected.  Returns true if the vector engine is in use.
+ * Default is false.
+ *
  * =a IPClassifier, IPFilter */
 
 class Classifier : public Element { public:
@@ -85,6 +101,7 @@ class Classifier : public Element { public:
   const char *flags() const			{ return "A"; }
 
   int configure(Vector<String> &, ErrorHandler *);
+  int initialize(ErrorHandler *);
   void add_handlers();
 
   // creating Exprs
@@ -98,6 +115,7 @@ class Classifier : public Element { public:
   void finish_expr_subtree(Vector<int> &, Combiner = C_AND, int success = SUCCESS, int failure = FAILURE);
 
   void push(int port, Packet *);
+  void push_batch(int port, PacketBatch &);
 
   struct Expr {
     int offset;
@@ -133,6 +151,14 @@ class Classifier : public Element { public:
   unsigned _safe_length;
   unsigned _align_offset;
 
+  ClassifierJIT *_jit;
+  int (*_jit_match)(const unsigned char *, const unsigned char *);
+  bool _jit_wanted;
+  ClassifierSIMD *_simd;
+  const ClassifierSIMD *_simd_match;
+  bool _simd_wanted;
+  void compile_programs(int split);
+
   void redirect_expr_subtree(int first, int next, int success, int failure);
 
   void combine_compatible_states();
@@ -147,8 +173,12 @@ class Classifier : public Element { public:
 		      unsigned min_binary_search = 7) const;
 
   static String program_string(Element *, void *);
+  static String read_engine(Element *, void *);
+  static int write_engine(const String &, Element *, void *, ErrorHandler *);
 
-  void length_checked_push(Packet *);
+  inline int match(const Packet *) const;
+  int length_checked_match(const Packet *) const;
+  int match_burst(PacketBatch &, Packet **, int *) const;
 
  private:
 
@@ -0,0 +1,220 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * classifierjit.{cc,hh} -- compile Classifier decision trees to native code
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "classifierjit.hh"
+#include <click/glue.hh>
+#if CLICK_CLASSIFIER_JIT
+# include <sys/mman.h>
+# include <unistd.h>
+#endif
+CLICK_DECLS
+
+ClassifierJIT::ClassifierJIT()
+    : _code(0), _code_size(0), _map_size(0), _f(0)
+{
+}
+
+ClassifierJIT::~ClassifierJIT()
+{
+    clear();
+}
+
+void
+ClassifierJIT::clear()
+{
+#if CLICK_CLASSIFIER_JIT
+    if (_code)
+	munmap(_code, _map_size);
+#endif
+    _code = 0;
+    _code_size = _map_size = 0;
+    _f = 0;
+}
+
+bool
+ClassifierJIT::available()
+{
+#if CLICK_CLASSIFIER_JIT
+    return true;
+#else
+    return false;
+#endif
+}
+
+#if CLICK_CLASSIFIER_JIT
+
+/* The generated code follows the System V AMD64 calling convention: the two
+   base pointers arrive in %rdi and %rsi, the result leaves in %eax, and only
+   %eax is clobbered.  Each Expr becomes one test followed by conditional
+   jumps; a branch to the next Expr in sequence falls through.  Jumps to
+   outputs go to shared "mov $port, %eax; ret" stubs at the end. */
+
+namespace {
+
+class Assembler { public:
+
+    Vector<unsigned char> code;
+    Vector<int> fixup_pos;	// where a rel32 lives
+    Vector<int> fixup_target;	// Expr index > 0, or -port
+
+    void byte(int x) {
+	code.push_back(x);
+    }
+    void word(uint32_t x) {
+	for (int i = 0; i < 4; i++, x >>= 8)
+	    code.push_back(x & 0xFF);
+    }
+    void jump(int opcode2, int target) {
+	// opcode2 < 0 means an unconditional jmp rel32
+	if (opcode2 < 0)
+	    byte(0xE9);
+	else {
+	    byte(0x0F);
+	    byte(opcode2);
+	}
+	fixup_pos.push_back(code.size());
+	fixup_target.push_back(target);
+	word(0);
+    }
+
+};
+
+enum { JE = 0x84, JNE = 0x85, JMP = -1 };
+enum { RDI = 7, RSI = 6 };
+
+}
+
+int
+ClassifierJIT::compile(const Vector<Classifier::Expr> &exprs, int split)
+{
+    clear();
+    if (exprs.size() == 0)
+	return -1;
+
+    Assembler a;
+    Vector<int> state_pos(exprs.size(), -1);
+
+    for (int i = 0; i < exprs.size(); i++) {
+	const Classifier::Expr &e = exprs[i];
+	state_pos[i] = a.code.size();
+	int next = (i + 1 < exprs.size() ? i + 1 : 0);
+
+	if (e.mask.u == 0) {
+	    // always true
+	    if (e.yes() != next || next == 0)
+		a.jump(JMP, e.yes());
+	    continue;
+	}
+
+	int reg = RDI, disp = e.offset;
+	if (e.offset >= split)
+	    reg = RSI, disp = e.offset - split;
+
+	int nbytes = 0, k = 0;
+	for (int j = 0; j < 4; j++)
+	    if (e.mask.c[j])
+		nbytes++, k = j;
+
+	if (nbytes == 1 && e.mask.c[k] == 0xFF) {
+	    // cmpb $value, disp+k(%reg)
+	    a.byte(0x80);
+	    a.byte(0x80 | (7 << 3) | reg);
+	    a.word(disp + k);
+	    a.byte(e.value.c[k]);
+	} else if (e.mask.u == 0xFFFFFFFFU) {
+	    // cmpl $value, disp(%reg)
+	    a.byte(0x81);
+	    a.byte(0x80 | (7 << 3) | reg);
+	    a.word(disp);
+	    a.word(e.value.u);
+	} else {
+	    // movl disp(%reg), %eax; andl $mask, %eax; cmpl $value, %eax
+	    a.byte(0x8B);
+	    a.byte(0x80 | reg);
+	    a.word(disp);
+	    a.byte(0x25);
+	    a.word(e.mask.u);
+	    a.byte(0x3D);
+	    a.word(e.value.u);
+	}
+
+	if (next && e.yes() == next)
+	    a.jump(JNE, e.no());
+	else if (next && e.no() == next)
+	    a.jump(JE, e.yes());
+	else {
+	    a.jump(JE, e.yes());
+	    a.jump(JMP, e.no());
+	}
+    }
+
+    // return stubs, one per output actually used
+    Vector<int> port_pos;
+    for (int i = 0; i < a.fixup_target.size(); i++)
+	if (a.fixup_target[i] <= 0) {
+	    int port = -a.fixup_target[i];
+	    if (port >= port_pos.size())
+		port_pos.resize(port + 1, -1);
+	    if (port_pos[port] < 0) {
+		port_pos[port] = a.code.size();
+		a.byte(0xB8);	// movl $port, %eax
+		a.word(port);
+		a.byte(0xC3);	// ret
+	    }
+	}
+
+    // resolve jumps
+    for (int i = 0; i < a.fixup_pos.size(); i++) {
+	int t = a.fixup_target[i];
+	int dest = (t > 0 ? state_pos[t] : port_pos[-t]);
+	uint32_t rel = dest - (a.fixup_pos[i] + 4);
+	for (int j = 0; j < 4; j++, rel >>= 8)
+	    a.code[a.fixup_pos[i] + j] = rel & 0xFF;
+    }
+
+    // copy into executable memory
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t map_size = (a.code.size() + page - 1) & ~(page - 1);
+    void *m = mmap(0, map_size, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (m == MAP_FAILED)
+	return -1;
+    memcpy(m, a.code.begin(), a.code.size());
+    if (mprotect(m, map_size, PROT_READ | PROT_EXEC) < 0) {
+	munmap(m, map_size);
+	return -1;
+    }
+
+    _code = reinterpret_cast<unsigned char *>(m);
+    _code_size = a.code.size();
+    _map_size = map_size;
+    _f = reinterpret_cast<Function>(m);
+    return 0;
+}
+
+#else
+
+int
+ClassifierJIT::compile(const Vector<Classifier::Expr> &, int)
+{
+    clear();
+    return -1;
+}
+
+#endif
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(ClassifierJIT)
@@ -0,0 +1,55 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_CLASSIFIERJIT_HH
+#define CLICK_CLASSIFIERJIT_HH
+#include "classifier.hh"
+CLICK_DECLS
+
+/*
+ * ClassifierJIT: compiles a Classifier decision tree into native code
+ *
+ * The generated function takes two base pointers.  Expr offsets less than
+ * the split passed to compile() are relative to the first pointer; larger
+ * offsets, minus the split, are relative to the second (IPFilter uses this
+ * for transport-header offsets).  It returns the output port, exactly like
+ * the interpreter's fast path, and so may only be called on packets at least
+ * the Classifier's safe length long.
+ *
+ * Code generation is supported only at user level on x86-64; elsewhere
+ * compile() fails and Classifier keeps interpreting.
+ */
+
+#if CLICK_USERLEVEL && defined(__x86_64__) && HAVE_MMAP
+# define CLICK_CLASSIFIER_JIT 1
+#endif
+
+class ClassifierJIT { public:
+
+    typedef int (*Function)(const unsigned char *data,
+			    const unsigned char *data2);
+
+    ClassifierJIT();
+    ~ClassifierJIT();
+
+    static bool available();
+
+    int compile(const Vector<Classifier::Expr> &exprs, int split);
+
+    Function function() const		{ return _f; }
+    size_t code_size() const		{ return _code_size; }
+
+  private:
+
+    unsigned char *_code;
+    size_t _code_size;
+    size_t _map_size;
+    Function _f;
+
+    void clear();
+
+    ClassifierJIT(const ClassifierJIT &);
+    ClassifierJIT &operator=(const ClassifierJIT &);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,153 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * classifiersimd.{cc,hh} -- classify bursts of packets in lockstep
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "classifiersimd.hh"
+#include <click/glue.hh>
+#if CLICK_CLASSIFIER_SIMD
+# include <immintrin.h>
+#endif
+CLICK_DECLS
+
+ClassifierSIMD::ClassifierSIMD()
+{
+}
+
+bool
+ClassifierSIMD::available()
+{
+#if CLICK_CLASSIFIER_SIMD
+    static int avx2 = -1;
+    if (avx2 < 0) {
+	__builtin_cpu_init();
+	avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+    return avx2;
+#else
+    return false;
+#endif
+}
+
+int
+ClassifierSIMD::compile(const Vector<Classifier::Expr> &exprs, int split)
+{
+    _offset.clear();
+    _second.clear();
+    _mask.clear();
+    _value.clear();
+    _yes.clear();
+    _no.clear();
+    if (exprs.size() == 0 || !available())
+	return -1;
+
+    for (const Classifier::Expr *e = exprs.begin(); e != exprs.end(); ++e) {
+	bool second = e->offset >= split;
+	_offset.push_back(second ? e->offset - split : e->offset);
+	_second.push_back(second ? -1 : 0);
+	_mask.push_back(e->mask.u);
+	_value.push_back(e->value.u);
+	_yes.push_back(e->yes());
+	_no.push_back(e->no());
+    }
+    return 0;
+}
+
+#if CLICK_CLASSIFIER_SIMD
+
+__attribute__((target("avx2"))) static void
+match_avx2(const int32_t *offset, const int32_t *second,
+	   const uint32_t *mask, const uint32_t *value,
+	   const int32_t *yes, const int32_t *no,
+	   const unsigned char * const *data,
+	   const unsigned char * const *data2, int n, int *ports)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i active = _mm256_cmpgt_epi32(_mm256_set1_epi32(n),
+					_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    __m256i pos = zero;
+    int32_t p[8];
+    int am, s = 0;
+
+    // pad short bursts by repeating the first packet
+    const unsigned char *d1[8], *d2[8];
+    for (int i = 0; i < 8; i++) {
+	d1[i] = data[i < n ? i : 0];
+	d2[i] = data2[i < n ? i : 0];
+    }
+
+    // Step all packets together while the unfinished ones share a state.
+    while (1) {
+	const unsigned char * const *d = (second[s] ? d2 : d1);
+	int o = offset[s];
+	__m256i words = _mm256_setr_epi32(*(const int32_t *) (d[0] + o),
+					  *(const int32_t *) (d[1] + o),
+					  *(const int32_t *) (d[2] + o),
+					  *(const int32_t *) (d[3] + o),
+					  *(const int32_t *) (d[4] + o),
+					  *(const int32_t *) (d[5] + o),
+					  *(const int32_t *) (d[6] + o),
+					  *(const int32_t *) (d[7] + o));
+	__m256i eq = _mm256_cmpeq_epi32(_mm256_and_si256(words, _mm256_set1_epi32(mask[s])),
+					_mm256_set1_epi32(value[s]));
+	__m256i next = _mm256_blendv_epi8(_mm256_set1_epi32(no[s]),
+					  _mm256_set1_epi32(yes[s]), eq);
+	pos = _mm256_blendv_epi8(pos, next, active);
+	active = _mm256_and_si256(active, _mm256_cmpgt_epi32(next, zero));
+
+	if (!(am = _mm256_movemask_ps(_mm256_castsi256_ps(active))))
+	    break;
+	_mm256_storeu_si256((__m256i *) p, pos);
+	s = p[__builtin_ctz(am)];
+	__m256i same = _mm256_cmpeq_epi32(pos, _mm256_set1_epi32(s));
+	if (_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_andnot_si256(same, active))))
+	    break;
+    }
+
+    // Finish packets that diverged one at a time.
+    _mm256_storeu_si256((__m256i *) p, pos);
+    for (int i = 0; i < n; i++) {
+	int x = p[i];
+	if (am & (1 << i))
+	    do {
+		const unsigned char *d = (second[x] ? data2[i] : data[i]);
+		uint32_t w = *(const uint32_t *) (d + offset[x]);
+		x = ((w & mask[x]) == value[x] ? yes[x] : no[x]);
+	    } while (x > 0);
+	ports[i] = -x;
+    }
+}
+
+void
+ClassifierSIMD::match(const unsigned char * const *data,
+		      const unsigned char * const *data2, int n, int *ports) const
+{
+    assert(n > 0 && n <= width && _offset.size());
+    match_avx2(_offset.begin(), _second.begin(), _mask.begin(), _value.begin(),
+	       _yes.begin(), _no.begin(), data, data2, n, ports);
+}
+
+#else
+
+void
+ClassifierSIMD::match(const unsigned char * const *, const unsigned char * const *,
+		      int, int *) const
+{
+    assert(0);
+}
+
+#endif
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(ClassifierSIMD)
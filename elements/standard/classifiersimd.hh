@@ -0,0 +1,56 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_CLASSIFIERSIMD_HH
+#define CLICK_CLASSIFIERSIMD_HH
+#include "classifier.hh"
+CLICK_DECLS
+
+/*
+ * ClassifierSIMD: classifies up to eight packets at once with AVX2
+ *
+ * match() walks the same decision tree as Classifier's interpreter, but
+ * for a burst of packets in lockstep.  While every unfinished packet is at
+ * the same step, which is common for bursts from one flow, the step's mask
+ * and value are broadcast, one 32-bit word is loaded per packet, and all
+ * eight are compared and advanced in one operation.  Once the packets'
+ * paths diverge, each is finished separately from the step it reached.
+ *
+ * As with ClassifierJIT, Expr offsets at or above the split are relative to
+ * the second data pointer, and every packet must be at least the
+ * Classifier's safe length long.
+ *
+ * The engine requires a user-level x86-64 build and an AVX2 CPU, detected
+ * at run time; available() returns false otherwise.
+ */
+
+#if CLICK_USERLEVEL && defined(__x86_64__) \
+    && (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+# define CLICK_CLASSIFIER_SIMD 1
+#endif
+
+class ClassifierSIMD { public:
+
+    enum { width = 8 };
+
+    ClassifierSIMD();
+
+    static bool available();
+
+    int compile(const Vector<Classifier::Expr> &exprs, int split);
+
+    void match(const unsigned char * const *data,
+	       const unsigned char * const *data2, int n, int *ports) const;
+
+  private:
+
+    // one entry per Expr
+    Vector<int32_t> _offset;	// relative to data or data2
+    Vector<int32_t> _second;	// -1 if relative to data2, else 0
+    Vector<uint32_t> _mask;
+    Vector<uint32_t> _value;
+    Vector<int32_t> _yes;
+    Vector<int32_t> _no;
+
+};
+
+CLICK_ENDDECLS
+#endif
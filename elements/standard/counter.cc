@@ -105,6 +105,44 @@ Counter::simple_action(Packet *p)
   return p;
 }
 
+void
+Counter::simple_action_batch(PacketBatch &batch)
+{
+    counter_t byte_count = 0;
+    for (Packet *p = batch.front(); p; p = p->next())
+	byte_count += p->length();
+
+    // If a trigger might fire within this batch, count packet by packet so
+    // it fires at exactly the right packet.
+    if ((!_count_triggered && _count + batch.count() >= _count_trigger)
+	|| (!_byte_triggered && _byte_count + byte_count >= _byte_trigger)) {
+	for (Packet *p = batch.front(); p; p = p->next())
+	    (void) Counter::simple_action(p);
+	return;
+    }
+
+    _count += batch.count();
+    _byte_count += byte_count;
+    _rate.update(batch.count());
+    _byte_rate.update(byte_count);
+}
+
+void
+Counter::push_batch(int, PacketBatch &batch)
+{
+    simple_action_batch(batch);
+    output(0).push_batch(batch);
+}
+
+void
+Counter::pull_batch(int, PacketBatch &batch, int max)
+{
+    PacketBatch in;
+    input(0).pull_batch(in, max);
+    simple_action_batch(in);
+    batch.append(in);
+}
+
 
 enum { H_COUNT, H_BYTE_COUNT, H_RATE, H_BIT_RATE, H_BYTE_RATE, H_RESET,
        H_COUNT_CALL, H_BYTE_COUNT_CALL };
@@ -115,6 +115,9 @@ class Counter : public Element { public:
     int llrpc(unsigned, void *);
 
     Packet *simple_action(Packet *);
+    void simple_action_batch(PacketBatch &);
+    void push_batch(int, PacketBatch &);
+    void pull_batch(int, PacketBatch &, int);
 
   private:
 
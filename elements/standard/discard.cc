@@ -48,6 +48,13 @@ Discard::push(int, Packet *p)
     p->kill();
 }
 
+void
+Discard::push_batch(int, PacketBatch &batch)
+{
+    _count += batch.count();
+    batch.kill();
+}
+
 bool
 Discard::run_task(Task *)
 {
@@ -43,6 +43,7 @@ class Discard : public Element { public:
   void add_handlers();
 
   void push(int, Packet *);
+  void push_batch(int, PacketBatch &);
   bool run_task(Task *);
 
  protected:
@@ -59,6 +59,7 @@ class FrontDropQueue : public NotifierQueue { public:
   void take_state(Element *, ErrorHandler *);
 
   void push(int port, Packet *);
+  void push_batch(int port, PacketBatch &b)	{ Element::push_batch(port, b); }
 
 };
 
@@ -80,6 +80,65 @@ FullNoteQueue::pull(int)
 	return pull_failure();
 }
 
+void
+FullNoteQueue::push_batch(int, PacketBatch &batch)
+{
+    // Code taken from push_success(), but updates notifiers once per batch.
+    int h = _head, t = _tail, ot = t;
+
+    while (!batch.empty()) {
+	int nt = next_i(t);
+	if (nt == h)
+	    break;
+	_q[t] = batch.pop_front();
+	t = nt;
+    }
+
+    if (t != ot) {
+	asm("" : : : "memory");
+	_tail = t;
+
+	int s = size(h, t);
+	if (s > _highwater_length)
+	    _highwater_length = s;
+
+	_empty_note.wake();
+
+	if (s == capacity()) {
+	    _full_note.sleep();
+#if HAVE_MULTITHREAD
+	    // See push_success().
+	    if (size() < capacity())
+		_full_note.wake();
+#endif
+	}
+    }
+
+    while (Packet *p = batch.pop_front())
+	push_failure(p);
+}
+
+void
+FullNoteQueue::pull_batch(int, PacketBatch &batch, int max)
+{
+    // Code taken from pull_success(), but updates notifiers once per batch.
+    int h = _head, t = _tail;
+    if (h == t) {
+	(void) pull_failure();
+	return;
+    }
+
+    for (int n = 0; h != t && n < max; ++n) {
+	batch.push_back(_q[h]);
+	h = next_i(h);
+    }
+    asm("" : : : "memory");
+    _head = h;
+
+    _sleepiness = 0;
+    _full_note.wake();
+}
+
 CLICK_ENDDECLS
 ELEMENT_REQUIRES(NotifierQueue)
 EXPORT_ELEMENT(FullNoteQueue FullNoteQueue-FullNoteQueue)
@@ -108,11 +108,13 @@ InfiniteSource::run_task(Task *)
     int n = _burstsize;
     if (_limit >= 0 && _count + n >= _limit)
 	n = (_count > _limit ? 0 : _limit - _count);
+    PacketBatch batch;
     for (int i = 0; i < n; i++) {
 	Packet *p = _packet->clone();
 	p->timestamp_anno().set_now();
-	output(0).push(p);
+	batch.push_back(p);
     }
+    output(0).push_batch(batch);
     _count += n;
     if (n > 0)
 	_task.fast_reschedule();
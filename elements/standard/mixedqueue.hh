@@ -82,6 +82,7 @@ class MixedQueue : public NotifierQueue { public:
     void *cast(const char *);
 
     void push(int port, Packet *);
+    void push_batch(int port, PacketBatch &b)	{ Element::push_batch(port, b); }
 
 };
 
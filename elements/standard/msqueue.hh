@@ -7,13 +7,13 @@ CLICK_DECLS
  * =c
  * MSQueue
  * MSQueue(CAPACITY)
- * =deprecated ThreadSafeQueue
  * =s smpclick
  * stores packets in a FIFO queue
  * =d
  * Stores incoming packets in a multiple producer single consumer
- * first-in-first-out queue. Enqueue operations are synchronized, dequeue
- * operations are not. Drops incoming packets if the queue already holds
+ * first-in-first-out queue. Enqueue operations are synchronized, as in
+ * ThreadSafeQueue; dequeue operations are not, so at most one thread may pull
+ * from an MSQueue at a time. Drops incoming packets if the queue already holds
  * CAPACITY packets. The default for CAPACITY is 1000.
  *
  * =h length read-only
@@ -22,7 +22,7 @@ CLICK_DECLS
  * Returns the number of packets dropped by the queue so far.
  * =h capacity read/write
  * Returns or sets the queue's capacity.
- * =a Queue
+ * =a Queue, ThreadSafeQueue
  */
 
 class MSQueue : public ThreadSafeQueue { public:
@@ -33,8 +33,6 @@ class MSQueue : public ThreadSafeQueue { public:
     const char *class_name() const		{ return "MSQueue"; }
     void *cast(const char *);
 
-    int configure(Vector<String> &, ErrorHandler *);
-
 #if CLICK_LINUXMODULE && __i386__ && HAVE_INTEL_CPU
     static void prefetch_packet(Packet *p);
 #endif
@@ -95,6 +95,58 @@ NotifierQueue::pull(int)
     return p;
 }
 
+void
+NotifierQueue::push_batch(int, PacketBatch &batch)
+{
+    // Code taken from NotifierQueue::push(), but wakes listeners once per
+    // batch.
+    int h = _head, t = _tail, ot = t;
+
+    while (Packet *p = batch.pop_front()) {
+	int nt = next_i(t);
+	if (nt != h) {
+	    _q[t] = p;
+	    t = nt;
+	} else {
+	    if (_drops == 0 && _capacity > 0)
+		click_chatter("%{element}: overflow", this);
+	    _drops++;
+	    checked_output_push(1, p);
+	}
+    }
+
+    if (t != ot) {
+	asm("" : : : "memory");
+	_tail = t;
+
+	int s = size(h, t);
+	if (s > _highwater_length)
+	    _highwater_length = s;
+
+	_empty_note.wake();
+    }
+}
+
+void
+NotifierQueue::pull_batch(int port, PacketBatch &batch, int max)
+{
+    int h = _head, t = _tail;
+    if (h == t) {
+	// use pull() to manage sleepiness
+	if (Packet *p = NotifierQueue::pull(port))
+	    batch.push_back(p);
+	return;
+    }
+
+    for (int n = 0; h != t && n < max; ++n) {
+	batch.push_back(_q[h]);
+	h = next_i(h);
+    }
+    asm("" : : : "memory");
+    _head = h;
+    _sleepiness = 0;
+}
+
 #if NOTIFIERQUEUE_DEBUG
 #include <click/straccum.hh>
 
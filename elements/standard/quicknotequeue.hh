@@ -75,6 +75,7 @@ class QuickNoteQueue : public FullNoteQueue { public:
 
     // FullNoteQueue's push() suffices
     Packet *pull(int port);
+    void pull_batch(int port, PacketBatch &b, int max) { Element::pull_batch(port, b, max); }
 
 };
 
@@ -172,6 +172,26 @@ SimpleQueue::pull(int)
     return deq();
 }
 
+void
+SimpleQueue::push_batch(int port, PacketBatch &batch)
+{
+    while (Packet *p = batch.pop_front())
+	SimpleQueue::push(port, p);
+}
+
+void
+SimpleQueue::pull_batch(int, PacketBatch &batch, int max)
+{
+    // Code taken from SimpleQueue::deq.
+    int h = _head, t = _tail;
+    for (int n = 0; h != t && n < max; ++n) {
+	batch.push_back(_q[h]);
+	h = next_i(h);
+    }
+    // memory barrier here
+    _head = h;
+}
+
 #if 0
 Vector<Packet *>
 SimpleQueue::yank(bool (filter)(const Packet *, void *), void *thunk)
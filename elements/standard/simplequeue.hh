@@ -97,6 +97,8 @@ class SimpleQueue : public Element, public Storage { public:
 
     void push(int port, Packet*);
     Packet* pull(int port);
+    void push_batch(int port, PacketBatch &);
+    void pull_batch(int port, PacketBatch &, int);
 
   protected:
 
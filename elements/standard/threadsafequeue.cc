@@ -21,6 +21,7 @@
 CLICK_DECLS
 
 ThreadSafeQueue::ThreadSafeQueue()
+    : _single_consumer(false)
 {
     _xhead = _xtail = 0;
 }
@@ -49,42 +50,152 @@ ThreadSafeQueue::live_reconfigure(Vector<String> &conf, ErrorHandler *errh)
     return r;
 }
 
-void
-ThreadSafeQueue::push(int, Packet *p)
+static inline void
+relax()
 {
-    // Code taken from SimpleQueue::push().
-    int h, t, nt;
+#if defined(__i386__) || defined(__x86_64__)
+    asm volatile("pause" : : : "memory");
+#else
+    asm volatile("" : : : "memory");
+#endif
+}
 
+/** Claims up to @a want free slots, returning the number claimed.  The first
+    slot's index is stored in @a t. */
+inline int
+ThreadSafeQueue::claim_tail(int want, int &t)
+{
+    int n;
     do {
-	h = _head;
-	t = _tail;
-	nt = next_i(t);
+	int h = _head;
+	t = _xtail;
+	n = _capacity - size(h, t);
+	if (n > want)
+	    n = want;
+	if (n <= 0)
+	    return 0;
+    } while (!_xtail.compare_and_swap(t, advance(t, n)));
+    return n;
+}
 
-	if (nt == h) {
-	    push_failure(p);
-	    return;
+/** Makes the filled slots [@a t, @a nt) visible to pullers, after waiting
+    for pushers that claimed earlier slots.  The compare-and-swap is also a
+    memory barrier, so the caller's later check of the empty notifier can't
+    be reordered before the store; otherwise a puller going to sleep could
+    miss the new packets. */
+inline void
+ThreadSafeQueue::publish_tail(int t, int nt)
+{
+    while (!atomic_uint32_t::compare_and_swap((volatile uint32_t &) _tail, t, nt))
+	relax();
+}
+
+inline int
+ThreadSafeQueue::claim_head(int want, int &h)
+{
+    int n;
+    do {
+	int t = _tail;
+	h = _xhead;
+	n = size(h, t);
+	if (n > want)
+	    n = want;
+	if (n <= 0)
+	    return 0;
+	if (_single_consumer) {
+	    _xhead = advance(h, n);
+	    break;
 	}
-    } while (!_xtail.compare_and_swap(t, nt));
+    } while (!_xhead.compare_and_swap(h, advance(h, n)));
+    return n;
+}
+
+inline void
+ThreadSafeQueue::publish_head(int h, int nh)
+{
+    // See publish_tail().
+    while (!atomic_uint32_t::compare_and_swap((volatile uint32_t &) _head, h, nh))
+	relax();
+}
+
+inline void
+ThreadSafeQueue::push_notify(int nt)
+{
+    // Code taken from push_success().
+    int s = size(_head, nt);
+    if (s > _highwater_length)
+	_highwater_length = s;
+
+    _empty_note.wake();
 
-    push_success(h, t, nt, p);
+    if (s == capacity()) {
+	_full_note.sleep();
+	// See push_success().
+	if (size() < capacity())
+	    _full_note.wake();
+    }
+}
+
+void
+ThreadSafeQueue::push(int, Packet *p)
+{
+    int t;
+    if (claim_tail(1, t)) {
+	int nt = next_i(t);
+	_q[t] = p;
+	publish_tail(t, nt);
+	push_notify(nt);
+    } else
+	push_failure(p);
+}
+
+void
+ThreadSafeQueue::push_batch(int, PacketBatch &batch)
+{
+    int t, n = claim_tail(batch.count(), t);
+    if (n) {
+	int nt = t;
+	for (int i = 0; i < n; ++i, nt = next_i(nt))
+	    _q[nt] = batch.pop_front();
+	publish_tail(t, nt);
+	push_notify(nt);
+    }
+
+    while (Packet *p = batch.pop_front())
+	push_failure(p);
 }
 
 Packet *
 ThreadSafeQueue::pull(int)
 {
-    // Code taken from SimpleQueue::deq.
-    int h, t, nh;
+    int h;
+    if (!claim_head(1, h))
+	return pull_failure();
 
-    do {
-	h = _head;
-	t = _tail;
-	nh = next_i(h);
+    Packet *p = _q[h];
+    publish_head(h, next_i(h));
+
+    _sleepiness = 0;
+    _full_note.wake();
+    return p;
+}
+
+void
+ThreadSafeQueue::pull_batch(int, PacketBatch &batch, int max)
+{
+    int h, n = claim_head(max, h);
+    if (!n) {
+	(void) pull_failure();
+	return;
+    }
 
-	if (h == t)
-	    return pull_failure();
-    } while (!_xhead.compare_and_swap(h, nh));
+    int nh = h;
+    for (int i = 0; i < n; ++i, nh = next_i(nh))
+	batch.push_back(_q[nh]);
+    publish_head(h, nh);
 
-    return pull_success(h, t, nh);
+    _sleepiness = 0;
+    _full_note.wake();
 }
 
 CLICK_ENDDECLS
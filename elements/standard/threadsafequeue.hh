@@ -20,10 +20,18 @@ Stores incoming packets in a first-in-first-out queue.
 Drops incoming packets if the queue already holds CAPACITY packets.
 The default for CAPACITY is 1000.
 
-This variant of the default Queue is (should be) completely thread safe, in
-that it supports multiple concurrent pushers and pullers.  In all respects
-other than thread safety it behaves just like Queue, and like Queue it has
-non-full and non-empty notifiers.
+This variant of the default Queue is completely thread safe, in that it
+supports multiple concurrent pushers and pullers.  In all respects other than
+thread safety it behaves just like Queue, and like Queue it has non-full and
+non-empty notifiers.
+
+ThreadSafeQueue is a lock-free ring.  A pusher claims a run of free slots with
+one compare-and-swap, fills them, and then publishes them once every earlier
+claim has been published; pullers work the same way at the other end.
+Batches are claimed and published as a unit, and the notifiers are updated
+once per batch, so threads handing bursts to one another touch the shared
+queue state once per burst rather than once per packet.  The pushers' and
+pullers' claim pointers live on separate cache lines.
 
 =h length read-only
 
@@ -63,11 +71,34 @@ class ThreadSafeQueue : public FullNoteQueue { public:
 
     void push(int port, Packet *);
     Packet *pull(int port);
+    void push_batch(int port, PacketBatch &);
+    void pull_batch(int port, PacketBatch &, int max);
+
+  protected:
+
+    bool _single_consumer;
 
   private:
 
-    atomic_uint32_t _xhead;
+    enum { cache_line_size = 64 };
+
+    // Pushers claim slots starting at _xtail, pullers at _xhead.  _tail and
+    // _head trail them, covering only slots whose claims are complete.
+    char _pad0[cache_line_size];
     atomic_uint32_t _xtail;
+    char _pad1[cache_line_size - sizeof(atomic_uint32_t)];
+    atomic_uint32_t _xhead;
+    char _pad2[cache_line_size - sizeof(atomic_uint32_t)];
+
+    int advance(int i, int n) const {
+	i += n;
+	return (i > _capacity ? i - _capacity - 1 : i);
+    }
+    inline int claim_tail(int want, int &t);
+    inline void publish_tail(int t, int nt);
+    inline int claim_head(int want, int &h);
+    inline void publish_head(int h, int nh);
+    inline void push_notify(int nt);
 
 };
 
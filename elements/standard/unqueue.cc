@@ -73,18 +73,13 @@ Unqueue::run_task(Task *)
 	    return false;
     }
 
-    while (worked < limit && _active) {
-	if (Packet *p = input(0).pull()) {
-	    ++worked;
-	    output(0).push(p);
-	} else if (!_signal)
-	    goto out;
-	else
-	    break;
-    }
+    PacketBatch batch;
+    input(0).pull_batch(batch, limit);
+    worked = batch.count();
+    output(0).push_batch(batch);
 
-    _task.fast_reschedule();
-  out:
+    if (worked == limit || _signal)
+	_task.fast_reschedule();
     _count += worked;
     return worked > 0;
 }
@@ -25,16 +25,17 @@
 #include <click/error.hh>
 #include <click/timer.hh>
 #include <click/router.hh>
+#include <click/master.hh>
 #include <click/llrpc.h>
 CLICK_DECLS
 
 IPRewriter::IPRewriter()
-  : _tcp_map(0), _udp_map(0), _tcp_done(0),
-    _tcp_done_tail(0),
+  : _nshards(1), _locking(true),
     _tcp_done_gc_timer(tcp_done_gc_hook, this),
     _tcp_gc_timer(tcp_gc_hook, this),
     _udp_gc_timer(udp_gc_hook, this)
 {
+  _overflow_used = 0;
 }
 
 IPRewriter::~IPRewriter()
@@ -67,6 +68,7 @@ IPRewriter::configure(Vector<String> &conf, ErrorHandler *errh)
   _udp_gc_interval = 10;		// 10 seconds
   _tcp_done_gc_incr = false;
   _dst_anno = true;
+  _nshards = 1;
 
   if (cp_va_kparse_remove_keywords
       (conf, this, errh,
@@ -78,9 +80,13 @@ IPRewriter::configure(Vector<String> &conf, ErrorHandler *errh)
        "UDP_TIMEOUT", 0, cpSeconds, &_udp_timeout_jiffies,
        "TCP_DONE_GC_INCR", 0, cpBool, &_tcp_done_gc_incr,
        "DST_ANNO", 0, cpBool, &_dst_anno,
+       "SHARDS", 0, cpInteger, &_nshards,
        cpEnd) < 0)
     return -1;
 
+  if (_nshards < 1 || _nshards > 1024)
+    return errh->error("SHARDS must be between 1 and 1024");
+
   if (conf.size() != ninputs())
       return errh->error("need %d arguments, one per input port", ninputs());
 
@@ -95,18 +101,34 @@ IPRewriter::configure(Vector<String> &conf, ErrorHandler *errh)
   _tcp_done_timeout_jiffies *= CLICK_HZ;
   _udp_timeout_jiffies *= CLICK_HZ;
 
+  // one extra shard for overflow
+  for (int i = 0; i <= _nshards; i++)
+    _shards.push_back(new Shard);
+
   return (errh->nerrors() == before ? 0 : -1);
 }
 
 int
-IPRewriter::initialize(ErrorHandler *)
+IPRewriter::initialize(ErrorHandler *errh)
 {
   _nmapping_failures = 0;
+#if CLICK_LINUXMODULE
+  // handlers run in process context, beside the router thread
+  _locking = true;
+#else
+  _locking = (master()->nthreads() > 1);
+#endif
 
   _tcp_gc_timer.initialize(this);
   _tcp_done_gc_timer.initialize(this);
   _udp_gc_timer.initialize(this);
 
+  _reap_max_usec = 0;
+  for (int i = 0; i < _shards.size(); i++)
+    if (_shards[i]->tcp_expiry.initialize(_tcp_timeout_jiffies, _tcp_gc_interval * CLICK_HZ) < 0
+	|| _shards[i]->udp_expiry.initialize(_udp_timeout_jiffies, _udp_gc_interval * CLICK_HZ) < 0)
+      return errh->error("out of memory");
+
   _tcp_gc_timer.schedule_after_sec(_tcp_gc_interval);
   _udp_gc_timer.schedule_after_sec(_udp_gc_interval);
   _tcp_done_gc_timer.schedule_after_sec(_tcp_done_gc_interval);
@@ -117,8 +139,15 @@ IPRewriter::initialize(ErrorHandler *)
 void
 IPRewriter::cleanup(CleanupStage)
 {
-  clear_map(_tcp_map);
-  clear_map(_udp_map);
+  for (int i = 0; i < _shards.size(); i++) {
+    Shard *s = _shards[i];
+    clear_map(s->tcp_map);
+    clear_map(s->udp_map);
+    s->tcp_expiry.reset();
+    s->udp_expiry.reset();
+    delete s;
+  }
+  _shards.clear();
 
   for (int i = 0; i < _input_specs.size(); i++)
     if (_input_specs[i].kind == INPUT_SPEC_PATTERN)
@@ -146,9 +175,6 @@ IPRewriter::take_state(Element *e, ErrorHandler *errh)
       errh->message("(out of range mappings will be dropped)");
   }
 
-  _tcp_map.swap(rw->_tcp_map);
-  _udp_map.swap(rw->_udp_map);
-
   // check rw->_all_patterns against our _all_patterns
   Vector<Pattern *> pattern_map;
   for (int i = 0; i < rw->_all_patterns.size(); i++) {
@@ -159,80 +185,112 @@ IPRewriter::take_state(Element *e, ErrorHandler *errh)
     pattern_map.push_back(q);
   }
 
-  take_state_map(_tcp_map, &_tcp_done, &_tcp_done_tail, rw->_all_patterns, pattern_map);
-  take_state_map(_udp_map, 0, 0, rw->_all_patterns, pattern_map);
-  Mapping *m = _tcp_done;
-  Mapping *mp = 0;
-  while (m) {
-    mp = m;
-    m = m->free_next();
+  // rw may have a different number of shards, so rehash every mapping
+  for (int i = 0; i < rw->_shards.size(); i++) {
+    Shard *o = rw->_shards[i];
+    Map tcp_map(0), udp_map(0);
+    tcp_map.swap(o->tcp_map);
+    udp_map.swap(o->udp_map);
+    for (Mapping *m = o->tcp_done; m; ) {
+      Mapping *next = m->free_next();
+      m->set_free_next(0);
+      m = next;
+    }
+    o->tcp_done = o->tcp_done_tail = 0;
+
+    Mapping *done = 0, *done_tail = 0;
+    take_state_map(tcp_map, &done, &done_tail, rw->_all_patterns, pattern_map);
+    take_state_map(udp_map, 0, 0, rw->_all_patterns, pattern_map);
+
+    for (int x = 0; x < 2; x++) {
+      Map &map = (x ? udp_map : tcp_map);
+      for (Map::iterator iter = map.begin(); iter.live(); iter++) {
+	Mapping *m = iter.value();
+	if (m->is_primary()) {
+	  Shard *s = home_shard(m);
+	  if (s == _shards[_nshards])
+	    _overflow_used = 1;
+	  Map &to = (x ? s->udp_map : s->tcp_map);
+	  to.set(m->reverse()->flow_id().reverse(), m);
+	  to.set(m->flow_id().reverse(), m->reverse());
+	}
+      }
+    }
+
+    while (Mapping *m = done) {
+      done = m->free_next();
+      m->clear_free_tracked();
+      Shard *s = home_shard(m);
+      m->add_to_free_tracked_tail(s->tcp_done, s->tcp_done_tail);
+    }
+  }
+
+  for (int i = 0; i < _shards.size(); i++) {
+    _shards[i]->tcp_expiry.rebuild(_shards[i]->tcp_map);
+    _shards[i]->udp_expiry.rebuild(_shards[i]->udp_map);
   }
-  _tcp_done_tail = mp;
+}
+
+bool
+IPRewriter::reap(ExpiryWheel &wheel, Map &map)
+{
+  Timestamp start = Timestamp::now();
+  bool done = wheel.expire(map, click_jiffies(), GC_SLICE);
+  uint32_t usec = (Timestamp::now() - start).usecval();
+  if (usec > _reap_max_usec)
+    _reap_max_usec = usec;
+  return done;
 }
 
 void
 IPRewriter::tcp_gc_hook(Timer *timer, void *thunk)
 {
   IPRewriter *rw = (IPRewriter *)thunk;
-  unsigned wait = rw->_tcp_gc_interval;
-#if IPRW_RWLOCKS
-  if (rw->_rwlock.attempt_write()) {
-#elif IPRW_SPINLOCKS
-  if (rw->_spinlock.attempt()) {
-#endif
-  rw->clean_map(rw->_tcp_map, click_jiffies() - rw->_tcp_timeout_jiffies);
-#if IPRW_RWLOCKS
-  rw->_rwlock.release_write();
-  } else wait = 1;		// XXX too long a wait?
-#elif IPRW_SPINLOCKS
-  rw->_spinlock.release();
-  } else wait = 1;
-#endif
-  timer->reschedule_after_sec(wait);
+  bool done = true;
+  for (int i = 0; i < rw->_shards.size(); i++) {
+    Shard *s = rw->_shards[i];
+    rw->lock_shard(s);
+    if (!rw->reap(s->tcp_expiry, s->tcp_map))
+      done = false;
+    rw->unlock_shard(s);
+  }
+  if (done)
+    timer->reschedule_after_sec(rw->_tcp_gc_interval);
+  else
+    timer->schedule_now();
 }
 
 void
 IPRewriter::tcp_done_gc_hook(Timer *timer, void *thunk)
 {
   IPRewriter *rw = (IPRewriter *)thunk;
-  unsigned wait = rw->_tcp_done_gc_interval;
-#if IPRW_RWLOCKS
-  if (rw->_rwlock.attempt_write()) {
-#elif IPRW_SPINLOCKS
-  if (rw->_spinlock.attempt()) {
-#endif
-  rw->clean_map_free_tracked
-    (rw->_tcp_map, rw->_tcp_done, rw->_tcp_done_tail,
-     click_jiffies() - rw->_tcp_done_timeout_jiffies);
-#if IPRW_RWLOCKS
-  rw->_rwlock.release_write();
-  } else wait = 1;		// XXX too long a wait?
-#elif IPRW_SPINLOCKS
-  rw->_spinlock.release();
-  } else wait = 1;
-#endif
-  timer->reschedule_after_sec(wait);
+  for (int i = 0; i < rw->_shards.size(); i++) {
+    Shard *s = rw->_shards[i];
+    rw->lock_shard(s);
+    rw->clean_map_free_tracked
+      (s->tcp_map, s->tcp_done, s->tcp_done_tail,
+       click_jiffies() - rw->_tcp_done_timeout_jiffies);
+    rw->unlock_shard(s);
+  }
+  timer->reschedule_after_sec(rw->_tcp_done_gc_interval);
 }
 
 void
 IPRewriter::udp_gc_hook(Timer *timer, void *thunk)
 {
   IPRewriter *rw = (IPRewriter *)thunk;
-  unsigned wait = rw->_udp_gc_interval;
-#if IPRW_RWLOCKS
-  if (rw->_rwlock.attempt_write()) {
-#elif IPRW_SPINLOCKS
-  if (rw->_spinlock.attempt()) {
-#endif
-  rw->clean_map(rw->_udp_map, click_jiffies() - rw->_udp_timeout_jiffies);
-#if IPRW_RWLOCKS
-  rw->_rwlock.release_write();
-  } else wait = 1;		// XXX too long a wait?
-#elif IPRW_SPINLOCKS
-  rw->_spinlock.release();
-  } else wait = 1;
-#endif
-  timer->reschedule_after_sec(wait);
+  bool done = true;
+  for (int i = 0; i < rw->_shards.size(); i++) {
+    Shard *s = rw->_shards[i];
+    rw->lock_shard(s);
+    if (!rw->reap(s->udp_expiry, s->udp_map))
+      done = false;
+    rw->unlock_shard(s);
+  }
+  if (done)
+    timer->reschedule_after_sec(rw->_udp_gc_interval);
+  else
+    timer->schedule_now();
 }
 
 IPRw::Mapping *
@@ -248,15 +306,31 @@ IPRewriter::apply_pattern(Pattern *pattern, int ip_p, const IPFlowID &flow,
   Mapping *reverse = new Mapping(_dst_anno);
 
   if (forward && reverse) {
-    Map& map = (ip_p == IP_PROTO_TCP ? _tcp_map : _udp_map);
+    int si = flow_shard(flow, _nshards);
+    Shard *s = _shards[si];
+    lock_shard(s);
+    Map& map = (ip_p == IP_PROTO_TCP ? s->tcp_map : s->udp_map);
 
     if (!pattern)
       Mapping::make_pair(ip_p, flow, flow, fport, rport, forward, reverse);
-    else if (!pattern->create_mapping(ip_p, flow, fport, rport, forward, reverse, map))
+    else if (!pattern->create_mapping(ip_p, flow, fport, rport, forward, reverse, map, _nshards, si)) {
+      unlock_shard(s);
       goto failure;
+    }
 
-    map.set(flow, forward);
-    map.set(forward->flow_id().reverse(), reverse);
+    // Lock order: a flow's shard, then the overflow shard.
+    Shard *home = home_shard(forward);
+    if (home != s) {
+      lock_shard(home);
+      _overflow_used = 1;
+    }
+    Map& home_map = (ip_p == IP_PROTO_TCP ? home->tcp_map : home->udp_map);
+    home_map.set(flow, forward);
+    home_map.set(forward->flow_id().reverse(), reverse);
+    (ip_p == IP_PROTO_TCP ? home->tcp_expiry : home->udp_expiry).insert(forward);
+    if (home != s)
+      unlock_shard(home);
+    unlock_shard(s);
     return forward;
   }
 
@@ -267,6 +341,20 @@ IPRewriter::apply_pattern(Pattern *pattern, int ip_p, const IPFlowID &flow,
   return 0;
 }
 
+IPRw::Mapping *
+IPRewriter::get_mapping(int ip_p, const IPFlowID &in) const
+{
+  if (ip_p != IP_PROTO_TCP && ip_p != IP_PROTO_UDP)
+    return 0;
+  Shard *s = _shards[flow_shard(in, _nshards)], *home;
+  lock_shard(s);
+  Mapping *m = find_mapping(s, ip_p, in, home);
+  if (home != s)
+    unlock_shard(home);
+  unlock_shard(s);
+  return m;
+}
+
 void
 IPRewriter::push(int port, Packet *p_in)
 {
@@ -275,9 +363,6 @@ IPRewriter::push(int port, Packet *p_in)
       return;
 
   click_ip *iph = p->ip_header();
-#if IPRW_RWLOCKS
-  bool has_lock = false;
-#endif
 
   // handle non-TCP and non-first fragments
   int ip_p = iph->ip_p;
@@ -290,33 +375,17 @@ IPRewriter::push(int port, Packet *p_in)
     return;
   }
 
-#if IPRW_RWLOCKS
-  _rwlock.acquire_read();
-#elif IPRW_SPINLOCKS
-  _spinlock.acquire();
-#endif
   IPFlowID flow(p);
-  Mapping *m = (ip_p == IP_PROTO_TCP ? _tcp_map.get(flow) : _udp_map.get(flow));
-
-#if IPRW_RWLOCKS
-  _rwlock.release_read();
-#endif
+  Shard *s = _shards[flow_shard(flow, _nshards)], *home;
+  lock_shard(s);
+  Mapping *m = find_mapping(s, ip_p, flow, home);
 
   if (!m) {			// create new mapping
     const InputSpec &is = _input_specs[port];
-#if IPRW_RWLOCKS
-    _rwlock.acquire_write();
-    has_lock = true;
-#endif
     switch (is.kind) {
 
      case INPUT_SPEC_NOCHANGE:
-#if IPRW_RWLOCKS
-      _rwlock.release_write();
-      has_lock = false;
-#elif IPRW_SPINLOCKS
-      _spinlock.release();
-#endif
+      unlock_shard(s);
       output(is.u.output).push(p);
       return;
 
@@ -339,15 +408,12 @@ IPRewriter::push(int port, Packet *p_in)
 
     }
     if (!m) {
-#if IPRW_RWLOCKS
-      _rwlock.release_write();
-      has_lock = false;
-#elif IPRW_SPINLOCKS
-      _spinlock.release();
-#endif
+      unlock_shard(s);
       p->kill();
       return;
     }
+    if ((home = home_shard(m)) != s)
+      lock_shard(home);
   }
 
   m->apply(p);
@@ -356,33 +422,22 @@ IPRewriter::push(int port, Packet *p_in)
     click_tcp *tcph = p->tcp_header();
     if (tcph->th_flags & (TH_SYN | TH_FIN | TH_RST)) {
 
-#if IPRW_RWLOCKS
-      if (!has_lock) {
-        _rwlock.acquire_write();
-        has_lock = true;
-      }
-#endif
-
       if (_tcp_done_gc_incr && (tcph->th_flags & TH_SYN))
         incr_clean_map_free_tracked
-	  (_tcp_map, _tcp_done, _tcp_done_tail, click_jiffies() - _tcp_done_timeout_jiffies);
+	  (s->tcp_map, s->tcp_done, s->tcp_done_tail, click_jiffies() - _tcp_done_timeout_jiffies);
 
       // add to list for dropping TCP connections faster
       if (!m->free_tracked() && (tcph->th_flags & (TH_FIN | TH_RST))
 	  && m->session_over())
-	m->add_to_free_tracked_tail(_tcp_done, _tcp_done_tail);
+	m->add_to_free_tracked_tail(home->tcp_done, home->tcp_done_tail);
     }
   }
 
-#if IPRW_RWLOCKS
-  if (has_lock) {
-    _rwlock.release_write();
-    has_lock = false;
-  }
-#elif IPRW_SPINLOCKS
-  _spinlock.release();
-#endif
-  output(m->output()).push(p);
+  int out = m->output();
+  if (home != s)
+    unlock_shard(home);
+  unlock_shard(s);
+  output(out).push(p);
 }
 
 
@@ -390,20 +445,18 @@ String
 IPRewriter::dump_mappings_handler(Element *e, void *thunk)
 {
   IPRewriter *rw = (IPRewriter *)e;
-  Map *map = (thunk ? &rw->_udp_map : &rw->_tcp_map);
-
-#if IPRW_SPINLOCKS
-  rw->_spinlock.acquire();
-#endif
   StringAccum sa;
-  for (Map::iterator iter = map->begin(); iter.live(); iter++) {
-    Mapping *m = iter.value();
-    if (m->is_primary())
-      sa << m->unparse() << "\n";
+  for (int i = 0; i < rw->_shards.size(); i++) {
+    Shard *s = rw->_shards[i];
+    Map *map = (thunk ? &s->udp_map : &s->tcp_map);
+    rw->lock_shard(s);
+    for (Map::iterator iter = map->begin(); iter.live(); iter++) {
+      Mapping *m = iter.value();
+      if (m->is_primary())
+	sa << m->unparse() << "\n";
+    }
+    rw->unlock_shard(s);
   }
-#if IPRW_SPINLOCKS
-  rw->_spinlock.release();
-#endif
   return sa.take_string();
 }
 
@@ -411,18 +464,16 @@ String
 IPRewriter::dump_tcp_done_mappings_handler(Element *e, void *)
 {
   IPRewriter *rw = (IPRewriter *)e;
-
-#if IPRW_SPINLOCKS
-  rw->_spinlock.acquire();
-#endif
   StringAccum sa;
-  for (Mapping *m = rw->_tcp_done; m; m = m->free_next()) {
-    if (m->session_over())
-      sa << m->unparse() << "\n";
+  for (int i = 0; i < rw->_shards.size(); i++) {
+    Shard *s = rw->_shards[i];
+    rw->lock_shard(s);
+    for (Mapping *m = s->tcp_done; m; m = m->free_next()) {
+      if (m->session_over())
+	sa << m->unparse() << "\n";
+    }
+    rw->unlock_shard(s);
   }
-#if IPRW_SPINLOCKS
-  rw->_spinlock.release();
-#endif
   return sa.take_string();
 }
 
@@ -430,10 +481,15 @@ String
 IPRewriter::dump_nmappings_handler(Element *e, void *thunk)
 {
   IPRewriter *rw = (IPRewriter *)e;
-  if (!thunk)
-      return String(rw->_tcp_map.size()) + " " + String(rw->_udp_map.size());
-  else
-      return String(rw->_nmapping_failures);
+  if (!thunk) {
+    uint32_t tcp = 0, udp = 0;
+    for (int i = 0; i < rw->_shards.size(); i++) {
+      tcp += rw->_shards[i]->tcp_map.size();
+      udp += rw->_shards[i]->udp_map.size();
+    }
+    return String(tcp) + " " + String(udp);
+  } else
+    return String(rw->_nmapping_failures);
 }
 
 String
@@ -441,18 +497,33 @@ IPRewriter::dump_patterns_handler(Element *e, void *)
 {
   IPRewriter *rw = (IPRewriter *)e;
   String s;
-#if IPRW_SPINLOCKS
-  rw->_spinlock.acquire();
-#endif
   for (int i = 0; i < rw->_input_specs.size(); i++)
     if (rw->_input_specs[i].kind == INPUT_SPEC_PATTERN)
       s += rw->_input_specs[i].u.pattern.p->unparse() + "\n";
-#if IPRW_SPINLOCKS
-  rw->_spinlock.release();
-#endif
   return s;
 }
 
+String
+IPRewriter::reap_stats_handler(Element *e, void *)
+{
+  IPRewriter *rw = (IPRewriter *)e;
+  uint32_t tcp_examined = 0, tcp_freed = 0, udp_examined = 0, udp_freed = 0;
+  for (int i = 0; i < rw->_shards.size(); i++) {
+    Shard *s = rw->_shards[i];
+    tcp_examined += s->tcp_expiry.nexamined();
+    tcp_freed += s->tcp_expiry.nfreed();
+    udp_examined += s->udp_expiry.nexamined();
+    udp_freed += s->udp_expiry.nfreed();
+  }
+  StringAccum sa;
+  sa << "tcp_examined " << tcp_examined
+     << "\ntcp_freed " << tcp_freed
+     << "\nudp_examined " << udp_examined
+     << "\nudp_freed " << udp_freed
+     << "\nmax_usec " << rw->_reap_max_usec << "\n";
+  return sa.take_string();
+}
+
 void
 IPRewriter::add_handlers()
 {
@@ -462,6 +533,7 @@ IPRewriter::add_handlers()
   add_read_handler("nmappings", dump_nmappings_handler, (void *)0);
   add_read_handler("mapping_failures", dump_nmappings_handler, (void *)1);
   add_read_handler("patterns", dump_patterns_handler, (void *)0);
+  add_read_handler("reap_stats", reap_stats_handler, 0);
 }
 
 int
@@ -476,20 +548,10 @@ IPRewriter::llrpc(unsigned command, void *data)
     //		  -EAGAIN.
 
     IPFlowID *val = reinterpret_cast<IPFlowID *>(data);
-#if IPRW_SPINLOCKS
-    _spinlock.acquire();
-#endif
     Mapping *m = get_mapping(IP_PROTO_TCP, *val);
-    if (!m) {
-#if IPRW_SPINLOCKS
-      _spinlock.release();
-#endif
+    if (!m)
       return -EAGAIN;
-    }
     *val = m->flow_id();
-#if IPRW_SPINLOCKS
-    _spinlock.release();
-#endif
     return 0;
 
   } else if (command == CLICK_LLRPC_IPREWRITER_MAP_UDP) {
@@ -501,20 +563,10 @@ IPRewriter::llrpc(unsigned command, void *data)
     //		  -EAGAIN.
 
     IPFlowID *val = reinterpret_cast<IPFlowID *>(data);
-#if IPRW_SPINLOCKS
-    _spinlock.acquire();
-#endif
     Mapping *m = get_mapping(IP_PROTO_UDP, *val);
-    if (!m) {
-#if IPRW_SPINLOCKS
-      _spinlock.release();
-#endif
+    if (!m)
       return -EAGAIN;
-    }
     *val = m->flow_id();
-#if IPRW_SPINLOCKS
-    _spinlock.release();
-#endif
     return 0;
 
   } else
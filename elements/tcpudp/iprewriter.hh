@@ -140,6 +140,29 @@ seconds.
 
 Reap timed-out UDP connections every I<time> seconds. Default is 10 seconds.
 
+Reaping does not scan every mapping.  Mappings are kept in buckets ordered by
+the time they could next expire, and each reap visits only the buckets that
+have come due, moving recently used mappings to later buckets.  A single reap
+examines at most about a thousand mappings; if more are due, reaping resumes
+once other tasks have run, so that large tables never stall packet processing
+for long.
+
+=item SHARDS I<n>
+
+Integer. Partition the mapping table into I<n> shards, each with its own lock,
+reaping state, and list of completed TCP sessions.  A flow and its reply always
+belong to the same shard, so threads processing different flows rarely contend
+for a lock, and no lock is shared by all flows.  When a pattern chooses a
+source port (or address), it chooses only among values whose reply mapping
+falls in the new flow's shard, so each shard allocates from about 1/I<n> of
+the pattern's range.  Patterns that cannot vary, such as '1.0.0.1 20 - -',
+store mappings whose directions fall in different shards in a shared overflow
+table, which is then also checked on lookup misses.  Default is 1.
+
+Shards are locked only when the router runs more than one thread (or, in the
+Linux kernel module, where handlers run beside the router thread).  In a
+single-threaded user-level router, lookups take no lock.
+
 =item DST_ANNO
 
 Boolean. If true, then set the destination IP address annotation on passing
@@ -162,14 +185,14 @@ UDP mappings.
 Returns a human-readable description of the IPRewriter's current set of
 mappings for completed TCP sessions.
 
+=h reap_stats read-only
+
+Returns the number of TCP and UDP mappings examined and freed by reaping so
+far, and the longest time spent in a single reap, in microseconds.
+
 =a TCPRewriter, IPAddrRewriter, IPAddrPairRewriter, IPRewriterPatterns,
 RoundRobinIPMapper, FTPPortMapper, ICMPRewriter, ICMPPingRewriter */
 
-#if defined(CLICK_LINUXMODULE) && __MTCLICK__
-# define IPRW_SPINLOCKS 1
-# define IPRW_RWLOCKS 0
-#endif
-
 class IPRewriter : public IPRw { public:
 
   IPRewriter();
@@ -196,10 +219,26 @@ class IPRewriter : public IPRw { public:
 
  private:
 
-  Map _tcp_map;
-  Map _udp_map;
-  Mapping *_tcp_done;
-  Mapping *_tcp_done_tail;
+  struct Shard {
+    Map tcp_map;
+    Map udp_map;
+    ExpiryWheel tcp_expiry;
+    ExpiryWheel udp_expiry;
+    Mapping *tcp_done;
+    Mapping *tcp_done_tail;
+    Spinlock lock;
+    Shard()	: tcp_map(0), udp_map(0), tcp_done(0), tcp_done_tail(0) { }
+  };
+
+  // _shards[_nshards] is the overflow shard, which holds mapping pairs
+  // whose two flow IDs hash to different shards.
+  Vector<Shard *> _shards;
+  int _nshards;
+  atomic_uint32_t _overflow_used;	// read without the overflow shard's lock
+
+  // False when only one thread can reach the element; then shards are not
+  // locked at all.
+  bool _locking;
 
   Vector<InputSpec> _input_specs;
   bool _dst_anno;
@@ -215,15 +254,15 @@ class IPRewriter : public IPRw { public:
   int _tcp_timeout_jiffies;
   int _tcp_done_timeout_jiffies;
 
-#if IPRW_SPINLOCKS
-  Spinlock _spinlock;
-#endif
-#if IPRW_RWLOCKS
-  ReadWriteLock _rwlock;
-#endif
-
   int _nmapping_failures;
-
+  uint32_t _reap_max_usec;
+
+  inline void lock_shard(Shard *) const;
+  inline void unlock_shard(Shard *) const;
+  inline Mapping *find_mapping(Shard *, int ip_p, const IPFlowID &,
+			       Shard *&home) const;
+  inline Shard *home_shard(const Mapping *) const;
+  bool reap(ExpiryWheel &, Map &);
   static void tcp_gc_hook(Timer *, void *);
   static void udp_gc_hook(Timer *, void *);
   static void tcp_done_gc_hook(Timer *, void *);
@@ -232,19 +271,53 @@ class IPRewriter : public IPRw { public:
   static String dump_tcp_done_mappings_handler(Element *, void *);
   static String dump_nmappings_handler(Element *, void *);
   static String dump_patterns_handler(Element *, void *);
+  static String reap_stats_handler(Element *, void *);
 
 };
 
 
+inline void
+IPRewriter::lock_shard(Shard *s) const
+{
+  if (_locking)
+    s->lock.acquire();
+}
+
+inline void
+IPRewriter::unlock_shard(Shard *s) const
+{
+  if (_locking)
+    s->lock.release();
+}
+
 inline IPRw::Mapping *
-IPRewriter::get_mapping(int ip_p, const IPFlowID &in) const
+IPRewriter::find_mapping(Shard *s, int ip_p, const IPFlowID &in,
+			 Shard *&home) const
+{
+  // Call with s->lock held.  If the mapping is found in the overflow shard,
+  // returns with that shard's lock held as well.
+  home = s;
+  Mapping *m = (ip_p == IP_PROTO_TCP ? s->tcp_map.get(in) : s->udp_map.get(in));
+  if (!m && _overflow_used) {
+    Shard *o = _shards[_nshards];
+    lock_shard(o);
+    m = (ip_p == IP_PROTO_TCP ? o->tcp_map.get(in) : o->udp_map.get(in));
+    if (m)
+      home = o;
+    else
+      unlock_shard(o);
+  }
+  return m;
+}
+
+inline IPRewriter::Shard *
+IPRewriter::home_shard(const Mapping *m) const
 {
-  if (ip_p == IP_PROTO_TCP)
-    return _tcp_map[in];
-  else if (ip_p == IP_PROTO_UDP)
-    return _udp_map[in];
+  int s = flow_shard(m->flow_id(), _nshards);
+  if (flow_shard(m->reverse()->flow_id(), _nshards) == s)
+    return _shards[s];
   else
-    return 0;
+    return _shards[_nshards];
 }
 
 CLICK_ENDDECLS
@@ -118,9 +118,7 @@ TCPRewriter::TCPMapping::apply(WritablePacket *p)
     if (_flags & F_DST_ANNO)
 	p->set_dst_ip_anno(_mapto.daddr());
 
-    uint32_t sum = (~iph->ip_sum & 0xFFFF) + _ip_csum_delta;
-    sum = (sum & 0xFFFF) + (sum >> 16);
-    iph->ip_sum = ~(sum + (sum >> 16));
+    click_update_in_cksum_delta(&iph->ip_sum, _ip_csum_delta);
 
     mark_used();
 
@@ -138,15 +136,13 @@ TCPRewriter::TCPMapping::apply(WritablePacket *p)
 
     uint32_t newval = htonl(new_seq(ntohl(tcph->th_seq)));
     if (tcph->th_seq != newval) {
-	csum_delta += (~tcph->th_seq >> 16) + (~tcph->th_seq & 0xFFFF)
-	    + (newval >> 16) + (newval & 0xFFFF);
+	csum_delta += click_in_cksum_delta32(tcph->th_seq, newval);
 	tcph->th_seq = newval;
     }
 
     newval = htonl(reverse()->new_ack(ntohl(tcph->th_ack)));
     if (tcph->th_ack != newval) {
-	csum_delta += (~tcph->th_ack >> 16) + (~tcph->th_ack & 0xFFFF)
-	    + (newval >> 16) + (newval & 0xFFFF);
+	csum_delta += click_in_cksum_delta32(tcph->th_ack, newval);
 	tcph->th_ack = newval;
     }
 
@@ -158,9 +154,7 @@ TCPRewriter::TCPMapping::apply(WritablePacket *p)
 	csum_delta += reverse()->apply_sack(tcph, p->transport_length());
 
     // update checksum
-    uint32_t sum2 = (~tcph->th_sum & 0xFFFF) + csum_delta;
-    sum2 = (sum2 & 0xFFFF) + (sum2 >> 16);
-    tcph->th_sum = ~(sum2 + (sum2 >> 16));
+    click_update_in_cksum_delta(&tcph->th_sum, csum_delta);
 
     // check for session ending flags
     if (tcph->th_flags & TH_RST)
@@ -246,8 +240,10 @@ TCPRewriter::configure(Vector<String> &conf, ErrorHandler *errh)
 }
 
 int
-TCPRewriter::initialize(ErrorHandler *)
+TCPRewriter::initialize(ErrorHandler *errh)
 {
+  if (_tcp_expiry.initialize(_tcp_timeout_jiffies, _tcp_gc_interval * CLICK_HZ) < 0)
+    return errh->error("out of memory");
   _tcp_gc_timer.initialize(this);
   _tcp_gc_timer.schedule_after_sec(_tcp_gc_interval);
   _tcp_done_gc_timer.initialize(this);
@@ -261,6 +257,7 @@ void
 TCPRewriter::cleanup(CleanupStage)
 {
   clear_map(_tcp_map);
+  _tcp_expiry.reset();
   for (int i = 0; i < _input_specs.size(); i++)
     if (_input_specs[i].kind == INPUT_SPEC_PATTERN)
       _input_specs[i].u.pattern.p->unuse();
@@ -300,14 +297,17 @@ TCPRewriter::take_state(Element *e, ErrorHandler *errh)
   }
 
   take_state_map(_tcp_map, &_tcp_done, &_tcp_done_tail, rw->_all_patterns, pattern_map);
+  _tcp_expiry.rebuild(_tcp_map);
 }
 
 void
 TCPRewriter::tcp_gc_hook(Timer *timer, void *thunk)
 {
   TCPRewriter *rw = (TCPRewriter *)thunk;
-  rw->clean_map(rw->_tcp_map, click_jiffies() - rw->_tcp_timeout_jiffies);
-  timer->reschedule_after_sec(rw->_tcp_gc_interval);
+  if (rw->_tcp_expiry.expire(rw->_tcp_map, click_jiffies(), GC_SLICE))
+    timer->reschedule_after_sec(rw->_tcp_gc_interval);
+  else
+    timer->schedule_now();
 }
 
 void
@@ -338,6 +338,7 @@ TCPRewriter::apply_pattern(Pattern *pattern, int ip_p, const IPFlowID &flow,
     IPFlowID reverse_flow = forward->flow_id().reverse();
     _tcp_map.set(flow, forward);
     _tcp_map.set(reverse_flow, reverse);
+    _tcp_expiry.insert(forward);
     return forward;
   }
 
@@ -54,6 +54,9 @@ mapping as stale. Default is 1 hour.
 Reap timed-out completed TCP connections every I<time> seconds. Default is 10
 seconds.
 
+As in IPRewriter, reaping visits only mappings that could have timed out, and
+a large reap is split into slices interleaved with other tasks.
+
 =item DST_ANNO
 
 Boolean. If true, then set the destination IP address annotation on passing
@@ -122,6 +125,7 @@ class TCPRewriter : public IPRw { public:
  private:
 
   Map _tcp_map;
+  ExpiryWheel _tcp_expiry;
   Mapping *_tcp_done;
   Mapping *_tcp_done_tail;
 
@@ -0,0 +1,284 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * aestest.{cc,hh} -- regression test element for the IPsec AES code
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "aestest.hh"
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/glue.hh>
+#include <click/straccum.hh>
+#include <click/timestamp.hh>
+#include "elements/ipsec/aescipher.hh"
+CLICK_DECLS
+
+#define CHECK(x) if (!(x)) return errh->error("%s:%d: test %<%s%> failed", __FILE__, __LINE__, #x);
+
+static const char * const impl_names[] = { "portable", "AES-NI" };
+
+AESTest::AESTest()
+{
+}
+
+AESTest::~AESTest()
+{
+}
+
+int
+AESTest::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _benchmark = false;
+    _bytes = 16 << 20;
+    return cp_va_kparse(conf, this, errh,
+			"BENCHMARK", 0, cpBool, &_benchmark,
+			"BYTES", 0, cpUnsigned, &_bytes,
+			cpEnd);
+}
+
+static int
+unhex(const char *s, unsigned char *out)
+{
+    int n = 0;
+    for (; s[0] && s[1]; s += 2, n++) {
+	int hi = (s[0] <= '9' ? s[0] - '0' : s[0] - 'a' + 10);
+	int lo = (s[1] <= '9' ? s[1] - '0' : s[1] - 'a' + 10);
+	out[n] = hi * 16 + lo;
+    }
+    return n;
+}
+
+static void
+random_bytes(unsigned char *x, int len)
+{
+    for (int i = 0; i < len; i++)
+	x[i] = click_random();
+}
+
+int
+AESTest::test_cipher(ErrorHandler *errh)
+{
+    // FIPS-197, Appendix C
+    static const struct {
+	const char *key, *ciphertext;
+    } kat[] = {
+	{ "000102030405060708090a0b0c0d0e0f",
+	  "69c4e0d86a7b0430d8cdb78070b4c55a" },
+	{ "000102030405060708090a0b0c0d0e0f1011121314151617",
+	  "dda97ca4864cdfe06eaf70a0ec0d7191" },
+	{ "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f",
+	  "8ea2b7ca516745bfeafc49904b496089" }
+    };
+    unsigned char key[32], pt[16], ct[16], out[16];
+    unsigned char blocks[9 * 16], blocks_out[9 * 16], blocks_back[9 * 16];
+    AESCipher aes;
+    unhex("00112233445566778899aabbccddeeff", pt);
+
+    for (int hw = 0; hw < 2; hw++) {
+	if (hw && !AESCipher::hardware_available())
+	    continue;
+	for (size_t i = 0; i < sizeof(kat) / sizeof(kat[0]); i++) {
+	    int keylen = unhex(kat[i].key, key);
+	    unhex(kat[i].ciphertext, ct);
+	    CHECK(aes.set_key(key, keylen * 8) == 0);
+	    aes.encrypt(pt, out, hw);
+	    if (memcmp(out, ct, 16) != 0)
+		return errh->error("%s AES-%d encryption differs", impl_names[hw], keylen * 8);
+	    aes.decrypt(ct, out, hw);
+	    if (memcmp(out, pt, 16) != 0)
+		return errh->error("%s AES-%d decryption differs", impl_names[hw], keylen * 8);
+	}
+    }
+    CHECK(aes.set_key(key, 100) < 0);
+
+    // the implementations agree, and decrypt_blocks inverts encrypt
+    for (int trial = 0; trial < 300; trial++) {
+	int bits = 128 + 64 * (trial % 3);
+	random_bytes(key, bits / 8);
+	random_bytes(blocks, sizeof(blocks));
+	CHECK(aes.set_key(key, bits) == 0);
+	for (int b = 0; b < 9; b++) {
+	    aes.encrypt(blocks + 16 * b, blocks_out + 16 * b, false);
+	    aes.encrypt(blocks + 16 * b, out, true);
+	    CHECK(memcmp(out, blocks_out + 16 * b, 16) == 0);
+	}
+	int n = trial % 10;
+	for (int hw = 0; hw < 2; hw++) {
+	    memset(blocks_back, 0, sizeof(blocks_back));
+	    aes.decrypt_blocks(blocks_out, blocks_back, n, hw);
+	    CHECK(memcmp(blocks_back, blocks, 16 * n) == 0);
+	}
+    }
+    return 0;
+}
+
+int
+AESTest::test_gcm(ErrorHandler *errh)
+{
+    // test cases 1-4 from McGrew and Viega, "The Galois/Counter Mode of
+    // Operation (GCM)"
+    static const char k3[] = "feffe9928665731c6d6a8f9467308308";
+    static const char p3[] = "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b391aafd255";
+    static const char c3[] = "42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091473f5985";
+    static const struct {
+	const char *key, *iv, *aad, *plaintext, *ciphertext;
+	int len;
+	const char *tag;
+    } kat[] = {
+	{ "00000000000000000000000000000000", "000000000000000000000000", "",
+	  "", "", 0, "58e2fccefa7e3061367f1d57a4e7455a" },
+	{ "00000000000000000000000000000000", "000000000000000000000000", "",
+	  "00000000000000000000000000000000", "0388dace60b6a392f328c2b971b2fe78",
+	  16, "ab6e47d42cec13bdf53a67b21257bddf" },
+	{ k3, "cafebabefacedbaddecaf888", "", p3, c3,
+	  64, "4d5c2af327cd64a62cf35abd2ba6fab4" },
+	{ k3, "cafebabefacedbaddecaf888", "feedfacedeadbeeffeedfacedeadbeefabaddad2", p3, c3,
+	  60, "5bc94fbc3221a5db94fae95ae7121a47" }
+    };
+    unsigned char key[16], iv[12], aad[64], pt[512], ct[512], data[512], tag[16], tag2[16];
+    AESCipher aes;
+    AESGCM gcm;
+
+    for (int hw = 0; hw < 2; hw++) {
+	if (hw && !AESCipher::hardware_available())
+	    continue;
+	for (size_t i = 0; i < sizeof(kat) / sizeof(kat[0]); i++) {
+	    unhex(kat[i].key, key);
+	    unhex(kat[i].iv, iv);
+	    int aadlen = unhex(kat[i].aad, aad);
+	    unhex(kat[i].plaintext, pt);
+	    unhex(kat[i].ciphertext, ct);
+	    unhex(kat[i].tag, tag2);
+	    aes.set_key(key, 128);
+	    gcm.set_key(aes);
+
+	    memcpy(data, pt, kat[i].len);
+	    gcm.seal(aes, iv, aad, aadlen, data, kat[i].len, tag, hw);
+	    if (memcmp(data, ct, kat[i].len) != 0 || memcmp(tag, tag2, 16) != 0)
+		return errh->error("%s GCM test case %d: seal differs", impl_names[hw], (int) i + 1);
+	    gcm.open(aes, iv, aad, aadlen, data, kat[i].len, tag, hw);
+	    if (memcmp(data, pt, kat[i].len) != 0 || memcmp(tag, tag2, 16) != 0)
+		return errh->error("%s GCM test case %d: open differs", impl_names[hw], (int) i + 1);
+	}
+    }
+
+    // the implementations agree on random data of every length
+    for (int len = 0; len <= 300; len++) {
+	int aadlen = (len % 4) * 6;
+	random_bytes(key, 16);
+	random_bytes(iv, 12);
+	random_bytes(aad, aadlen);
+	random_bytes(pt, len);
+	aes.set_key(key, 128);
+	gcm.set_key(aes);
+
+	memcpy(ct, pt, len);
+	gcm.seal(aes, iv, aad, aadlen, ct, len, tag, false);
+	memcpy(data, pt, len);
+	gcm.seal(aes, iv, aad, aadlen, data, len, tag2, true);
+	CHECK(memcmp(data, ct, len) == 0 && memcmp(tag, tag2, 16) == 0);
+	for (int hw = 0; hw < 2; hw++) {
+	    memcpy(data, ct, len);
+	    gcm.open(aes, iv, aad, aadlen, data, len, tag2, hw);
+	    CHECK(memcmp(data, pt, len) == 0 && memcmp(tag, tag2, 16) == 0);
+	}
+	// any change to the ciphertext changes the tag
+	if (len > 0) {
+	    memcpy(data, ct, len);
+	    data[click_random(0, len - 1)] ^= 1 << click_random(0, 7);
+	    gcm.open(aes, iv, aad, aadlen, data, len, tag2, true);
+	    CHECK(memcmp(tag, tag2, 16) != 0);
+	}
+    }
+    return 0;
+}
+
+void
+AESTest::benchmark(ErrorHandler *errh)
+{
+    static const int sizes[] = { 64, 256, 576, 1024, 1500 };
+    unsigned char key[16], iv[12], aad[8], tag[16];
+    unsigned char *buf = new unsigned char[2048];
+    random_bytes(key, sizeof(key));
+    random_bytes(iv, sizeof(iv));
+    random_bytes(aad, sizeof(aad));
+    random_bytes(buf, 2048);
+    AESCipher aes;
+    AESGCM gcm;
+    aes.set_key(key, 128);
+    gcm.set_key(aes);
+    volatile unsigned char sink = 0;
+
+    errh->message("%6s %10s %10s %10s %10s %10s", "size", "setkey", "cbc-sw", "cbc-hw", "gcm-sw", "gcm-hw");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+	int size = sizes[s];
+	uint32_t n = _bytes / size + 1;
+	StringAccum sa;
+	sa.snprintf(20, "%6d", size);
+
+	// key expansion, which IPsecAES used to repeat for every packet
+	Timestamp t0 = Timestamp::now();
+	AESCipher tmp;
+	for (uint32_t i = 0; i < n; i++) {
+	    key[i & 15] ^= i;
+	    tmp.set_key(key, 128);
+	}
+	Timestamp t1 = Timestamp::now();
+	sink += tmp.rounds();
+	sa.snprintf(20, " %10.2f", (t1 - t0).doubleval() * 1e9 / n);
+
+	for (int mode = 0; mode < 4; mode++) {
+	    bool hw = mode & 1;
+	    if (hw && !AESCipher::hardware_available()) {
+		sa.snprintf(20, " %10s", "-");
+		continue;
+	    }
+	    t0 = Timestamp::now();
+	    for (uint32_t i = 0; i < n; i++)
+		if (mode < 2) {
+		    // CBC encryption, as in IPsecAES
+		    const unsigned char *chain = iv;
+		    for (unsigned char *b = buf; b < buf + size; b += 16) {
+			for (int j = 0; j < 16; j++)
+			    b[j] ^= chain[j];
+			aes.encrypt(b, b, hw);
+			chain = b;
+		    }
+		} else
+		    gcm.seal(aes, iv, aad, sizeof(aad), buf, size, tag, hw);
+	    t1 = Timestamp::now();
+	    sink += buf[0] + tag[0];
+	    sa.snprintf(20, " %10.2f", (t1 - t0).doubleval() * 1e9 / n);
+	}
+	errh->message("%s", sa.c_str());
+    }
+    (void) sink;
+    delete[] buf;
+}
+
+int
+AESTest::initialize(ErrorHandler *errh)
+{
+    int r = test_cipher(errh);
+    if (r >= 0)
+	r = test_gcm(errh);
+    if (r >= 0 && _benchmark)
+	benchmark(errh);
+    if (r >= 0)
+	errh->message("All tests pass!");
+    return r;
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel IPsecAESCipher)
+EXPORT_ELEMENT(AESTest)
@@ -0,0 +1,67 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_AESTEST_HH
+#define CLICK_AESTEST_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+AESTest([I<keywords>])
+
+=s test
+
+runs regression tests and benchmarks for the IPsec AES code
+
+=d
+
+AESTest checks the AES block cipher and AES-GCM code used by the IPsec
+elements at initialization time: published known-answer tests for both the
+portable and the AES-NI implementations, and agreement between the two on
+random keys and data. It does not route packets.
+
+Keyword arguments are:
+
+=over 8
+
+=item BENCHMARK
+
+Boolean. If true, also time, over a range of packet sizes, AES key expansion
+and the CBC and GCM transforms with the portable and the AES-NI
+implementations, and print the results as nanoseconds per packet. Default is
+false.
+
+=item BYTES
+
+Unsigned. Number of bytes to process per benchmark measurement. Default is
+16MB.
+
+=back
+
+=a
+
+IPsecAES, IPsecAESGCM, ChecksumTest */
+
+class AESTest : public Element { public:
+
+    AESTest();
+    ~AESTest();
+
+    const char *class_name() const		{ return "AESTest"; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+
+  private:
+
+    bool _benchmark;
+    uint32_t _bytes;
+
+    int test_cipher(ErrorHandler *);
+    int test_gcm(ErrorHandler *);
+    void benchmark(ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,202 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * checksumtest.{cc,hh} -- regression test element for Internet checksums
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "checksumtest.hh"
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/glue.hh>
+#include <click/straccum.hh>
+#include <click/timestamp.hh>
+#include <clicknet/ip.h>
+CLICK_DECLS
+
+#define BUFSIZE		9216
+#define CHECK(x) if (!(x)) return errh->error("%s:%d: test %<%s%> failed", __FILE__, __LINE__, #x);
+
+static const char * const engine_names[] = { "generic", "sse2", "avx2" };
+
+ChecksumTest::ChecksumTest()
+{
+}
+
+ChecksumTest::~ChecksumTest()
+{
+}
+
+int
+ChecksumTest::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _benchmark = false;
+    _bytes = 64 << 20;
+    return cp_va_kparse(conf, this, errh,
+			"BENCHMARK", 0, cpBool, &_benchmark,
+			"BYTES", 0, cpUnsigned, &_bytes,
+			cpEnd);
+}
+
+// the original click_in_cksum: one halfword per iteration
+static uint16_t
+reference_cksum(const unsigned char *x, int len)
+{
+    uint32_t sum = 0;
+    for (; len > 1; x += 2, len -= 2) {
+	uint16_t hw;
+	memcpy(&hw, x, 2);
+	sum += hw;
+    }
+    if (len == 1) {
+	uint16_t hw = 0;
+	*(unsigned char *) &hw = *x;
+	sum += hw;
+    }
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum += (sum >> 16);
+    return ~sum;
+}
+
+int
+ChecksumTest::test_engines(const unsigned char *buf, ErrorHandler *errh)
+{
+    static const int big_lengths[] = { 1499, 1500, 4095, 4096, 8999, 9000, BUFSIZE - 8 };
+    for (int engine = 0; engine < CLICK_IN_CKSUM_NENGINES; engine++) {
+	if (!click_in_cksum_engine_available(engine))
+	    continue;
+	for (int offset = 0; offset < 8; offset++) {
+	    for (int len = 0; len <= 600; len++)
+		if (click_in_cksum_engine(engine, buf + offset, len) != reference_cksum(buf + offset, len))
+		    return errh->error("%s engine: offset %d, length %d differs", engine_names[engine], offset, len);
+	    for (size_t i = 0; i < sizeof(big_lengths) / sizeof(big_lengths[0]); i++) {
+		int len = big_lengths[i];
+		if (click_in_cksum_engine(engine, buf + offset, len) != reference_cksum(buf + offset, len))
+		    return errh->error("%s engine: offset %d, length %d differs", engine_names[engine], offset, len);
+	    }
+	}
+    }
+
+    for (int len = 0; len <= 600; len++)
+	CHECK(click_in_cksum(buf, len) == reference_cksum(buf, len));
+
+    // all-ones data stresses carry propagation
+    unsigned char *ones = new unsigned char[BUFSIZE];
+    memset(ones, 0xFF, BUFSIZE);
+    for (int engine = 0; engine < CLICK_IN_CKSUM_NENGINES; engine++)
+	if (click_in_cksum_engine_available(engine)
+	    && click_in_cksum_engine(engine, ones, BUFSIZE) != reference_cksum(ones, BUFSIZE)) {
+	    delete[] ones;
+	    return errh->error("%s engine: all-ones data differs", engine_names[engine]);
+	}
+    delete[] ones;
+    return 0;
+}
+
+int
+ChecksumTest::test_incremental(ErrorHandler *errh)
+{
+    uint16_t data[32];
+    for (int trial = 0; trial < 2000; trial++) {
+	for (int i = 0; i < 32; i++)
+	    data[i] = click_random();
+	data[0] |= 1;		// never all zero
+	uint16_t csum = click_in_cksum((const unsigned char *) data, sizeof(data));
+
+	// one halfword
+	int i = click_random(1, 31);
+	uint16_t old_hw = data[i];
+	data[i] = click_random();
+	click_update_in_cksum(&csum, old_hw, data[i]);
+	CHECK(csum == click_in_cksum((const unsigned char *) data, sizeof(data)));
+
+	// one 32-bit word at an even offset
+	i = click_random(1, 30);
+	uint32_t old_w, new_w = click_random();
+	memcpy(&old_w, &data[i], 4);
+	memcpy(&data[i], &new_w, 4);
+	click_update_in_cksum32(&csum, old_w, new_w);
+	CHECK(csum == click_in_cksum((const unsigned char *) data, sizeof(data)));
+
+	// a range, through a precomputed delta, applied twice
+	uint16_t old_range[6];
+	i = click_random(1, 26);
+	memcpy(old_range, &data[i], sizeof(old_range));
+	for (int j = 0; j < 6; j++)
+	    data[i + j] = click_random();
+	uint16_t delta = click_in_cksum_delta(old_range, &data[i], sizeof(old_range));
+	click_update_in_cksum_delta(&csum, delta);
+	CHECK(csum == click_in_cksum((const unsigned char *) data, sizeof(data)));
+	uint16_t new_range[6];
+	memcpy(new_range, &data[i], sizeof(new_range));
+	memcpy(&data[i], old_range, sizeof(old_range));
+	click_update_in_cksum_delta(&csum, click_in_cksum_delta(new_range, old_range, sizeof(old_range)));
+	CHECK(csum == click_in_cksum((const unsigned char *) data, sizeof(data)));
+    }
+    return 0;
+}
+
+void
+ChecksumTest::benchmark(const unsigned char *buf, ErrorHandler *errh)
+{
+    static const int sizes[] = { 20, 40, 64, 128, 256, 576, 1500, 4096, 9000 };
+    volatile uint16_t sink = 0;
+    errh->message("%6s %10s %10s %10s %10s %10s", "size", "default", "reference", engine_names[0], engine_names[1], engine_names[2]);
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+	int size = sizes[s];
+	uint32_t n = _bytes / size + 1;
+	StringAccum sa;
+	sa.snprintf(20, "%6d", size);
+	for (int engine = -2; engine < CLICK_IN_CKSUM_NENGINES; engine++) {
+	    if (engine >= 0 && !click_in_cksum_engine_available(engine)) {
+		sa.snprintf(20, " %10s", "-");
+		continue;
+	    }
+	    Timestamp t0 = Timestamp::now();
+	    uint16_t x = 0;
+	    for (uint32_t i = 0; i < n; i++)
+		if (engine == -2)
+		    x += click_in_cksum(buf + (i & 7), size);
+		else if (engine == -1)
+		    x += reference_cksum(buf + (i & 7), size);
+		else
+		    x += click_in_cksum_engine(engine, buf + (i & 7), size);
+	    Timestamp t1 = Timestamp::now();
+	    sink += x;
+	    sa.snprintf(20, " %10.2f", (t1 - t0).doubleval() * 1e9 / n);
+	}
+	errh->message("%s", sa.c_str());
+    }
+    (void) sink;
+}
+
+int
+ChecksumTest::initialize(ErrorHandler *errh)
+{
+    unsigned char *buf = new unsigned char[BUFSIZE];
+    for (int i = 0; i < BUFSIZE; i++)
+	buf[i] = click_random();
+
+    int r = test_engines(buf, errh);
+    if (r >= 0)
+	r = test_incremental(errh);
+    if (r >= 0 && _benchmark)
+	benchmark(buf, errh);
+    delete[] buf;
+    if (r >= 0)
+	errh->message("All tests pass!");
+    return r;
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+EXPORT_ELEMENT(ChecksumTest)
@@ -0,0 +1,65 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_CHECKSUMTEST_HH
+#define CLICK_CHECKSUMTEST_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+ChecksumTest([I<keywords>])
+
+=s test
+
+runs regression tests and benchmarks for Internet checksums
+
+=d
+
+ChecksumTest checks every checksum engine the CPU supports, and the
+incremental update helpers, against a simple word-at-a-time reference
+implementation at initialization time. It does not route packets.
+
+Keyword arguments are:
+
+=over 8
+
+=item BENCHMARK
+
+Boolean. If true, also time click_in_cksum, each available engine, and the
+reference implementation over a range of data sizes, and print the results as
+nanoseconds per checksum. Default is false.
+
+=item BYTES
+
+Unsigned. Number of bytes to checksum per benchmark measurement. Default is
+64MB.
+
+=back
+
+=a
+
+SetIPChecksum, CheckIPHeader */
+
+class ChecksumTest : public Element { public:
+
+    ChecksumTest();
+    ~ChecksumTest();
+
+    const char *class_name() const		{ return "ChecksumTest"; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+
+  private:
+
+    bool _benchmark;
+    uint32_t _bytes;
+
+    int test_engines(const unsigned char *, ErrorHandler *);
+    int test_incremental(ErrorHandler *);
+    void benchmark(const unsigned char *, ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,274 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * linktabletest.{cc,hh} -- regression test element for LinkTable
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "linktabletest.hh"
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/glue.hh>
+#include <click/hashmap.hh>
+#include <click/straccum.hh>
+#include <click/timestamp.hh>
+#include "elements/wifi/linktable.hh"
+CLICK_DECLS
+
+LinkTableTest::LinkTableTest()
+    : _lt(0), _seq(0)
+{
+}
+
+LinkTableTest::~LinkTableTest()
+{
+}
+
+int
+LinkTableTest::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    Element *e;
+    _benchmark = false;
+    _degree = 8;
+    if (cp_va_kparse(conf, this, errh,
+		     "TABLE", cpkP+cpkM, cpElement, &e,
+		     "BENCHMARK", 0, cpBool, &_benchmark,
+		     "DEGREE", 0, cpUnsigned, &_degree,
+		     cpEnd) < 0)
+	return -1;
+
+    if (!(_lt = static_cast<LinkTable *>(e->cast("LinkTable"))))
+	return errh->error("TABLE argument must be a LinkTable element");
+    return 0;
+}
+
+// Loads the table with nhosts hosts, host 0 being the table's own, and
+// nlinks distinct random links.
+void
+LinkTableTest::make_graph(int nhosts, int nlinks)
+{
+    _lt->clear();
+    _hosts.clear();
+    _links.clear();
+    _hosts.push_back(_lt->ip());
+    for (int i = 1; i < nhosts; i++)
+	_hosts.push_back(IPAddress(htonl(0x0A000000 + i)));
+
+    HashMap<IPPair, int> seen;
+    while (_links.size() < nlinks) {
+	Link l;
+	l.from = click_random(0, nhosts - 1);
+	l.to = click_random(0, nhosts - 1);
+	l.metric = click_random(1, 1000);
+	IPPair p(_hosts[l.from], _hosts[l.to]);
+	if (l.from == l.to || seen.findp(p))
+	    continue;
+	seen.insert(p, 1);
+	_links.push_back(l);
+	_lt->update_link(_hosts[l.from], _hosts[l.to], ++_seq, 0, l.metric);
+    }
+}
+
+// Changes link i's metric, unless the table rejects the update.
+bool
+LinkTableTest::change_link(int i, uint32_t metric)
+{
+    if (!_lt->update_link(_hosts[_links[i].from], _hosts[_links[i].to], ++_seq, 0, metric))
+	return false;
+    _links[i].metric = metric;
+    return true;
+}
+
+namespace {
+struct HostState {
+    uint32_t metric;
+    bool marked;
+};
+}
+
+// LinkTable's original route computation: for each host settled, probe every
+// other host for a link. Metrics are 0 for unreached hosts and the root.
+void
+LinkTableTest::reference(bool from_me, Vector<uint32_t> &metric)
+{
+    HashMap<IPAddress, HostState> hosts;
+    HashMap<IPPair, uint32_t> links;
+    HostState blank = { 0, false };
+    for (int i = 0; i < _hosts.size(); i++)
+	hosts.insert(_hosts[i], blank);
+    for (int i = 0; i < _links.size(); i++)
+	links.insert(IPPair(_hosts[_links[i].from], _hosts[_links[i].to]), _links[i].metric);
+
+    IPAddress current_ip = _hosts[0];
+    while (current_ip) {
+	HostState *current = hosts.findp(current_ip);
+	current->marked = true;
+	for (int i = 0; i < _hosts.size(); i++) {
+	    HostState *neighbor = hosts.findp(_hosts[i]);
+	    if (neighbor->marked)
+		continue;
+	    IPPair pair = (from_me ? IPPair(current_ip, _hosts[i]) : IPPair(_hosts[i], current_ip));
+	    uint32_t *m = links.findp(pair);
+	    if (!m || !*m)
+		continue;
+	    uint32_t adjusted_metric = current->metric + *m;
+	    if (!neighbor->metric || adjusted_metric < neighbor->metric)
+		neighbor->metric = adjusted_metric;
+	}
+
+	current_ip = IPAddress();
+	uint32_t min_metric = ~0;
+	for (int i = 0; i < _hosts.size(); i++) {
+	    HostState *h = hosts.findp(_hosts[i]);
+	    if (!h->marked && h->metric && h->metric < min_metric) {
+		current_ip = _hosts[i];
+		min_metric = h->metric;
+	    }
+	}
+    }
+
+    metric.clear();
+    for (int i = 0; i < _hosts.size(); i++)
+	metric.push_back(hosts.findp(_hosts[i])->metric);
+}
+
+int
+LinkTableTest::check(const char *what, ErrorHandler *errh)
+{
+    Vector<uint32_t> ref;
+    for (int from_me = 0; from_me < 2; from_me++) {
+	const char *dir = (from_me ? "from" : "to");
+	reference(from_me, ref);
+	for (int i = 0; i < _hosts.size(); i++) {
+	    IPAddress h = _hosts[i];
+	    uint32_t m = (from_me ? _lt->get_host_metric_from_me(h) : _lt->get_host_metric_to_me(h));
+	    if (m != ref[i])
+		return errh->error("%s, %d hosts: metric %s %s is %u, expected %u", what, _hosts.size(), dir, h.unparse().c_str(), m, ref[i]);
+
+	    // the route ends at h and the root, and its links add up; hosts
+	    // with no links are unknown to the table
+	    Vector<IPAddress> r = _lt->best_route(h, from_me);
+	    bool ok;
+	    if (ref[i] == 0)
+		ok = (r.size() == 0 || (r.size() == 1 && r[0] == h));
+	    else
+		ok = (r.size() >= 2
+		      && r[0] == (from_me ? _hosts[0] : h)
+		      && r.back() == (from_me ? h : _hosts[0])
+		      && _lt->get_route_metric(r) == ref[i]);
+	    if (!ok)
+		return errh->error("%s, %d hosts: bad route %s %s", what, _hosts.size(), dir, h.unparse().c_str());
+	}
+    }
+    return 0;
+}
+
+void
+LinkTableTest::benchmark(ErrorHandler *errh)
+{
+    static const int sizes[] = { 1000, 2000, 5000, 10000 };
+    errh->message("%6s %7s %10s %10s %10s", "hosts", "links", "full", "incr", "old");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+	int n = sizes[s];
+	make_graph(n, n * _degree);
+	StringAccum sa;
+	sa.snprintf(30, "%6d %7d", n, _links.size());
+
+	// full computation in both directions
+	int reps = 20;
+	Timestamp t0 = Timestamp::now();
+	for (int i = 0; i < reps; i++) {
+	    _lt->dijkstra(true);
+	    _lt->dijkstra(false);
+	}
+	Timestamp t1 = Timestamp::now();
+	sa.snprintf(20, " %10.1f", (t1 - t0).doubleval() * 1e6 / reps);
+
+	// one link's metric changes
+	int changes = 2000;
+	t0 = Timestamp::now();
+	for (int i = 0; i < changes; i++)
+	    change_link(click_random(0, _links.size() - 1), click_random(1, 1000));
+	t1 = Timestamp::now();
+	sa.snprintf(20, " %10.1f", (t1 - t0).doubleval() * 1e6 / changes);
+
+	// the original O(V^2) computation, which takes seconds beyond this
+	if (n <= 2000) {
+	    Vector<uint32_t> ref;
+	    t0 = Timestamp::now();
+	    reference(true, ref);
+	    reference(false, ref);
+	    t1 = Timestamp::now();
+	    sa.snprintf(20, " %10.1f", (t1 - t0).doubleval() * 1e6);
+	} else
+	    sa.snprintf(20, " %10s", "-");
+	errh->message("%s", sa.c_str());
+    }
+}
+
+int
+LinkTableTest::initialize(ErrorHandler *errh)
+{
+    int r = 0;
+    for (int trial = 0; trial < 8 && r >= 0; trial++) {
+	int n = 10 + trial * 20;
+	make_graph(n, n * (2 + trial % 3));
+	_lt->dijkstra(true);
+	_lt->dijkstra(false);
+	r = check("full", errh);
+
+	// links get longer and shorter, and new ones appear; metric 0 means
+	// no link and is rejected
+	for (int i = 0; i < 100 && r >= 0; i++) {
+	    int which = click_random(0, 4);
+	    int l = click_random(0, _links.size() - 1);
+	    if (which == 0)
+		change_link(l, _links[l].metric / 2 + 1);
+	    else if (which == 1)
+		change_link(l, _links[l].metric * 3);
+	    else if (which == 2)
+		change_link(l, click_random(1, 1000));
+	    else if (which == 3) {
+		if (change_link(l, 0))
+		    return errh->error("metric 0 link accepted");
+	    } else {
+		Link nl;
+		nl.from = click_random(0, n - 1);
+		nl.to = click_random(0, n - 1);
+		for (l = 0; l < _links.size(); l++)
+		    if (_links[l].from == nl.from && _links[l].to == nl.to)
+			break;
+		if (nl.from == nl.to || l < _links.size())
+		    continue;
+		nl.metric = 0;
+		_links.push_back(nl);
+		if (click_random(0, 3) == 0) {
+		    // a new link with metric 0 adds nothing
+		    if (change_link(l, 0))
+			return errh->error("metric 0 link accepted");
+		} else
+		    change_link(l, click_random(1, 1000));
+	    }
+	    r = check("incremental", errh);
+	}
+    }
+    if (r >= 0 && _benchmark)
+	benchmark(errh);
+    _lt->clear();
+    if (r >= 0)
+	errh->message("All tests pass!");
+    return r;
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel LinkTable)
+EXPORT_ELEMENT(LinkTableTest)
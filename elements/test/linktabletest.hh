@@ -0,0 +1,84 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_LINKTABLETEST_HH
+#define CLICK_LINKTABLETEST_HH
+#include <click/element.hh>
+#include <click/ipaddress.hh>
+CLICK_DECLS
+class LinkTable;
+
+/*
+=c
+
+LinkTableTest(TABLE [, I<keywords>])
+
+=s test
+
+runs regression tests and benchmarks for LinkTable's route computation
+
+=d
+
+LinkTableTest checks the shortest-path trees kept by TABLE, a LinkTable
+element, at initialization time. It loads TABLE with random graphs and compares
+TABLE's route metrics and routes, both from and to TABLE's host, with those of
+a straightforward O(V^2) Dijkstra. It then changes random links one at a time,
+which TABLE handles incrementally, and compares the results after each change.
+It clears TABLE when done and does not route packets.
+
+Keyword arguments are:
+
+=over 8
+
+=item BENCHMARK
+
+Boolean. If true, also time, on random graphs of 1000 to 10000 hosts, a full
+route computation in both directions, an incremental update after a single
+link changes, and the O(V^2) computation, and print the results in
+microseconds. Default is false.
+
+=item DEGREE
+
+Unsigned. Average number of links from each host in the benchmark graphs.
+Default is 8.
+
+=back
+
+=a
+
+LinkTable */
+
+class LinkTableTest : public Element { public:
+
+    LinkTableTest();
+    ~LinkTableTest();
+
+    const char *class_name() const		{ return "LinkTableTest"; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+
+  private:
+
+    LinkTable *_lt;
+    bool _benchmark;
+    uint32_t _degree;
+
+    struct Link {
+	int from;
+	int to;
+	uint32_t metric;
+    };
+
+    uint32_t _seq;
+    Vector<IPAddress> _hosts;
+    Vector<Link> _links;
+
+    void make_graph(int nhosts, int nlinks);
+    bool change_link(int i, uint32_t metric);
+    void reference(bool from_me, Vector<uint32_t> &metric);
+    int check(const char *what, ErrorHandler *);
+    void benchmark(ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
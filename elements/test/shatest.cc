@@ -0,0 +1,263 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * shatest.{cc,hh} -- regression test element for the IPsec SHA and HMAC code
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "shatest.hh"
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/glue.hh>
+#include <click/straccum.hh>
+#include <click/timestamp.hh>
+#include "elements/ipsec/multisha.hh"
+#include "elements/ipsec/hmac.hh"
+CLICK_DECLS
+
+#define CHECK(x) if (!(x)) return errh->error("%s:%d: test %<%s%> failed", __FILE__, __LINE__, #x);
+
+static const char * const alg_names[] = { "SHA-1", "SHA-256" };
+
+SHATest::SHATest()
+{
+}
+
+SHATest::~SHATest()
+{
+}
+
+int
+SHATest::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _benchmark = false;
+    _bytes = 16 << 20;
+    return cp_va_kparse(conf, this, errh,
+			"BENCHMARK", 0, cpBool, &_benchmark,
+			"BYTES", 0, cpUnsigned, &_bytes,
+			cpEnd);
+}
+
+static int
+unhex(const char *s, unsigned char *out)
+{
+    int n = 0;
+    for (; s[0] && s[1]; s += 2, n++) {
+	int hi = (s[0] <= '9' ? s[0] - '0' : s[0] - 'a' + 10);
+	int lo = (s[1] <= '9' ? s[1] - '0' : s[1] - 'a' + 10);
+	out[n] = hi * 16 + lo;
+    }
+    return n;
+}
+
+static void
+random_bytes(unsigned char *x, int len)
+{
+    for (int i = 0; i < len; i++)
+	x[i] = click_random();
+}
+
+static void
+hash(int alg, const unsigned char *data, int len, unsigned char *digest)
+{
+    MultiSHA::Job job;
+    MultiSHA::init(alg, job);
+    job.data = data;
+    job.len = len;
+    job.digest = digest;
+    MultiSHA::run(alg, &job, 1, 1);
+}
+
+int
+SHATest::test_hash(ErrorHandler *errh)
+{
+    // FIPS 180-2, Appendices A and B
+    static const char abc[] = "abc";
+    static const char abc448[] = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    static const struct {
+	int alg;
+	const char *message, *digest;
+    } kat[] = {
+	{ MultiSHA::SHA1, abc, "a9993e364706816aba3e25717850c26c9cd0d89d" },
+	{ MultiSHA::SHA1, abc448, "84983e441c3bd26ebaae4aa1f95129e5e54670f1" },
+	{ MultiSHA::SHA256, abc, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+	{ MultiSHA::SHA256, abc448, "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" }
+    };
+    unsigned char digest[MultiSHA::MAX_DIGEST_SIZE], expected[MultiSHA::MAX_DIGEST_SIZE];
+
+    for (size_t i = 0; i < sizeof(kat) / sizeof(kat[0]); i++) {
+	int dlen = unhex(kat[i].digest, expected);
+	CHECK(dlen == MultiSHA::digest_size(kat[i].alg));
+	hash(kat[i].alg, (const unsigned char *) kat[i].message, strlen(kat[i].message), digest);
+	if (memcmp(digest, expected, dlen) != 0)
+	    return errh->error("%s test vector %d differs", alg_names[kat[i].alg], (int) i + 1);
+    }
+
+    // lanes agree with the scalar code on messages of mixed lengths, which
+    // make lanes finish at different times
+    enum { N = 19 };
+    unsigned char *buf = new unsigned char[N * 300];
+    unsigned char out[MultiSHA::MAX_LANES + 1][N][MultiSHA::MAX_DIGEST_SIZE];
+    MultiSHA::Job jobs[N];
+    random_bytes(buf, N * 300);
+    for (int trial = 0; trial < 40; trial++)
+	for (int alg = 0; alg < 2; alg++)
+	    for (int lanes = 1; lanes <= MultiSHA::MAX_LANES; lanes *= 2) {
+		for (int i = 0; i < N; i++) {
+		    MultiSHA::init(alg, jobs[i]);
+		    jobs[i].data = buf + 300 * i;
+		    jobs[i].len = (trial < 2 ? 55 + i + 2 * trial : click_random(0, 299));
+		    jobs[i].digest = out[lanes][i];
+		}
+		MultiSHA::run(alg, jobs, N, lanes);
+		for (int i = 0; i < N; i++) {
+		    hash(alg, jobs[i].data, jobs[i].len, out[0][i]);
+		    if (memcmp(out[0][i], out[lanes][i], MultiSHA::digest_size(alg)) != 0) {
+			delete[] buf;
+			return errh->error("%s with %d lanes differs on %d bytes", alg_names[alg], lanes, jobs[i].len);
+		    }
+		}
+	    }
+    delete[] buf;
+    return 0;
+}
+
+int
+SHATest::test_hmac(ErrorHandler *errh)
+{
+    // RFC 2202 and RFC 4231, test case 2
+    static const char jefe[] = "Jefe";
+    static const char what[] = "what do ya want for nothing?";
+    static const struct {
+	int alg;
+	const char *digest;
+    } kat[] = {
+	{ MultiSHA::SHA1, "effcdf6ae5eb2fa2d27416d5f184df9c259a7c79" },
+	{ MultiSHA::SHA256, "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843" }
+    };
+    unsigned char digest[MultiSHA::MAX_DIGEST_SIZE], expected[MultiSHA::MAX_DIGEST_SIZE];
+    HMACKey key;
+
+    for (size_t i = 0; i < sizeof(kat) / sizeof(kat[0]); i++) {
+	int dlen = unhex(kat[i].digest, expected);
+	key.set_key(kat[i].alg, (const unsigned char *) jefe, strlen(jefe));
+	key.compute((const unsigned char *) what, strlen(what), digest);
+	if (memcmp(digest, expected, dlen) != 0)
+	    return errh->error("HMAC-%s test vector differs", alg_names[kat[i].alg]);
+    }
+
+    // the short-pad SHA-1 variant matches the original HMAC(), with
+    // per-message keys hashed together
+    enum { N = 13, KEY_SIZE = 16 };
+    HMACKey keys[N];
+    const HMACKey *kp[N];
+    unsigned char kbuf[N][KEY_SIZE], mbuf[N][600], out[N][MultiSHA::MAX_DIGEST_SIZE];
+    const unsigned char *data[N];
+    unsigned char *dp[N];
+    int len[N];
+    for (int trial = 0; trial < 20; trial++) {
+	for (int i = 0; i < N; i++) {
+	    random_bytes(kbuf[i], KEY_SIZE);
+	    keys[i].set_key(MultiSHA::SHA1, kbuf[i], KEY_SIZE, KEY_SIZE);
+	    kp[i] = &keys[i];
+	    len[i] = click_random(0, 599);
+	    random_bytes(mbuf[i], len[i]);
+	    data[i] = mbuf[i];
+	    dp[i] = out[i];
+	}
+	HMACKey::compute(kp, data, len, dp, N, MultiSHA::MAX_LANES);
+	for (int i = 0; i < N; i++) {
+	    unsigned dlen = 20;
+	    HMAC(kbuf[i], KEY_SIZE, mbuf[i], len[i], digest, &dlen);
+	    if (memcmp(digest, out[i], 20) != 0)
+		return errh->error("short-pad HMAC-SHA-1 differs from HMAC() on %d bytes", len[i]);
+	}
+    }
+    return 0;
+}
+
+void
+SHATest::benchmark(ErrorHandler *errh)
+{
+    static const int sizes[] = { 64, 256, 576, 1024, 1500 };
+    enum { N = 16, KEY_SIZE = 16 };
+    unsigned char kbuf[KEY_SIZE];
+    unsigned char *buf = new unsigned char[N * 1500];
+    unsigned char out[N][MultiSHA::MAX_DIGEST_SIZE];
+    random_bytes(kbuf, KEY_SIZE);
+    random_bytes(buf, N * 1500);
+    HMACKey keys[2];
+    keys[MultiSHA::SHA1].set_key(MultiSHA::SHA1, kbuf, KEY_SIZE, KEY_SIZE);
+    keys[MultiSHA::SHA256].set_key(MultiSHA::SHA256, kbuf, KEY_SIZE);
+    const HMACKey *kp[N];
+    const unsigned char *data[N];
+    unsigned char *dp[N];
+    int len[N];
+    volatile unsigned char sink = 0;
+
+    errh->message("%d lanes available", MultiSHA::lanes_available());
+    errh->message("%6s %10s %10s %10s %10s %10s %10s %10s", "size", "HMAC()",
+		  "sha1x1", "sha1x4", "sha1x8", "sha256x1", "sha256x4", "sha256x8");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+	int size = sizes[s];
+	uint32_t n = (_bytes / size + N) / N;
+	StringAccum sa;
+	sa.snprintf(20, "%6d", size);
+
+	// the original implementation, as IPsecAuthHMACSHA1 used to call it
+	Timestamp t0 = Timestamp::now();
+	for (uint32_t i = 0; i < n; i++)
+	    for (int j = 0; j < N; j++) {
+		unsigned dlen = 20;
+		HMAC(kbuf, KEY_SIZE, buf + 1500 * j, size, out[j], &dlen);
+	    }
+	Timestamp t1 = Timestamp::now();
+	sink += out[0][0];
+	sa.snprintf(20, " %10.2f", (t1 - t0).doubleval() * 1e9 / (n * N));
+
+	for (int alg = 0; alg < 2; alg++)
+	    for (int lanes = 1; lanes <= MultiSHA::MAX_LANES; lanes = (lanes == 1 ? 4 : lanes * 2)) {
+		for (int j = 0; j < N; j++) {
+		    kp[j] = &keys[alg];
+		    data[j] = buf + 1500 * j;
+		    len[j] = size;
+		    dp[j] = out[j];
+		}
+		t0 = Timestamp::now();
+		for (uint32_t i = 0; i < n; i++)
+		    HMACKey::compute(kp, data, len, dp, N, lanes);
+		t1 = Timestamp::now();
+		sink += out[0][0];
+		sa.snprintf(20, " %10.2f", (t1 - t0).doubleval() * 1e9 / (n * N));
+	    }
+	errh->message("%s", sa.c_str());
+    }
+    (void) sink;
+    delete[] buf;
+}
+
+int
+SHATest::initialize(ErrorHandler *errh)
+{
+    int r = test_hash(errh);
+    if (r >= 0)
+	r = test_hmac(errh);
+    if (r >= 0 && _benchmark)
+	benchmark(errh);
+    if (r >= 0)
+	errh->message("All tests pass!");
+    return r;
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel IPsecMultiSHA IPsecAuthHMACSHA1)
+EXPORT_ELEMENT(SHATest)
@@ -0,0 +1,67 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_SHATEST_HH
+#define CLICK_SHATEST_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+SHATest([I<keywords>])
+
+=s test
+
+runs regression tests and benchmarks for the IPsec SHA and HMAC code
+
+=d
+
+SHATest checks the multi-buffer SHA-1, SHA-256, and HMAC code used by the
+IPsec authentication elements at initialization time: published known-answer
+tests, agreement between the scalar, 4-lane, and 8-lane implementations on
+messages of random lengths, and agreement between the short-pad HMAC-SHA1
+variant and the original implementation. It does not route packets.
+
+Keyword arguments are:
+
+=over 8
+
+=item BENCHMARK
+
+Boolean. If true, also time HMAC computation over a range of packet sizes,
+for each algorithm and lane count, and print the results as nanoseconds per
+packet. Default is false.
+
+=item BYTES
+
+Unsigned. Number of bytes to process per benchmark measurement. Default is
+16MB.
+
+=back
+
+=a
+
+IPsecAuthHMACSHA1, IPsecAuthHMACSHA256, AESTest */
+
+class SHATest : public Element { public:
+
+    SHATest();
+    ~SHATest();
+
+    const char *class_name() const		{ return "SHATest"; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+
+  private:
+
+    bool _benchmark;
+    uint32_t _bytes;
+
+    int test_hash(ErrorHandler *);
+    int test_hmac(ErrorHandler *);
+    void benchmark(ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
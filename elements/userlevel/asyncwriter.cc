@@ -0,0 +1,424 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * asyncwriter.{cc,hh} -- writes records to a file from a helper thread
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "asyncwriter.hh"
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/element.hh>
+#include <click/master.hh>
+#include <click/routerthread.hh>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+CLICK_DECLS
+
+AsyncWriter::AsyncWriter()
+    : _enabled(false), _direct(false), _fd(-1), _bufsize(262144),
+      _nbuffers(8), _buffers(0), _slots(0), _nslots(0), _master(0),
+      _free(0), _full(0), _full_tail(0), _busy(false), _sleeping(false),
+      _stop(false), _stage(0), _stage_len(0), _error(0)
+#if HAVE_MULTITHREAD
+    , _threaded(false)
+#endif
+{
+    _wake[0] = _wake[1] = -1;
+}
+
+int
+AsyncWriter::configure_keywords(Vector<String> &conf, Element *e, ErrorHandler *errh)
+{
+    bool async = _enabled, direct = _direct;
+    uint32_t bufsize = _bufsize, nbuffers = _nbuffers;
+    if (cp_va_kparse_remove_keywords(conf, e, errh,
+		    "ASYNC", 0, cpBool, &async,
+		    "ASYNC_BUFFER", 0, cpUnsigned, &bufsize,
+		    "ASYNC_NBUFFERS", 0, cpUnsigned, &nbuffers,
+		    "DIRECT", 0, cpBool, &direct,
+		    cpEnd) < 0)
+	return -1;
+    if (bufsize < ALIGN || bufsize > 0x10000000)
+	return errh->error("ASYNC_BUFFER must be between %d and 2^28", ALIGN);
+    if (nbuffers < 2 || nbuffers > 4096)
+	return errh->error("ASYNC_NBUFFERS must be between 2 and 4096");
+    if (direct && !async)
+	return errh->error("DIRECT requires ASYNC");
+#if !HAVE_MULTITHREAD
+    // without a writer thread, the forwarding path would do the writes
+    if (async)
+	return errh->error("ASYNC requires a multithreaded Click");
+#endif
+    _enabled = async;
+    _direct = direct;
+    _bufsize = (bufsize + ALIGN - 1) & ~(ALIGN - 1);
+    _nbuffers = nbuffers;
+    return 0;
+}
+
+static char *
+aligned_alloc_buffer(size_t size)
+{
+    void *p;
+    if (posix_memalign(&p, 4096, size) != 0)
+	return 0;
+    return reinterpret_cast<char *>(p);
+}
+
+int
+AsyncWriter::initialize(FILE *f, Element *e, ErrorHandler *errh)
+{
+    if (!_enabled)
+	return 0;
+    // everything after this goes through the writer, not stdio
+    fflush(f);
+    _fd = fileno(f);
+
+    _master = e->master();
+    _nslots = (_master->nthreads() > 0 ? _master->nthreads() : 1);
+    if (!(_slots = new Slot[_nslots])
+	|| !(_buffers = new Buffer[_nbuffers]()))
+	return errh->error(strerror(ENOMEM));
+    for (int i = 0; i < _nslots; i++) {
+	_slots[i].buf = 0;
+	_slots[i].drops = 0;
+    }
+    for (int i = _nbuffers - 1; i >= 0; i--) {
+	if (!(_buffers[i].data = aligned_alloc_buffer(_bufsize)))
+	    return errh->error(strerror(ENOMEM));
+	_buffers[i].len = 0;
+	_buffers[i].next = _free;
+	_free = &_buffers[i];
+    }
+
+    if (_direct) {
+	// O_DIRECT needs aligned offsets, so only start it at offset 0
+#ifdef O_DIRECT
+	struct stat st;
+	int flags;
+	if (fstat(_fd, &st) >= 0 && S_ISREG(st.st_mode)
+	    && lseek(_fd, 0, SEEK_CUR) == 0
+	    && (flags = fcntl(_fd, F_GETFL)) >= 0
+	    && fcntl(_fd, F_SETFL, flags | O_DIRECT) >= 0
+	    && (_stage = aligned_alloc_buffer(_bufsize)))
+	    /* OK */;
+	else
+#endif
+	{
+	    errh->warning("cannot use DIRECT on this file, continuing without it");
+	    _direct = false;
+	}
+    }
+
+#if HAVE_MULTITHREAD
+    // the writer sleeps reading _wake[0]; writes to _wake[1] never block
+    if (pipe(_wake) < 0) {
+	_wake[0] = _wake[1] = -1;
+	return errh->error("pipe: %s", strerror(errno));
+    }
+    fcntl(_wake[1], F_SETFL, O_NONBLOCK);
+    pthread_mutex_init(&_lock, 0);
+    pthread_cond_init(&_cond, 0);
+    int err = pthread_create(&_thread, 0, thread_main, this);
+    if (err != 0) {
+	pthread_cond_destroy(&_cond);
+	pthread_mutex_destroy(&_lock);
+	return errh->error("cannot start writer thread: %s", strerror(err));
+    }
+    _threaded = true;
+#endif
+    return 0;
+}
+
+void
+AsyncWriter::cleanup()
+{
+    if (!_slots)
+	return;
+#if HAVE_MULTITHREAD
+    if (_threaded) {
+	flush();
+	_list_lock.acquire();
+	_stop = true;
+	_list_lock.release();
+	wake_writer();
+	pthread_join(_thread, 0);
+	pthread_cond_destroy(&_cond);
+	pthread_mutex_destroy(&_lock);
+	_threaded = false;
+    }
+#endif
+    for (int i = 0; i < 2; i++)
+	if (_wake[i] >= 0) {
+	    close(_wake[i]);
+	    _wake[i] = -1;
+	}
+    if (_stage) {
+	// the tail is not a whole block, so write it without O_DIRECT
+#ifdef O_DIRECT
+	int flags = fcntl(_fd, F_GETFL);
+	if (flags >= 0)
+	    (void) fcntl(_fd, F_SETFL, flags & ~O_DIRECT);
+#endif
+	write_all(_stage, _stage_len);
+	free(_stage);
+	_stage = 0;
+    }
+    for (int i = 0; i < _nbuffers && _buffers; i++)
+	free(_buffers[i].data);
+    delete[] _buffers;
+    delete[] _slots;
+    _buffers = 0;
+    _slots = 0;
+    _nslots = 0;
+    _free = _full = _full_tail = 0;
+    _busy = _sleeping = _stop = false;
+}
+
+inline AsyncWriter::Slot &
+AsyncWriter::current_slot()
+{
+    // handlers and other non-driver threads share thread 0's slot
+    for (int i = 1; i < _nslots; i++)
+	if (_master->thread(i)->current_thread_is_running())
+	    return _slots[i];
+    return _slots[0];
+}
+
+AsyncWriter::Buffer *
+AsyncWriter::take_free()
+{
+    if (!_free)			// don't bother locking
+	return 0;
+    _list_lock.acquire();
+    Buffer *b = _free;
+    if (b)
+	_free = b->next;
+    _list_lock.release();
+    return b;
+}
+
+void
+AsyncWriter::wake_writer()
+{
+    // Called after changing the writer's work.  Only a sleeping writer needs
+    // a byte, and it consumes exactly one, so the pipe never fills.
+    _list_lock.acquire();
+    bool wake = _sleeping;
+    _sleeping = false;
+    _list_lock.release();
+    if (wake) {
+	char c = 0;
+	(void) ::write(_wake[1], &c, 1);
+    }
+}
+
+void
+AsyncWriter::hand_off(Buffer *b)
+{
+    b->next = 0;
+    _list_lock.acquire();
+    if (_full_tail)
+	_full_tail->next = b;
+    else
+	_full = b;
+    _full_tail = b;
+    _list_lock.release();
+    wake_writer();
+}
+
+bool
+AsyncWriter::pending()
+{
+    _list_lock.acquire();
+    bool p = (_full || _busy);
+    _list_lock.release();
+    return p;
+}
+
+bool
+AsyncWriter::write(const void *hdr, uint32_t hlen, const void *data, uint32_t dlen)
+{
+    uint32_t len = hlen + dlen;
+    Slot &s = current_slot();
+    s.lock.acquire();
+    Buffer *b = s.buf;
+    if (b && b->len + len > _bufsize) {
+	hand_off(b);
+	b = s.buf = 0;
+    }
+    if (!b && len <= _bufsize)
+	b = s.buf = take_free();
+    if (!b || len > _bufsize) {
+	s.drops++;
+	s.lock.release();
+	return false;
+    }
+    memcpy(b->data + b->len, hdr, hlen);
+    if (dlen)
+	memcpy(b->data + b->len + hlen, data, dlen);
+    b->len += len;
+    s.lock.release();
+    return true;
+}
+
+void
+AsyncWriter::flush()
+{
+#if HAVE_MULTITHREAD
+    if (!_threaded)
+	return;
+    for (int i = 0; i < _nslots; i++) {
+	Slot &s = _slots[i];
+	s.lock.acquire();
+	if (s.buf && s.buf->len) {
+	    hand_off(s.buf);
+	    s.buf = 0;
+	}
+	s.lock.release();
+    }
+    // the writer changes pending() before it takes _lock to signal
+    pthread_mutex_lock(&_lock);
+    while (pending())
+	pthread_cond_wait(&_cond, &_lock);
+    pthread_mutex_unlock(&_lock);
+#endif
+}
+
+AsyncWriter::counter_t
+AsyncWriter::drops() const
+{
+    counter_t d = 0;
+    for (int i = 0; i < _nslots; i++)
+	d += _slots[i].drops;
+    return d;
+}
+
+void
+AsyncWriter::write_all(const char *data, uint32_t len)
+{
+    while (len > 0 && !_error) {
+	ssize_t w = ::write(_fd, data, len);
+	if (w > 0) {
+	    data += w;
+	    len -= w;
+	} else if (w < 0 && errno == EINTR)
+	    /* try again */;
+#ifdef O_DIRECT
+	else if (w < 0 && errno == EINVAL && _stage) {
+	    // the file system refused O_DIRECT; carry on without it
+	    int flags = fcntl(_fd, F_GETFL);
+	    if (flags < 0 || !(flags & O_DIRECT)
+		|| fcntl(_fd, F_SETFL, flags & ~O_DIRECT) < 0)
+		_error = EINVAL;
+	}
+#endif
+	else
+	    _error = (w < 0 ? errno : EIO);
+    }
+}
+
+void
+AsyncWriter::write_buffer(const Buffer *b)
+{
+    if (!_stage) {
+	write_all(b->data, b->len);
+	return;
+    }
+    const char *data = b->data;
+    uint32_t len = b->len;
+    while (len > 0) {
+	uint32_t n = _bufsize - _stage_len;
+	if (n > len)
+	    n = len;
+	memcpy(_stage + _stage_len, data, n);
+	_stage_len += n;
+	data += n;
+	len -= n;
+	if (_stage_len == _bufsize) {
+	    write_all(_stage, _bufsize);
+	    _stage_len = 0;
+	}
+    }
+}
+
+#if HAVE_MULTITHREAD
+void *
+AsyncWriter::thread_main(void *thunk)
+{
+    static_cast<AsyncWriter *>(thunk)->run();
+    return 0;
+}
+
+void
+AsyncWriter::run()
+{
+    _list_lock.acquire();
+    while (1) {
+	Buffer *b = _full;
+	if (!b && _stop)
+	    break;
+	else if (!b) {
+	    _sleeping = true;
+	    _list_lock.release();
+	    char c;
+	    while (read(_wake[0], &c, 1) < 0 && errno == EINTR)
+		/* try again */;
+	    _list_lock.acquire();
+	    continue;
+	}
+	if (!(_full = b->next))
+	    _full_tail = 0;
+	_busy = true;
+	_list_lock.release();
+
+	write_buffer(b);
+
+	_list_lock.acquire();
+	b->len = 0;
+	b->next = _free;
+	_free = b;
+	_busy = false;
+	_list_lock.release();
+
+	pthread_mutex_lock(&_lock);
+	pthread_cond_broadcast(&_cond);
+	pthread_mutex_unlock(&_lock);
+	_list_lock.acquire();
+    }
+    _list_lock.release();
+}
+#endif
+
+String
+AsyncWriter::read_handler(Element *e, void *thunk)
+{
+    const AsyncWriter *aw = reinterpret_cast<const AsyncWriter *>((const uint8_t *)e + (intptr_t)thunk);
+    return String(aw->drops());
+}
+
+void
+AsyncWriter::add_handlers(Element *e) const
+{
+    if (_enabled) {
+	intptr_t offset = (const uint8_t *)this - (const uint8_t *)e;
+	e->add_read_handler("drops", read_handler, (void *)offset);
+    }
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel|ns)
+ELEMENT_PROVIDES(AsyncWriter)
@@ -0,0 +1,117 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_ASYNCWRITER_HH
+#define CLICK_ASYNCWRITER_HH
+#include <click/string.hh>
+#include <click/vector.hh>
+#include <click/sync.hh>
+#include <stdio.h>
+#if HAVE_MULTITHREAD
+# include <pthread.h>
+#endif
+CLICK_DECLS
+class ErrorHandler;
+class Element;
+class Master;
+
+/*
+ * AsyncWriter takes the file writes off an element's forwarding path.
+ * Records are appended to per-router-thread buffers; full buffers are handed
+ * to a writer thread, which writes them with large, optionally O_DIRECT,
+ * writes.  The forwarding path never waits for the writer: it takes only
+ * spinlocks held for a few instructions, and if the writer falls behind and
+ * no buffer is free, records are dropped and counted.  Each record lands in
+ * a single buffer, so records from different threads never interleave.
+ * ASYNC requires a multithreaded Click.
+ */
+
+class AsyncWriter { public:
+
+    AsyncWriter();
+    ~AsyncWriter()			{ cleanup(); }
+
+    bool enabled() const		{ return _enabled; }
+    int error() const			{ return _error; }
+
+    int configure_keywords(Vector<String> &conf, Element *, ErrorHandler *);
+    int initialize(FILE *f, Element *, ErrorHandler *);
+    void add_handlers(Element *) const;
+    void cleanup();
+
+    bool write(const void *data, uint32_t len) {
+	return write(data, len, 0, 0);
+    }
+    bool write(const void *hdr, uint32_t hlen, const void *data, uint32_t dlen);
+    void flush();
+
+#if HAVE_INT64_TYPES
+    typedef uint64_t counter_t;
+#else
+    typedef uint32_t counter_t;
+#endif
+    counter_t drops() const;
+
+  private:
+
+    enum { ALIGN = 4096 };
+
+    struct Buffer {
+	char *data;
+	uint32_t len;
+	Buffer *next;
+    };
+
+    struct Slot {
+	Spinlock lock;
+	Buffer *buf;
+	counter_t drops;
+    };
+
+    bool _enabled;
+    bool _direct;
+    int _fd;
+    uint32_t _bufsize;
+    int _nbuffers;
+
+    Buffer *_buffers;
+    Slot *_slots;		// one per router thread
+    int _nslots;
+    Master *_master;
+
+    // _list_lock protects the buffer lists and the writer's state
+    Spinlock _list_lock;
+    Buffer * volatile _free;
+    Buffer *_full;
+    Buffer *_full_tail;
+    bool _busy;
+    bool _sleeping;		// writer waits for a byte on _wake[0]
+    bool _stop;
+    int _wake[2];
+
+    char *_stage;		// O_DIRECT: collects whole aligned blocks
+    uint32_t _stage_len;
+    volatile int _error;
+
+#if HAVE_MULTITHREAD
+    bool _threaded;
+    pthread_t _thread;
+    pthread_mutex_t _lock;	// flush() waits on _cond for the writer
+    pthread_cond_t _cond;
+
+    static void *thread_main(void *);
+    void run();
+#endif
+
+    inline Slot &current_slot();
+    Buffer *take_free();
+    void hand_off(Buffer *);
+    void wake_writer();
+    bool pending();
+    void write_buffer(const Buffer *);
+    void write_all(const char *data, uint32_t len);
+
+    static String read_handler(Element *, void *);
+
+};
+
+CLICK_ENDDECLS
+#endif
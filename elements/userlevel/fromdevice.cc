@@ -41,7 +41,10 @@
 # include <sys/socket.h>
 # include <net/if.h>
 # include <features.h>
-# if __GLIBC__ >= 2 && __GLIBC_MINOR__ >= 1
+# if HAVE_LINUX_IF_PACKET_H
+#  include <linux/if_packet.h>
+#  include <net/ethernet.h>
+# elif __GLIBC__ >= 2 && __GLIBC_MINOR__ >= 1
 #  include <netpacket/packet.h>
 #  include <net/ethernet.h>
 # else
@@ -49,6 +52,12 @@
 #  include <linux/if_packet.h>
 #  include <linux/if_ether.h>
 # endif
+# if HAVE_LINUX_IF_PACKET_H && HAVE_MMAP && defined(TP_STATUS_BLK_TMO)
+#  define FROMDEVICE_LINUX_MMAP 1
+#  include <sys/mman.h>
+#  include <click/sync.hh>
+#  include <click/atomic.hh>
+# endif
 #endif
 
 CLICK_DECLS
@@ -56,7 +65,7 @@ CLICK_DECLS
 FromDevice::FromDevice()
     :
 #if FROMDEVICE_LINUX
-      _linux_fd(-1),
+      _linux_fd(-1), _ring(0), _ring_drops(0),
 #endif
 #if FROMDEVICE_PCAP
       _pcap(0), _pcap_task(this), _pcap_complaints(0),
@@ -78,6 +87,10 @@ FromDevice::configure(Vector<String> &conf, ErrorHandler *errh)
     _headroom += (4 - (_headroom + 2) % 4) % 4; // default 4/2 alignment
     _force_ip = false;
     String bpf_filter, capture;
+#if FROMDEVICE_LINUX
+    _ring_blocks = 64;
+    _ring_block_size = 262144;
+#endif
     if (cp_va_kparse(conf, this, errh,
 		     "DEVNAME", cpkP+cpkM, cpString, &_ifname,
 		     "PROMISC", cpkP, cpBool, &promisc,
@@ -88,12 +101,23 @@ FromDevice::configure(Vector<String> &conf, ErrorHandler *errh)
 		     "BPF_FILTER", 0, cpString, &bpf_filter,
 		     "OUTBOUND", 0, cpBool, &outbound,
 		     "HEADROOM", 0, cpUnsigned, &_headroom,
+#if FROMDEVICE_LINUX
+		     "RING_BLOCKS", 0, cpUnsigned, &_ring_blocks,
+		     "RING_BLOCK_SIZE", 0, cpUnsigned, &_ring_block_size,
+#endif
 		     cpEnd) < 0)
 	return -1;
     if (_snaplen > 8190 || _snaplen < 14)
 	return errh->error("SNAPLEN out of range");
     if (_headroom > 8190)
 	return errh->error("HEADROOM out of range");
+#if FROMDEVICE_LINUX
+    if (_ring_blocks < 1)
+	return errh->error("RING_BLOCKS out of range");
+    if ((_ring_block_size & (_ring_block_size - 1)) != 0
+	|| _ring_block_size % getpagesize() != 0)
+	return errh->error("RING_BLOCK_SIZE must be a power of two and a multiple of the page size");
+#endif
 
 #if FROMDEVICE_PCAP
     _bpf_filter = bpf_filter;
@@ -115,6 +139,10 @@ FromDevice::configure(Vector<String> &conf, ErrorHandler *errh)
     else if (capture == "LINUX")
 	_capture = CAPTURE_LINUX;
 #endif
+#if FROMDEVICE_LINUX_MMAP
+    else if (capture == "MMAP")
+	_capture = CAPTURE_MMAP;
+#endif
 #if FROMDEVICE_PCAP
     else if (capture == "PCAP")
 	_capture = CAPTURE_PCAP;
@@ -203,6 +231,164 @@ FromDevice::set_promiscuous(int fd, String ifname, bool promisc)
 }
 #endif /* FROMDEVICE_LINUX */
 
+#if FROMDEVICE_LINUX_MMAP
+/* An MmapRing describes a TPACKET_V3 receive ring.  Each packet emitted
+   from the ring holds a reference to its block, and the block returns to
+   the kernel when the last reference is dropped.  Packets may outlive their
+   FromDevice, so the ring is reference counted too: it is unmapped only
+   once the element is gone and no block is outstanding.
+
+   A packet's buffer starts RING_STASH bytes into its frame's tpacket3_hdr,
+   whose first bytes, already read, hold a pointer to the ring.  The data
+   destructor reads that pointer back from just before the buffer, so it
+   needs no lookup or lock, and pushing headers onto the packet can't
+   overwrite it. */
+struct FromDevice::MmapRing {
+    unsigned char *base;
+    size_t size;
+    unsigned block_size;
+    unsigned nblocks;
+    unsigned next_block;
+    atomic_uint32_t *refs;	// per-block packet references
+    atomic_uint32_t users;	// 1 for the element + 1 per outstanding block
+
+    tpacket_block_desc *block(unsigned b) const {
+	return reinterpret_cast<tpacket_block_desc *>(base + b * block_size);
+    }
+    void unref_block(unsigned b);
+    void unuse();
+};
+
+enum { RING_STASH = 8 };
+
+void
+FromDevice::MmapRing::unref_block(unsigned b)
+{
+    if (refs[b].dec_and_test()) {
+	// make sure all our reads and writes of the block are done before
+	// handing it back
+	__sync_synchronize();
+	block(b)->hdr.bh1.block_status = TP_STATUS_KERNEL;
+	unuse();
+    }
+}
+
+void
+FromDevice::MmapRing::unuse()
+{
+    if (users.dec_and_test()) {
+	munmap(base, size);
+	delete[] refs;
+	delete this;
+    }
+}
+
+void
+FromDevice::ring_packet_destructor(unsigned char *head, size_t)
+{
+    MmapRing *r;
+    memcpy(&r, head - RING_STASH, sizeof(r));
+    r->unref_block((head - r->base) / r->block_size);
+}
+
+int
+FromDevice::open_ring(ErrorHandler *errh)
+{
+    static_assert(sizeof(MmapRing *) <= RING_STASH);
+    int version = TPACKET_V3;
+    if (setsockopt(_linux_fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0)
+	return errh->error("%s: PACKET_VERSION: %s", _ifname.c_str(), strerror(errno));
+
+    // With TPACKET_V3, frames are packed into blocks at variable offsets;
+    // the frame size is used only for the kernel's sanity checks.
+    struct tpacket_req3 req;
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = _ring_block_size;
+    req.tp_block_nr = _ring_blocks;
+    req.tp_frame_size = 2048;
+    req.tp_frame_nr = (_ring_block_size / req.tp_frame_size) * _ring_blocks;
+    if (setsockopt(_linux_fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0)
+	return errh->error("%s: PACKET_RX_RING: %s", _ifname.c_str(), strerror(errno));
+
+    size_t size = (size_t) _ring_block_size * _ring_blocks;
+    void *base = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, _linux_fd, 0);
+    if (base == MAP_FAILED)
+	return errh->error("%s: mmap: %s", _ifname.c_str(), strerror(errno));
+
+    MmapRing *r = new MmapRing;
+    r->base = reinterpret_cast<unsigned char *>(base);
+    r->size = size;
+    r->block_size = _ring_block_size;
+    r->nblocks = _ring_blocks;
+    r->next_block = 0;
+    r->refs = new atomic_uint32_t[_ring_blocks];
+    for (unsigned b = 0; b < _ring_blocks; ++b)
+	r->refs[b] = 0;
+    r->users = 1;
+    _ring = r;
+    return 0;
+}
+
+void
+FromDevice::selected_ring()
+{
+    MmapRing *r = _ring;
+    unsigned b = r->next_block;
+    tpacket_block_desc *desc = r->block(b);
+    // A block stays TP_STATUS_USER until its last packet is freed, so one
+    // whose packets from the last trip around the ring are still alive
+    // looks ready too; wait until unref_block() hands it back.
+    if (r->refs[b].value() != 0
+	|| !(*reinterpret_cast<volatile uint32_t *>(&desc->hdr.bh1.block_status) & TP_STATUS_USER))
+	return;
+    // read the block's contents only after seeing its status
+    __sync_synchronize();
+    r->next_block = (b + 1 == r->nblocks ? 0 : b + 1);
+    ++r->users;
+    r->refs[b] = 1;		// released after the loop
+
+    PacketBatch batch;
+    unsigned char *hp = reinterpret_cast<unsigned char *>(desc) + desc->hdr.bh1.offset_to_first_pkt;
+    for (unsigned i = desc->hdr.bh1.num_pkts; i > 0; --i) {
+	tpacket3_hdr *h = reinterpret_cast<tpacket3_hdr *>(hp);
+	sockaddr_ll *sa = reinterpret_cast<sockaddr_ll *>(hp + TPACKET_ALIGN(sizeof(tpacket3_hdr)));
+	hp += h->tp_next_offset;
+	if (sa->sll_pkttype == PACKET_OUTGOING && !_outbound)
+	    continue;
+
+	uint32_t len = h->tp_snaplen;
+	if (len > (uint32_t) _snaplen)
+	    len = _snaplen;
+	Timestamp ts = Timestamp::make_nsec(h->tp_sec, h->tp_nsec);
+	uint32_t extra = h->tp_len - len;
+	unsigned mac = h->tp_mac;
+	Packet::PacketType ptype = (Packet::PacketType) sa->sll_pkttype;
+
+	unsigned char *frame = reinterpret_cast<unsigned char *>(h);
+	memcpy(frame, &r, sizeof(r));
+	++r->refs[b];
+	WritablePacket *p = Packet::make(frame + RING_STASH, mac - RING_STASH + len, ring_packet_destructor);
+	if (!p) {
+	    --r->refs[b];
+	    continue;
+	}
+	p->pull(mac - RING_STASH);
+	p->set_packet_type_anno(ptype);
+	p->timestamp_anno() = ts;
+	p->set_mac_header(p->data());
+	SET_EXTRA_LENGTH_ANNO(p, extra);
+	_count++;
+	if (!_force_ip || fake_pcap_force_ip(p, _datalink))
+	    batch.push_back(p);
+	else
+	    checked_output_push(1, p);
+    }
+
+    r->unref_block(b);
+    output(0).push_batch(batch);
+}
+#endif /* FROMDEVICE_LINUX_MMAP */
+
 int
 FromDevice::initialize(ErrorHandler *errh)
 {
@@ -278,7 +464,7 @@ FromDevice::initialize(ErrorHandler *errh)
 #endif
 
 #if FROMDEVICE_LINUX
-    if (_capture == CAPTURE_LINUX) {
+    if (_capture == CAPTURE_LINUX || _capture == CAPTURE_MMAP) {
 	_linux_fd = open_packet_socket(_ifname, errh);
 	if (_linux_fd < 0)
 	    return -1;
@@ -291,6 +477,11 @@ FromDevice::initialize(ErrorHandler *errh)
 	} else
 	    _was_promisc = promisc_ok;
 
+# if FROMDEVICE_LINUX_MMAP
+	if (_capture == CAPTURE_MMAP && open_ring(errh) < 0)
+	    return -1;
+# endif
+
 	add_select(_linux_fd, SELECT_READ);
 
 	_datalink = FAKE_DLT_EN10MB;
@@ -309,6 +500,12 @@ FromDevice::cleanup(CleanupStage stage)
 {
     if (stage >= CLEANUP_INITIALIZED && !_sniffer)
 	KernelFilter::device_filter(_ifname, false, ErrorHandler::default_handler());
+#if FROMDEVICE_LINUX_MMAP
+    if (_ring) {
+	_ring->unuse();
+	_ring = 0;
+    }
+#endif
 #if FROMDEVICE_LINUX
     if (_linux_fd >= 0) {
 	if (_was_promisc >= 0)
@@ -374,6 +571,10 @@ FromDevice::selected(int)
 	    ErrorHandler::default_handler()->error("%{element}: %s", this, pcap_geterr(_pcap));
     }
 #endif
+#if FROMDEVICE_LINUX_MMAP
+    if (_capture == CAPTURE_MMAP)
+	selected_ring();
+#endif
 #if FROMDEVICE_LINUX
     if (_capture == CAPTURE_LINUX) {
 	struct sockaddr_ll sa;
@@ -424,6 +625,17 @@ FromDevice::kernel_drops(bool& known, int& max_drops) const
     // but for now, we just give up.
 #endif
     known = false, max_drops = -1;
+#if FROMDEVICE_LINUX_MMAP
+    if (_capture == CAPTURE_MMAP && _linux_fd >= 0) {
+	// reading the statistics resets them, so accumulate
+	struct tpacket_stats_v3 stats;
+	socklen_t len = sizeof(stats);
+	if (getsockopt(_linux_fd, SOL_PACKET, PACKET_STATISTICS, &stats, &len) >= 0) {
+	    _ring_drops += stats.tp_drops;
+	    known = true, max_drops = _ring_drops;
+	}
+    }
+#endif
 #if FROMDEVICE_PCAP
     if (_capture == CAPTURE_PCAP) {
 	struct pcap_stat stats;
@@ -24,7 +24,7 @@ CLICK_DECLS
 
 =c
 
-FromDevice(DEVNAME [, I<keywords> SNIFFER, PROMISC, SNAPLEN, FORCE_IP, CAPTURE, BPF_FILTER, OUTBOUND, HEADROOM])
+FromDevice(DEVNAME [, I<keywords> SNIFFER, PROMISC, SNAPLEN, FORCE_IP, CAPTURE, BPF_FILTER, OUTBOUND, HEADROOM, RING_BLOCKS, RING_BLOCK_SIZE])
 
 =s netdevices
 
@@ -82,9 +82,18 @@ but the IP header annotation has been set appropriately.) Default is false.
 =item CAPTURE
 
 Word.  Defines the capture method FromDevice will use to read packets from the
-kernel.  Linux targets generally support PCAP and LINUX; other targets support
-only PCAP.  Defaults to LINUX on Linux targets (unless you give a BPF_FILTER),
-and PCAP elsewhere.
+kernel.  Linux targets generally support PCAP, LINUX, and MMAP; other targets
+support only PCAP.  Defaults to LINUX on Linux targets (unless you give a
+BPF_FILTER), and PCAP elsewhere.
+
+The MMAP method maps a TPACKET_V3 receive ring shared with the kernel and
+emits packets whose data points directly into the ring, without copying.
+Each selected() call drains one ring block.  A block returns to the kernel
+only once every packet taken from it has been killed, so packets that wait
+in long queues reduce the ring's capacity; the kernel drops packets (see
+"kernel_drops") when no block is free.  An MMAP packet's headroom is the
+rest of its ring frame's header, about 70 bytes on Ethernet; elements that
+push more than that will copy the data.  HEADROOM is ignored.
 
 =item BPF_FILTER
 
@@ -103,6 +112,15 @@ false.
 Integer. Amount of bytes of headroom to leave before the packet data. Defaults
 to roughly 28.
 
+=item RING_BLOCKS
+
+Unsigned.  Number of blocks in the MMAP receive ring.  Defaults to 64.
+
+=item RING_BLOCK_SIZE
+
+Unsigned.  Size of each MMAP ring block in bytes.  Must be a power of two
+that is a multiple of the page size.  Defaults to 262144.
+
 =back
 
 =e
@@ -170,6 +188,14 @@ class FromDevice : public Element { public:
 #if FROMDEVICE_LINUX
     int _linux_fd;
     unsigned char *_linux_packetbuf;
+    struct MmapRing;
+    MmapRing *_ring;
+    unsigned _ring_blocks;
+    unsigned _ring_block_size;
+    mutable uint32_t _ring_drops;
+    int open_ring(ErrorHandler *);
+    void selected_ring();
+    static void ring_packet_destructor(unsigned char *, size_t);
 #endif
 #if FROMDEVICE_PCAP
     pcap_t* _pcap;
@@ -195,7 +221,7 @@ class FromDevice : public Element { public:
     int _was_promisc : 2;
     int _snaplen;
     unsigned _headroom;
-    enum { CAPTURE_PCAP, CAPTURE_LINUX };
+    enum { CAPTURE_PCAP, CAPTURE_LINUX, CAPTURE_MMAP };
     int _capture;
 #if FROMDEVICE_PCAP
     String _bpf_filter;
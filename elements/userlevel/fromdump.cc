@@ -141,6 +141,8 @@ FromDump::configure(Vector<String> &conf, ErrorHandler *errh)
 
     if (stop && _end_h)
 	return errh->error("'END_CALL' and 'STOP' are mutually exclusive");
+    else if (_ff.partitioned() && _packet_filepos != 0)
+	return errh->error("'PARTITION' and 'FILEPOS' are mutually exclusive");
     else if (stop)
 	_end_h = new HandlerCall(name() + ".stop");
     else if (_have_last_time && !_end_h)
@@ -205,8 +207,10 @@ FromDump::initialize(ErrorHandler *errh)
     // check handler call, initialize Task
     if (_end_h && _end_h->initialize_write(this, errh) < 0)
 	return -1;
-    if (output_is_push(0))
+    if (output_is_push(0)) {
 	ScheduleInfo::initialize_task(this, &_task, _active, errh);
+	_nonfull_signal = Notifier::downstream_full_signal(this, 0, &_task);
+    }
     _timer.initialize(this);
 
     // skip if hotswapping
@@ -238,6 +242,7 @@ FromDump::initialize(ErrorHandler *errh)
     if (fh->version_major != FAKE_PCAP_VERSION_MAJOR)
 	return _ff.error(errh, "unknown major version %d", fh->version_major);
     _minor_version = fh->version_minor;
+    _snaplen = fh->snaplen;
     // map possible host link types to global link types
     _linktype = fake_pcap_canonical_dlt(fh->linktype, true);
 
@@ -249,8 +254,10 @@ FromDump::initialize(ErrorHandler *errh)
 	// force FORCE_IP.
 	_force_ip = true;
 
-    // maybe skip ahead in the file
-    if (_packet_filepos != 0) {
+    // maybe read only part of the file, or skip ahead in it
+    if (_ff.partitioned())
+	return _ff.set_partition_range(_ff.file_pos(), resync_partition, this, errh);
+    else if (_packet_filepos != 0) {
 	int result = _ff.seek(_packet_filepos, errh);
 	_packet_filepos = 0;
 	return result;
@@ -271,6 +278,7 @@ FromDump::take_state(Element *e, ErrorHandler *errh)
     _swapped = o->_swapped;
     _extra_pkthdr_crap = o->_extra_pkthdr_crap;
     _minor_version = o->_minor_version;
+    _snaplen = o->_snaplen;
 
     _linktype = o->_linktype;
     if (_linktype == FAKE_DLT_RAW)
@@ -317,6 +325,71 @@ FromDump::prepare_times(const Timestamp &ts)
     _have_any_times = true;
 }
 
+bool
+FromDump::plausible_header(const uint8_t *data, uint32_t *caplen_ptr, int32_t *sec_ptr) const
+{
+    fake_pcap_pkthdr ph;
+    memcpy(&ph, data, sizeof(ph));
+    if (_swapped) {
+	fake_pcap_pkthdr swapped_ph = ph;
+	swap_packet_header(&swapped_ph, &ph);
+    }
+    uint32_t len = ph.len, caplen = ph.caplen;
+    if (_minor_version < 3 || (_minor_version == 3 && caplen > len))
+	len = ph.caplen, caplen = ph.len;
+    if ((uint32_t) ph.ts.tv.tv_usec >= 1000000 || caplen > 65535
+	|| caplen > len + 1 || (_snaplen && caplen > _snaplen))
+	return false;
+    *caplen_ptr = caplen;
+    *sec_ptr = ph.ts.tv.tv_sec;
+    return true;
+}
+
+int
+FromDump::resync_partition(FromFile &ff, void *thunk, ErrorHandler *errh)
+{
+    // Find the first packet header at or after the current position.  A
+    // candidate offset is accepted if it starts a chain of RESYNC_CHAIN
+    // plausible headers with nearby timestamps, or a shorter chain that
+    // ends exactly at the end of the file.
+    FromDump *fd = static_cast<FromDump *>(thunk);
+    const uint32_t hdrlen = sizeof(fake_pcap_pkthdr) + fd->_extra_pkthdr_crap;
+    const uint32_t search = 65536 + hdrlen;
+    const uint32_t window = search + RESYNC_CHAIN * (65535 + hdrlen);
+
+    off_t base = ff.file_pos();
+    uint8_t *data = new uint8_t[window];
+    int r = ff.read(data, window, errh);
+    if (r < 0) {
+	delete[] data;
+	return -1;
+    }
+    uint32_t n = r;
+    bool at_eof = (n < window);
+
+    uint32_t q;
+    for (q = 0; q < search && q <= n; q++) {
+	uint32_t pos = q, caplen;
+	int32_t sec, last_sec = 0;
+	int k;
+	for (k = 0; k < RESYNC_CHAIN && pos + hdrlen <= n; k++) {
+	    if (!fd->plausible_header(data + pos, &caplen, &sec)
+		|| (k > 0 && (sec - last_sec > 86400 || last_sec - sec > 86400)))
+		break;
+	    last_sec = sec;
+	    pos += hdrlen + caplen;
+	}
+	if (k == RESYNC_CHAIN ? pos <= n : (at_eof && pos == n))
+	    break;
+    }
+
+    delete[] data;
+    if (q < search && q <= n)
+	return ff.seek(base + q, errh);
+    else
+	return ff.error(errh, "can't find a packet header near offset %ld for PARTITION", (long) base);
+}
+
 bool
 FromDump::read_packet(ErrorHandler *errh)
 {
@@ -327,6 +400,10 @@ FromDump::read_packet(ErrorHandler *errh)
     Packet *p;
     assert(!_packet);
 
+    // stop at the end of our piece of a partitioned file
+    if (_ff.partition_done())
+	return false;
+
     // record file position
     _packet_filepos = _ff.file_pos();
 
@@ -419,7 +496,7 @@ FromDump::run_timer(Timer *)
 bool
 FromDump::run_task(Task *)
 {
-    if (!_active)
+    if (!_active || !_nonfull_signal)
 	return false;
 
     int retry_count = 0;
@@ -12,7 +12,7 @@ class HandlerCall;
 /*
 =c
 
-FromDump(FILENAME [, I<keywords> STOP, TIMING, SAMPLE, FORCE_IP, START, START_AFTER, END, END_AFTER, INTERVAL, END_CALL, FILEPOS, MMAP])
+FromDump(FILENAME [, I<keywords> STOP, TIMING, SAMPLE, FORCE_IP, START, START_AFTER, END, END_AFTER, INTERVAL, END_CALL, FILEPOS, MMAP, PARTITION])
 
 =s traces
 
@@ -24,8 +24,10 @@ Reads packets from a file produced by `tcpdump -w FILENAME' or ToDump and
 emits them from the output, optionally stopping the driver when there are no
 more packets.
 
-FromDump also transparently reads gzip- and bzip2-compressed tcpdump files, if
-you have zcat(1) and bzcat(1) installed.
+FromDump also transparently reads gzip-, bzip2-, and zstd-compressed tcpdump
+files.  If Click was built with zlib, libbz2, or libzstd, a helper thread
+uncompresses the file ahead of the packets being read; otherwise FromDump runs
+zcat(1), bzcat(1), or zstdcat(1).
 
 Keyword arguments are:
 
@@ -108,13 +110,44 @@ This can result in slightly better performance on some machines. FromDump's
 regular file discipline is pretty optimized, so the difference is often small
 in practice. Default is true on most operating systems, but false on Linux.
 
+=item PARTITION
+
+Argument has the form `I<I>/I<N>', where 0 E<lt>= I<I> E<lt> I<N>.  If
+supplied, FromDump divides the file's packets into I<N> pieces of roughly
+equal size and emits only the packets in piece I<I>.  See
+the notes on parallel reading below.  The file must be an uncompressed
+regular file.  PARTITION and FILEPOS are mutually exclusive.
+
 =back
 
 You can supply at most one of START and START_AFTER, and at most one of END,
 END_AFTER, and INTERVAL.
 
+Several FromDump elements with the same FILENAME and different PARTITION
+arguments can read one large tcpdump file in parallel.  Each element finds
+the packet boundary at or after its nominal starting offset by looking for a
+chain of plausible packet headers, so the pieces never overlap and together
+contain every packet in the file.  Each element has its own file descriptor
+and mmap window.  Use StaticThreadSched to run the elements on different
+threads.
+
+The pieces are emitted independently, so packets from different pieces will
+be interleaved.  To restore timestamp order, pull the elements through a
+TimeSortedSched in STRICT mode, and tell it when each piece is done with
+END_CALL, as in the example below.
+
 Only available in user-level processes.
 
+=e
+
+   fd0 :: FromDump(big.pcap, PARTITION 0/2, END_CALL tss.finished 0);
+   fd1 :: FromDump(big.pcap, PARTITION 1/2, END_CALL tss.finished 1);
+   tss :: TimeSortedSched(STRICT true, STOP true);
+   fd0 -> ThreadSafeQueue -> [0] tss;
+   fd1 -> ThreadSafeQueue -> [1] tss;
+   tss -> ...;
+   StaticThreadSched(fd0 0, fd1 1);
+
 =n
 
 By default, `tcpdump -w FILENAME' dumps only the first 68 bytes of
@@ -125,7 +158,8 @@ FromDump sets packets' extra length annotations to any additional length
 recorded in the dump.
 
 FromDump is a notifier signal, active when the element is active and the dump
-contains more packets.
+contains more packets.  In push mode, FromDump waits while a downstream full
+notifier, such as a full Queue, says there is no room for more packets.
 
 If FromDump uses mmap, then a corrupt file might cause Click to crash with a
 segmentation violation.
@@ -170,6 +204,12 @@ This handler is useful for elements like AggregateIPFlows that can record
 statistics about portions of a trace; with packet_filepos, they can note
 exactly where the relevant portion begins.
 
+=h partition read-only
+
+Returns `I<I>/I<N> I<start> I<end>', where I<start> and I<end> are the file
+offsets of this element's piece of the file.  I<End> is `-' for the last
+piece.  Only present if PARTITION was supplied.
+
 =h extend_interval write-only
 
 Text is a time interval. If END_TIME or one of its cousins was specified, then
@@ -184,7 +224,7 @@ the file by writing C<filepos>.
 =a
 
 ToDump, FromDevice.u, ToDevice.u, tcpdump(1), mmap(2), AggregateIPFlows,
-FromTcpdump */
+FromTcpdump, TimeSortedSched, StaticThreadSched */
 
 class FromDump : public Element { public:
 
@@ -212,7 +252,7 @@ class FromDump : public Element { public:
 
   private:
 
-    enum { BUFFER_SIZE = 32768, SAMPLING_SHIFT = 28 };
+    enum { BUFFER_SIZE = 32768, SAMPLING_SHIFT = 28, RESYNC_CHAIN = 8 };
 
     FromFile _ff;
 
@@ -231,6 +271,7 @@ class FromDump : public Element { public:
     unsigned _extra_pkthdr_crap;
     unsigned _sampling_prob;
     int _minor_version;
+    uint32_t _snaplen;
     int _linktype;
 
     Timestamp _first_time;
@@ -247,11 +288,14 @@ class FromDump : public Element { public:
     Timer _timer;
     Task _task;
     ActiveNotifier _notifier;
+    NotifierSignal _nonfull_signal;
 
     Timestamp _time_offset;
     off_t _packet_filepos;
 
     bool read_packet(ErrorHandler *);
+    bool plausible_header(const uint8_t *, uint32_t *caplen, int32_t *sec) const;
+    static int resync_partition(FromFile &, void *, ErrorHandler *);
 
     void prepare_times(const Timestamp &);
 
@@ -33,6 +33,18 @@
 #ifdef ALLOW_MMAP
 # include <sys/mman.h>
 #endif
+#if HAVE_ZLIB
+# include <zlib.h>
+#endif
+#if HAVE_BZLIB
+# include <bzlib.h>
+#endif
+#if HAVE_ZSTD
+# include <zstd.h>
+#endif
+#if HAVE_MULTITHREAD
+# include <pthread.h>
+#endif
 CLICK_DECLS
 
 FromFile::FromFile()
@@ -40,7 +52,9 @@ FromFile::FromFile()
 #ifdef ALLOW_MMAP
       _mmap(true),
 #endif
-      _filename(), _pipe(0), _landmark_pattern("%f"), _lineno(0)
+      _filename(), _pipe(0), _landmark_pattern("%f"), _lineno(0),
+      _decompressor(0), _partition(0), _npartitions(1), _partition_start(0),
+      _partition_end(-1)
 {
 }
 
@@ -52,10 +66,21 @@ FromFile::configure_keywords(Vector<String> &conf, Element *e, ErrorHandler *err
 #else
     bool mmap = _mmap;
 #endif
+    String partition;
     if (cp_va_kparse_remove_keywords(conf, e, errh,
 		    "MMAP", 0, cpBool, &mmap,
+		    "PARTITION", 0, cpArgument, &partition,
 		    cpEnd) < 0)
 	return -1;
+    if (partition) {
+	// "I/N": read the Ith of N roughly equal pieces of the file
+	const char *s = partition.begin(), *end = partition.end();
+	if ((s = cp_integer(s, end, 10, &_partition)) == partition.begin()
+	    || s == end || *s != '/'
+	    || cp_integer(s + 1, end, 10, &_npartitions) != end
+	    || _npartitions < 1 || _partition < 0 || _partition >= _npartitions)
+	    return errh->error("PARTITION should be 'I/N', with 0 <= I < N");
+    }
 #ifdef ALLOW_MMAP
     _mmap = mmap;
 #else
@@ -118,6 +143,433 @@ FromFile::warning(ErrorHandler *errh, const char *format, ...) const
     return r;
 }
 
+// A Decompressor turns a gzip, bzip2, or zstd stream into a sequence of
+// uncompressed data packets.  With multithreading, a helper thread reads and
+// decompresses ahead into a ring of NSLOTS packets while the element parses
+// earlier ones; otherwise each packet is decompressed on demand.
+
+class FromFile::Decompressor { public:
+
+    enum { M_NONE = 0, M_GZIP = 1, M_BZIP2 = 2, M_ZSTD = 3 };
+    static int method(const uint8_t *buf, uint32_t len);
+
+    Decompressor(int method, int fd, Packet *prefix);
+    ~Decompressor();
+
+    int start(ErrorHandler *errh);
+    int next(WritablePacket *&p);
+    const String &error_message() const	{ return _error; }
+
+  private:
+
+    enum { IN_SIZE = 65536, OUT_SIZE = 131072, NSLOTS = 2 };
+
+    int _method;
+    int _fd;
+    Packet *_prefix;		// compressed data read before we started
+    unsigned char *_in;
+    const unsigned char *_in_ptr;
+    uint32_t _in_len;
+    bool _in_eof;
+    bool _boundary;		// true iff at the end of a compressed stream
+    bool _initialized;
+    String _error;
+
+#if HAVE_ZLIB
+    z_stream _gz;
+#endif
+#if HAVE_BZLIB
+    bz_stream _bz;
+#endif
+#if HAVE_ZSTD
+    ZSTD_DStream *_zs;
+#endif
+
+#if HAVE_MULTITHREAD
+    bool _threaded;
+    bool _stop;
+    pthread_t _thread;
+    pthread_mutex_t _lock;
+    pthread_cond_t _cond;
+    WritablePacket *_slot[NSLOTS];
+    int _slot_len[NSLOTS];
+    int _head;
+    int _count;
+    WritablePacket *_filling;
+    static void *thread_main(void *);
+#endif
+    int _result;		// final result of fill(), once known
+
+    int read_input();
+    int decompress(unsigned char *out, uint32_t out_len,
+		   uint32_t &consumed, uint32_t &produced);
+    int fill(WritablePacket *&p);
+
+};
+
+int
+FromFile::Decompressor::method(const uint8_t *buf, uint32_t len)
+{
+#if HAVE_ZLIB
+    if (len >= 3 && buf[0] == 037 && buf[1] == 0213)
+	return M_GZIP;
+#endif
+#if HAVE_BZLIB
+    if (len >= 4 && buf[0] == 'B' && buf[1] == 'Z' && buf[2] == 'h'
+	&& buf[3] >= '0' && buf[3] <= '9')
+	return M_BZIP2;
+#endif
+#if HAVE_ZSTD
+    if (len >= 4 && buf[0] == 0x28 && buf[1] == 0xB5 && buf[2] == 0x2F
+	&& buf[3] == 0xFD)
+	return M_ZSTD;
+#endif
+    (void) buf, (void) len;
+    return M_NONE;
+}
+
+FromFile::Decompressor::Decompressor(int method, int fd, Packet *prefix)
+    : _method(method), _fd(fd), _prefix(prefix), _in(0), _in_ptr(0),
+      _in_len(0), _in_eof(false), _boundary(false), _initialized(false),
+#if HAVE_ZSTD
+      _zs(0),
+#endif
+#if HAVE_MULTITHREAD
+      _threaded(false), _stop(false), _head(0), _count(0), _filling(0),
+#endif
+      _result(1)
+{
+}
+
+FromFile::Decompressor::~Decompressor()
+{
+#if HAVE_MULTITHREAD
+    if (_threaded) {
+	pthread_mutex_lock(&_lock);
+	_stop = true;
+	pthread_cond_broadcast(&_cond);
+	pthread_mutex_unlock(&_lock);
+	// The helper thread may be blocked reading a pipe; it permits
+	// cancellation only there.
+	pthread_cancel(_thread);
+	pthread_join(_thread, 0);
+	for (; _count > 0; _head = (_head + 1) % NSLOTS, _count--)
+	    if (_slot[_head])
+		_slot[_head]->kill();
+	if (_filling)
+	    _filling->kill();
+	pthread_cond_destroy(&_cond);
+	pthread_mutex_destroy(&_lock);
+    }
+#endif
+    if (_initialized)
+	switch (_method) {
+#if HAVE_ZLIB
+	  case M_GZIP:
+	    inflateEnd(&_gz);
+	    break;
+#endif
+#if HAVE_BZLIB
+	  case M_BZIP2:
+	    BZ2_bzDecompressEnd(&_bz);
+	    break;
+#endif
+#if HAVE_ZSTD
+	  case M_ZSTD:
+	    ZSTD_freeDStream(_zs);
+	    break;
+#endif
+	}
+    if (_prefix)
+	_prefix->kill();
+    delete[] _in;
+}
+
+int
+FromFile::Decompressor::start(ErrorHandler *errh)
+{
+    if (!(_in = new unsigned char[IN_SIZE]))
+	return errh->error(strerror(ENOMEM));
+
+    switch (_method) {
+#if HAVE_ZLIB
+      case M_GZIP:
+	memset(&_gz, 0, sizeof(_gz));
+	// 15 + 32: maximum window, detect gzip or zlib header
+	if (inflateInit2(&_gz, 15 + 32) != Z_OK)
+	    return errh->error("zlib initialization failed");
+	break;
+#endif
+#if HAVE_BZLIB
+      case M_BZIP2:
+	memset(&_bz, 0, sizeof(_bz));
+	if (BZ2_bzDecompressInit(&_bz, 0, 0) != BZ_OK)
+	    return errh->error("bzip2 initialization failed");
+	break;
+#endif
+#if HAVE_ZSTD
+      case M_ZSTD:
+	if (!(_zs = ZSTD_createDStream())
+	    || ZSTD_isError(ZSTD_initDStream(_zs)))
+	    return errh->error("zstd initialization failed");
+	break;
+#endif
+      default:
+	return errh->error("unsupported compression method");
+    }
+    _initialized = true;
+
+#if HAVE_MULTITHREAD
+    pthread_mutex_init(&_lock, 0);
+    pthread_cond_init(&_cond, 0);
+    int err = pthread_create(&_thread, 0, thread_main, this);
+    if (err != 0) {
+	pthread_cond_destroy(&_cond);
+	pthread_mutex_destroy(&_lock);
+	errh->warning("cannot start decompression thread: %s", strerror(err));
+    } else
+	_threaded = true;
+#endif
+    return 0;
+}
+
+int
+FromFile::Decompressor::read_input()
+{
+    if (_prefix) {
+	// first consume the data read before decompression started
+	assert(_prefix->length() <= IN_SIZE);
+	memcpy(_in, _prefix->data(), _prefix->length());
+	_in_ptr = _in;
+	_in_len = _prefix->length();
+	_prefix->kill();
+	_prefix = 0;
+	return 0;
+    }
+
+#if HAVE_MULTITHREAD
+    int oldstate;
+    if (_threaded)
+	pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &oldstate);
+#endif
+    ssize_t got;
+    do {
+	got = ::read(_fd, _in, IN_SIZE);
+    } while (got < 0 && (errno == EINTR || errno == EAGAIN));
+#if HAVE_MULTITHREAD
+    if (_threaded)
+	pthread_setcancelstate(oldstate, 0);
+#endif
+
+    if (got < 0) {
+	_error = strerror(errno);
+	return -1;
+    }
+    _in_ptr = _in;
+    _in_len = got;
+    _in_eof = (got == 0);
+    return 0;
+}
+
+int
+FromFile::Decompressor::decompress(unsigned char *out, uint32_t out_len,
+				   uint32_t &consumed, uint32_t &produced)
+{
+    switch (_method) {
+
+#if HAVE_ZLIB
+      case M_GZIP: {
+	  _gz.next_in = const_cast<Bytef *>(_in_ptr);
+	  _gz.avail_in = _in_len;
+	  _gz.next_out = out;
+	  _gz.avail_out = out_len;
+	  int r = inflate(&_gz, Z_NO_FLUSH);
+	  consumed = _in_len - _gz.avail_in;
+	  produced = out_len - _gz.avail_out;
+	  if (consumed || produced)
+	      _boundary = false;
+	  if (r == Z_STREAM_END) {
+	      // concatenated gzip members form a single stream
+	      inflateReset(&_gz);
+	      _boundary = true;
+	  } else if (r != Z_OK && r != Z_BUF_ERROR) {
+	      _error = (_gz.msg ? _gz.msg : "zlib error");
+	      return -1;
+	  }
+	  return 0;
+      }
+#endif
+
+#if HAVE_BZLIB
+      case M_BZIP2: {
+	  _bz.next_in = reinterpret_cast<char *>(const_cast<unsigned char *>(_in_ptr));
+	  _bz.avail_in = _in_len;
+	  _bz.next_out = reinterpret_cast<char *>(out);
+	  _bz.avail_out = out_len;
+	  int r = BZ2_bzDecompress(&_bz);
+	  consumed = _in_len - _bz.avail_in;
+	  produced = out_len - _bz.avail_out;
+	  if (consumed || produced)
+	      _boundary = false;
+	  if (r == BZ_STREAM_END) {
+	      BZ2_bzDecompressEnd(&_bz);
+	      memset(&_bz, 0, sizeof(_bz));
+	      if (BZ2_bzDecompressInit(&_bz, 0, 0) != BZ_OK) {
+		  _initialized = false;
+		  _error = "bzip2 initialization failed";
+		  return -1;
+	      }
+	      _boundary = true;
+	  } else if (r != BZ_OK) {
+	      _error = "bzip2 data corrupt";
+	      return -1;
+	  }
+	  return 0;
+      }
+#endif
+
+#if HAVE_ZSTD
+      case M_ZSTD: {
+	  ZSTD_inBuffer in = { _in_ptr, _in_len, 0 };
+	  ZSTD_outBuffer o = { out, out_len, 0 };
+	  size_t r = ZSTD_decompressStream(_zs, &o, &in);
+	  if (ZSTD_isError(r)) {
+	      _error = ZSTD_getErrorName(r);
+	      return -1;
+	  }
+	  consumed = in.pos;
+	  produced = o.pos;
+	  if (consumed || produced)
+	      _boundary = (r == 0);
+	  return 0;
+      }
+#endif
+
+      default:
+	(void) out, (void) out_len, (void) consumed, (void) produced;
+	_error = "unsupported compression method";
+	return -1;
+    }
+}
+
+int
+FromFile::Decompressor::fill(WritablePacket *&result)
+{
+    // Returns the number of bytes in result, 0 at end of file, or -1 on
+    // error.  Once end of file or an error is reached, keeps returning it.
+    result = 0;
+    if (_result <= 0)
+	return _result;
+
+    WritablePacket *p = Packet::make(0, 0, OUT_SIZE, 0);
+    if (!p) {
+	_error = strerror(ENOMEM);
+	return -1;
+    }
+#if HAVE_MULTITHREAD
+    _filling = p;
+#endif
+
+    uint32_t out_len = 0;
+    while (out_len < OUT_SIZE) {
+	if (_in_len == 0 && !_in_eof && read_input() < 0)
+	    goto error;
+	uint32_t consumed = 0, produced = 0;
+	if (decompress(p->data() + out_len, OUT_SIZE - out_len, consumed, produced) < 0)
+	    goto error;
+	_in_ptr += consumed;
+	_in_len -= consumed;
+	out_len += produced;
+	if (consumed == 0 && produced == 0) {
+	    if (_in_len == 0 && _in_eof) {
+		if (!_boundary && out_len == 0) {
+		    _error = "compressed data truncated";
+		    goto error;
+		}
+		break;
+	    } else if (_in_len != 0) {
+		_error = "compressed data corrupt";
+		goto error;
+	    }
+	}
+    }
+
+#if HAVE_MULTITHREAD
+    _filling = 0;
+#endif
+    if (out_len == 0) {
+	p->kill();
+	return (_result = 0);
+    }
+    p->take(OUT_SIZE - out_len);
+    result = p;
+    return out_len;
+
+  error:
+#if HAVE_MULTITHREAD
+    _filling = 0;
+#endif
+    p->kill();
+    return (_result = -1);
+}
+
+#if HAVE_MULTITHREAD
+void *
+FromFile::Decompressor::thread_main(void *thunk)
+{
+    Decompressor *d = static_cast<Decompressor *>(thunk);
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, 0);
+    pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, 0);
+    while (1) {
+	WritablePacket *p;
+	int r = d->fill(p);
+
+	pthread_mutex_lock(&d->_lock);
+	while (d->_count == NSLOTS && !d->_stop)
+	    pthread_cond_wait(&d->_cond, &d->_lock);
+	if (d->_stop) {
+	    pthread_mutex_unlock(&d->_lock);
+	    if (p)
+		p->kill();
+	    break;
+	}
+	int tail = (d->_head + d->_count) % NSLOTS;
+	d->_slot[tail] = p;
+	d->_slot_len[tail] = r;
+	d->_count++;
+	pthread_cond_broadcast(&d->_cond);
+	pthread_mutex_unlock(&d->_lock);
+
+	if (r <= 0)
+	    break;
+    }
+    return 0;
+}
+#endif
+
+int
+FromFile::Decompressor::next(WritablePacket *&p)
+{
+#if HAVE_MULTITHREAD
+    if (_threaded) {
+	pthread_mutex_lock(&_lock);
+	while (_count == 0)
+	    pthread_cond_wait(&_cond, &_lock);
+	int r = _slot_len[_head];
+	p = _slot[_head];
+	if (r > 0) {
+	    // leave the final result in place for later calls
+	    _head = (_head + 1) % NSLOTS;
+	    _count--;
+	    pthread_cond_broadcast(&_cond);
+	}
+	pthread_mutex_unlock(&_lock);
+	return r;
+    }
+#endif
+    return fill(p);
+}
+
 #ifdef ALLOW_MMAP
 static void
 munmap_destructor(unsigned char *data, size_t amount)
@@ -184,6 +636,19 @@ FromFile::read_buffer(ErrorHandler *errh)
 				// beyond _len
     _len = 0;
 
+    if (_decompressor) {
+	WritablePacket *p;
+	int result = _decompressor->next(p);
+	if (!p && !(p = Packet::make(0, 0, 0, 0)))
+	    return error(errh, strerror(ENOMEM));
+	_data_packet = p;
+	_buffer = _data_packet->data();
+	if (result < 0)
+	    return error(errh, "%s", _decompressor->error_message().c_str());
+	_len = result;
+	return _len;
+    }
+
 #ifdef ALLOW_MMAP
     if (_mmap) {
 	int result = read_buffer_mmap(errh);
@@ -315,30 +780,40 @@ int
 FromFile::seek(off_t want, ErrorHandler* errh)
 {
     if (want >= _file_offset && want < (off_t) (_file_offset + _len)) {
-	_pos = want;
+	_pos = want - _file_offset;
 	return 0;
     }
 
+    // In the mmap and lseek cases, refill the buffer right away, so that
+    // _pos lies within it and file_pos() reports the new position.
 #ifdef ALLOW_MMAP
     if (_mmap) {
 	_mmap_off = (want / _mmap_unit) * _mmap_unit;
-	_pos = _len + want - _mmap_off;
-	return 0;
+	_file_offset = _mmap_off;
+	_pos = want - _mmap_off;
+	_len = 0;
+	return (read_buffer(errh) < 0 ? -1 : 0);
     }
 #endif
 
-    // check length of file
-    struct stat statbuf;
-    if (fstat(_fd, &statbuf) < 0)
-	return error(errh, "stat: %s", strerror(errno));
-    if (S_ISREG(statbuf.st_mode) && statbuf.st_size && want > statbuf.st_size)
-	return errh->error("FILEPOS out of range");
+    if (_decompressor) {
+	// can only move forward through uncompressed data
+	if (want < _file_offset)
+	    return errh->error("cannot seek backwards in compressed file");
+    } else {
+	// check length of file
+	struct stat statbuf;
+	if (fstat(_fd, &statbuf) < 0)
+	    return error(errh, "stat: %s", strerror(errno));
+	if (S_ISREG(statbuf.st_mode) && statbuf.st_size && want > statbuf.st_size)
+	    return errh->error("FILEPOS out of range");
 
-    // try to seek
-    if (lseek(_fd, want, SEEK_SET) != (off_t) -1) {
-	_pos = _len;
-	_file_offset = want - _len;
-	return 0;
+	// try to seek
+	if (lseek(_fd, want, SEEK_SET) != (off_t) -1) {
+	    _file_offset = want;
+	    _pos = _len = 0;
+	    return (read_buffer(errh) < 0 ? -1 : 0);
+	}
     }
 
     // otherwise, read data
@@ -372,9 +847,27 @@ FromFile::initialize(ErrorHandler *errh)
     else if (result == 0)
 	return error(errh, "empty file");
 
-    // check for a gziped or bzip2d dump
-    if (_fd == STDIN_FILENO || _pipe)
-	/* cannot handle gzip or bzip2 */;
+    // check for a gziped, bzip2d, or zstd-compressed dump
+    if (_pipe || _decompressor)
+	/* already uncompressing */;
+    else if (int method = Decompressor::method(_buffer, _len)) {
+	// Uncompress in-process.  Rewind to the beginning if we can;
+	// otherwise, hand over the data we've already read.
+	Packet *prefix = 0;
+	if (lseek(_fd, 0, SEEK_SET) == (off_t) -1) {
+	    prefix = _data_packet;
+	    prefix->take(prefix->length() - _len);
+	    _data_packet = 0;
+	}
+	_decompressor = new Decompressor(method, _fd, prefix);
+	if (_decompressor->start(errh) < 0)
+	    return -1;
+#ifdef ALLOW_MMAP
+	_mmap = false;
+#endif
+	goto retry_file;
+    } else if (_fd == STDIN_FILENO)
+	/* cannot run zcat or bzcat on the standard input */;
     else if (compressed_data(_buffer, _len)) {
 	close(_fd);
 	_fd = -1;
@@ -387,6 +880,51 @@ FromFile::initialize(ErrorHandler *errh)
     return 0;
 }
 
+int
+FromFile::set_partition_range(off_t data_start, ResyncFunction resync,
+			      void *thunk, ErrorHandler *errh)
+{
+    // The records between data_start and the end of the file are divided
+    // into _npartitions pieces of about equal size.  Each piece begins at
+    // the first record boundary at or after its nominal start offset, as
+    // found by resync, so the pieces are disjoint and cover every record.
+    struct stat statbuf;
+    if (_pipe || _decompressor || _fd == STDIN_FILENO
+	|| fstat(_fd, &statbuf) < 0 || !S_ISREG(statbuf.st_mode))
+	return error(errh, "PARTITION requires an uncompressed regular file");
+    off_t size = statbuf.st_size;
+    if (data_start > size)
+	data_start = size;
+    off_t piece = (size - data_start) / _npartitions;
+
+    if (_partition + 1 < _npartitions) {
+	if (seek(data_start + piece * (_partition + 1), errh) < 0
+	    || resync(*this, thunk, errh) < 0)
+	    return -1;
+	_partition_end = file_pos();
+    } else
+	_partition_end = -1;
+
+    if (seek(data_start + piece * _partition, errh) < 0
+	|| (_partition > 0 && resync(*this, thunk, errh) < 0))
+	return -1;
+    _partition_start = file_pos();
+    return 0;
+}
+
+int
+FromFile::resync_line(FromFile &ff, void *, ErrorHandler *errh)
+{
+    // Move to the start of the next line, unless already at a line start.
+    String line;
+    if (ff.file_pos() == 0)
+	return 0;
+    else if (ff.seek(ff.file_pos() - 1, errh) < 0
+	|| ff.read_line(line, errh, true) < 0)
+	return -1;
+    return 0;
+}
+
 void
 FromFile::take_state(FromFile &o, ErrorHandler *errh)
 {
@@ -394,6 +932,8 @@ FromFile::take_state(FromFile &o, ErrorHandler *errh)
     o._fd = -1;
     _pipe = o._pipe;
     o._pipe = 0;
+    _decompressor = o._decompressor;
+    o._decompressor = 0;
 
     _buffer = o._buffer;
     _pos = o._pos;
@@ -411,11 +951,16 @@ FromFile::take_state(FromFile &o, ErrorHandler *errh)
 #endif
 
     _file_offset = o._file_offset;
+    _partition_start = o._partition_start;
+    _partition_end = o._partition_end;
 }
 
 void
 FromFile::cleanup()
 {
+    // stop the decompression thread before closing its file
+    delete _decompressor;
+    _decompressor = 0;
     if (_pipe)
 	pclose(_pipe);
     else if (_fd >= 0 && _fd != STDIN_FILENO)
@@ -545,12 +1090,27 @@ FromFile::filesize_handler(Element *e, void *thunk)
 {
     FromFile *fd = reinterpret_cast<FromFile *>((uint8_t *)e + (intptr_t)thunk);
     struct stat s;
-    if (fd->_fd >= 0 && fstat(fd->_fd, &s) >= 0 && S_ISREG(s.st_mode))
+    if (fd->_fd >= 0 && !fd->_decompressor
+	&& fstat(fd->_fd, &s) >= 0 && S_ISREG(s.st_mode))
 	return String(s.st_size);
     else
 	return "-";
 }
 
+String
+FromFile::partition_handler(Element *e, void *thunk)
+{
+    FromFile *fd = reinterpret_cast<FromFile *>((uint8_t *)e + (intptr_t)thunk);
+    StringAccum sa;
+    sa << fd->_partition << '/' << fd->_npartitions << ' '
+       << fd->_partition_start << ' ';
+    if (fd->_partition_end >= 0)
+	sa << fd->_partition_end;
+    else
+	sa << '-';
+    return sa.take_string();
+}
+
 String
 FromFile::filepos_handler(Element* e, void* thunk)
 {
@@ -577,6 +1137,8 @@ FromFile::add_handlers(Element* e, bool filepos_writable) const
     e->add_read_handler("filepos", filepos_handler, (void *)offset);
     if (filepos_writable)
 	e->add_write_handler("filepos", filepos_write_handler, (void *)offset);
+    if (_npartitions > 1)
+	e->add_read_handler("partition", partition_handler, (void *)offset);
 }
 
 CLICK_ENDDECLS
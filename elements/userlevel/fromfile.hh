@@ -28,6 +28,14 @@ class FromFile { public:
 
     off_t file_pos() const		{ return _file_offset + _pos; }
 
+    bool partitioned() const		{ return _npartitions > 1; }
+    typedef int (*ResyncFunction)(FromFile &, void *, ErrorHandler *);
+    int set_partition_range(off_t data_start, ResyncFunction resync, void *thunk, ErrorHandler *);
+    static int resync_line(FromFile &, void *, ErrorHandler *);
+    bool partition_done() const {
+	return _partition_end >= 0 && file_pos() >= _partition_end;
+    }
+
     int configure_keywords(Vector<String> &conf, Element *, ErrorHandler *);
     int initialize(ErrorHandler *);
     void add_handlers(Element *, bool filepos_writable = false) const;
@@ -77,6 +85,14 @@ class FromFile { public:
     String _landmark_pattern;
     int _lineno;
 
+    class Decompressor;
+    Decompressor *_decompressor;
+
+    int _partition;
+    int _npartitions;
+    off_t _partition_start;
+    off_t _partition_end;	// -1 means end of file
+
 #ifdef ALLOW_MMAP
     int read_buffer_mmap(ErrorHandler *);
 #endif
@@ -87,6 +103,7 @@ class FromFile { public:
     static String filename_handler(Element *, void *);
     static String filesize_handler(Element *, void *);
     static String filepos_handler(Element *, void *);
+    static String partition_handler(Element *, void *);
     static int filepos_write_handler(const String&, Element*, void*, ErrorHandler*);
 
 };
@@ -45,10 +45,16 @@
 
 CLICK_DECLS
 
+#if HAVE_RECVMMSG && HAVE_SENDMMSG
+// per-message control data: room for SO_TIMESTAMP
+static const size_t cmsg_space = CMSG_SPACE(sizeof(struct timeval));
+#endif
+
 RawSocket::RawSocket()
   : _task(this), _timer(this),
     _fd(-1), _port(0), _proper(false), _snaplen(2048),
-    _headroom(Packet::default_headroom), _rq(0), _wq(0)
+    _headroom(Packet::default_headroom), _rq(0), _wq(0),
+    _burst(1), _msgs(0), _iovs(0), _addrs(0), _cmsgs(0), _rslab(0)
 {
 }
 
@@ -72,10 +78,20 @@ RawSocket::configure(Vector<String> &conf, ErrorHandler *errh)
 		   "SNAPLEN", 0, cpUnsigned, &_snaplen,
 		   "HEADROOM", 0, cpUnsigned, &_headroom,
 		   "PROPER", 0, cpBool, &_proper,
+		   "BURST", 0, cpInteger, &_burst,
 		   cpEnd) < 0)
     return -1;
   socktype = socktype.upper();
 
+  if (_burst < 1)
+    return errh->error("BURST must be at least 1");
+#if !HAVE_RECVMMSG || !HAVE_SENDMMSG
+  if (_burst > 1) {
+    errh->warning("BURST requires recvmmsg() and sendmmsg(), ignoring");
+    _burst = 1;
+  }
+#endif
+
   if (socktype == "TCP")
     _protocol = IPPROTO_TCP;
   else if (socktype == "UDP")
@@ -143,6 +159,27 @@ RawSocket::initialize(ErrorHandler *errh)
   if (setsockopt(_fd, 0, IP_HDRINCL, &one, sizeof(one)) < 0)
     return initialize_socket_error(errh, "IP_HDRINCL");
 
+#if HAVE_RECVMMSG && HAVE_SENDMMSG
+  if (_burst > 1) {
+    // SIOCGSTAMP reports only the last packet read, so ask for per-packet
+    // timestamps instead
+# ifdef SO_TIMESTAMP
+    if (noutputs() && setsockopt(_fd, SOL_SOCKET, SO_TIMESTAMP, &one, sizeof(one)) < 0)
+      return initialize_socket_error(errh, "setsockopt(SO_TIMESTAMP)");
+# endif
+    _msgs = new struct mmsghdr[_burst];
+    _iovs = new struct iovec[_burst];
+    _addrs = new struct sockaddr_in[_burst];
+    _cmsgs = new char[_burst * cmsg_space];
+    _rslab = new WritablePacket *[_burst];
+    if (!_msgs || !_iovs || !_addrs || !_cmsgs || !_rslab)
+      return initialize_socket_error(errh, "out of memory");
+    memset(_msgs, 0, sizeof(struct mmsghdr) * _burst);
+    memset(_addrs, 0, sizeof(struct sockaddr_in) * _burst);
+    memset(_rslab, 0, sizeof(WritablePacket *) * _burst);
+  }
+#endif
+
   if (noutputs())
     add_select(_fd, SELECT_READ);
 
@@ -162,6 +199,21 @@ RawSocket::cleanup(CleanupStage)
     _rq->kill();
   if (_wq)
     _wq->kill();
+  _wb.kill();
+  if (_rslab)
+    for (int i = 0; i < _burst; i++)
+      if (_rslab[i])
+	_rslab[i]->kill();
+  delete[] _rslab;
+  delete[] _msgs;
+  delete[] _iovs;
+  delete[] _addrs;
+  delete[] _cmsgs;
+  _rslab = 0;
+  _msgs = 0;
+  _iovs = 0;
+  _addrs = 0;
+  _cmsgs = 0;
   if (_fd >= 0) {
     close(_fd);
     remove_select(_fd, SELECT_READ | SELECT_WRITE);
@@ -175,7 +227,9 @@ RawSocket::selected(int fd)
   ErrorHandler *errh = ErrorHandler::default_handler();
   int len;
 
-  if (noutputs()) {
+  if (noutputs() && _burst > 1)
+    read_burst(errh);
+  else if (noutputs()) {
     // read data from socket
     if (!_rq)
       _rq = Packet::make(_headroom, (const unsigned char *)0, _snaplen, 0);
@@ -204,7 +258,9 @@ RawSocket::selected(int fd)
     }
   }
 
-  if (ninputs()) {
+  if (ninputs() && _burst > 1)
+    write_burst(errh);
+  else if (ninputs()) {
     // write data to socket
     Packet *p;
     if (_wq) {
@@ -265,10 +321,147 @@ RawSocket::selected(int fd)
   }
 }
 
+void
+RawSocket::read_burst(ErrorHandler *errh)
+{
+#if HAVE_RECVMMSG && HAVE_SENDMMSG
+  int n;
+
+  // refill the receive slab and set up one message per packet
+  for (n = 0; n < _burst; n++) {
+    if (!_rslab[n] && !(_rslab[n] = Packet::make(_headroom, (const unsigned char *)0, _snaplen, 0)))
+      break;
+    struct msghdr &mh = _msgs[n].msg_hdr;
+    _iovs[n].iov_base = _rslab[n]->data();
+    _iovs[n].iov_len = _snaplen;
+    mh.msg_iov = &_iovs[n];
+    mh.msg_iovlen = 1;
+    mh.msg_name = 0;
+    mh.msg_namelen = 0;
+    mh.msg_control = _cmsgs + n * cmsg_space;
+    mh.msg_controllen = cmsg_space;
+    mh.msg_flags = 0;
+  }
+  if (n == 0)
+    return;
+
+  int r = recvmmsg(_fd, _msgs, n, MSG_TRUNC, 0);
+  if (r < 0) {
+    if (errno != EAGAIN)
+      errh->error("recvmmsg: %s", strerror(errno));
+    return;
+  }
+
+  PacketBatch batch;
+  for (int i = 0; i < r; i++) {
+    struct msghdr &mh = _msgs[i].msg_hdr;
+    int len = _msgs[i].msg_len;
+    WritablePacket *p = _rslab[i];
+    if (len == 0)
+      continue;
+    _rslab[i] = 0;
+    if (len > _snaplen) {
+      assert(p->length() == (uint32_t)_snaplen);
+      SET_EXTRA_LENGTH_ANNO(p, len - _snaplen);
+    } else
+      p->take(_snaplen - len);
+    // set timestamp
+# ifdef SCM_TIMESTAMP
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(&mh); c; c = CMSG_NXTHDR(&mh, c))
+      if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMP) {
+	struct timeval tv;
+	memcpy(&tv, CMSG_DATA(c), sizeof(tv));
+	p->timestamp_anno() = Timestamp(tv);
+      }
+# endif
+    // set IP annotations
+    if (fake_pcap_force_ip(p, FAKE_DLT_RAW))
+      batch.push_back(p);
+    else
+      p->kill();
+  }
+
+  output(0).push_batch(batch);
+#else
+  (void) errh;
+#endif
+}
+
+void
+RawSocket::write_burst(ErrorHandler *errh)
+{
+#if HAVE_RECVMMSG && HAVE_SENDMMSG
+  if (_wb.empty()) {
+    input(0).pull_batch(_wb, _burst);
+
+    // drop runts now so every queued packet can be sent as-is
+    PacketBatch ok;
+    while (Packet *p = _wb.pop_front())
+      // cast to int so very large plen is interpreted as negative
+      if ((int)p->length() < (int)sizeof(click_ip)) {
+	errh->error("runt IP packet (%d bytes)", p->length());
+	p->kill();
+      } else
+	ok.push_back(p);
+    _wb.swap(ok);
+  }
+
+  while (!_wb.empty()) {
+    int n = 0;
+    for (Packet *p = _wb.front(); p; p = p->next(), n++) {
+      struct msghdr &mh = _msgs[n].msg_hdr;
+      _addrs[n].sin_family = PF_INET;
+      _addrs[n].sin_addr = ((const click_ip *) p->data())->ip_dst;
+      _iovs[n].iov_base = const_cast<unsigned char *>(p->data());
+      _iovs[n].iov_len = p->length();
+      mh.msg_name = &_addrs[n];
+      mh.msg_namelen = sizeof(struct sockaddr_in);
+      mh.msg_iov = &_iovs[n];
+      mh.msg_iovlen = 1;
+      mh.msg_control = 0;
+      mh.msg_controllen = 0;
+      mh.msg_flags = 0;
+    }
+
+    int r = sendmmsg(_fd, _msgs, n, 0);
+    if (r < 0) {
+      if (errno == ENOBUFS || errno == EAGAIN) {
+	// socket queue full, try again later
+	remove_select(_fd, SELECT_WRITE);
+	_events &= ~SELECT_WRITE;
+	_backoff = (!_backoff) ? 1 : _backoff*2;
+	_timer.schedule_after(Timestamp::make_usec(_backoff));
+	return;
+      } else if (errno == EINTR) {
+	// interrupted by signal, try again immediately
+	continue;
+      } else {
+	// unexpected error: drop packet
+	errh->error("sendmmsg: %s", strerror(errno));
+	r = 1;
+      }
+    }
+
+    // raw sockets send each packet whole
+    for (int i = 0; i < r; i++)
+      _wb.pop_front()->kill();
+  }
+  _backoff = 0;
+
+  // nothing to write, wait for upstream signal
+  if (!_signal && (_events & SELECT_WRITE)) {
+    remove_select(_fd, SELECT_WRITE);
+    _events &= ~SELECT_WRITE;
+  }
+#else
+  (void) errh;
+#endif
+}
+
 void
 RawSocket::run_timer(Timer *)
 {
-  if ((_wq || _signal) && !(_events & SELECT_WRITE) && _fd >= 0) {
+  if ((_wq || !_wb.empty() || _signal) && !(_events & SELECT_WRITE) && _fd >= 0) {
     add_select(_fd, SELECT_WRITE);
     _events |= SELECT_WRITE;
     selected(_fd);
@@ -278,7 +471,7 @@ RawSocket::run_timer(Timer *)
 bool
 RawSocket::run_task(Task *)
 {
-  if (!_wq && !(_events & SELECT_WRITE) && _fd >= 0) {
+  if (!_wq && _wb.empty() && !(_events & SELECT_WRITE) && _fd >= 0) {
     add_select(_fd, SELECT_WRITE);
     _events |= SELECT_WRITE;
     selected(_fd);
@@ -5,6 +5,7 @@
 #include <click/task.hh>
 #include <click/timer.hh>
 #include <click/notifier.hh>
+#include <click/packetbatch.hh>
 CLICK_DECLS
 
 /*
@@ -51,6 +52,14 @@ by this element. This could be useful for encapsulation protocols
 which add headers to the packet, and can avoid expensive push
 operations later in the packet's life.
 
+=item BURST
+
+Integer. The maximum number of packets to receive or send per system
+call. If greater than 1 and the system supports recvmmsg() and
+sendmmsg(), RawSocket preallocates BURST receive packets, reads up to
+BURST packets per readiness event and emits them as a single batch,
+and pulls and sends up to BURST packets at a time. Default is 1.
+
 =back
 
 =e
@@ -96,7 +105,17 @@ private:
   Packet *_wq;			// queue to store pulled packet for when sendto() blocks
   int _events;			// keeps track of the events for which select() is waiting
 
+  int _burst;			// packets per recvmmsg()/sendmmsg()
+  struct mmsghdr *_msgs;	// message headers for recvmmsg()/sendmmsg()
+  struct iovec *_iovs;
+  struct sockaddr_in *_addrs;	// per-message destinations
+  char *_cmsgs;			// per-message control data (timestamps)
+  WritablePacket **_rslab;	// preallocated receive packets
+  PacketBatch _wb;		// pulled packets not yet sent
+
   int initialize_socket_error(ErrorHandler *, const char *);
+  void read_burst(ErrorHandler *);
+  void write_burst(ErrorHandler *);
 
 };
 
@@ -30,6 +30,7 @@
 #include <sys/un.h>
 #include <arpa/inet.h>
 #include <netinet/tcp.h>
+#include <netinet/udp.h>
 #include <fcntl.h>
 #include "socket.hh"
 
@@ -39,13 +40,20 @@
 
 CLICK_DECLS
 
+#if HAVE_RECVMMSG && HAVE_SENDMMSG
+// per-message control data: room for SO_TIMESTAMP plus UDP_GRO or UDP_SEGMENT
+static const size_t cmsg_space = CMSG_SPACE(sizeof(struct timeval)) + CMSG_SPACE(sizeof(int));
+#endif
+
 Socket::Socket()
   : _task(this), _timer(this),
     _fd(-1), _active(-1), _rq(0), _wq(0),
     _local_port(0), _local_pathname(""),
     _timestamp(true), _sndbuf(-1), _rcvbuf(-1),
     _snaplen(2048), _headroom(Packet::default_headroom), _nodelay(1),
-    _verbose(false), _client(false), _proper(false), _allow(0), _deny(0)
+    _verbose(false), _client(false), _proper(false), _allow(0), _deny(0),
+    _burst(1), _gso(false), _gro(false), _msgs(0), _iovs(0), _addrs(0),
+    _cmsgs(0), _rslab(0), _rslab_len(0)
 {
 }
 
@@ -78,9 +86,21 @@ Socket::configure(Vector<String> &conf, ErrorHandler *errh)
 		"PROPER", 0, cpBool, &_proper,
 		"ALLOW", 0, cpElement, &allow,
 		"DENY", 0, cpElement, &deny,
+		"BURST", 0, cpInteger, &_burst,
+		"GSO", 0, cpBool, &_gso,
+		"GRO", 0, cpBool, &_gro,
 		cpEnd) < 0)
     return -1;
 
+  if (_burst < 1)
+    return errh->error("BURST must be at least 1");
+#if !HAVE_RECVMMSG || !HAVE_SENDMMSG
+  if (_burst > 1) {
+    errh->warning("BURST requires recvmmsg() and sendmmsg(), ignoring");
+    _burst = 1;
+  }
+#endif
+
   if (allow && !(_allow = (IPRouteTable *)allow->cast("IPRouteTable")))
     return errh->error("%s is not an IPRouteTable", allow->name().c_str());
 
@@ -259,6 +279,9 @@ Socket::initialize(ErrorHandler *errh)
   fcntl(_fd, F_SETFL, O_NONBLOCK);
   fcntl(_fd, F_SETFD, FD_CLOEXEC);
 
+  if (initialize_burst(errh) < 0)
+    return -1;
+
   if (noutputs())
     add_select(_fd, SELECT_READ);
 
@@ -272,6 +295,53 @@ Socket::initialize(ErrorHandler *errh)
   return 0;
 }
 
+int
+Socket::initialize_burst(ErrorHandler *errh)
+{
+  if (_socktype != SOCK_DGRAM)
+    _burst = 1;
+  if (_burst == 1 || _protocol != IPPROTO_UDP)
+    _gso = _gro = false;
+  if (_burst == 1)
+    return 0;
+
+#if HAVE_RECVMMSG && HAVE_SENDMMSG
+# ifdef UDP_SEGMENT
+  // the kernel accepts a zero segment size iff it supports UDP GSO
+  int zero = 0;
+  if (_gso && setsockopt(_fd, IPPROTO_UDP, UDP_SEGMENT, &zero, sizeof(zero)) < 0) {
+    errh->warning("UDP segmentation offload not supported, ignoring GSO");
+    _gso = false;
+  }
+# else
+  _gso = false;
+# endif
+# ifdef UDP_GRO
+  int one = 1;
+  if (_gro && setsockopt(_fd, IPPROTO_UDP, UDP_GRO, &one, sizeof(one)) < 0) {
+    errh->warning("UDP generic receive offload not supported, ignoring GRO");
+    _gro = false;
+  }
+# else
+  _gro = false;
+# endif
+
+  _msgs = new struct mmsghdr[_burst];
+  _iovs = new struct iovec[_burst];
+  _addrs = new sockaddr_union[_burst];
+  _cmsgs = new char[_burst * cmsg_space];
+  _rslab = new WritablePacket *[_burst];
+  if (!_msgs || !_iovs || !_addrs || !_cmsgs || !_rslab)
+    return initialize_socket_error(errh, "out of memory");
+  memset(_msgs, 0, sizeof(struct mmsghdr) * _burst);
+  memset(_rslab, 0, sizeof(WritablePacket *) * _burst);
+  _rslab_len = (_gro ? 65535 : _snaplen);
+#else
+  (void) errh;
+#endif
+  return 0;
+}
+
 void
 Socket::cleanup(CleanupStage)
 {
@@ -283,6 +353,21 @@ Socket::cleanup(CleanupStage)
     _rq->kill();
   if (_wq)
     _wq->kill();
+  _wb.kill();
+  if (_rslab)
+    for (int i = 0; i < _burst; i++)
+      if (_rslab[i])
+	_rslab[i]->kill();
+  delete[] _rslab;
+  delete[] _msgs;
+  delete[] _iovs;
+  delete[] _addrs;
+  delete[] _cmsgs;
+  _rslab = 0;
+  _msgs = 0;
+  _iovs = 0;
+  _addrs = 0;
+  _cmsgs = 0;
   if (_fd >= 0) {
     // shut down the listening socket in case we forked
 #ifdef SHUT_RDWR
@@ -330,7 +415,16 @@ Socket::selected(int fd)
   socklen_t from_len = sizeof(from);
   bool allow;
 
-  if (noutputs()) {
+  if (noutputs() && _burst > 1) {
+    // read a burst of datagrams
+    if (read_burst() < 0 && errno != EAGAIN) {
+      if (_verbose)
+	click_chatter("%s: %s", declaration().c_str(), strerror(errno));
+      close_active();
+      return;
+    }
+
+  } else if (noutputs()) {
     // accept new connections
     if (_socktype == SOCK_STREAM && !_client && _active < 0 && fd == _fd) {
       _active = accept(_fd, (struct sockaddr *)&from, &from_len);
@@ -424,6 +518,106 @@ Socket::selected(int fd)
     run_task(0);
 }
 
+int
+Socket::read_burst()
+{
+#if HAVE_RECVMMSG && HAVE_SENDMMSG
+  int n;
+
+  // refill the receive slab and set up one message per packet
+  for (n = 0; n < _burst; n++) {
+    if (!_rslab[n] && !(_rslab[n] = Packet::make(_headroom, 0, _rslab_len, 0)))
+      break;
+    struct msghdr &mh = _msgs[n].msg_hdr;
+    _iovs[n].iov_base = _rslab[n]->data();
+    _iovs[n].iov_len = _rslab_len;
+    mh.msg_iov = &_iovs[n];
+    mh.msg_iovlen = 1;
+    mh.msg_name = (_client ? 0 : &_addrs[n]);
+    mh.msg_namelen = (_client ? 0 : sizeof(sockaddr_union));
+    mh.msg_control = (_gro ? _cmsgs + n * cmsg_space : 0);
+    mh.msg_controllen = (_gro ? cmsg_space : 0);
+    mh.msg_flags = 0;
+  }
+  if (n == 0) {
+    errno = EAGAIN;
+    return -1;
+  }
+
+  int r = recvmmsg(_active, _msgs, n, MSG_TRUNC, 0);
+  if (r <= 0)
+    return r;
+
+  Timestamp now;
+  if (_timestamp)
+    now = Timestamp::now();
+
+  PacketBatch batch;
+  for (int i = 0; i < r; i++) {
+    struct msghdr &mh = _msgs[i].msg_hdr;
+    int len = _msgs[i].msg_len;
+
+    if (!_client) {
+      sockaddr_union &from = _addrs[i];
+      if (_family == AF_INET && !allowed(IPAddress(from.in.sin_addr))) {
+	if (_verbose)
+	  click_chatter("%s: dropped datagram from %s:%d", declaration().c_str(),
+			IPAddress(from.in.sin_addr).unparse().c_str(), ntohs(from.in.sin_port));
+	continue;
+      }
+      memcpy(&_remote, &from, mh.msg_namelen);
+      _remote_len = mh.msg_namelen;
+    }
+
+    if (_gro) {
+      // split a coalesced read into its datagrams; the slab packet is
+      // reused, so copy each one out
+      int seg = len;
+# ifdef UDP_GRO
+      for (struct cmsghdr *c = CMSG_FIRSTHDR(&mh); c; c = CMSG_NXTHDR(&mh, c))
+	if (c->cmsg_level == IPPROTO_UDP && c->cmsg_type == UDP_GRO)
+	  memcpy(&seg, CMSG_DATA(c), sizeof(int));
+# endif
+      if (len > (int) _rslab_len)
+	len = _rslab_len;
+      if (seg <= 0)
+	seg = len;
+      int off = 0;
+      do {
+	int l = (len - off < seg ? len - off : seg);
+	if (l > _snaplen)
+	  l = _snaplen;
+	WritablePacket *q = Packet::make(_headroom, _rslab[i]->data() + off, l, 0);
+	if (!q)
+	  break;
+	if (_timestamp)
+	  q->timestamp_anno() = now;
+	batch.push_back(q);
+	off += seg;
+      } while (off < len);
+      continue;
+    }
+
+    WritablePacket *q = _rslab[i];
+    _rslab[i] = 0;
+    if (len > _snaplen) {
+      assert(q->length() == (uint32_t)_snaplen);
+      SET_EXTRA_LENGTH_ANNO(q, len - _snaplen);
+    } else
+      q->take(_snaplen - len);
+    if (_timestamp)
+      q->timestamp_anno() = now;
+    batch.push_back(q);
+  }
+
+  output(0).push_batch(batch);
+  return r;
+#else
+  errno = EAGAIN;
+  return -1;
+#endif
+}
+
 int
 Socket::write_packet(Packet *p)
 {
@@ -471,6 +665,106 @@ Socket::write_packet(Packet *p)
   return 0;
 }
 
+int
+Socket::write_burst()
+{
+#if HAVE_RECVMMSG && HAVE_SENDMMSG
+  bool dst_anno = (!IPAddress(_remote_ip) && _client && _family == AF_INET);
+
+  assert(_active >= 0);
+
+  while (!_wb.empty()) {
+    // Build one message per packet, or, with GSO, one message per run of
+    // equal-length packets to the same destination.  The last packet of a
+    // run may be shorter.
+    int nmsg = 0, niov = 0;
+    Packet *p = _wb.front();
+    while (p) {
+      struct msghdr &mh = _msgs[nmsg].msg_hdr;
+      sockaddr_union &to = _addrs[nmsg];
+      memcpy(&to, &_remote, _remote_len);
+      if (dst_anno)
+	to.in.sin_addr = p->dst_ip_anno();
+      mh.msg_name = &to;
+      mh.msg_namelen = _remote_len;
+      mh.msg_iov = &_iovs[niov];
+      mh.msg_control = 0;
+      mh.msg_controllen = 0;
+      mh.msg_flags = 0;
+
+      uint32_t seg = p->length(), total = 0;
+      int n = 0;
+      do {
+	_iovs[niov].iov_base = const_cast<unsigned char *>(p->data());
+	_iovs[niov].iov_len = p->length();
+	total += p->length();
+	niov++;
+	n++;
+	uint32_t len = p->length();
+	p = p->next();
+	if (!_gso || !p || len != seg || seg == 0 || n == 64
+	    || total + p->length() > 65507 || p->length() > seg
+	    || (dst_anno && p->dst_ip_anno() != to.in.sin_addr))
+	  break;
+      } while (1);
+      mh.msg_iovlen = n;
+
+# ifdef UDP_SEGMENT
+      if (n > 1) {
+	mh.msg_control = _cmsgs + nmsg * cmsg_space;
+	mh.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+	struct cmsghdr *c = CMSG_FIRSTHDR(&mh);
+	c->cmsg_level = IPPROTO_UDP;
+	c->cmsg_type = UDP_SEGMENT;
+	c->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+	uint16_t gso_size = seg;
+	memcpy(CMSG_DATA(c), &gso_size, sizeof(uint16_t));
+      }
+# endif
+      nmsg++;
+    }
+
+    int r = sendmmsg(_active, _msgs, nmsg, 0);
+    if (r < 0) {
+      // out of memory or would block
+      if (errno == ENOBUFS || errno == EAGAIN)
+	return -1;
+
+      // interrupted by signal, try again immediately
+      else if (errno == EINTR)
+	continue;
+
+      // the device cannot segment this burst; send datagrams separately
+      else if (_gso && _msgs[0].msg_hdr.msg_iovlen > 1
+	       && (errno == EINVAL || errno == EIO)) {
+	if (_verbose)
+	  click_chatter("%s: sendmmsg: %s, disabling GSO", declaration().c_str(), strerror(errno));
+	_gso = false;
+	continue;
+      }
+
+      // connection probably terminated or other fatal error
+      else {
+	if (_verbose)
+	  click_chatter("%s: %s", declaration().c_str(), strerror(errno));
+	_wb.kill();
+	close_active();
+	return 0;
+      }
+    }
+
+    // free the packets of the messages that were sent
+    for (int i = 0; i < r; i++)
+      for (size_t j = 0; j < _msgs[i].msg_hdr.msg_iovlen; j++)
+	_wb.pop_front()->kill();
+  }
+
+  return 0;
+#else
+  return write_packet(_wb.pop_front());
+#endif
+}
+
 void
 Socket::push(int, Packet *p)
 {
@@ -507,7 +801,32 @@ Socket::run_task(Task *)
   assert(ninputs() && input_is_pull(0));
   bool any = false;
 
-  if (_active >= 0) {
+  if (_active >= 0 && _burst > 1) {
+    int err = 0;
+
+    // write as much as we can, a burst at a time
+    do {
+      if (_wb.empty())
+	input(0).pull_batch(_wb, _burst);
+      if (_wb.empty())
+	break;
+      any = true;
+      err = write_burst();
+    } while (err >= 0 && _active >= 0);
+
+    if (_active < 0)
+      /* connection closed */;
+    else if (err < 0)
+      // keep the rest of the burst for when the socket becomes available
+      add_select(_active, SELECT_WRITE);
+    else if (_signal)
+      // more pending
+      _task.fast_reschedule();
+    else
+      // wrote all we could and no more pending
+      remove_select(_active, SELECT_WRITE);
+
+  } else if (_active >= 0) {
     Packet *p = 0;
     int err = 0;
 
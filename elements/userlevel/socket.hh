@@ -6,6 +6,7 @@
 #include <click/task.hh>
 #include <click/timer.hh>
 #include <click/notifier.hh>
+#include <click/packetbatch.hh>
 #include "../ip/iproutetable.hh"
 #include <sys/un.h>
 CLICK_DECLS
@@ -142,6 +143,33 @@ Boolean. PlanetLab specific. If true and Click has been configured
 
 Integer. Per-packet headroom. Defaults to 28.
 
+=item BURST
+
+Integer. Applies to datagram sockets only. The maximum number of
+datagrams to receive or send per system call. If greater than 1 and
+the system supports recvmmsg() and sendmmsg(), Socket preallocates
+BURST receive packets, reads up to BURST datagrams per readiness
+event, and emits them downstream as a single batch; a "pull" Socket
+pulls up to BURST packets at a time and sends them with one
+sendmmsg(). Default is 1.
+
+=item GSO
+
+Boolean. Applies to UDP sockets with BURST greater than 1. If true
+and the kernel supports UDP segmentation offload, consecutive pulled
+packets with the same length and destination are handed to the kernel
+as one large datagram, which the kernel or device splits into the
+original datagrams. Default is false.
+
+=item GRO
+
+Boolean. Applies to UDP sockets with BURST greater than 1. If true
+and the kernel supports UDP generic receive offload, the kernel may
+deliver several same-sized datagrams from one sender in a single
+large read; Socket splits them back into one packet per datagram.
+Each preallocated receive packet is then 65535 bytes long. Default is
+false.
+
 =back
 
 =e
@@ -201,13 +229,15 @@ private:
   int _fd;	// socket descriptor
   int _active;	// connection descriptor
 
+  union sockaddr_union { struct sockaddr_in in; struct sockaddr_un un; };
+
   // local address to bind()
-  union { struct sockaddr_in in; struct sockaddr_un un; } _local;
+  sockaddr_union _local;
   socklen_t _local_len;
 
   // remote address to connect() to or sendto() (for
   // non-connection-mode sockets)
-  union { struct sockaddr_in in; struct sockaddr_un un; } _remote;
+  sockaddr_union _remote;
   socklen_t _remote_len;
 
   NotifierSignal _signal;	// packet is available to pull()
@@ -238,7 +268,21 @@ private:
   IPRouteTable *_allow;		// lookup table of good hosts
   IPRouteTable *_deny;		// lookup table of bad hosts
 
+  int _burst;			// datagrams per recvmmsg()/sendmmsg()
+  bool _gso;			// send with UDP segmentation offload
+  bool _gro;			// receive with UDP generic receive offload
+  struct mmsghdr *_msgs;	// message headers for recvmmsg()/sendmmsg()
+  struct iovec *_iovs;		// one per message or pulled packet
+  sockaddr_union *_addrs;	// per-message source or destination
+  char *_cmsgs;			// per-message control data (GSO/GRO)
+  WritablePacket **_rslab;	// preallocated receive packets
+  uint32_t _rslab_len;		// length of each receive packet
+  PacketBatch _wb;		// pulled packets not yet sent
+
   int initialize_socket_error(ErrorHandler *, const char *);
+  int initialize_burst(ErrorHandler *);
+  int read_burst();
+  int write_burst();
 
 };
 
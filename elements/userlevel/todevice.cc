@@ -57,13 +57,22 @@ CLICK_DECLS
 
 ToDevice::ToDevice()
   : _task(this), _timer(&_task), _fd(-1), _my_fd(false),
-    _q(0),
+    _burst(1),
+#if TODEVICE_SENDMMSG
+    _msgs(0), _iovs(0),
+#endif
     _pulls(0)
 {
+  memset(_pull_hist, 0, sizeof(_pull_hist));
+  memset(_send_hist, 0, sizeof(_send_hist));
 }
 
 ToDevice::~ToDevice()
 {
+#if TODEVICE_SENDMMSG
+  delete[] _msgs;
+  delete[] _iovs;
+#endif
 }
 
 int
@@ -73,10 +82,13 @@ ToDevice::configure(Vector<String> &conf, ErrorHandler *errh)
   if (cp_va_kparse(conf, this, errh,
 		   "DEVNAME", cpkP+cpkM, cpString, &_ifname,
 		   "DEBUG", 0, cpBool, &_debug,
+		   "BURST", 0, cpInteger, &_burst,
 		   cpEnd) < 0)
     return -1;
   if (!_ifname)
     return errh->error("interface not set");
+  if (_burst < 1)
+    return errh->error("BURST must be at least 1");
   return 0;
 }
 
@@ -143,6 +155,20 @@ ToDevice::initialize(ErrorHandler *errh)
     return errh->error("duplicate writer for device `%s'", _ifname.c_str());
   used = this;
 
+#if TODEVICE_SENDMMSG
+  if (_burst > 1) {
+    _msgs = new struct mmsghdr[_burst];
+    _iovs = new struct iovec[_burst];
+    if (!_msgs || !_iovs)
+      return errh->error("out of memory");
+    memset(_msgs, 0, sizeof(struct mmsghdr) * _burst);
+    for (int i = 0; i < _burst; i++) {
+      _msgs[i].msg_hdr.msg_iov = &_iovs[i];
+      _msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+  }
+#endif
+
   ScheduleInfo::join_scheduler(this, &_task, errh);
   _signal = Notifier::upstream_empty_signal(this, 0, &_task);
   return 0;
@@ -151,12 +177,37 @@ ToDevice::initialize(ErrorHandler *errh)
 void
 ToDevice::cleanup(CleanupStage)
 {
+  _q.kill();
   if (_fd >= 0 && _my_fd)
     close(_fd);
   _fd = -1;
 }
 
 
+void
+ToDevice::record_burst(uint32_t *hist, int n)
+{
+    int b = 0;
+    while ((n >> (b + 1)) && b < nhist - 1)
+	b++;
+    hist[b]++;
+}
+
+String
+ToDevice::unparse_hist(const uint32_t *hist)
+{
+    StringAccum sa;
+    for (int b = 0; b < nhist; b++)
+	if (hist[b]) {
+	    if (b == 0)
+		sa << "1 ";
+	    else
+		sa << (1 << b) << '-' << (2 << b) - 1 << ' ';
+	    sa << hist[b] << '\n';
+	}
+    return sa.take_string();
+}
+
 /*
  * Linux select marks datagram fd's as writeable when the socket
  * buffer has enough space to do a send (sock_writeable() in
@@ -170,17 +221,40 @@ ToDevice::cleanup(CleanupStage)
 bool
 ToDevice::run_task(Task *)
 {
-    Packet *p = _q;
-    _q = 0;
-    if (!p) {
-	p = input(0).pull();
+    if (_q.empty()) {
+	input(0).pull_batch(_q, _burst);
 	_pulls++;
+	if (!_q.empty())
+	    record_burst(_pull_hist, _q.count());
     }
 
-    if (p) {
+    PacketBatch sent;
+    bool worked = !_q.empty();
+    while (Packet *p = _q.front()) {
 	int retval;
 	const char *syscall;
-
+	int n = 1;
+
+#if TODEVICE_SENDMMSG
+	if (_q.count() > 1) {
+	    // _q never holds more than _burst packets
+	    n = 0;
+	    for (; p; p = p->next(), n++) {
+		_iovs[n].iov_base = const_cast<unsigned char *>(p->data());
+		_iovs[n].iov_len = p->length();
+	    }
+	    retval = sendmmsg(_fd, _msgs, n, 0);
+	    if (retval > 0)
+		n = retval;
+	    else if (retval == 0) {
+		// nothing was sent: keep the packets and wait, as for EAGAIN
+		retval = -1;
+		errno = EAGAIN;
+	    }
+	    syscall = "sendmmsg";
+	} else
+#endif
+	{
 #if TODEVICE_WRITE
 	retval = ((uint32_t) write(_fd, p->data(), p->length()) == p->length() ? 0 : -1);
 	syscall = "write";
@@ -190,15 +264,16 @@ ToDevice::run_task(Task *)
 #else
 	retval = 0;
 #endif
+	}
 
 	if (retval >= 0) {
 	    _backoff = 0;
-	    checked_output_push(0, p);
+	    record_burst(_send_hist, n);
+	    for (; n > 0; n--)
+		sent.push_back(_q.pop_front());
 
 	} else if (errno == ENOBUFS || errno == EAGAIN) {
-	    assert(!_q);
-	    _q = p;
-
+	    // leave the unsent packets in _q for next time
 	    if (!_backoff) {
 		_backoff = 1;
 		add_select(_fd, SELECT_WRITE);
@@ -212,18 +287,20 @@ ToDevice::run_task(Task *)
 		}
 	    }
 
+	    checked_output_push_batch(0, sent);
 	    return false;
 
 	} else {
 	    click_chatter("ToDevice(%s) %s: %s", _ifname.c_str(), syscall, strerror(errno));
-	    checked_output_push(1, p);
+	    checked_output_push(1, _q.pop_front());
 	}
     }
 
-    if (!p && !_signal)
+    checked_output_push_batch(0, sent);
+    if (!worked && !_signal)
 	return false;
     _task.fast_reschedule();
-    return p != 0;
+    return worked;
 }
 
 void
@@ -234,7 +311,8 @@ ToDevice::selected(int)
 }
 
 
-enum {H_DEBUG, H_SIGNAL, H_PULLS, H_Q};
+enum {H_DEBUG, H_SIGNAL, H_PULLS, H_Q, H_PULL_BURSTS, H_SEND_BURSTS,
+      H_RESET_COUNTS};
 
 String
 ToDevice::read_param(Element *e, void *thunk)
@@ -248,7 +326,11 @@ ToDevice::read_param(Element *e, void *thunk)
   case H_PULLS:
       return String(td->_pulls);
   case H_Q:
-      return String((bool) td->_q);
+      return String(!td->_q.empty());
+  case H_PULL_BURSTS:
+      return unparse_hist(td->_pull_hist);
+  case H_SEND_BURSTS:
+      return unparse_hist(td->_send_hist);
   default:
       return String();
   }
@@ -268,6 +350,10 @@ ToDevice::write_param(const String &in_s, Element *e, void *vparam,
     td->_debug = debug;
     break;
   }
+  case H_RESET_COUNTS:
+    memset(td->_pull_hist, 0, sizeof(td->_pull_hist));
+    memset(td->_send_hist, 0, sizeof(td->_send_hist));
+    break;
   }
   return 0;
 }
@@ -281,8 +367,11 @@ ToDevice::add_handlers()
   add_read_handler("pulls", read_param, (void *) H_PULLS);
   add_read_handler("signal", read_param, (void *) H_SIGNAL);
   add_read_handler("q", read_param, (void *) H_Q);
+  add_read_handler("pull_bursts", read_param, (void *) H_PULL_BURSTS);
+  add_read_handler("send_bursts", read_param, (void *) H_SEND_BURSTS);
 
   add_write_handler("debug", write_param, (void *) H_DEBUG);
+  add_write_handler("reset_counts", write_param, (void *) H_RESET_COUNTS, Handler::BUTTON);
 
 }
 
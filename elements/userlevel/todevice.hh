@@ -30,6 +30,14 @@ CLICK_DECLS
  *
  * Boolean.  If true, print out debug messages.
  *
+ * =item BURST
+ *
+ * Integer.  The maximum number of packets to pull and send per task
+ * invocation.  Default is 1.  Where the sendmmsg() system call is available,
+ * ToDevice hands each burst to the kernel in as few system calls as
+ * possible.  Packets that could not be sent because the device's send buffer
+ * was full are kept and sent first on the next attempt.
+ *
  * =back
  *
  * This element is only available at user level.
@@ -46,6 +54,20 @@ CLICK_DECLS
  *
  * Packets that are written successfully are sent on output 0, if it exists.
  * Packets that fail to be written are pushed out output 1, if it exists.
+ *
+ * =h pull_bursts read-only
+ *
+ * Returns a histogram of the number of packets obtained per pull, one
+ * "RANGE COUNT" line per power-of-two size range.
+ *
+ * =h send_bursts read-only
+ *
+ * Returns a histogram, in the same format, of the number of packets sent per
+ * system call.
+ *
+ * =h reset_counts write-only
+ *
+ * Resets the burst histograms.
 
  * KernelTun lets you send IP packets to the host kernel's IP processing code,
  * sort of like the kernel module's ToHost element.
@@ -56,6 +78,11 @@ CLICK_DECLS
 #if defined(__linux__)
 # define TODEVICE_LINUX 1
 # define TODEVICE_SEND 1
+# if HAVE_SENDMMSG
+#  define TODEVICE_SENDMMSG 1
+#  include <sys/socket.h>
+#  include <sys/uio.h>
+# endif
 #elif HAVE_PCAP
 extern "C" {
 # include <pcap.h>
@@ -103,7 +130,18 @@ private:
   NotifierSignal _signal;
 
 
-  Packet *_q;
+  PacketBatch _q;
+  int _burst;
+#if TODEVICE_SENDMMSG
+  struct mmsghdr *_msgs;
+  struct iovec *_iovs;
+#endif
+
+  enum { nhist = 16 };
+  uint32_t _pull_hist[nhist];
+  uint32_t _send_hist[nhist];
+  static void record_burst(uint32_t *hist, int n);
+  static String unparse_hist(const uint32_t *hist);
 public:
   bool _debug;
   bool _backoff;
@@ -23,9 +23,7 @@
 #include "todump.hh"
 #include <click/confparse.hh>
 #include <click/router.hh>
-#if CLICK_NS
-# include <click/master.hh>
-#endif
+#include <click/master.hh>
 #include <click/error.hh>
 #include <click/standard/scheduleinfo.hh>
 #include <click/packet_anno.hh>
@@ -53,6 +51,8 @@ ToDump::configure(Vector<String> &conf, ErrorHandler *errh)
     bool per_node = false;
 #endif
 
+    if (_aw.configure_keywords(conf, this, errh) < 0)
+	return -1;
     if (cp_va_kparse(conf, this, errh,
 		     "FILENAME", cpkP+cpkM, cpFilename, &_filename,
 		     "SNAPLEN", cpkP, cpUnsigned, &_snaplen,
@@ -103,7 +103,8 @@ ToDump::hotswap_element() const
     if (Element *e = Element::hotswap_element())
 	if (ToDump *td = (ToDump *)e->cast("ToDump"))
 	    if (td->_filename == _filename
-		&& td->_linktype == _linktype)
+		&& td->_linktype == _linktype
+		&& !td->_aw.enabled() && !_aw.enabled())
 		return td;
     return 0;
 }
@@ -153,6 +154,8 @@ ToDump::initialize(ErrorHandler *errh)
 	    _fp = stdout;
 	    _filename = "<stdout>";
 	}
+	if (_aw.initialize(_fp, this, errh) < 0)
+	    return -1;
 
 	struct fake_pcap_file_header h;
 
@@ -165,7 +168,11 @@ ToDump::initialize(ErrorHandler *errh)
 	h.snaplen = _snaplen;
 	h.linktype = _linktype;
 
-	size_t wrote_header = fwrite(&h, sizeof(h), 1, _fp);
+	size_t wrote_header;
+	if (_aw.enabled())
+	    wrote_header = _aw.write(&h, sizeof(h));
+	else
+	    wrote_header = fwrite(&h, sizeof(h), 1, _fp);
 	if (wrote_header != 1)
 	    return errh->error("%s: unable to write file header", _filename.c_str());
     }
@@ -189,6 +196,7 @@ ToDump::take_state(Element *e, ErrorHandler *)
 void
 ToDump::cleanup(CleanupStage)
 {
+    _aw.cleanup();
     if (_fp && _fp != stdout)
 	fclose(_fp);
     _fp = 0;
@@ -215,17 +223,30 @@ ToDump::write_packet(Packet *p)
 	to_write = _snaplen;
     ph.caplen = to_write;
 
+    if (_aw.enabled()) {
+	if (_aw.write(&ph, sizeof(ph), p->data(), to_write))
+	    _count++;
+	if (_aw.error())
+	    write_error(_aw.error());
+	return;
+    }
+
     // XXX writing to pipe?
     if (fwrite(&ph, sizeof(ph), 1, _fp) == 0
 	|| fwrite(p->data(), 1, to_write, _fp) == 0) {
-	if (errno != EAGAIN) {
-	    _active = false;
-	    click_chatter("ToDump(%s): %s", _filename.c_str(), strerror(errno));
-	}
+	if (errno != EAGAIN)
+	    write_error(errno);
     } else
 	_count++;
 }
 
+void
+ToDump::write_error(int err)
+{
+    _active = false;
+    click_chatter("ToDump(%s): %s", _filename.c_str(), strerror(err));
+}
+
 void
 ToDump::push(int, Packet *p)
 {
@@ -258,7 +279,7 @@ ToDump::run_task(Task *)
     return p != 0;
 }
 
-enum { H_FILENAME = 0, H_COUNT = 1, H_RESET_COUNTS = 2 };
+enum { H_FILENAME = 0, H_COUNT = 1, H_RESET_COUNTS = 2, H_FLUSH = 3 };
 
 String
 ToDump::read_handler(Element *e, void *thunk)
@@ -275,11 +296,22 @@ ToDump::read_handler(Element *e, void *thunk)
 }
 
 int
-ToDump::write_handler(const String &, Element *e, void *, ErrorHandler *)
+ToDump::write_handler(const String &, Element *e, void *thunk, ErrorHandler *)
 {
     ToDump *td = static_cast<ToDump *>(e);
-    td->_count = 0;
-    return 0;
+    switch ((uintptr_t) thunk) {
+    case H_RESET_COUNTS:
+	td->_count = 0;
+	return 0;
+    case H_FLUSH:
+	if (td->_aw.enabled())
+	    td->_aw.flush();
+	else if (td->_fp)
+	    fflush(td->_fp);
+	return 0;
+    default:
+	return -1;
+    }
 }
 
 void
@@ -288,10 +320,12 @@ ToDump::add_handlers()
     add_read_handler("filename", read_handler, (void *)H_FILENAME);
     add_read_handler("count", read_handler, (void *)H_COUNT);
     add_write_handler("reset_counts", write_handler, (void *)H_RESET_COUNTS, Handler::BUTTON);
+    add_write_handler("flush", write_handler, (void *)H_FLUSH, Handler::BUTTON);
+    _aw.add_handlers(this);
     if (input_is_pull(0) && noutputs() == 0)
 	add_task_handlers(&_task);
 }
 
 CLICK_ENDDECLS
-ELEMENT_REQUIRES(userlevel|ns FakePcap)
+ELEMENT_REQUIRES(userlevel|ns FakePcap AsyncWriter)
 EXPORT_ELEMENT(ToDump)
@@ -5,13 +5,14 @@
 #include <click/element.hh>
 #include <click/task.hh>
 #include <click/notifier.hh>
+#include "asyncwriter.hh"
 #include <stdio.h>
 CLICK_DECLS
 
 /*
 =c
 
-ToDump(FILENAME [, I<keywords> SNAPLEN, ENCAP, USE_ENCAP_FROM, EXTRA_LENGTH])
+ToDump(FILENAME [, I<keywords> SNAPLEN, ENCAP, USE_ENCAP_FROM, EXTRA_LENGTH, ASYNC, ASYNC_BUFFER, ASYNC_NBUFFERS, DIRECT])
 
 =s traces
 
@@ -60,6 +61,30 @@ USE_ENCAP_FROM. FromDump and FromDevice.u have `encap' handlers.
 Boolean. Set to true if you want ToDump to store any extra length as recorded
 in packets' extra length annotations. Default is true.
 
+=item ASYNC
+
+Boolean. If true, ToDump copies each packet record into a buffer and returns
+immediately; a separate writer thread writes full buffers to the file. If the
+writer falls behind and no buffer is free, ToDump drops the record and counts
+it in the C<drops> handler instead of delaying the packet. Requires a
+multithreaded Click. Default is false.
+
+=item ASYNC_BUFFER
+
+Unsigned. Size of each ASYNC buffer in bytes, rounded up to a multiple of
+4096. Default is 262144.
+
+=item ASYNC_NBUFFERS
+
+Unsigned. Number of ASYNC buffers, at least 2. Default is 8.
+
+=item DIRECT
+
+Boolean. If true, the ASYNC writer thread writes to the file with O_DIRECT,
+bypassing the page cache, in whole multiples of ASYNC_BUFFER. Only works
+for regular files, and only if the operating system supports O_DIRECT.
+Requires ASYNC. Default is false.
+
 =back
 
 This element is only available at user level.
@@ -80,6 +105,15 @@ Resets "count" to 0.
 
 Returns the filename.
 
+=h drops read-only
+
+Returns the number of records dropped because the ASYNC writer thread fell
+behind. Only present if ASYNC is true.
+
+=h flush write-only
+
+Writes any buffered records to the file.
+
 =a
 
 FromDump, FromDevice.u, ToDevice.u, tcpdump(1) */
@@ -126,10 +160,12 @@ class ToDump : public Element { public:
     Task _task;
     NotifierSignal _signal;
     Element **_use_encap_from;
+    AsyncWriter _aw;
 
     static String read_handler(Element *, void *);
     static int write_handler(const String &, Element *, void *, ErrorHandler *);
     void write_packet(Packet *);
+    void write_error(int err);
 
 };
 
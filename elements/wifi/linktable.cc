@@ -48,9 +48,14 @@ LinkTable::initialize (ErrorHandler *)
 void
 LinkTable::run_timer(Timer *)
 {
-  clear_stale();
-  dijkstra(true);
-  dijkstra(false);
+  // update_link keeps the trees current; recompute them only when links
+  // have gone away
+  if (clear_stale())
+    rebuild_graph();
+  if (!_tree[true]._valid)
+    dijkstra(true);
+  if (!_tree[false]._valid)
+    dijkstra(false);
   _timer.schedule_after_msec(5000);
 }
 void *
@@ -76,7 +81,7 @@ LinkTable::configure (Vector<String> &conf, ErrorHandler *errh)
 
   _stale_timeout.assign(stale_period, 0);
 
-  _hosts.insert(_ip, HostInfo(_ip));
+  ensure_host(_ip);
   return ret;
 }
 
@@ -88,6 +93,9 @@ LinkTable::take_state(Element *e, ErrorHandler *) {
 
   _hosts = q->_hosts;
   _links = q->_links;
+  _node_ip = q->_node_ip;
+  ensure_host(_ip);
+  rebuild_graph();
   dijkstra(true);
   dijkstra(false);
 }
@@ -138,7 +146,87 @@ LinkTable::clear()
 {
   _hosts.clear();
   _links.clear();
+  _node_ip.clear();
+  ensure_host(_ip);
+  rebuild_graph();
+}
+
+int
+LinkTable::host_index(IPAddress ip) const
+{
+  const HostInfo *nfo = _hosts.findp(ip);
+  return nfo ? nfo->_index : -1;
+}
+
+int
+LinkTable::ensure_host(IPAddress ip)
+{
+  HostInfo *nfo = _hosts.findp(ip);
+  if (nfo) {
+    return nfo->_index;
+  }
+  int x = _node_ip.size();
+  _hosts.insert(ip, HostInfo(ip, x));
+  _node_ip.push_back(ip);
+  _out.push_back(Vector<Edge>());
+  _in.push_back(Vector<Edge>());
+  for (int t = 0; t < 2; t++) {
+    _tree[t]._metric.push_back(UNREACHED);
+    _tree[t]._prev.push_back(-1);
+  }
+  _heap_pos.push_back(-1);
+  return x;
+}
+
+void
+LinkTable::set_adjacent(Vector<Edge> &adj, int node, uint32_t metric)
+{
+  Edge *e;
+  for (e = adj.begin(); e != adj.end() && e->_node != node; e++)
+    /* nada */;
+  if (e == adj.end()) {
+    if (metric) {
+      adj.push_back(Edge(node, metric));
+    }
+  } else if (metric) {
+    e->_metric = metric;
+  } else {
+    *e = adj.back();
+    adj.pop_back();
+  }
+}
+
+/* Sets the metric of the link from -> to. Metric 0 means no link, as in
+ * dijkstra's original link scan. */
+void
+LinkTable::set_edge(int from, int to, uint32_t metric)
+{
+  set_adjacent(_out[from], to, metric);
+  set_adjacent(_in[to], from, metric);
+}
 
+void
+LinkTable::rebuild_graph()
+{
+  int n = _node_ip.size();
+  _out.clear();
+  _out.resize(n);
+  _in.clear();
+  _in.resize(n);
+  for (LTIter iter = _links.begin(); iter.live(); iter++) {
+    const LinkInfo &nfo = iter.value();
+    if (nfo._metric) {
+      set_edge(host_index(nfo._from), host_index(nfo._to), nfo._metric);
+    }
+  }
+  for (int t = 0; t < 2; t++) {
+    _tree[t]._metric.resize(n, UNREACHED);
+    _tree[t]._prev.resize(n, -1);
+    _tree[t]._valid = false;
+  }
+  _heap.clear();
+  _heap_pos.clear();
+  _heap_pos.resize(n, -1);
 }
 bool
 LinkTable::update_link(IPAddress from, IPAddress to,
@@ -152,27 +240,28 @@ LinkTable::update_link(IPAddress from, IPAddress to,
   }
 
   /* make sure both the hosts exist */
-  HostInfo *nfrom = _hosts.findp(from);
-  if (!nfrom) {
-    HostInfo foo = HostInfo(from);
-    _hosts.insert(from, foo);
-    nfrom = _hosts.findp(from);
-  }
-  HostInfo *nto = _hosts.findp(to);
-  if (!nto) {
-    _hosts.insert(to, HostInfo(to));
-    nto = _hosts.findp(to);
-  }
-
-  assert(nfrom);
-  assert(nto);
+  int nfrom = ensure_host(from);
+  int nto = ensure_host(to);
 
   IPPair p = IPPair(from, to);
   LinkInfo *lnfo = _links.findp(p);
+  uint32_t old_metric = UNREACHED;
   if (!lnfo) {
     _links.insert(p, LinkInfo(from, to, seq, age, metric));
   } else {
+    old_metric = lnfo->_metric;
     lnfo->update(seq, age, metric);
+    metric = lnfo->_metric;
+  }
+
+  if (old_metric == 0) {
+    old_metric = UNREACHED;
+  }
+  if (metric != old_metric) {
+    set_edge(nfrom, nto, metric);
+    /* the from_me tree follows links forward, the to_me tree backward */
+    update_tree(true, nfrom, nto, old_metric, metric);
+    update_tree(false, nto, nfrom, old_metric, metric);
   }
   return true;
 }
@@ -211,11 +300,11 @@ LinkTable::get_host_metric_to_me(IPAddress s)
   if (!s) {
     return 0;
   }
-  HostInfo *nfo = _hosts.findp(s);
-  if (!nfo) {
+  int x = host_index(s);
+  if (x < 0) {
     return 0;
   }
-  return nfo->_metric_to_me;
+  return host_metric(false, x);
 }
 
 uint32_t
@@ -224,11 +313,11 @@ LinkTable::get_host_metric_from_me(IPAddress s)
   if (!s) {
     return 0;
   }
-  HostInfo *nfo = _hosts.findp(s);
-  if (!nfo) {
+  int x = host_index(s);
+  if (x < 0) {
     return 0;
   }
-  return nfo->_metric_from_me;
+  return host_metric(true, x);
 }
 
 uint32_t
@@ -345,25 +434,17 @@ LinkTable::best_route(IPAddress dst, bool from_me)
   if (!dst) {
     return reverse_route;
   }
-  HostInfo *nfo = _hosts.findp(dst);
+  int x = host_index(dst);
+  if (x < 0) {
+    return reverse_route;
+  }
 
-  if (from_me) {
-    while (nfo && nfo->_metric_from_me != 0) {
-      reverse_route.push_back(nfo->_ip);
-      nfo = _hosts.findp(nfo->_prev_from_me);
-    }
-    if (nfo && nfo->_metric_from_me == 0) {
-    reverse_route.push_back(nfo->_ip);
-    }
-  } else {
-    while (nfo && nfo->_metric_to_me != 0) {
-      reverse_route.push_back(nfo->_ip);
-      nfo = _hosts.findp(nfo->_prev_to_me);
-    }
-    if (nfo && nfo->_metric_to_me == 0) {
-      reverse_route.push_back(nfo->_ip);
-    }
+  const Tree &tree = _tree[from_me];
+  while (host_metric(from_me, x) != 0) {
+    reverse_route.push_back(_node_ip[x]);
+    x = tree._prev[x];
   }
+  reverse_route.push_back(_node_ip[x]);
 
 
   if (from_me) {
@@ -456,15 +537,17 @@ LinkTable::print_hosts()
 
 
 
-void
+bool
 LinkTable::clear_stale() {
 
   LTable links;
+  bool removed = false;
   for (LTIter iter = _links.begin(); iter.live(); iter++) {
     LinkInfo nfo = iter.value();
     if ((unsigned) _stale_timeout.sec() >= nfo.age()) {
       links.insert(IPPair(nfo._from, nfo._to), nfo);
     } else {
+      removed = true;
       if (0) {
 	click_chatter("%{element} :: %s removing link %s -> %s metric %d seq %d age %d\n",
 		      this,
@@ -483,145 +566,193 @@ LinkTable::clear_stale() {
     LinkInfo nfo = iter.value();
     _links.insert(IPPair(nfo._from, nfo._to), nfo);
   }
-
+  return removed;
 }
 
 Vector<IPAddress>
 LinkTable::get_neighbors(IPAddress ip)
 {
   Vector<IPAddress> neighbors;
+  int x = host_index(ip);
+  if (x < 0) {
+    return neighbors;
+  }
+  for (const Edge *e = _out[x].begin(); e != _out[x].end(); e++) {
+    if (e->_node != x) {
+      neighbors.push_back(_node_ip[e->_node]);
+    }
+  }
+  return neighbors;
+}
 
-  typedef HashMap<IPAddress, bool> IPMap;
-  IPMap ip_addrs;
+uint32_t
+LinkTable::host_metric(bool from_me, int x) const
+{
+  const Tree &tree = _tree[from_me];
+  if (!tree._valid || tree._metric[x] == UNREACHED) {
+    return 0;
+  }
+  return tree._metric[x];
+}
 
-  for (HTIter iter = _hosts.begin(); iter.live(); iter++) {
-    ip_addrs.insert(iter.value()._ip, true);
+void
+LinkTable::heap_update(const Vector<uint32_t> &metric, int x)
+{
+  int i = _heap_pos[x];
+  if (i < 0) {
+    i = _heap.size();
+    _heap.push_back(x);
+  }
+  // sift up: x's metric has only decreased
+  while (i > 0) {
+    int p = (i - 1) / 2;
+    if (metric[_heap[p]] <= metric[x]) {
+      break;
+    }
+    _heap[i] = _heap[p];
+    _heap_pos[_heap[i]] = i;
+    i = p;
   }
+  _heap[i] = x;
+  _heap_pos[x] = i;
+}
 
-  for (IPMap::const_iterator i = ip_addrs.begin(); i.live(); i++) {
-    HostInfo *neighbor = _hosts.findp(i.key());
-    assert(neighbor);
-    if (ip != neighbor->_ip) {
-      LinkInfo *lnfo = _links.findp(IPPair(ip, neighbor->_ip));
-      if (lnfo) {
-	neighbors.push_back(neighbor->_ip);
+int
+LinkTable::heap_pop(const Vector<uint32_t> &metric)
+{
+  int top = _heap[0];
+  _heap_pos[top] = -1;
+  int x = _heap.back();
+  _heap.pop_back();
+  int n = _heap.size();
+  if (n > 0) {
+    int i = 0;
+    while (1) {
+      int c = 2 * i + 1;
+      if (c >= n) {
+	break;
+      }
+      if (c + 1 < n && metric[_heap[c + 1]] < metric[_heap[c]]) {
+	c++;
       }
+      if (metric[x] <= metric[_heap[c]]) {
+	break;
+      }
+      _heap[i] = _heap[c];
+      _heap_pos[_heap[i]] = i;
+      i = c;
     }
-
+    _heap[i] = x;
+    _heap_pos[x] = i;
   }
+  return top;
+}
 
-  return neighbors;
+/* Runs Dijkstra's algorithm from the hosts in the heap, following the
+ * adjacency arrays in fwd. */
+void
+LinkTable::settle(Tree &tree, const Vector<Vector<Edge> > &fwd)
+{
+  while (_heap.size()) {
+    int x = heap_pop(tree._metric);
+    uint32_t base = tree._metric[x];
+    for (const Edge *e = fwd[x].begin(); e != fwd[x].end(); e++) {
+      uint64_t m = (uint64_t) base + e->_metric;
+      uint32_t adjusted_metric = (m < UNREACHED ? m : UNREACHED - 1);
+      if (adjusted_metric < tree._metric[e->_node]) {
+	tree._metric[e->_node] = adjusted_metric;
+	tree._prev[e->_node] = x;
+	heap_update(tree._metric, e->_node);
+      }
+    }
+  }
 }
+
 void
 LinkTable::dijkstra(bool from_me)
 {
   Timestamp start = Timestamp::now();
-  IPAddress src = _ip;
-
-  typedef HashMap<IPAddress, bool> IPMap;
-  IPMap ip_addrs;
-
-  for (HTIter iter = _hosts.begin(); iter.live(); iter++) {
-    ip_addrs.insert(iter.value()._ip, true);
-  }
+  Tree &tree = _tree[from_me];
+  int root = ensure_host(_ip);
 
-  for (IPMap::const_iterator i = ip_addrs.begin(); i.live(); i++) {
+  for (int x = 0; x < _node_ip.size(); x++) {
     /* clear them all initially */
-    HostInfo *n = _hosts.findp(i.key());
-    n->clear(from_me);
+    tree._metric[x] = UNREACHED;
+    tree._prev[x] = -1;
   }
-  HostInfo *root_info = _hosts.findp(src);
-
-
-  assert(root_info);
+  tree._metric[root] = 0;
+  tree._prev[root] = root;
+  heap_update(tree._metric, root);
+  settle(tree, from_me ? _out : _in);
+  tree._valid = true;
 
-  if (from_me) {
-    root_info->_prev_from_me = root_info->_ip;
-    root_info->_metric_from_me = 0;
-  } else {
-    root_info->_prev_to_me = root_info->_ip;
-    root_info->_metric_to_me = 0;
-  }
-
-  IPAddress current_min_ip = root_info->_ip;
+  dijkstra_time = Timestamp::now() - start;
+}
 
-  while (current_min_ip) {
-    HostInfo *current_min = _hosts.findp(current_min_ip);
-    assert(current_min);
-    if (from_me) {
-      current_min->_marked_from_me = true;
-    } else {
-      current_min->_marked_to_me = true;
+/* The metric of the link u -> v changed from old_metric (UNREACHED if it is
+ * new) to new_metric, where u is v's predecessor in the direction the tree
+ * grows. Repairs only the part of the tree that changes. */
+void
+LinkTable::update_tree(bool from_me, int u, int v,
+		       uint32_t old_metric, uint32_t new_metric)
+{
+  Tree &tree = _tree[from_me];
+  if (!tree._valid || u == v || tree._metric[u] == UNREACHED) {
+    return;
+  }
+  const Vector<Vector<Edge> > &fwd = (from_me ? _out : _in);
+  const Vector<Vector<Edge> > &back = (from_me ? _in : _out);
+
+  if (new_metric < old_metric) {
+    /* a shorter link can only shorten routes through v */
+    uint64_t m = (uint64_t) tree._metric[u] + new_metric;
+    if (m < tree._metric[v]) {
+      tree._metric[v] = m;
+      tree._prev[v] = u;
+      heap_update(tree._metric, v);
+      settle(tree, fwd);
     }
+    return;
+  }
 
-
-    for (IPMap::const_iterator i = ip_addrs.begin(); i.live(); i++) {
-      HostInfo *neighbor = _hosts.findp(i.key());
-      assert(neighbor);
-      bool marked = neighbor->_marked_to_me;
-      if (from_me) {
-	marked = neighbor->_marked_from_me;
-      }
-
-      if (marked) {
-	continue;
-      }
-
-      IPPair pair = IPPair(neighbor->_ip, current_min_ip);
-      if (from_me) {
-	pair = IPPair(current_min_ip, neighbor->_ip);
-      }
-      LinkInfo *lnfo = _links.findp(pair);
-      if (!lnfo || !lnfo->_metric) {
-	continue;
-      }
-      uint32_t neighbor_metric = neighbor->_metric_to_me;
-      uint32_t current_metric = current_min->_metric_to_me;
-
-      if (from_me) {
-	neighbor_metric = neighbor->_metric_from_me;
-	current_metric = current_min->_metric_from_me;
-      }
-
-
-      uint32_t adjusted_metric = current_metric + lnfo->_metric;
-      if (!neighbor_metric ||
-	  adjusted_metric < neighbor_metric) {
-	if (from_me) {
-	  neighbor->_metric_from_me = adjusted_metric;
-	  neighbor->_prev_from_me = current_min_ip;
-	} else {
-	  neighbor->_metric_to_me = adjusted_metric;
-	  neighbor->_prev_to_me = current_min_ip;
-	}
-
+  /* a longer link only matters if the tree uses it; then every route
+   * through it, v's subtree, must be found again */
+  if (tree._prev[v] != u) {
+    return;
+  }
+  Vector<int> subtree;
+  subtree.push_back(v);
+  for (int i = 0; i < subtree.size(); i++) {
+    int x = subtree[i];
+    for (const Edge *e = fwd[x].begin(); e != fwd[x].end(); e++) {
+      if (tree._prev[e->_node] == x && e->_node != x) {
+	subtree.push_back(e->_node);
       }
     }
+    tree._metric[x] = UNREACHED;
+    tree._prev[x] = -1;
+  }
 
-    current_min_ip = IPAddress();
-    uint32_t  min_metric = ~0;
-    for (IPMap::const_iterator i = ip_addrs.begin(); i.live(); i++) {
-      HostInfo *nfo = _hosts.findp(i.key());
-      uint32_t metric = nfo->_metric_to_me;
-      bool marked = nfo->_marked_to_me;
-      if (from_me) {
-	metric = nfo->_metric_from_me;
-	marked = nfo->_marked_from_me;
+  /* start each from its best neighbor outside the subtree */
+  for (int i = 0; i < subtree.size(); i++) {
+    int x = subtree[i];
+    for (const Edge *e = back[x].begin(); e != back[x].end(); e++) {
+      uint32_t base = tree._metric[e->_node];
+      if (base == UNREACHED || _heap_pos[e->_node] >= 0) {
+	continue;		// unreached, or in the subtree
       }
-      if (!marked && metric &&
-	  metric < min_metric) {
-        current_min_ip = nfo->_ip;
-        min_metric = metric;
+      uint64_t m = (uint64_t) base + e->_metric;
+      uint32_t adjusted_metric = (m < UNREACHED ? m : UNREACHED - 1);
+      if (adjusted_metric < tree._metric[x]) {
+	tree._metric[x] = adjusted_metric;
+	tree._prev[x] = e->_node;
       }
     }
-
-
+    if (tree._metric[x] != UNREACHED) {
+      heap_update(tree._metric, x);
+    }
   }
-
-  dijkstra_time = Timestamp::now() - start;
-  //StringAccum sa;
-  //sa << "dijstra took " << finish - start;
-  //click_chatter("%s: %s\n", name().c_str(), sa.take_string().c_str());
+  settle(tree, fwd);
 }
 
 
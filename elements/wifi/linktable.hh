@@ -16,7 +16,14 @@ CLICK_DECLS
  * Keeps a Link state database and calculates Weighted Shortest Path
  * for other elements
  * =d
- * Runs dijkstra's algorithm occasionally.
+ * Keeps shortest-path trees to and from this host. Hosts are numbered densely
+ * as they appear, and each keeps arrays of its incoming and outgoing links,
+ * so Dijkstra's algorithm runs over an indexed heap in O(E log V) time. When
+ * a single link's metric changes, only the routes that change are
+ * recomputed. A full recomputation runs when stale links are removed, and on
+ * the dijkstra handler.
+ * =h dijkstra_time read-only
+ * Returns the time taken by the last full shortest-path computation.
  * =a ARPTable
  *
  */
@@ -76,6 +83,7 @@ public:
   void clear();
 
   /* other public functions */
+  IPAddress ip() const { return _ip; }
   String route_to_string(Path p);
   bool update_link(IPAddress from, IPAddress to,
 		   uint32_t seq, uint32_t age, uint32_t metric);
@@ -94,7 +102,7 @@ public:
   unsigned get_route_metric(const Vector<IPAddress> &route);
   Vector<IPAddress> get_neighbors(IPAddress ip);
   void dijkstra(bool);
-  void clear_stale();
+  bool clear_stale();
   Vector<IPAddress> best_route(IPAddress dst, bool from_me);
 
   Vector< Vector<IPAddress> > top_n_routes(IPAddress dst, int n);
@@ -179,52 +187,43 @@ protected:
   class HostInfo {
   public:
     IPAddress _ip;
-    uint32_t _metric_from_me;
-    uint32_t _metric_to_me;
-
-    IPAddress _prev_from_me;
-    IPAddress _prev_to_me;
-
-    bool _marked_from_me;
-    bool _marked_to_me;
-
-    HostInfo(IPAddress p) {
-      _ip = p;
-      _metric_from_me = 0;
-      _metric_to_me = 0;
-      _prev_from_me = IPAddress();
-      _prev_to_me = IPAddress();
-      _marked_from_me = false;
-      _marked_to_me = false;
-    }
-    HostInfo() {
-      HostInfo(IPAddress());
-    }
-
-    HostInfo(const HostInfo &p) :
-      _ip(p._ip),
-      _metric_from_me(p._metric_from_me),
-      _metric_to_me(p._metric_to_me),
-      _prev_from_me(p._prev_from_me),
-      _prev_to_me(p._prev_to_me),
-      _marked_from_me(p._marked_from_me),
-      _marked_to_me(p._marked_to_me)
-    { }
+    int _index;			// into _node_ip, _out, _in, and the trees
 
-    void clear(bool from_me) {
-      if (from_me ) {
-	_prev_from_me = IPAddress();
-	_metric_from_me = 0;
-	_marked_from_me = false;
-      } else {
-	_prev_to_me = IPAddress();
-	_metric_to_me = 0;
-	_marked_to_me = false;
-      }
+    HostInfo(IPAddress p, int index = -1)
+      : _ip(p), _index(index) {
+    }
+    HostInfo()
+      : _ip(), _index(-1) {
     }
 
   };
 
+  // One direction of a link, as stored in a host's adjacency array.
+  struct Edge {
+    int _node;
+    uint32_t _metric;
+    Edge()
+      : _node(-1), _metric(0) {
+    }
+    Edge(int node, uint32_t metric)
+      : _node(node), _metric(metric) {
+    }
+  };
+
+  // A shortest-path tree rooted at this host, indexed by host index.
+  // _metric is UNREACHED for hosts with no route; _prev is the next host
+  // toward this host.
+  struct Tree {
+    Vector<uint32_t> _metric;
+    Vector<int> _prev;
+    bool _valid;
+    Tree()
+      : _valid(false) {
+    }
+  };
+
+  enum { UNREACHED = 0xFFFFFFFFU };
+
   typedef HashMap<IPAddress, HostInfo> HTable;
   typedef HTable::const_iterator HTIter;
 
@@ -235,6 +234,29 @@ protected:
   HTable _hosts;
   LTable _links;
 
+  Vector<IPAddress> _node_ip;
+  Vector<Vector<Edge> > _out;	// links from each host
+  Vector<Vector<Edge> > _in;	// links to each host
+  Tree _tree[2];		// indexed by from_me
+
+  // Indexed binary heap of hosts for dijkstra, keyed by a tree's metrics.
+  // Empty between computations, so every _heap_pos entry is -1.
+  Vector<int> _heap;
+  Vector<int> _heap_pos;
+
+  void heap_update(const Vector<uint32_t> &metric, int x);
+  int heap_pop(const Vector<uint32_t> &metric);
+  void settle(Tree &tree, const Vector<Vector<Edge> > &fwd);
+
+  int host_index(IPAddress ip) const;
+  int ensure_host(IPAddress ip);
+  static void set_adjacent(Vector<Edge> &adj, int node, uint32_t metric);
+  void set_edge(int from, int to, uint32_t metric);
+  void rebuild_graph();
+  uint32_t host_metric(bool from_me, int x) const;
+  void update_tree(bool from_me, int u, int v,
+		   uint32_t old_metric, uint32_t new_metric);
+
 
   IPAddress _ip;
   Timestamp _stale_timeout;
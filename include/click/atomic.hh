@@ -529,5 +529,25 @@ operator<=(const atomic_uint32_t &a, const atomic_uint32_t &b)
 
 typedef atomic_uint32_t uatomic32_t;
 
+/** @brief  Full memory barrier.
+ *
+ * No load or store before the barrier may be reordered with any load or
+ * store after it, as seen by other processors. */
+inline void
+click_fence()
+{
+#if CLICK_LINUXMODULE
+    smp_mb();
+#elif CLICK_ATOMIC_X86 && defined(__x86_64__)
+    asm volatile ("mfence" : : : "memory");
+#elif CLICK_ATOMIC_X86
+    asm volatile (CLICK_ATOMIC_LOCK "addl $0,0(%%esp)" : : : "cc", "memory");
+#elif HAVE_MULTITHREAD && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 1))
+    __sync_synchronize();
+#else
+    asm volatile ("" : : : "memory");
+#endif
+}
+
 CLICK_ENDDECLS
 #endif
@@ -5,6 +5,7 @@
 #include <click/vector.hh>
 #include <click/string.hh>
 #include <click/packet.hh>
+#include <click/packetbatch.hh>
 #include <click/handler.hh>
 CLICK_DECLS
 class Router;
@@ -35,6 +36,10 @@ class Element { public:
     virtual Packet *pull(int port) CLICK_WARN_UNUSED_RESULT;
     virtual Packet *simple_action(Packet *p);
 
+    virtual void push_batch(int port, PacketBatch &batch);
+    virtual void pull_batch(int port, PacketBatch &batch, int max);
+    virtual void simple_action_batch(PacketBatch &batch);
+
     virtual bool run_task(Task *task);	// return true iff did useful work
     virtual void run_timer(Timer *timer);
 #if CLICK_USERLEVEL
@@ -42,6 +47,7 @@ class Element { public:
 #endif
 
     inline void checked_output_push(int port, Packet *p) const;
+    inline void checked_output_push_batch(int port, PacketBatch &batch) const;
 
     // ELEMENT CHARACTERISTICS
     virtual const char *class_name() const = 0;
@@ -198,6 +204,9 @@ class Element { public:
 	inline void push(Packet* p) const;
 	inline Packet* pull() const;
 
+	inline void push_batch(PacketBatch &batch) const;
+	inline void pull_batch(PacketBatch &batch, int max) const;
+
 #if CLICK_STATS >= 1
 	unsigned npackets() const	{ return _packets; }
 #endif
@@ -611,6 +620,78 @@ Element::Port::pull() const
     return p;
 }
 
+/** @brief Push a batch of packets over this port.
+ * @param batch packets to push
+ *
+ * Pushes every packet in @a batch downstream with a single call to the next
+ * element's @link Element::push_batch() push_batch() @endlink function.
+ * Elements that do not implement push_batch() receive the packets one at a
+ * time through push().  On return, @a batch is empty.  Does nothing if @a
+ * batch is empty.
+ *
+ * This port must be an active() push output port.
+ *
+ * @sa push
+ */
+inline void
+Element::Port::push_batch(PacketBatch &batch) const
+{
+    assert(_e);
+    if (batch.empty())
+	return;
+#if CLICK_STATS >= 1
+    _packets += batch.count();
+#endif
+#if CLICK_STATS >= 2
+    _e->input(_port)._packets += batch.count();
+    click_cycles_t c0 = click_get_cycles();
+    _e->push_batch(_port, batch);
+    click_cycles_t x = click_get_cycles() - c0;
+    ++_e->_calls;
+    _e->_self_cycles += x;
+    _owner->_child_cycles += x;
+#else
+    _e->push_batch(_port, batch);
+#endif
+}
+
+/** @brief Pull up to @a max packets over this port.
+ * @param batch batch to which pulled packets are appended
+ * @param max maximum number of packets to pull
+ *
+ * Pulls packets from upstream with a single call to the previous element's
+ * @link Element::pull_batch() pull_batch() @endlink function, and appends
+ * them to @a batch.  Elements that do not implement pull_batch() are pulled
+ * one packet at a time.  Fewer than @a max packets, or none, may be
+ * returned.
+ *
+ * This port must be an active() pull input port.
+ *
+ * @sa pull
+ */
+inline void
+Element::Port::pull_batch(PacketBatch &batch, int max) const
+{
+    assert(_e);
+#if CLICK_STATS >= 1
+    int old_count = batch.count();
+#endif
+#if CLICK_STATS >= 2
+    click_cycles_t c0 = click_get_cycles();
+    _e->pull_batch(_port, batch, max);
+    click_cycles_t x = click_get_cycles() - c0;
+    ++_e->_calls;
+    _e->_self_cycles += x;
+    _owner->_child_cycles += x;
+    _e->output(_port)._packets += batch.count() - old_count;
+#else
+    _e->pull_batch(_port, batch, max);
+#endif
+#if CLICK_STATS >= 1
+    _packets += batch.count() - old_count;
+#endif
+}
+
 /** @brief Push packet @a p to output @a port, or kill it if @a port is out of
  * range.
  *
@@ -632,6 +713,24 @@ Element::checked_output_push(int port, Packet* p) const
 	p->kill();
 }
 
+/** @brief Push @a batch to output @a port, or kill its packets if @a port is
+ * out of range.
+ *
+ * @param port output port number
+ * @param batch packets to push
+ *
+ * The batch analogue of checked_output_push().  On return, @a batch is
+ * empty.
+ */
+inline void
+Element::checked_output_push_batch(int port, PacketBatch &batch) const
+{
+    if ((unsigned) port < (unsigned) noutputs())
+	_ports[1][port].push_batch(batch);
+    else
+	batch.kill();
+}
+
 #undef PORT_ASSIGN
 CLICK_ENDDECLS
 #endif
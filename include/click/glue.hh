@@ -294,6 +294,16 @@ typedef struct device net_device;
 #define static_assert(x) switch (x) case 0: case !!(x):
 
 
+// PREFETCHING
+
+// Hint that *p will be read soon.  Never faults, even if p is invalid.
+#if __GNUC__ > 3 || (__GNUC__ == 3 && __GNUC_MINOR__ >= 1)
+# define click_prefetch(p)	__builtin_prefetch((p))
+#else
+# define click_prefetch(p)	((void) (p))
+#endif
+
+
 // PROCESSOR IDENTITIES
 
 #if CLICK_LINUXMODULE
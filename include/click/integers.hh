@@ -176,6 +176,24 @@ int ffs_lsb(uint64_t x);
 #endif
 
 
+#if HAVE_INT64_TYPES
+# if HAVE_LONG_LONG && HAVE___BUILTIN_POPCOUNTLL && !HAVE_NO_INTEGER_BUILTINS
+/** @brief Return the number of 1 bits in @a x. */
+inline int popcount(uint64_t x) {
+    return __builtin_popcountll(x);
+}
+# else
+/** @brief Return the number of 1 bits in @a x. */
+inline int popcount(uint64_t x) {
+    x -= (x >> 1) & 0x5555555555555555ULL;
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (x * 0x0101010101010101ULL) >> 56;
+}
+# endif
+#endif
+
+
 /** @brief Return the integer approximation of @a x's square root.
  * @return The integer @a y where @a y*@a y <= @a x, but
  * (@a y+1)*(@a y+1) > @a x.
@@ -9,6 +9,16 @@ CLICK_DECLS
 // IP6 routing table.
 // Lookup by longest prefix.
 // Each entry contains a gateway and an output index.
+//
+// Prefix routes live in a compressed multibit trie, six address bits per
+// level (as in Poptrie).  Each node keeps a 64-bit vector of the slots that
+// have a child and a 64-bit vector of the slots where the pushed-down leaf
+// route changes; both child and leaf arrays are packed, and are indexed by
+// counting bits in those vectors.  A lookup is therefore at most 22 node
+// visits with no per-route work.  Adding or removing a route rebuilds only
+// the node that holds it and the descendants whose inherited route changed.
+// Routes whose mask is not a prefix are kept aside and force the old linear
+// scan.
 
 class IP6Table { public:
 
@@ -19,19 +29,59 @@ class IP6Table { public:
 
   void add(const IP6Address &dst, const IP6Address &mask, const IP6Address &gw, int index);
   void del(const IP6Address &dst, const IP6Address &mask);
-  void clear()				{ _v.clear(); }
+  void clear();
   String dump();
 
  private:
 
+  enum { STRIDE = 6, MAXDEPTH = 127 / STRIDE, NOROUTE = 0xFFFFFFFFU };
+
   struct Entry {
     IP6Address _dst;
     IP6Address _mask;
     IP6Address _gw;
     int _index;
+    int _prefix_len;		// -1 if _mask is not a prefix
     int _valid;
   };
   Vector<Entry> _v;
+  Vector<int> _free;		// invalid slots in _v
+  int _nodd;			// number of valid non-prefix entries
+
+  // route IDs are _v indexes plus one; 0 means no route
+  struct Local {
+    uint8_t bits;		// first slot covered
+    uint8_t len;		// prefix bits within this node, 0-6
+    uint32_t id;
+  };
+
+  // A node's children are stored contiguously, so a lookup touches one
+  // cache line per level.  Nodes are moved with memcpy when their parent's
+  // child array changes.
+  struct Node {
+    uint64_t vector;		// slots with a child
+    uint64_t leafvec;		// slots starting a new run in leaves
+    Node *children;
+    uint32_t *leaves;
+    uint32_t inherited;		// best route covering the whole node
+    int nlocal;
+    Local *local;		// routes ending in this node, shortest first
+  };
+  Node *_root;
+
+  inline uint32_t lookup_id(const IP6Address &dst) const;
+  bool lookup_linear(const IP6Address &dst, IP6Address &gw, int &index) const;
+  uint32_t find_id(const IP6Address &dst, int prefix_len) const;
+  void set_route(const IP6Address &dst, int prefix_len, uint32_t id);
+  static inline void init_node(Node *n, uint32_t inherited);
+  static inline Node *child(const Node *n, int slot);
+  static Node *insert_child(Node *n, int slot);
+  static void remove_child(Node *n, int slot);
+  static void rebuild(Node *n);
+  static void free_node(Node *n);
+
+  IP6Table(const IP6Table &);
+  IP6Table &operator=(const IP6Table &);
 
 };
 
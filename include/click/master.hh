@@ -34,17 +34,14 @@ class Master { public:
 
     const volatile int* stopper_ptr() const	{ return &_stopper; }
 
-    Timestamp next_timer_expiry() const		{ return _timer_expiry; }
-    const Timestamp &timer_check() const	{ return _timer_check; }
-    void run_timers();
+    Timestamp next_timer_expiry() const;
     unsigned max_timer_stride() const		{ return _max_timer_stride; }
-    unsigned timer_stride() const		{ return _timer_stride; }
     void set_max_timer_stride(unsigned timer_stride);
 
 #if CLICK_USERLEVEL
     int add_select(int fd, Element*, int mask);
     int remove_select(int fd, Element*, int mask);
-    void run_selects(bool more_tasks);
+    void run_selects(RouterThread *thread);
 
     int add_signal_handler(int signo, Router*, const String &handler);
     int remove_signal_handler(int signo, Router*, const String &handler);
@@ -53,6 +50,9 @@ class Master { public:
 
     void kill_router(Router*);
 
+    void rcu_snapshot(Vector<uint32_t> &epochs) const;
+    bool rcu_quiescent(const Vector<uint32_t> &epochs) const;
+
 #if CLICK_NS
     void initialize_ns(simclick_node_t *simnode);
     simclick_node_t *simnode() const		{ return _simnode; }
@@ -68,10 +68,6 @@ class Master { public:
 
   private:
 
-    // stick _timer_expiry here so it will most likely fit in a cache line,
-    // & we don't have to worry about its parts being updated separately
-    Timestamp _timer_expiry;
-
 #if CLICK_LINUXMODULE
     spinlock_t _master_lock;
     struct task_struct *_master_lock_task;
@@ -106,47 +102,9 @@ class Master { public:
     void process_pending(RouterThread*);
 
     // TIMERS
+    // Each RouterThread keeps its own timers.
     unsigned _max_timer_stride;
-    unsigned _timer_stride;
-    unsigned _timer_count;
-    Vector<Timer *> _timer_heap;
-    Vector<Timer *> _timer_runchunk;
-#if CLICK_LINUXMODULE
-    spinlock_t _timer_lock;
-    struct task_struct *_timer_task;
-#elif HAVE_MULTITHREAD
-    Spinlock _timer_lock;
-#endif
-    Timestamp _timer_check;
     uint32_t _timer_check_reports;
-    inline Timestamp next_timer_expiry_adjusted() const;
-    void lock_timers();
-    bool attempt_lock_timers();
-    void unlock_timers();
-    inline void run_one_timer(Timer *);
-
-    void set_timer_expiry() {
-	if (_timer_heap.size())
-	    _timer_expiry = _timer_heap.at_u(0)->_expiry;
-	else
-	    _timer_expiry = Timestamp();
-    }
-    void check_timer_expiry(Timer *t);
-
-    struct timer_less {
-	bool operator()(Timer *a, Timer *b) {
-	    return a->expiry() < b->expiry();
-	}
-    };
-    struct timer_place {
-	Timer **_begin;
-	timer_place(Timer **begin)
-	    : _begin(begin) {
-	}
-	void operator()(Timer **t) {
-	    (*t)->_schedpos1 = (t - _begin) + 1;
-	}
-    };
 
 #if CLICK_USERLEVEL
     // SELECT
@@ -155,6 +113,9 @@ class Master { public:
     int _selected_callno;
     Vector<int> _selected_callnos;
 # endif
+# if HAVE_SYS_EPOLL_H
+    int _epoll_fd;
+# endif
 # if !HAVE_POLL_H
     struct pollfd {
 	int fd;
@@ -174,12 +135,16 @@ class Master { public:
 # endif
     void remove_pollfd(int pi, int event);
 # if HAVE_SYS_EVENT_H && HAVE_KQUEUE
-    void run_selects_kqueue(bool);
+    void run_selects_kqueue(RouterThread *, bool);
+# endif
+# if HAVE_SYS_EPOLL_H
+    void update_epoll(int fd, int old_events);
+    void run_selects_epoll(RouterThread *, bool);
 # endif
 # if HAVE_POLL_H
-    void run_selects_poll(bool);
+    void run_selects_poll(RouterThread *, bool);
 # else
-    void run_selects_select(bool);
+    void run_selects_select(RouterThread *, bool);
 # endif
 
     // SIGNALS
@@ -276,53 +241,6 @@ Master::unpause()
     _master_paused--;
 }
 
-inline Timestamp
-Master::next_timer_expiry_adjusted() const
-{
-    Timestamp e = _timer_expiry;
-    if (_timer_stride >= 8 || e.sec() == 0)
-	/* do nothing */;
-    else if (_timer_stride >= 4)
-	e -= Timer::adjustment();
-    else
-	e -= Timer::adjustment() + Timer::adjustment();
-    return e;
-}
-
-inline void
-Master::lock_timers()
-{
-#if CLICK_LINUXMODULE
-    if (current != _timer_task)
-	spin_lock(&_timer_lock);
-#elif HAVE_MULTITHREAD
-    _timer_lock.acquire();
-#endif
-}
-
-inline bool
-Master::attempt_lock_timers()
-{
-#if CLICK_LINUXMODULE
-    return spin_trylock(&_timer_lock);
-#elif HAVE_MULTITHREAD
-    return _timer_lock.attempt();
-#else
-    return true;
-#endif
-}
-
-inline void
-Master::unlock_timers()
-{
-#if CLICK_LINUXMODULE
-    if (current != _timer_task)
-	spin_unlock(&_timer_lock);
-#elif HAVE_MULTITHREAD
-    _timer_lock.release();
-#endif
-}
-
 inline Master *
 Element::master() const
 {
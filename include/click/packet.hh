@@ -56,6 +56,10 @@ class Packet { public:
 #endif
 
     inline void kill();
+#if HAVE_CLICK_PACKET_POOL
+    static String packet_pool_stats();
+    static void static_cleanup();
+#endif
 
     inline bool shared() const;
     Packet *clone() CLICK_WARN_UNUSED_RESULT;
@@ -676,6 +680,9 @@ class Packet { public:
     static WritablePacket *make(int, int, int);
     bool alloc_data(uint32_t, uint32_t, uint32_t);
 #endif
+#if HAVE_CLICK_PACKET_POOL
+    static void recycle(Packet *p);
+#endif
 #if CLICK_BSDMODULE
     static void assimilate_mbuf(Packet *p);
     void assimilate_mbuf();
@@ -1246,6 +1253,9 @@ Packet::kill()
     b->list = 0;
 # endif
     skbmgr_recycle_skbs(b);
+#elif HAVE_CLICK_PACKET_POOL
+    if (_use_count.dec_and_test())
+	recycle(this);
 #else
     if (_use_count.dec_and_test())
 	delete this;
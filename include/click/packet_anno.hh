@@ -106,13 +106,24 @@
 #define SEQUENCE_NUMBER_ANNO(p)		((p)->anno_u32(SEQUENCE_NUMBER_ANNO_OFFSET))
 #define SET_SEQUENCE_NUMBER_ANNO(p, v)	((p)->set_anno_u32(SEQUENCE_NUMBER_ANNO_OFFSET, (v)))
 
-#define IPSEC_SA_DATA_REFERENCE_ANNO_OFFSET	36
-#define IPSEC_SA_DATA_REFERENCE_ANNO_SIZE	4
-#define IPSEC_SA_DATA_REFERENCE_ANNO(p)	((p)->anno_u32(IPSEC_SA_DATA_REFERENCE_ANNO_OFFSET))
-#define SET_IPSEC_SA_DATA_REFERENCE_ANNO(p, v) ((p)->set_anno_u32(IPSEC_SA_DATA_REFERENCE_ANNO_OFFSET, (v)))
+// a pointer: bytes 36-39, or bytes 40-47 on 64-bit hosts.  No free range is
+// wide enough, so on 64-bit hosts it shares bytes with PERFCTR_ANNO: don't
+// count cycles or performance events (SetCycleCount, SetPerfCount) between
+// an IPsec route lookup and the IPsec elements that use its SA.
+#if SIZEOF_LONG > 4
+# define IPSEC_SA_DATA_REFERENCE_ANNO_OFFSET	40
+# define IPSEC_SA_DATA_REFERENCE_ANNO_SIZE	8
+# define IPSEC_SA_DATA_REFERENCE_ANNO(p)	((p)->anno_u64(IPSEC_SA_DATA_REFERENCE_ANNO_OFFSET))
+# define SET_IPSEC_SA_DATA_REFERENCE_ANNO(p, v) ((p)->set_anno_u64(IPSEC_SA_DATA_REFERENCE_ANNO_OFFSET, (v)))
+#else
+# define IPSEC_SA_DATA_REFERENCE_ANNO_OFFSET	36
+# define IPSEC_SA_DATA_REFERENCE_ANNO_SIZE	4
+# define IPSEC_SA_DATA_REFERENCE_ANNO(p)	((p)->anno_u32(IPSEC_SA_DATA_REFERENCE_ANNO_OFFSET))
+# define SET_IPSEC_SA_DATA_REFERENCE_ANNO(p, v) ((p)->set_anno_u32(IPSEC_SA_DATA_REFERENCE_ANNO_OFFSET, (v)))
+#endif
 
 #if HAVE_INT64_TYPES
-// bytes 40-47
+// bytes 40-47; IPSEC_SA_DATA_REFERENCE_ANNO on 64-bit hosts
 # define PERFCTR_ANNO_OFFSET		40
 # define PERFCTR_ANNO_SIZE		8
 # define PERFCTR_ANNO(p)		((p)->anno_u64(PERFCTR_ANNO_OFFSET))
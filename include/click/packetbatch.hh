@@ -0,0 +1,175 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_PACKETBATCH_HH
+#define CLICK_PACKETBATCH_HH
+#include <click/packet.hh>
+CLICK_DECLS
+
+/** @file <click/packetbatch.hh>
+ * @brief A FIFO list of packets passed between elements in one call.
+ */
+
+/** @class PacketBatch
+ * @brief A FIFO list of packets.
+ *
+ * A PacketBatch holds zero or more packets in order.  Elements pass batches
+ * to one another with Element::Port::push_batch() and
+ * Element::Port::pull_batch(), moving many packets per virtual function
+ * call.
+ *
+ * Packets in a batch are chained through their next() annotations, so
+ * adding and removing packets never allocates memory.  A packet can belong
+ * to at most one batch at a time, and code must not change the next()
+ * annotation of a packet while it is in a batch.  Packets removed with
+ * pop_front() have null next() annotations.  To examine a batch's packets
+ * without removing them, walk the chain from front():
+ *
+ * @code
+ * for (Packet *p = batch.front(); p; p = p->next())
+ *     total += p->length();
+ * @endcode
+ *
+ * A PacketBatch does not own its packets in the C++ sense: destroying a
+ * batch does not free them.  Element code that receives a batch is
+ * responsible for every packet in it, just as push() is responsible for its
+ * packet argument.
+ *
+ * @code
+ * void MyElement::push_batch(int, PacketBatch &batch)
+ * {
+ *     PacketBatch out;
+ *     while (Packet *p = batch.pop_front())
+ *         if ((p = process(p)))
+ *             out.push_back(p);
+ *     output(0).push_batch(out);
+ * }
+ * @endcode
+ */
+class PacketBatch { public:
+
+    /** @brief Construct an empty batch. */
+    PacketBatch()
+	: _head(0), _tail(0), _count(0) {
+    }
+
+    /** @brief Return true iff the batch contains no packets. */
+    bool empty() const {
+	return !_head;
+    }
+
+    /** @brief Return the number of packets in the batch. */
+    int count() const {
+	return _count;
+    }
+
+    /** @brief Return the first packet in the batch, or null if empty. */
+    Packet *front() const {
+	return _head;
+    }
+
+    /** @brief Return the last packet in the batch, or null if empty. */
+    Packet *back() const {
+	return _tail;
+    }
+
+    inline void push_back(Packet *p);
+    inline Packet *pop_front();
+    inline void append(PacketBatch &x);
+    inline void swap(PacketBatch &x);
+    inline void clear();
+    inline void kill();
+
+  private:
+
+    Packet *_head;
+    Packet *_tail;
+    int _count;
+
+    PacketBatch(const PacketBatch &);
+    PacketBatch &operator=(const PacketBatch &);
+
+};
+
+/** @brief Add @a p to the end of the batch.
+ * @param p packet, which must not belong to another batch */
+inline void
+PacketBatch::push_back(Packet *p)
+{
+    assert(p);
+    p->set_next(0);
+    if (_tail)
+	_tail->set_next(p);
+    else
+	_head = p;
+    _tail = p;
+    ++_count;
+}
+
+/** @brief Remove and return the first packet in the batch.
+ *
+ * Returns null if the batch is empty. */
+inline Packet *
+PacketBatch::pop_front()
+{
+    Packet *p = _head;
+    if (p) {
+	_head = p->next();
+	p->set_next(0);
+	if (!_head)
+	    _tail = 0;
+	--_count;
+    }
+    return p;
+}
+
+/** @brief Move all packets in @a x to the end of this batch.
+ *
+ * Leaves @a x empty. */
+inline void
+PacketBatch::append(PacketBatch &x)
+{
+    if (x._head) {
+	if (_tail)
+	    _tail->set_next(x._head);
+	else
+	    _head = x._head;
+	_tail = x._tail;
+	_count += x._count;
+	x._head = x._tail = 0;
+	x._count = 0;
+    }
+}
+
+/** @brief Swap the contents of this batch and @a x. */
+inline void
+PacketBatch::swap(PacketBatch &x)
+{
+    Packet *h = _head, *t = _tail;
+    int c = _count;
+    _head = x._head;
+    _tail = x._tail;
+    _count = x._count;
+    x._head = h;
+    x._tail = t;
+    x._count = c;
+}
+
+/** @brief Empty the batch without freeing its packets.
+ *
+ * The caller must already have accounted for the packets some other way. */
+inline void
+PacketBatch::clear()
+{
+    _head = _tail = 0;
+    _count = 0;
+}
+
+/** @brief Kill every packet in the batch, leaving it empty. */
+inline void
+PacketBatch::kill()
+{
+    while (Packet *p = pop_front())
+	p->kill();
+}
+
+CLICK_ENDDECLS
+#endif
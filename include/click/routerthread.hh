@@ -3,6 +3,7 @@
 #define CLICK_ROUTERTHREAD_HH
 #include <click/sync.hh>
 #include <click/vector.hh>
+#include <click/timer.hh>
 #if CLICK_LINUXMODULE
 # include <click/cxxprotect.h>
 CLICK_CXX_PROTECT
@@ -38,6 +39,7 @@ class RouterThread
 	   THREAD_UNKNOWN = -1000 };
 
     inline int thread_id() const;
+    inline bool current_thread_is_running() const;
 
     // Task list functions
     inline bool active() const;
@@ -59,6 +61,14 @@ class RouterThread
 
     void unschedule_router_tasks(Router*);
 
+    // Timer functions
+    Timestamp next_timer_expiry() const	{ return _timer_expiry; }
+    const Timestamp &timer_check() const	{ return _timer_check; }
+    unsigned timer_stride() const		{ return _timer_stride; }
+    void run_timers();
+
+    void unschedule_router_timers(Router*);
+
 #if HAVE_ADAPTIVE_SCHEDULER
     // min_cpu_share() and max_cpu_share() are expressed on a scale with
     // Task::MAX_UTILIZATION == 100%.
@@ -112,6 +122,40 @@ class RouterThread
 
     uint32_t _any_pending;
 
+    // Read-copy-update: odd while the thread cannot be looking at shared
+    // structures (blocked or outside the driver), advanced by 2 every
+    // driver iteration.  See Master::rcu_snapshot.
+    volatile uint32_t _rcu_epoch;
+
+    // TIMERS
+    // stick _timer_expiry here so it will most likely fit in a cache line,
+    // & we don't have to worry about its parts being updated separately
+    Timestamp _timer_expiry;
+    unsigned _timer_stride;
+    unsigned _timer_count;
+    // Each thread runs the timers scheduled on its own hierarchical timing
+    // wheel.  Level L slot S holds timers whose expiry tick agrees with
+    // _timer_tick above bit (L+1)*timer_wheel_bits and has S in bits
+    // [L*timer_wheel_bits, (L+1)*timer_wheel_bits); timers further out wait
+    // in _timer_overflow.
+    enum { timer_wheel_bits = 8,
+	   timer_wheel_size = 1 << timer_wheel_bits,
+	   timer_wheel_levels = 4,
+	   timer_tick_shift = 10 };	// ticks are 1/1024 seconds
+    Timer *_timer_wheel[timer_wheel_levels][timer_wheel_size];
+    uint32_t _timer_wheel_used[timer_wheel_levels][timer_wheel_size / 32];
+    Timer *_timer_overflow;
+    Timer *_timer_runlist;
+    volatile bool _timer_running;	// a callback runs without the lock
+    uint64_t _timer_tick;
+    Vector<Timer *> _timer_runchunk;
+#if CLICK_LINUXMODULE
+    spinlock_t _timer_lock;
+#elif HAVE_MULTITHREAD
+    Spinlock _timer_lock;
+#endif
+    Timestamp _timer_check;
+
 #if CLICK_LINUXMODULE
     bool _greedy;
 #endif
@@ -168,9 +212,32 @@ class RouterThread
 #if HAVE_TASK_HEAP
     void task_reheapify_from(int pos, Task*);
 #endif
-    inline bool current_thread_is_running() const;
+
+    inline void rcu_quiescent();
+    inline void rcu_offline();
+    inline void rcu_online();
+
+    // timer functions
+    inline Timestamp next_timer_expiry_adjusted() const;
+    inline void lock_timers();
+    inline bool attempt_lock_timers();
+    inline void unlock_timers();
+    inline void lock_idle_timers();
+    inline void run_one_timer(Timer *);
+
+    static inline uint64_t timer_tick(const Timestamp &t);
+    static inline void timer_link(Timer *t, Timer **pprev);
+    static inline void timer_unlink(Timer *t);
+    void timer_insert(Timer *t);
+    int timer_wheel_next(int level, int slot);
+    uint64_t timer_next_tick();
+    void timer_cascade(Timer **head);
+    void timer_collect();
+    void set_timer_expiry();
+    void check_timer_expiry(Timer *t);
 
     friend class Task;
+    friend class Timer;
     friend class Master;
 
 };
@@ -293,6 +360,114 @@ RouterThread::current_thread_is_running() const
 #endif
 }
 
+inline void
+RouterThread::rcu_quiescent()
+{
+    click_fence();
+    _rcu_epoch += 2;
+    click_fence();
+}
+
+inline void
+RouterThread::rcu_offline()
+{
+    click_fence();
+    _rcu_epoch++;
+}
+
+inline void
+RouterThread::rcu_online()
+{
+    _rcu_epoch++;
+    click_fence();
+}
+
+inline Timestamp
+RouterThread::next_timer_expiry_adjusted() const
+{
+    Timestamp e = _timer_expiry;
+    if (_timer_stride >= 8 || e.sec() == 0)
+	/* do nothing */;
+    else if (_timer_stride >= 4)
+	e -= Timer::adjustment();
+    else
+	e -= Timer::adjustment() + Timer::adjustment();
+    return e;
+}
+
+inline uint64_t
+RouterThread::timer_tick(const Timestamp &t)
+{
+    if (t.sec() < 0)
+	return 0;
+    return ((uint64_t) t.sec() << timer_tick_shift)
+	+ (t.usec() << timer_tick_shift) / 1000000;
+}
+
+inline void
+RouterThread::timer_link(Timer *t, Timer **pprev)
+{
+    t->_next = *pprev;
+    if (t->_next)
+	t->_next->_pprev = &t->_next;
+    t->_pprev = pprev;
+    *pprev = t;
+}
+
+inline void
+RouterThread::timer_unlink(Timer *t)
+{
+    *t->_pprev = t->_next;
+    if (t->_next)
+	t->_next->_pprev = t->_pprev;
+    t->_pprev = 0;
+}
+
+inline void
+RouterThread::lock_timers()
+{
+#if CLICK_LINUXMODULE
+    spin_lock(&_timer_lock);
+#elif HAVE_MULTITHREAD
+    _timer_lock.acquire();
+#endif
+}
+
+inline bool
+RouterThread::attempt_lock_timers()
+{
+#if CLICK_LINUXMODULE
+    return spin_trylock(&_timer_lock);
+#elif HAVE_MULTITHREAD
+    return _timer_lock.attempt();
+#else
+    return true;
+#endif
+}
+
+inline void
+RouterThread::unlock_timers()
+{
+#if CLICK_LINUXMODULE
+    spin_unlock(&_timer_lock);
+#elif HAVE_MULTITHREAD
+    _timer_lock.release();
+#endif
+}
+
+inline void
+RouterThread::lock_idle_timers()
+{
+    // Lock the timers once no callback is running on this thread, unless
+    // we are that callback.
+    lock_timers();
+    while (_timer_running && !current_thread_is_running()) {
+	unlock_timers();
+	click_fence();
+	lock_timers();
+    }
+}
+
 inline void
 RouterThread::schedule_block_tasks()
 {
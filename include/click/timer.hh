@@ -10,6 +10,7 @@ class Element;
 class Router;
 class Timer;
 class Task;
+class RouterThread;
 
 typedef void (*TimerCallback)(Timer *timer, void *user_data);
 typedef TimerCallback TimerHook CLICK_DEPRECATED;
@@ -72,7 +73,7 @@ class Timer { public:
 
     /** @brief Return true iff the Timer is currently scheduled. */
     inline bool scheduled() const {
-	return _schedpos1 != 0;
+	return _pprev != 0;
     }
 
     /** @brief Return the Timer's current expiration time.
@@ -100,10 +101,7 @@ class Timer { public:
      *
      * If Click is compiled with statistics support, time spent in this
      * Timer will be charged to the @a owner element. */
-    inline void initialize(Element *owner) {
-	assert(!initialized() || _owner->router() == owner->router());
-	_owner = owner;
-    }
+    void initialize(Element *owner);
 
     /** @brief Initialize the timer.
      * @param router the owner router
@@ -119,7 +117,11 @@ class Timer { public:
      * @param when expiration time
      *
      * If @a when is more than 2 seconds behind system time, then the
-     * expiration time is silently updated to the current system time. */
+     * expiration time is silently updated to the current system time.
+     *
+     * The timer fires on the RouterThread that scheduled it.  Timers
+     * scheduled from outside any RouterThread, such as by handlers, stay
+     * where they last ran, initially on thread 0. */
     void schedule_at(const Timestamp &when);
 
     /** @brief Schedule the timer to fire at @a when.
@@ -250,13 +252,15 @@ class Timer { public:
 
   private:
 
-    int _schedpos1;
+    Timer *_next;
+    Timer **_pprev;
     Timestamp _expiry;
     union {
 	TimerCallback callback;
     } _hook;
     void *_thunk;
     Element *_owner;
+    RouterThread *_thread;
 
     Timer(const Timer &x);
     Timer &operator=(const Timer &x);
@@ -265,7 +269,10 @@ class Timer { public:
     static void element_hook(Timer *t, void *user_data);
     static void task_hook(Timer *t, void *user_data);
 
+    RouterThread *lock_thread();
+
     friend class Master;
+    friend class RouterThread;
 
 };
 
@@ -130,6 +130,17 @@ struct click_ip {
  * @a x must be two-byte aligned. */
 uint16_t click_in_cksum(const unsigned char *x, int len);
 uint16_t click_in_cksum_pseudohdr_raw(uint32_t csum, uint32_t src, uint32_t dst, int proto, int packet_len);
+
+/* Checksum engines.  click_in_cksum() picks the fastest engine the CPU
+   supports at run time; these let tests and benchmarks name one. */
+enum {
+    CLICK_IN_CKSUM_GENERIC = 0,	/* 64-bit accumulator, portable C */
+    CLICK_IN_CKSUM_SSE2 = 1,
+    CLICK_IN_CKSUM_AVX2 = 2,
+    CLICK_IN_CKSUM_NENGINES = 3
+};
+int click_in_cksum_engine_available(int engine);
+uint16_t click_in_cksum_engine(int engine, const unsigned char *x, int len);
 #else
 # define click_in_cksum(addr, len) \
 		ip_compute_csum((unsigned char *)(addr), (len))
@@ -182,6 +193,69 @@ click_update_in_cksum(uint16_t *csum, uint16_t old_hw, uint16_t new_hw)
     *csum = ~(sum + (sum >> 16));
 }
 
+/** @brief Return the checksum difference for a changed 32-bit word.
+ * @param old_w old word
+ * @param new_w new word
+ *
+ * The result is an unfolded one's-complement sum suitable for
+ * click_update_in_cksum_delta().  Differences for several changed words can
+ * be added together before they are applied.  Words are in network byte
+ * order, and must lie at an even offset from the start of the checksummed
+ * data. */
+static inline uint32_t
+click_in_cksum_delta32(uint32_t old_w, uint32_t new_w)
+{
+    return (~old_w >> 16) + (~old_w & 0xFFFF) + (new_w >> 16) + (new_w & 0xFFFF);
+}
+
+/** @brief Return the checksum difference for a changed data range.
+ * @param old_data old contents of the range
+ * @param new_data new contents of the range
+ * @param len length of the range in bytes; must be even
+ *
+ * The result is folded to 16 bits.  Rewriters compute it once per mapping,
+ * then apply it to every packet with click_update_in_cksum_delta(). */
+static inline uint16_t
+click_in_cksum_delta(const void *old_data, const void *new_data, int len)
+{
+    const uint16_t *o = (const uint16_t *) old_data;
+    const uint16_t *n = (const uint16_t *) new_data;
+    uint32_t delta = 0;
+    for (; len > 1; len -= 2, ++o, ++n)
+	delta += (~*o & 0xFFFF) + *n;
+    delta = (delta & 0xFFFF) + (delta >> 16);
+    return delta + (delta >> 16);
+}
+
+/** @brief Incrementally adjust an Internet checksum by a difference.
+ * @param[in, out] csum points to checksum
+ * @param delta checksum difference
+ *
+ * @a delta is the one's-complement sum of the complements of the old
+ * halfwords and the new halfwords, as returned by click_in_cksum_delta() or
+ * click_in_cksum_delta32(); it need not be folded, but must be less than
+ * 0xFFFF0000.  The caveat about ~+0 described for click_update_in_cksum()
+ * applies here too. */
+static inline void
+click_update_in_cksum_delta(uint16_t *csum, uint32_t delta)
+{
+    uint32_t sum = (~*csum & 0xFFFF) + delta;
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    *csum = ~(sum + (sum >> 16));
+}
+
+/** @brief Incrementally adjust an Internet checksum for a changed word.
+ * @param[in, out] csum points to checksum
+ * @param old_w old 32-bit word, in network byte order
+ * @param new_w new 32-bit word, in network byte order
+ *
+ * Equivalent to two calls to click_update_in_cksum(), one per halfword. */
+static inline void
+click_update_in_cksum32(uint16_t *csum, uint32_t old_w, uint32_t new_w)
+{
+    click_update_in_cksum_delta(csum, click_in_cksum_delta32(old_w, new_w));
+}
+
 /** @brief Potentially fix a zero-valued Internet checksum.
  * @param[in, out] csum points to checksum
  * @param x data to checksum
@@ -50,6 +50,7 @@
 
 #if CLICK_USERLEVEL
 # include <click/master.hh>
+# include <click/packet.hh>
 # include <click/notifier.hh>
 # include <click/straccum.hh>
 # include <click/nameinfo.hh>
@@ -401,7 +402,7 @@ click_remove_element_type(int which)
 }
 
 
-enum { GH_CLASSES, GH_PACKAGES };
+enum { GH_CLASSES, GH_PACKAGES, GH_PACKET_POOL };
 
 static String
 read_handler(Element *, void *thunk)
@@ -415,6 +416,10 @@ read_handler(Element *, void *thunk)
       case GH_PACKAGES:
 	click_public_packages(v);
 	break;
+#if HAVE_CLICK_PACKET_POOL
+      case GH_PACKET_POOL:
+	return Packet::packet_pool_stats();
+#endif
       default:
 	return "<error>\n";
     }
@@ -439,6 +444,9 @@ click_static_initialize()
 
     Router::add_read_handler(0, "classes", read_handler, (void *)GH_CLASSES);
     Router::add_read_handler(0, "packages", read_handler, (void *)GH_PACKAGES);
+#if HAVE_CLICK_PACKET_POOL
+    Router::add_read_handler(0, "packet_pool", read_handler, (void *)GH_PACKET_POOL);
+#endif
 
     click_export_elements();
 }
@@ -456,6 +464,9 @@ click_static_cleanup()
     cp_va_static_cleanup();
     NameInfo::static_cleanup();
     HashMap_ArenaFactory::static_cleanup();
+#if HAVE_CLICK_PACKET_POOL
+    Packet::static_cleanup();
+#endif
 
 # ifdef HAVE_DYNAMIC_LINKING
     delete tmpdir;
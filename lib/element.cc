@@ -2751,6 +2751,86 @@ Element::simple_action(Packet *p)
     return p;
 }
 
+/** @brief Push a batch of packets onto push input @a port.
+ *
+ * @param port the input port number on which the packets arrive
+ * @param batch the packets
+ *
+ * An upstream element transferred the packets in @a batch to this element
+ * over a push connection, using Port::push_batch().  push_batch() must
+ * account for every packet in @a batch, exactly as push() accounts for its
+ * packet argument, and must leave @a batch empty.
+ *
+ * The default implementation calls push() once per packet, so elements that
+ * do not care about batching need not implement push_batch().  Elements on
+ * hot forwarding paths can override it to process a batch in one call and
+ * forward the results with Port::push_batch().  An element that overrides
+ * push_batch() must also override push(), and the two must behave
+ * identically on each packet.
+ *
+ * @sa simple_action_batch
+ */
+void
+Element::push_batch(int port, PacketBatch &batch)
+{
+    while (Packet *p = batch.pop_front())
+	push(port, p);
+}
+
+/** @brief Pull up to @a max packets from pull output @a port.
+ *
+ * @param port the output port number receiving the pull request
+ * @param batch batch to which pulled packets are appended
+ * @param max maximum number of packets to return
+ *
+ * A downstream element initiated a batch transfer from this element over a
+ * pull connection, using Port::pull_batch().  This element should append at
+ * most @a max packets to @a batch.  Appending fewer packets, or none, is
+ * fine.
+ *
+ * The default implementation calls pull() until it returns null or @a max
+ * packets have been appended.
+ */
+void
+Element::pull_batch(int port, PacketBatch &batch, int max)
+{
+    for (int n = 0; n < max; ++n)
+	if (Packet *p = pull(port))
+	    batch.push_back(p);
+	else
+	    break;
+}
+
+/** @brief Process a batch of packets for a simple packet filter.
+ *
+ * @param batch the input packets; on return, the output packets
+ *
+ * This is the batch analogue of simple_action().  On return, @a batch should
+ * contain the packets to be forwarded on output 0, in order.  Packets that
+ * are dropped or emitted on other outputs are simply left out.
+ *
+ * The default implementation calls simple_action() on each packet.  Elements
+ * that implement simple_action_batch() typically also override push_batch()
+ * like this:
+ *
+ * @code
+ * void MyElement::push_batch(int, PacketBatch &batch)
+ * {
+ *     simple_action_batch(batch);
+ *     output(0).push_batch(batch);
+ * }
+ * @endcode
+ */
+void
+Element::simple_action_batch(PacketBatch &batch)
+{
+    PacketBatch out;
+    while (Packet *p = batch.pop_front())
+	if ((p = simple_action(p)))
+	    out.push_back(p);
+    batch.swap(out);
+}
+
 /** @brief Run the element's task.
  *
  * @return true if the task accomplished some meaningful work, false otherwise
@@ -16,38 +16,182 @@
 # include <string.h>
 #endif
 
+#if CLICK_USERLEVEL && defined(__x86_64__) \
+    && (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+# define CLICK_IN_CKSUM_SIMD 1
+# include <immintrin.h>
+#endif
+
 #if !CLICK_LINUXMODULE
-uint16_t
-click_in_cksum(const unsigned char *addr, int len)
+/*
+ * The one's-complement sum of 16-bit words can be computed by adding wider
+ * words and folding the carries back in at the end, since 2^16 == 1 modulo
+ * 0xFFFF.  Each engine adds 32-bit words into 64-bit accumulators, which
+ * cannot overflow for any length that fits in an int.  Byte order does not
+ * matter as long as the result is stored the way the data was read.
+ */
+
+/* Data shorter than this is summed by the generic engine directly; an IP
+   header is not worth an indirect call and vector setup. */
+#define IN_CKSUM_SIMD_MIN	64
+
+static inline uint32_t
+in_cksum_load32(const unsigned char *x)
 {
-    int nleft = len;
-    const uint16_t *w = (const uint16_t *)addr;
-    uint32_t sum = 0;
-    uint16_t answer = 0;
-
-    /*
-     * Our algorithm is simple, using a 32 bit accumulator (sum), we add
-     * sequential 16 bit words to it, and at the end, fold back all the
-     * carry bits from the top 16 bits into the lower 16 bits.
-     */
-    while (nleft > 1)  {
-	sum += *w++;
-	nleft -= 2;
-    }
+    uint32_t w;
+    memcpy(&w, x, 4);
+    return w;
+}
 
+static uint64_t
+in_cksum_add_generic(uint64_t sum, const unsigned char *x, int len)
+{
+    while (len >= 16) {
+	sum += (uint64_t) in_cksum_load32(x) + in_cksum_load32(x + 4)
+	    + in_cksum_load32(x + 8) + in_cksum_load32(x + 12);
+	x += 16;
+	len -= 16;
+    }
+    while (len >= 4) {
+	sum += in_cksum_load32(x);
+	x += 4;
+	len -= 4;
+    }
+    if (len >= 2) {
+	uint16_t hw;
+	memcpy(&hw, x, 2);
+	sum += hw;
+	x += 2;
+	len -= 2;
+    }
     /* mop up an odd byte, if necessary */
-    if (nleft == 1) {
-	*(unsigned char *)(&answer) = *(const unsigned char *)w ;
-	sum += answer;
+    if (len == 1) {
+	uint16_t hw = 0;
+	*(unsigned char *) &hw = *x;
+	sum += hw;
+    }
+    return sum;
+}
+
+#if CLICK_IN_CKSUM_SIMD
+__attribute__((target("sse2"))) static uint64_t
+in_cksum_add_sse2(uint64_t sum, const unsigned char *x, int len)
+{
+    /* widen each 32-bit lane to 64 bits by interleaving with zero */
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc0 = zero, acc1 = zero;
+    uint64_t lanes[2];
+    while (len >= 32) {
+	__m128i a = _mm_loadu_si128((const __m128i *) x);
+	__m128i b = _mm_loadu_si128((const __m128i *) (x + 16));
+	acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(a, zero));
+	acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(a, zero));
+	acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(b, zero));
+	acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(b, zero));
+	x += 32;
+	len -= 32;
     }
+    _mm_storeu_si128((__m128i *) lanes, _mm_add_epi64(acc0, acc1));
+    return in_cksum_add_generic(sum + lanes[0] + lanes[1], x, len);
+}
+
+__attribute__((target("avx2"))) static uint64_t
+in_cksum_add_avx2(uint64_t sum, const unsigned char *x, int len)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc0 = zero, acc1 = zero;
+    uint64_t lanes[4];
+    while (len >= 64) {
+	__m256i a = _mm256_loadu_si256((const __m256i *) x);
+	__m256i b = _mm256_loadu_si256((const __m256i *) (x + 32));
+	acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(a, zero));
+	acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(a, zero));
+	acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(b, zero));
+	acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(b, zero));
+	x += 64;
+	len -= 64;
+    }
+    _mm256_storeu_si256((__m256i *) lanes, _mm256_add_epi64(acc0, acc1));
+    sum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    return in_cksum_add_sse2(sum, x, len);
+}
+#endif
 
-    /* add back carry outs from top 16 bits to low 16 bits */
-    sum = (sum & 0xffff) + (sum >> 16);
-    sum += (sum >> 16);
-    /* guaranteed now that the lower 16 bits of sum are correct */
+static uint64_t in_cksum_add_init(uint64_t sum, const unsigned char *x, int len);
 
-    answer = ~sum;              /* truncate to 16 bits */
-    return answer;
+/* Engine for data of at least IN_CKSUM_SIMD_MIN bytes, chosen on first
+   use.  Racing initializations store the same value. */
+static uint64_t (*in_cksum_add_large)(uint64_t, const unsigned char *, int) = in_cksum_add_init;
+
+static uint64_t
+in_cksum_add_init(uint64_t sum, const unsigned char *x, int len)
+{
+#if CLICK_IN_CKSUM_SIMD
+    if (click_in_cksum_engine_available(CLICK_IN_CKSUM_AVX2))
+	in_cksum_add_large = in_cksum_add_avx2;
+    else if (click_in_cksum_engine_available(CLICK_IN_CKSUM_SSE2))
+	in_cksum_add_large = in_cksum_add_sse2;
+    else
+#endif
+	in_cksum_add_large = in_cksum_add_generic;
+    return in_cksum_add_large(sum, x, len);
+}
+
+static inline uint16_t
+in_cksum_fold(uint64_t sum)
+{
+    /* add back carry outs from the top bits to the low 16 bits */
+    sum = (sum & 0xFFFFFFFFU) + (sum >> 32);
+    sum = (sum & 0xFFFFFFFFU) + (sum >> 32);
+    uint32_t sum32 = (uint32_t) sum;
+    sum32 = (sum32 & 0xFFFF) + (sum32 >> 16);
+    sum32 += (sum32 >> 16);
+    /* guaranteed now that the lower 16 bits of sum32 are correct */
+    return ~sum32;
+}
+
+uint16_t
+click_in_cksum(const unsigned char *addr, int len)
+{
+    if (len < IN_CKSUM_SIMD_MIN)
+	return in_cksum_fold(in_cksum_add_generic(0, addr, len));
+    else
+	return in_cksum_fold(in_cksum_add_large(0, addr, len));
+}
+
+int
+click_in_cksum_engine_available(int engine)
+{
+    if (engine == CLICK_IN_CKSUM_GENERIC)
+	return 1;
+#if CLICK_IN_CKSUM_SIMD
+    else if (engine == CLICK_IN_CKSUM_SSE2 || engine == CLICK_IN_CKSUM_AVX2) {
+	static int sse2 = -1, avx2 = -1;
+	if (sse2 < 0) {
+	    __builtin_cpu_init();
+	    avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+	    sse2 = __builtin_cpu_supports("sse2") ? 1 : 0;
+	}
+	return engine == CLICK_IN_CKSUM_SSE2 ? sse2 : avx2;
+    }
+#endif
+    else
+	return 0;
+}
+
+uint16_t
+click_in_cksum_engine(int engine, const unsigned char *addr, int len)
+{
+    uint64_t (*add)(uint64_t, const unsigned char *, int) = in_cksum_add_generic;
+#if CLICK_IN_CKSUM_SIMD
+    if (engine == CLICK_IN_CKSUM_SSE2 && click_in_cksum_engine_available(engine))
+	add = in_cksum_add_sse2;
+    else if (engine == CLICK_IN_CKSUM_AVX2 && click_in_cksum_engine_available(engine))
+	add = in_cksum_add_avx2;
+#else
+    (void) engine;
+#endif
+    return in_cksum_fold(add(0, addr, len));
 }
 
 uint16_t
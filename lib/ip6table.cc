@@ -1,6 +1,6 @@
 // -*- c-basic-offset: 2; related-file-name: "../include/click/ip6table.hh" -*-
 /*
- * ip6table.{cc,hh} -- a stupid IP6 routing table, best for small routing tables
+ * ip6table.{cc,hh} -- IP6 routing table using a compressed multibit trie
  * Peilei Fan, Robert Morris
  *
  * Copyright (c) 1999-2000 Massachusetts Institute of Technology
@@ -18,19 +18,93 @@
 
 #include <click/config.h>
 #include <click/ip6table.hh>
+#include <click/integers.hh>
 #include <click/straccum.hh>
 CLICK_DECLS
 
 IP6Table::IP6Table()
+  : _nodd(0), _root(0)
 {
 }
 
 IP6Table::~IP6Table()
 {
+  clear();
+}
+
+inline void
+IP6Table::init_node(Node *n, uint32_t inherited)
+{
+  memset(n, 0, sizeof(Node));
+  n->inherited = inherited;
+}
+
+// Free everything n points to, but not n itself.
+void
+IP6Table::free_node(Node *n)
+{
+  for (int i = popcount(n->vector) - 1; i >= 0; i--)
+    free_node(&n->children[i]);
+  delete[] n->children;
+  delete[] n->leaves;
+  delete[] n->local;
+}
+
+void
+IP6Table::clear()
+{
+  if (_root) {
+    free_node(_root);
+    delete _root;
+  }
+  _root = 0;
+  _v.clear();
+  _free.clear();
+  _nodd = 0;
+}
+
+// Return the STRIDE bits of 'a' used at trie depth 'depth'.  The last level
+// only has 2 real bits; they end up as the top bits of the slot.
+static inline int
+prefix_chunk(const IP6Address &a, int depth)
+{
+  int pos = depth * 6;
+  const unsigned char *d = a.data();
+  unsigned w = d[pos >> 3] << 8;
+  if ((pos >> 3) < 15)
+    w |= d[(pos >> 3) + 1];
+  return (w >> (10 - (pos & 7))) & 63;
+}
+
+inline IP6Table::Node *
+IP6Table::child(const Node *n, int slot)
+{
+  uint64_t bit = (uint64_t) 1 << slot;
+  if (n->vector & bit)
+    return &n->children[popcount(n->vector & (bit - 1))];
+  else
+    return 0;
+}
+
+inline uint32_t
+IP6Table::lookup_id(const IP6Address &dst) const
+{
+  const uint32_t *d = dst.data32();
+  uint64_t hi = ((uint64_t) ntohl(d[0]) << 32) | ntohl(d[1]);
+  uint64_t lo = ((uint64_t) ntohl(d[2]) << 32) | ntohl(d[3]);
+  const Node *n = _root;
+  while (1) {
+    uint64_t bit = (uint64_t) 1 << (hi >> 58);
+    if (!(n->vector & bit))
+      return n->leaves[popcount(n->leafvec & ((bit - 1) | bit)) - 1];
+    n = &n->children[popcount(n->vector & (bit - 1))];
+    hi = (hi << STRIDE) | (lo >> (64 - STRIDE));
+    lo <<= STRIDE;
+  }
 }
 
 bool
-IP6Table::lookup(const IP6Address &dst, IP6Address &gw, int &index) const
+IP6Table::lookup_linear(const IP6Address &dst, IP6Address &gw, int &index) const
 {
   int best = -1;
 
@@ -49,6 +123,169 @@ IP6Table::lookup(const IP6Address &dst, IP6Address &gw, int &index) const
   }
 }
 
+bool
+IP6Table::lookup(const IP6Address &dst, IP6Address &gw, int &index) const
+{
+  if (_nodd)
+    return lookup_linear(dst, gw, index);
+
+  uint32_t id = (_root ? lookup_id(dst) : 0);
+  if (!id)
+    return false;
+  gw = _v[id - 1]._gw;
+  index = _v[id - 1]._index;
+  return true;
+}
+
+IP6Table::Node *
+IP6Table::insert_child(Node *n, int slot)
+{
+  uint64_t bit = (uint64_t) 1 << slot;
+  int nc = popcount(n->vector), pos = popcount(n->vector & (bit - 1));
+  Node *children = new Node[nc + 1];
+  memcpy(children, n->children, pos * sizeof(Node));
+  init_node(&children[pos], NOROUTE);
+  memcpy(children + pos + 1, n->children + pos, (nc - pos) * sizeof(Node));
+  delete[] n->children;
+  n->children = children;
+  n->vector |= bit;
+  return &children[pos];
+}
+
+void
+IP6Table::remove_child(Node *n, int slot)
+{
+  uint64_t bit = (uint64_t) 1 << slot;
+  int nc = popcount(n->vector), pos = popcount(n->vector & (bit - 1));
+  Node *children = (nc > 1 ? new Node[nc - 1] : 0);
+  memcpy(children, n->children, pos * sizeof(Node));
+  memcpy(children + pos, n->children + pos + 1, (nc - pos - 1) * sizeof(Node));
+  delete[] n->children;
+  n->children = children;
+  n->vector &= ~bit;
+}
+
+// Recompute n's leaves from n->inherited and n's own routes, then push the
+// result down to any child whose inherited route changed.
+void
+IP6Table::rebuild(Node *n)
+{
+  uint32_t best[64];
+  for (int s = 0; s < 64; s++)
+    best[s] = n->inherited;
+  for (const Local *l = n->local; l < n->local + n->nlocal; l++)
+    for (int s = l->bits; s < l->bits + (64 >> l->len); s++)
+      best[s] = l->id;
+
+  Node *c = n->children;
+  int nleaves = 0;
+  uint64_t leafvec = 0;
+  uint32_t leaves[64];
+  for (int s = 0; s < 64; s++)
+    if (n->vector & ((uint64_t) 1 << s)) {
+      if (c->inherited != best[s]) {
+	c->inherited = best[s];
+	rebuild(c);
+      }
+      c++;
+    } else if (nleaves == 0 || leaves[nleaves - 1] != best[s]) {
+      leafvec |= (uint64_t) 1 << s;
+      leaves[nleaves++] = best[s];
+    }
+
+  delete[] n->leaves;
+  n->leaves = (nleaves ? new uint32_t[nleaves] : 0);
+  memcpy(n->leaves, leaves, nleaves * sizeof(uint32_t));
+  n->leafvec = leafvec;
+}
+
+uint32_t
+IP6Table::find_id(const IP6Address &dst, int prefix_len) const
+{
+  int depth = (prefix_len > 0 ? (prefix_len - 1) / STRIDE : 0);
+  int len = prefix_len - depth * STRIDE;
+  const Node *n = _root;
+  for (int d = 0; n && d < depth; d++)
+    n = child(n, prefix_chunk(dst, d));
+  if (n) {
+    int bits = prefix_chunk(dst, depth) & ~((64 >> len) - 1);
+    for (const Local *l = n->local; l < n->local + n->nlocal; l++)
+      if (l->bits == bits && l->len == len)
+	return l->id;
+  }
+  return 0;
+}
+
+// Point the route dst/prefix_len at 'id', or remove it if 'id' is 0.
+void
+IP6Table::set_route(const IP6Address &dst, int prefix_len, uint32_t id)
+{
+  int depth = (prefix_len > 0 ? (prefix_len - 1) / STRIDE : 0);
+  int len = prefix_len - depth * STRIDE;
+  Node *path[MAXDEPTH + 1];
+  Node *top = 0;
+
+  if (!_root) {
+    if (!id)
+      return;
+    _root = new Node;
+    init_node(_root, 0);
+    top = _root;
+  }
+  Node *n = path[0] = _root;
+  for (int d = 0; d < depth; d++) {
+    int slot = prefix_chunk(dst, d);
+    Node *c = child(n, slot);
+    if (!c) {
+      if (!id)
+	return;
+      c = insert_child(n, slot);
+      if (!top)
+	top = n;
+    }
+    n = path[d + 1] = c;
+  }
+
+  Local l;
+  l.bits = prefix_chunk(dst, depth) & ~((64 >> len) - 1);
+  l.len = len;
+  l.id = id;
+  int i = 0;
+  while (i < n->nlocal
+	 && (n->local[i].len < len
+	     || (n->local[i].len == len && n->local[i].bits != l.bits)))
+    i++;
+  if (i < n->nlocal && n->local[i].len == len && id)
+    n->local[i].id = id;
+  else if (i < n->nlocal && n->local[i].len == len) {
+    memmove(n->local + i, n->local + i + 1, (n->nlocal - i - 1) * sizeof(Local));
+    if (--n->nlocal == 0) {
+      delete[] n->local;
+      n->local = 0;
+    }
+  } else if (id) {
+    Local *local = new Local[n->nlocal + 1];
+    memcpy(local, n->local, i * sizeof(Local));
+    local[i] = l;
+    memcpy(local + i + 1, n->local + i, (n->nlocal - i) * sizeof(Local));
+    delete[] n->local;
+    n->local = local;
+    n->nlocal++;
+  } else
+    return;
+
+  if (!id)
+    // prune nodes left with no routes and no children
+    while (depth > 0 && !n->nlocal && !n->vector) {
+      free_node(n);
+      depth--;
+      n = path[depth];
+      remove_child(n, prefix_chunk(dst, depth));
+    }
+
+  rebuild(top ? top : n);
+}
+
 void
 IP6Table::add(const IP6Address &dst, const IP6Address &mask,
 	      const IP6Address &gw, int index)
@@ -59,27 +296,54 @@ IP6Table::add(const IP6Address &dst, const IP6Address &mask,
   e._mask = mask;
   e._gw = gw;
   e._index = index;
+  e._prefix_len = mask.mask_to_prefix_len();
   e._valid = 1;
 
-  // Just in case, so we never encounter duplicate routes...
-  del(dst, mask);
-
-  for (int i = 0; i < _v.size(); i++)
-    if (!_v[i]._valid) {
-      _v[i] = e;
+  // Replace an existing route in place, so we never have duplicates
+  if (e._prefix_len >= 0) {
+    if (uint32_t id = find_id(e._dst, e._prefix_len)) {
+      _v[id - 1] = e;
       return;
     }
-  _v.push_back(e);
+  } else {
+    del(dst, mask);
+    _nodd++;
+  }
+
+  int i;
+  if (_free.size()) {
+    i = _free.back();
+    _free.pop_back();
+    _v[i] = e;
+  } else {
+    i = _v.size();
+    _v.push_back(e);
+  }
+  if (e._prefix_len >= 0)
+    set_route(e._dst, e._prefix_len, i + 1);
 }
 
 void
 IP6Table::del(const IP6Address &dst, const IP6Address &mask)
 {
   IP6Address dstnet = dst & mask;
+  int prefix_len = mask.mask_to_prefix_len();
+
+  if (prefix_len >= 0) {
+    if (uint32_t id = find_id(dstnet, prefix_len)) {
+      set_route(dstnet, prefix_len, 0);
+      _v[id - 1]._valid = 0;
+      _free.push_back(id - 1);
+    }
+    return;
+  }
 
   for (int i = 0; i < _v.size(); i++)
-    if (_v[i]._valid && (_v[i]._dst == dstnet) && (_v[i]._mask == mask))
+    if (_v[i]._valid && (_v[i]._dst == dstnet) && (_v[i]._mask == mask)) {
       _v[i]._valid = 0;
+      _free.push_back(i);
+      _nodd--;
+    }
 }
 
 String
@@ -34,6 +34,9 @@
 #  define EV_SET_UDATA_CAST	/* nothing */
 # endif
 #endif
+#if CLICK_USERLEVEL && HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
 CLICK_DECLS
 
 #if CLICK_USERLEVEL && !HAVE_POLL_H
@@ -52,29 +55,30 @@ Master::Master(int nthreads)
     _stopper = 0;
     _master_paused = 0;
 
-    for (int tid = -2; tid < nthreads; tid++)
-	_threads.push_back(new RouterThread(this, tid));
-
     // timer information
 #if CLICK_NS
     _max_timer_stride = 1;
 #else
     _max_timer_stride = 32;
 #endif
-    _timer_stride = _max_timer_stride;
-    _timer_count = 0;
 #if CLICK_LINUXMODULE
     _timer_check_reports = 5;
 #else
     _timer_check_reports = 0;
 #endif
 
+    for (int tid = -2; tid < nthreads; tid++)
+	_threads.push_back(new RouterThread(this, tid));
+
 #if CLICK_USERLEVEL
     // select information
 # if HAVE_SYS_EVENT_H && HAVE_KQUEUE
     _kqueue = kqueue();
     _selected_callno = 0;
 # endif
+# if HAVE_SYS_EPOLL_H
+    _epoll_fd = epoll_create(256);
+# endif
 # if !HAVE_POLL_H
     FD_ZERO(&_read_select_fd_set);
     FD_ZERO(&_write_select_fd_set);
@@ -104,10 +108,7 @@ Master::Master(int nthreads)
     spin_lock_init(&_master_lock);
     _master_lock_task = 0;
     _master_lock_count = 0;
-    spin_lock_init(&_timer_lock);
-    _timer_task = 0;
 #endif
-    _timer_check = Timestamp::now();
     _timer_check_reports = 0;
 
 #if CLICK_NS
@@ -139,6 +140,10 @@ Master::~Master()
     if (_kqueue >= 0)
 	close(_kqueue);
 #endif
+#if CLICK_USERLEVEL && HAVE_SYS_EPOLL_H
+    if (_epoll_fd >= 0)
+	close(_epoll_fd);
+#endif
 }
 
 void
@@ -163,7 +168,6 @@ Master::unuse()
 void
 Master::pause()
 {
-    lock_timers();
 #if CLICK_USERLEVEL
     _select_lock.acquire();
 #endif
@@ -173,7 +177,11 @@ Master::pause()
 #if CLICK_USERLEVEL
     _select_lock.release();
 #endif
-    unlock_timers();
+    // wait for timer callbacks that started before the pause
+    for (RouterThread **tp = _threads.begin(); tp < _threads.end(); tp++) {
+	(*tp)->lock_idle_timers();
+	(*tp)->unlock_timers();
+    }
 }
 
 
@@ -251,20 +259,8 @@ Master::kill_router(Router *router)
     // likely) when the pending list is processed.
 
     // Remove timers
-    {
-	lock_timers();
-	assert(!_timer_runchunk.size());
-	Timer* t;
-	for (Timer** tp = _timer_heap.end(); tp > _timer_heap.begin(); )
-	    if ((t = *--tp, t->router() == router)) {
-		remove_heap(_timer_heap.begin(), _timer_heap.end(), tp, timer_less(), timer_place(_timer_heap.begin()));
-		_timer_heap.pop_back();
-		t->_owner = 0;
-		t->_schedpos1 = 0;
-	    }
-	set_timer_expiry();
-	unlock_timers();
-    }
+    for (RouterThread **tp = _threads.begin(); tp < _threads.end(); tp++)
+	(*tp)->unschedule_router_timers(router);
 
 #if CLICK_USERLEVEL
     // Remove selects
@@ -372,6 +368,41 @@ Master::check_driver()
 }
 
 
+// READ-COPY-UPDATE
+
+/* A structure shared with packet processing can be replaced without locking
+ * lookups: build the new version on the side, publish it with a pointer
+ * store, call rcu_snapshot(), and reuse or free the old version once
+ * rcu_quiescent() returns true.  RouterThreads advance their epochs at the
+ * top of every driver iteration, so by then no task that might have seen the
+ * old version is still running.  Threads blocked in the OS, or outside the
+ * driver altogether, have odd epochs and never hold things up.  Poll
+ * rcu_quiescent() from a timer or a later update rather than spinning on
+ * it; the thread holding things up may be waiting for the caller. */
+
+void
+Master::rcu_snapshot(Vector<uint32_t> &epochs) const
+{
+    click_fence();		// publish before reading epochs
+    epochs.resize(_threads.size());
+    for (int i = 0; i < _threads.size(); i++)
+	epochs[i] = _threads[i]->_rcu_epoch;
+}
+
+bool
+Master::rcu_quiescent(const Vector<uint32_t> &epochs) const
+{
+    for (int i = 0; i < epochs.size(); i++) {
+	const RouterThread *t = _threads[i];
+	// The calling thread is not in the middle of a lookup.
+	if (!(epochs[i] & 1) && t->_rcu_epoch == epochs[i]
+	    && !t->current_thread_is_running())
+	    return false;
+    }
+    return true;
+}
+
+
 // PENDING TASKS
 
 void
@@ -402,119 +433,26 @@ Master::process_pending(RouterThread *thread)
 
 // TIMERS
 
-void
-Master::set_max_timer_stride(unsigned timer_stride)
-{
-    _max_timer_stride = timer_stride;
-    if (_timer_stride > _max_timer_stride)
-	_timer_stride = _max_timer_stride;
-}
-
-void
-Master::check_timer_expiry(Timer *t)
+Timestamp
+Master::next_timer_expiry() const
 {
-    // do not schedule timers for too far in the past
-    if (t->_expiry.sec() + Timer::behind_sec < _timer_check.sec()) {
-	if (_timer_check_reports > 0) {
-	    --_timer_check_reports;
-	    click_chatter("timer %p outdated expiry %{timestamp} updated to %{timestamp}", t, &t->_expiry, &_timer_check, &t->_expiry);
-	}
-	t->_expiry = _timer_check;
+    // the earliest of the threads' timers
+    Timestamp e;
+    for (int i = 0; i < _threads.size(); i++) {
+	Timestamp te = _threads[i]->next_timer_expiry();
+	if (te && (!e || te < e))
+	    e = te;
     }
-}
-
-inline void
-Master::run_one_timer(Timer *t)
-{
-#if CLICK_STATS >= 2
-    click_cycles_t start_cycles = click_get_cycles();
-#endif
-
-    t->_hook.callback(t, t->_thunk);
-
-#if CLICK_STATS >= 2
-    t->_owner->_timer_cycles += click_get_cycles() - start_cycles;
-    t->_owner->_timer_calls++;
-#endif
+    return e;
 }
 
 void
-Master::run_timers()
+Master::set_max_timer_stride(unsigned timer_stride)
 {
-    if (!attempt_lock_timers())
-	return;
-    if (_master_paused == 0 && _timer_heap.size() > 0 && !_stopper) {
-#if CLICK_LINUXMODULE
-	_timer_task = current;
-#endif
-	_timer_check = Timestamp::now();
-	Timer *t = _timer_heap.at_u(0);
-
-	if (t->_expiry <= _timer_check) {
-	    // potentially adjust timer stride
-	    Timestamp adj_expiry = t->_expiry + Timer::adjustment();
-	    if (adj_expiry <= _timer_check) {
-		_timer_count = 0;
-		if (_timer_stride > 1)
-		    _timer_stride = (_timer_stride * 4) / 5;
-	    } else if (++_timer_count >= 12) {
-		_timer_count = 0;
-		if (++_timer_stride >= _max_timer_stride)
-		    _timer_stride = _max_timer_stride;
-	    }
-
-	    // actually run timers
-	    int max_timers = 64;
-	    do {
-		pop_heap(_timer_heap.begin(), _timer_heap.end(), timer_less(), timer_place(_timer_heap.begin()));
-		_timer_heap.pop_back();
-		set_timer_expiry();
-		t->_schedpos1 = 0;
-
-		run_one_timer(t);
-	    } while (_timer_heap.size() > 0 && !_stopper
-		     && (t = _timer_heap.at_u(0), t->_expiry <= _timer_check)
-		     && --max_timers >= 0);
-
-	    // If we ran out of timers to run, then perhaps there's an
-	    // infinite timer loop or one timer is very far behind system
-	    // time.  Eventually the system would catch up and run all timers,
-	    // but in the meantime other timers could starve.  We detect this
-	    // case and run ALL expired timers, reducing possible damage.
-	    if (max_timers < 0 && !_stopper) {
-		_timer_runchunk.reserve(32);
-		do {
-		    pop_heap(_timer_heap.begin(), _timer_heap.end(), timer_less(), timer_place(_timer_heap.begin()));
-		    _timer_heap.pop_back();
-		    t->_schedpos1 = -_timer_runchunk.size() - 1;
-
-		    _timer_runchunk.push_back(t);
-		} while (_timer_heap.size() > 0
-			 && (t = _timer_heap.at_u(0), t->_expiry <= _timer_check));
-		set_timer_expiry();
-
-		Vector<Timer*>::iterator i = _timer_runchunk.begin();
-		for (; !_stopper && i != _timer_runchunk.end(); ++i)
-		    if (*i) {
-			(*i)->_schedpos1 = 0;
-			run_one_timer(*i);
-		    }
-
-		// reschedule unrun timers if stopped early
-		for (; i != _timer_runchunk.end(); ++i)
-		    if (*i) {
-			(*i)->_schedpos1 = 0;
-			(*i)->schedule_at((*i)->_expiry);
-		    }
-		_timer_runchunk.clear();
-	    }
-	}
-
-#if CLICK_LINUXMODULE
-	_timer_task = 0;
-#endif
-    }
-    unlock_timers();
+    _max_timer_stride = timer_stride;
+    for (int i = 0; i < _threads.size(); i++)
+	if (_threads[i]->_timer_stride > _max_timer_stride)
+	    _threads[i]->_timer_stride = _max_timer_stride;
 }
 
 
@@ -569,6 +507,9 @@ Master::add_select(int fd, Element *element, int mask)
 	_pollfds.back().events = 0;
     }
     int pi = _fd_to_pollfd[fd];
+#if HAVE_SYS_EPOLL_H
+    int old_events = _pollfds[pi].events;
+#endif
 
     // add the elements
     if (add_read) {
@@ -609,6 +550,11 @@ Master::add_select(int fd, Element *element, int mask)
     }
 #endif
 
+#if HAVE_SYS_EPOLL_H
+    if (_epoll_fd >= 0)
+	update_epoll(fd, old_events);
+#endif
+
 #if !HAVE_POLL_H
     // Add 'mask' to the fd_sets
     if (fd < FD_SETSIZE) {
@@ -664,6 +610,11 @@ Master::remove_pollfd(int pi, int event)
 	    click_chatter("Master::remove_pollfd(fd %d): kevent: %s", _pollfds[pi].fd, strerror(errno));
     }
 #endif
+#if HAVE_SYS_EPOLL_H
+    // change or remove the fd's epoll registration
+    if (_epoll_fd >= 0)
+	update_epoll(fd, _pollfds[pi].events | event);
+#endif
 #if !HAVE_POLL_H
     // remove event from select list
     if (fd < FD_SETSIZE) {
@@ -725,7 +676,7 @@ Master::remove_select(int fd, Element *element, int mask)
 
 #if HAVE_SYS_EVENT_H && HAVE_KQUEUE
 void
-Master::run_selects_kqueue(bool more_tasks)
+Master::run_selects_kqueue(RouterThread *thread, bool more_tasks)
 {
     // Decide how long to wait.
 # if CLICK_NS
@@ -739,7 +690,7 @@ Master::run_selects_kqueue(bool more_tasks)
     struct timespec wait, *wait_ptr = &wait;
     wait.tv_sec = wait.tv_nsec = 0;
     if (!more_tasks) {
-	Timestamp t = next_timer_expiry_adjusted();
+	Timestamp t = thread->next_timer_expiry_adjusted();
 	if (t.sec() == 0)
 	    wait_ptr = 0;
 	else if ((t -= Timestamp::now(), t.sec() >= 0))
@@ -760,8 +711,10 @@ Master::run_selects_kqueue(bool more_tasks)
 # endif
 
     struct kevent kev[64];
+    thread->rcu_offline();
     int n = kevent(_kqueue, 0, 0, &kev[0], 64, wait_ptr);
     int was_errno = errno;
+    thread->rcu_online();
     run_signals();
 
 # if HAVE_MULTITHREAD
@@ -790,9 +743,113 @@ Master::run_selects_kqueue(bool more_tasks)
 }
 #endif /* HAVE_SYS_EVENT_H && HAVE_KQUEUE */
 
+#if HAVE_SYS_EPOLL_H
+void
+Master::update_epoll(int fd, int old_events)
+{
+    // Bring the epoll registration for 'fd' in line with its pollfd, whose
+    // events were 'old_events' before the current change.  Registrations
+    // are level-triggered, like poll(): elements may leave data unread in
+    // selected() and expect to be called again.
+    int pi = _fd_to_pollfd[fd];
+    int events = (pi >= 0 ? _pollfds[pi].events : 0);
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = (events & POLLIN ? EPOLLIN : 0) | (events & POLLOUT ? EPOLLOUT : 0);
+    ev.data.fd = fd;
+
+    int r;
+    if (!events) {
+	// A closed fd leaves the epoll set on its own, so ignore errors.
+	(void) epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, fd, &ev);
+	return;
+    } else if (!old_events) {
+	r = epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+	// The fd may still be registered under an earlier incarnation.
+	if (r < 0 && errno == EEXIST)
+	    r = epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+    } else {
+	r = epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+	if (r < 0 && errno == ENOENT)
+	    r = epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    }
+
+    if (r < 0) {
+	// Not all file descriptors are epollable (regular files, for
+	// example).  So if we encounter a problem, fall back to poll().
+	close(_epoll_fd);
+	_epoll_fd = -1;
+    }
+}
+
+void
+Master::run_selects_epoll(RouterThread *thread, bool more_tasks)
+{
+    // Decide how long to wait.
+# if CLICK_NS
+    // Never block if we're running in the simulator.
+    int timeout = 0;
+    (void) more_tasks;
+# else
+    // Never wait if anything is scheduled; otherwise, if no timers, block
+    // indefinitely.
+    int timeout = 0;
+    if (!more_tasks) {
+	Timestamp t = thread->next_timer_expiry_adjusted();
+	if (t.sec() == 0)
+	    timeout = -1;
+	else if ((t -= Timestamp::now(), t.sec() >= 0)) {
+	    if (t.sec() >= INT_MAX / 1000)
+		timeout = INT_MAX - 1000;
+	    else
+		timeout = t.msecval();
+	}
+    }
+# endif /* CLICK_NS */
+
+    // Unlike poll(), epoll_wait() needs no private copy of the fd list:
+    // other threads may safely call epoll_ctl() while we block.
+# if HAVE_MULTITHREAD
+    _selecting_processor = click_current_processor();
+    _select_lock.release();
+# endif
+
+    struct epoll_event ev[64];
+    thread->rcu_offline();
+    int n = epoll_wait(_epoll_fd, &ev[0], 64, timeout);
+    int was_errno = errno;
+    thread->rcu_online();
+    run_signals();
+
+# if HAVE_MULTITHREAD
+    _select_lock.acquire();
+    _selecting_processor = click_invalid_processor();
+# endif
+
+    if (n < 0 && was_errno != EINTR)
+	perror("epoll_wait");
+    else if (n > 0)
+	for (struct epoll_event *p = &ev[0]; p < &ev[n]; p++) {
+	    // Beware: calling 'selected()' might call remove_select(), so
+	    // look up each fd's elements afresh.
+	    int fd = p->data.fd;
+	    Element *read_elt = 0, *write_elt = 0;
+	    if ((p->events & ~EPOLLOUT) && fd < _read_elements.size())
+		read_elt = _read_elements[fd];
+	    if ((p->events & ~EPOLLIN) && fd < _write_elements.size())
+		write_elt = _write_elements[fd];
+
+	    if (read_elt)
+		read_elt->selected(fd);
+	    if (write_elt && write_elt != read_elt)
+		write_elt->selected(fd);
+	}
+}
+#endif /* HAVE_SYS_EPOLL_H */
+
 #if HAVE_POLL_H
 void
-Master::run_selects_poll(bool more_tasks)
+Master::run_selects_poll(RouterThread *thread, bool more_tasks)
 {
     // Decide how long to wait.
 # if CLICK_NS
@@ -804,7 +861,7 @@ Master::run_selects_poll(bool more_tasks)
     // indefinitely.
     int timeout = 0;
     if (!more_tasks) {
-	Timestamp t = next_timer_expiry_adjusted();
+	Timestamp t = thread->next_timer_expiry_adjusted();
 	if (t.sec() == 0)
 	    timeout = -1;
 	else if ((t -= Timestamp::now(), t.sec() >= 0)) {
@@ -826,8 +883,10 @@ Master::run_selects_poll(bool more_tasks)
     Vector<struct pollfd> &my_pollfds(_pollfds);
 # endif
 
+    thread->rcu_offline();
     int n = poll(my_pollfds.begin(), my_pollfds.size(), timeout);
     int was_errno = errno;
+    thread->rcu_online();
     run_signals();
 
 # if HAVE_MULTITHREAD
@@ -865,7 +924,7 @@ Master::run_selects_poll(bool more_tasks)
 
 #else /* !HAVE_POLL_H */
 void
-Master::run_selects_select(bool more_tasks)
+Master::run_selects_select(RouterThread *thread, bool more_tasks)
 {
     // Decide how long to wait.
 # if CLICK_NS
@@ -879,7 +938,7 @@ Master::run_selects_select(bool more_tasks)
     struct timeval wait, *wait_ptr = &wait;
     timerclear(&wait);
     if (!more_tasks) {
-	Timestamp t = next_timer_expiry_adjusted();
+	Timestamp t = thread->next_timer_expiry_adjusted();
 	if (t.sec() == 0)
 	    wait_ptr = 0;
 	else if ((t -= Timestamp::now(), t.sec() >= 0))
@@ -895,8 +954,10 @@ Master::run_selects_select(bool more_tasks)
     _select_lock.release();
 # endif
 
+    thread->rcu_offline();
     int n = select(_max_select_fd + 1, &read_mask, &write_mask, (fd_set*) 0, wait_ptr);
     int was_errno = errno;
+    thread->rcu_online();
     run_signals();
 
 # if HAVE_MULTITHREAD
@@ -934,10 +995,11 @@ Master::run_selects_select(bool more_tasks)
 #endif /* HAVE_POLL_H */
 
 void
-Master::run_selects(bool more_tasks)
+Master::run_selects(RouterThread *thread)
 {
     // Wait in select() for input or timer, and call relevant elements'
     // selected() methods.
+    bool more_tasks = thread->active();
 
     if (!_select_lock.attempt())
 	return;
@@ -952,13 +1014,15 @@ Master::run_selects(bool more_tasks)
 	_select_lock.release();
 	if (!more_tasks) {
 	    struct timeval wait, *wait_ptr = &wait;
-	    Timestamp t = next_timer_expiry_adjusted();
+	    Timestamp t = thread->next_timer_expiry_adjusted();
 	    if (t.sec() == 0)
 		wait_ptr = 0;
 	    else if ((t -= Timestamp::now(), t.sec() >= 0))
 		wait = t.timeval();
+	    thread->rcu_offline();
 	    ignore_result(select(0, (fd_set *) 0, (fd_set *) 0, (fd_set *) 0,
 				 wait_ptr));
+	    thread->rcu_online();
 	}
 	return;
     }
@@ -975,14 +1039,20 @@ Master::run_selects(bool more_tasks)
     // Call the relevant selector implementation.
 #if HAVE_SYS_EVENT_H && HAVE_KQUEUE
     if (_kqueue >= 0) {
-	run_selects_kqueue(more_tasks);
+	run_selects_kqueue(thread, more_tasks);
+	goto unlock_select_exit;
+    }
+#endif
+#if HAVE_SYS_EPOLL_H
+    if (_epoll_fd >= 0) {
+	run_selects_epoll(thread, more_tasks);
 	goto unlock_select_exit;
     }
 #endif
 #if HAVE_POLL_H
-    run_selects_poll(more_tasks);
+    run_selects_poll(thread, more_tasks);
 #else
-    run_selects_select(more_tasks);
+    run_selects_select(thread, more_tasks);
 #endif
 
  unlock_select_exit:
@@ -25,6 +25,11 @@
 #if CLICK_USERLEVEL
 # include <unistd.h>
 #endif
+#if HAVE_CLICK_PACKET_POOL
+# include <click/integers.hh>
+# include <click/straccum.hh>
+# include <click/sync.hh>
+#endif
 CLICK_DECLS
 
 /** @file packet.hh
@@ -209,6 +214,339 @@ Packet::Packet()
 #endif
 }
 
+
+//
+// PACKET POOL
+//
+
+#if HAVE_CLICK_PACKET_POOL
+// Each thread keeps a private pool of free Packet headers and free data
+// buffers, so Packet::make() and Packet::kill() rarely call the allocator.
+// Data buffers come in a few size classes; a request is rounded up to the
+// smallest class that fits.  Buffers larger than the largest class are not
+// pooled.
+//
+// When one thread allocates packets and another frees them, the freeing
+// thread's pool would grow without bound.  So when a per-thread free list
+// reaches CLICK_PACKET_POOL_SIZE entries, the whole list is moved as a batch
+// to a global pool, where allocating threads can pick it up.  The global
+// pool holds at most CLICK_GLOBAL_PACKET_POOL_COUNT batches of each kind;
+// excess batches are returned to the system.
+# define CLICK_PACKET_POOL_SIZE			1024
+# define CLICK_GLOBAL_PACKET_POOL_COUNT		16
+# define CLICK_PACKET_POOL_NCLASS		3
+
+static const uint32_t packet_pool_class_size[CLICK_PACKET_POOL_NCLASS] = {
+    256, 2048, 10240
+};
+
+namespace {
+struct PacketData {
+    PacketData *next;		// next free buffer in this list
+    PacketData *batch_next;	// next list (in global pool)
+};
+
+struct PacketPool {
+    WritablePacket *p;		// free headers, linked by _next
+    unsigned pcount;
+    PacketData *pd[CLICK_PACKET_POOL_NCLASS]; // free buffers by size class
+    unsigned pdcount[CLICK_PACKET_POOL_NCLASS];
+    click_uint_large_t hits;	// allocations satisfied from the pool
+    click_uint_large_t misses;	// allocations that fell back to new
+    PacketPool *thread_pool_next;
+};
+}
+
+# if HAVE_MULTITHREAD
+static __thread PacketPool *thread_packet_pool;
+static PacketPool *all_thread_packet_pools;
+
+// Global pool: lists of exactly CLICK_PACKET_POOL_SIZE free items, chained
+// through _prev (headers) or batch_next (buffers).
+static struct {
+    WritablePacket *p;
+    unsigned pbatches;
+    PacketData *pd[CLICK_PACKET_POOL_NCLASS];
+    unsigned pdbatches[CLICK_PACKET_POOL_NCLASS];
+} global_packet_pool;
+static Spinlock global_packet_pool_lock;
+
+static PacketPool *
+make_thread_packet_pool()
+{
+    PacketPool *pp = new PacketPool;
+    memset(pp, 0, sizeof(PacketPool));
+    global_packet_pool_lock.acquire();
+    pp->thread_pool_next = all_thread_packet_pools;
+    all_thread_packet_pools = pp;
+    global_packet_pool_lock.release();
+    return thread_packet_pool = pp;
+}
+
+static inline PacketPool &
+packet_pool()
+{
+    PacketPool *pp = thread_packet_pool;
+    if (unlikely(!pp))
+	pp = make_thread_packet_pool();
+    return *pp;
+}
+# else
+static PacketPool the_packet_pool;
+
+static inline PacketPool &
+packet_pool()
+{
+    return the_packet_pool;
+}
+# endif
+
+static inline int
+packet_pool_class(uint32_t n)
+{
+    for (int c = 0; c < CLICK_PACKET_POOL_NCLASS; ++c)
+	if (n <= packet_pool_class_size[c])
+	    return c;
+    return -1;
+}
+
+static WritablePacket *
+packet_pool_take_packet(PacketPool &pool)
+{
+    if (!pool.p) {
+# if HAVE_MULTITHREAD
+	if (global_packet_pool.p) {
+	    global_packet_pool_lock.acquire();
+	    if (WritablePacket *p = global_packet_pool.p) {
+		global_packet_pool.p = static_cast<WritablePacket *>(p->prev());
+		--global_packet_pool.pbatches;
+		pool.p = p;
+		pool.pcount = CLICK_PACKET_POOL_SIZE;
+	    }
+	    global_packet_pool_lock.release();
+	}
+	if (!pool.p)
+# endif
+	    return 0;
+    }
+    WritablePacket *p = pool.p;
+    pool.p = static_cast<WritablePacket *>(p->next());
+    --pool.pcount;
+    return p;
+}
+
+static unsigned char *
+packet_pool_take_data(PacketPool &pool, int c)
+{
+    if (!pool.pd[c]) {
+# if HAVE_MULTITHREAD
+	if (global_packet_pool.pd[c]) {
+	    global_packet_pool_lock.acquire();
+	    if (PacketData *pd = global_packet_pool.pd[c]) {
+		global_packet_pool.pd[c] = pd->batch_next;
+		--global_packet_pool.pdbatches[c];
+		pool.pd[c] = pd;
+		pool.pdcount[c] = CLICK_PACKET_POOL_SIZE;
+	    }
+	    global_packet_pool_lock.release();
+	}
+	if (!pool.pd[c])
+# endif
+	    return 0;
+    }
+    PacketData *pd = pool.pd[c];
+    pool.pd[c] = pd->next;
+    --pool.pdcount[c];
+    return reinterpret_cast<unsigned char *>(pd);
+}
+
+// Pooled headers own no data, so we release their memory without running
+// ~Packet().
+static void
+packet_pool_free_packet_list(WritablePacket *p)
+{
+    while (p) {
+	WritablePacket *next = static_cast<WritablePacket *>(p->next());
+	::operator delete((void *) p);
+	p = next;
+    }
+}
+
+static void
+packet_pool_free_data_list(PacketData *pd)
+{
+    while (pd) {
+	PacketData *next = pd->next;
+	delete[] reinterpret_cast<unsigned char *>(pd);
+	pd = next;
+    }
+}
+
+// Called with a list of exactly CLICK_PACKET_POOL_SIZE free headers.
+static void
+packet_pool_overflow_packets(WritablePacket *p)
+{
+# if HAVE_MULTITHREAD
+    global_packet_pool_lock.acquire();
+    if (global_packet_pool.pbatches < CLICK_GLOBAL_PACKET_POOL_COUNT) {
+	p->set_prev(global_packet_pool.p);
+	global_packet_pool.p = p;
+	++global_packet_pool.pbatches;
+	p = 0;
+    }
+    global_packet_pool_lock.release();
+# endif
+    packet_pool_free_packet_list(p);
+}
+
+static void
+packet_pool_overflow_data(PacketData *pd, int c)
+{
+# if HAVE_MULTITHREAD
+    global_packet_pool_lock.acquire();
+    if (global_packet_pool.pdbatches[c] < CLICK_GLOBAL_PACKET_POOL_COUNT) {
+	pd->batch_next = global_packet_pool.pd[c];
+	global_packet_pool.pd[c] = pd;
+	++global_packet_pool.pdbatches[c];
+	pd = 0;
+    }
+    global_packet_pool_lock.release();
+# else
+    (void) c;
+# endif
+    packet_pool_free_data_list(pd);
+}
+
+static inline void
+packet_pool_put_packet(PacketPool &pool, WritablePacket *p)
+{
+    if (pool.pcount == CLICK_PACKET_POOL_SIZE) {
+	packet_pool_overflow_packets(pool.p);
+	pool.p = 0;
+	pool.pcount = 0;
+    }
+    p->set_next(pool.p);
+    pool.p = p;
+    ++pool.pcount;
+}
+
+// Free a data buffer allocated with new[].  Buffers whose length matches a
+// size class exactly are kept for reuse.
+static inline void
+packet_pool_put_data(unsigned char *head, uint32_t n)
+{
+    int c = packet_pool_class(n);
+    if (c < 0 || packet_pool_class_size[c] != n) {
+	delete[] head;
+	return;
+    }
+    PacketPool &pool = packet_pool();
+    if (pool.pdcount[c] == CLICK_PACKET_POOL_SIZE) {
+	packet_pool_overflow_data(pool.pd[c], c);
+	pool.pd[c] = 0;
+	pool.pdcount[c] = 0;
+    }
+    PacketData *pd = reinterpret_cast<PacketData *>(head);
+    pd->next = pool.pd[c];
+    pool.pd[c] = pd;
+    ++pool.pdcount[c];
+}
+
+/** @cond never */
+/** @brief Return a dead packet and its data to the packet pool.
+ *
+ * Called by kill() when the use count reaches zero. */
+void
+Packet::recycle(Packet *p)
+{
+    if (p->_data_packet)
+	p->_data_packet->kill();
+    else if (p->_head && p->_destructor)
+	p->_destructor(p->_head, p->_end - p->_head);
+    else if (p->_head)
+	packet_pool_put_data(p->_head, p->_end - p->_head);
+    packet_pool_put_packet(packet_pool(), static_cast<WritablePacket *>(p));
+}
+/** @endcond never */
+
+/** @brief Return packet pool statistics.
+ *
+ * The result has one "NAME VALUE" pair per line: pool hits and misses
+ * summed over all threads, followed by the number of free packet headers
+ * and free data buffers of each size class currently held in pools.  Used
+ * by the global "packet_pool" read handler. */
+String
+Packet::packet_pool_stats()
+{
+    click_uint_large_t hits = 0, misses = 0;
+    unsigned pcount = 0, pdcount[CLICK_PACKET_POOL_NCLASS];
+    memset(pdcount, 0, sizeof(pdcount));
+# if HAVE_MULTITHREAD
+    global_packet_pool_lock.acquire();
+    pcount = global_packet_pool.pbatches * CLICK_PACKET_POOL_SIZE;
+    for (int c = 0; c < CLICK_PACKET_POOL_NCLASS; ++c)
+	pdcount[c] = global_packet_pool.pdbatches[c] * CLICK_PACKET_POOL_SIZE;
+    for (PacketPool *pp = all_thread_packet_pools; pp; pp = pp->thread_pool_next) {
+# else
+    {
+	PacketPool *pp = &the_packet_pool;
+# endif
+	hits += pp->hits;
+	misses += pp->misses;
+	pcount += pp->pcount;
+	for (int c = 0; c < CLICK_PACKET_POOL_NCLASS; ++c)
+	    pdcount[c] += pp->pdcount[c];
+    }
+# if HAVE_MULTITHREAD
+    global_packet_pool_lock.release();
+# endif
+
+    StringAccum sa;
+    sa << "hits " << hits << '\n'
+       << "misses " << misses << '\n'
+       << "packets " << pcount << '\n';
+    for (int c = 0; c < CLICK_PACKET_POOL_NCLASS; ++c)
+	sa << "buffers_" << packet_pool_class_size[c] << ' ' << pdcount[c] << '\n';
+    return sa.take_string();
+}
+
+/** @brief Free all pooled packet headers and data buffers.
+ *
+ * Called by click_static_cleanup(), when no other threads are running. */
+void
+Packet::static_cleanup()
+{
+# if HAVE_MULTITHREAD
+    while (WritablePacket *p = global_packet_pool.p) {
+	global_packet_pool.p = static_cast<WritablePacket *>(p->prev());
+	packet_pool_free_packet_list(p);
+    }
+    global_packet_pool.pbatches = 0;
+    for (int c = 0; c < CLICK_PACKET_POOL_NCLASS; ++c) {
+	while (PacketData *pd = global_packet_pool.pd[c]) {
+	    global_packet_pool.pd[c] = pd->batch_next;
+	    packet_pool_free_data_list(pd);
+	}
+	global_packet_pool.pdbatches[c] = 0;
+    }
+    for (PacketPool *pp = all_thread_packet_pools; pp; pp = pp->thread_pool_next) {
+# else
+    {
+	PacketPool *pp = &the_packet_pool;
+# endif
+	packet_pool_free_packet_list(pp->p);
+	pp->p = 0;
+	pp->pcount = 0;
+	for (int c = 0; c < CLICK_PACKET_POOL_NCLASS; ++c) {
+	    packet_pool_free_data_list(pp->pd[c]);
+	    pp->pd[c] = 0;
+	    pp->pdcount[c] = 0;
+	}
+    }
+}
+#endif /* HAVE_CLICK_PACKET_POOL */
+
+
 Packet::~Packet()
 {
 #if CLICK_LINUXMODULE
@@ -219,6 +557,10 @@ Packet::~Packet()
 # if CLICK_USERLEVEL
     else if (_head && _destructor)
 	_destructor(_head, _end - _head);
+#  if HAVE_CLICK_PACKET_POOL
+    else if (_head)
+	packet_pool_put_data(_head, _end - _head);
+#  endif
     else
 	delete[] _head;
 # elif CLICK_BSDMODULE
@@ -234,6 +576,14 @@ Packet::~Packet()
 inline WritablePacket *
 Packet::make(int, int, int)
 {
+#if HAVE_CLICK_PACKET_POOL
+    PacketPool &pool = packet_pool();
+    if (WritablePacket *p = packet_pool_take_packet(pool)) {
+	++pool.hits;
+	return p;
+    }
+    ++pool.misses;
+#endif
     return static_cast<WritablePacket *>(new Packet(6, 6, 6));
 }
 
@@ -246,7 +596,22 @@ Packet::alloc_data(uint32_t headroom, uint32_t len, uint32_t tailroom)
     n = min_buffer_length;
   }
 #if CLICK_USERLEVEL
+# if HAVE_CLICK_PACKET_POOL
+  unsigned char *d = 0;
+  int c = packet_pool_class(n);
+  if (c >= 0) {
+    n = packet_pool_class_size[c];
+    PacketPool &pool = packet_pool();
+    if ((d = packet_pool_take_data(pool, c)))
+      ++pool.hits;
+    else
+      ++pool.misses;
+  }
+  if (!d)
+    d = new unsigned char[n];
+# else
   unsigned char *d = new unsigned char[n];
+# endif
   if (!d)
     return false;
   _head = d;
@@ -316,11 +681,17 @@ Packet::make(uint32_t headroom, const void *data,
     } else
 	return 0;
 #else
+# if HAVE_CLICK_PACKET_POOL
+    WritablePacket *p = make(6, 6, 6);
+    if (p)
+	new((void *) p) WritablePacket;
+# else
     WritablePacket *p = new WritablePacket;
+# endif
     if (!p)
 	return 0;
     if (!p->alloc_data(headroom, length, tailroom)) {
-	delete p;
+	p->kill();
 	return 0;
     }
     if (data)
@@ -350,7 +721,13 @@ WritablePacket *
 Packet::make(unsigned char *data, uint32_t length,
 	     void (*destructor)(unsigned char *, size_t))
 {
+# if HAVE_CLICK_PACKET_POOL
+    WritablePacket *p = make(6, 6, 6);
+    if (p)
+	new((void *) p) WritablePacket;
+# else
     WritablePacket *p = new WritablePacket;
+# endif
     if (p) {
 	p->_head = p->_data = data;
 	p->_tail = p->_end = data + length;
@@ -508,7 +885,11 @@ Packet::expensive_uniqueify(int32_t extra_headroom, int32_t extra_tailroom,
     else if (_destructor)
 	_destructor(old_head, old_end - old_head);
     else
+#  if HAVE_CLICK_PACKET_POOL
+	packet_pool_put_data(old_head, old_end - old_head);
+#  else
 	delete[] old_head;
+#  endif
     _destructor = 0;
 # elif CLICK_BSDMODULE
     else
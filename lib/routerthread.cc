@@ -24,6 +24,7 @@
 #include <click/router.hh>
 #include <click/routerthread.hh>
 #include <click/master.hh>
+#include <click/integers.hh>
 #if CLICK_LINUXMODULE
 # include <click/cxxprotect.h>
 CLICK_CXX_PROTECT
@@ -82,6 +83,7 @@ RouterThread::RouterThread(Master *m, int id)
     _prev = _next = _thread = this;
 #endif
     _any_pending = 0;
+    _rcu_epoch = 1;
 #if CLICK_LINUXMODULE
     _linux_task = 0;
 #elif HAVE_MULTITHREAD
@@ -89,6 +91,18 @@ RouterThread::RouterThread(Master *m, int id)
 #endif
     _task_blocker = 0;
     _task_blocker_waiting = 0;
+
+    _timer_stride = m->_max_timer_stride;
+    _timer_count = 0;
+    memset(_timer_wheel, 0, sizeof(_timer_wheel));
+    memset(_timer_wheel_used, 0, sizeof(_timer_wheel_used));
+    _timer_overflow = _timer_runlist = 0;
+    _timer_running = false;
+    _timer_tick = timer_tick(Timestamp::now());
+#if CLICK_LINUXMODULE
+    spin_lock_init(&_timer_lock);
+#endif
+    _timer_check = Timestamp::now();
 #if HAVE_ADAPTIVE_SCHEDULER
     _max_click_share = 80 * Task::MAX_UTILIZATION / 100;
     _min_click_share = Task::MAX_UTILIZATION / 200;
@@ -417,8 +431,10 @@ RouterThread::run_os()
     driver_unlock_tasks();
 
 #if CLICK_USERLEVEL
-    _master->run_selects(active());
+    // run_selects() marks the thread offline while it blocks
+    _master->run_selects(this);
 #elif CLICK_LINUXMODULE		/* Linux kernel module */
+    rcu_offline();
     if (_greedy) {
 	if (time_after(jiffies, greedy_schedule_jiffies + 5 * CLICK_HZ)) {
 	    greedy_schedule_jiffies = jiffies;
@@ -429,11 +445,7 @@ RouterThread::run_os()
 	SET_STATE(S_PAUSED);
 	set_current_state(TASK_RUNNING);
 	schedule();
-    } else if (_id != 0) {
-      block:
-	SET_STATE(S_BLOCKED);
-	schedule();
-    } else if (Timestamp wait = _master->next_timer_expiry_adjusted()) {
+    } else if (Timestamp wait = next_timer_expiry_adjusted()) {
 	wait -= Timestamp::now();
 	if (!(wait > Timestamp(0, Timestamp::subsec_per_sec / CLICK_HZ)))
 	    goto short_pause;
@@ -442,10 +454,14 @@ RouterThread::run_os()
 	    (void) schedule_timeout(LONG_MAX - CLICK_HZ - 1);
 	else
 	    (void) schedule_timeout(wait.jiffies() - 1);
-    } else
-	goto block;
+    } else {
+	SET_STATE(S_BLOCKED);
+	schedule();
+    }
     SET_STATE(S_RUNNING);
+    rcu_online();
 #elif defined(CLICK_BSDMODULE)
+    rcu_offline();
     if (_greedy)
 	/* do nothing */;
     else if (active()) {	// just schedule others for a moment
@@ -455,6 +471,7 @@ RouterThread::run_os()
 	tsleep(&_sleep_ident, PPAUSE, "pause", 1);
 	_sleep_ident = NULL;
     }
+    rcu_online();
 #else
 # error "Compiling for unknown target."
 #endif
@@ -475,6 +492,7 @@ RouterThread::driver()
 #endif
 
     driver_lock_tasks();
+    rcu_online();
 
 #if HAVE_ADAPTIVE_SCHEDULER
     int restride_iter = 0;
@@ -497,6 +515,9 @@ RouterThread::driver()
     _driver_epoch++;
 #endif
 
+    // Nothing from the previous iteration is still being looked at.
+    rcu_quiescent();
+
     if (*stopper == 0) {
 	// run occasional tasks: timers, select, etc.
 	iter++;
@@ -511,20 +532,20 @@ RouterThread::driver()
 #endif
 
 #if BSD_NETISRSCHED
-	bool run_timers = (iter % _master->timer_stride()) == 0
+	bool check_timers = (iter % _timer_stride) == 0
 	    || _oticks != ticks;
 #else
-	bool run_timers = (iter % _master->timer_stride()) == 0;
+	bool check_timers = (iter % _timer_stride) == 0;
 #endif
-	if (run_timers) {
+	if (check_timers) {
 #if BSD_NETISRSCHED
 	    _oticks = ticks;
 #endif
-	    _master->run_timers();
+	    run_timers();
 #if CLICK_NS
 	    // If there's another timer, tell the simulator to make us
 	    // run when it's due to go off.
-	    if (Timestamp next_expiry = _master->next_timer_expiry()) {
+	    if (Timestamp next_expiry = _timer_expiry) {
 		struct timeval nexttime = next_expiry.timeval();
 		simclick_sim_command(_master->simnode(), SIMCLICK_SCHEDULE, &nexttime);
 	    }
@@ -578,6 +599,7 @@ RouterThread::driver()
 #endif
 
   finish_driver:
+    rcu_offline();
     driver_unlock_tasks();
 
 #if HAVE_ADAPTIVE_SCHEDULER
@@ -610,6 +632,7 @@ RouterThread::driver_once()
     _running_processor = click_current_processor();
 #endif
     driver_lock_tasks();
+    rcu_online();
 
     Task *t = task_begin();
     if (t != task_end() && !t->_pending_nextptr) {
@@ -617,6 +640,7 @@ RouterThread::driver_once()
 	t->fire();
     }
 
+    rcu_offline();
     driver_unlock_tasks();
 #if CLICK_BSDMODULE  /* XXX MARKO */
     splx(s);
@@ -660,6 +684,274 @@ RouterThread::unschedule_router_tasks(Router* r)
     unlock_tasks();
 }
 
+
+// TIMERS
+
+void
+RouterThread::check_timer_expiry(Timer *t)
+{
+    // do not schedule timers for too far in the past
+    if (t->_expiry.sec() + Timer::behind_sec < _timer_check.sec()) {
+	if (_master->_timer_check_reports > 0) {
+	    --_master->_timer_check_reports;
+	    click_chatter("timer %p outdated expiry %{timestamp} updated to %{timestamp}", t, &t->_expiry, &_timer_check, &t->_expiry);
+	}
+	t->_expiry = _timer_check;
+    }
+}
+
+inline void
+RouterThread::run_one_timer(Timer *t)
+{
+#if CLICK_STATS >= 2
+    click_cycles_t start_cycles = click_get_cycles();
+#endif
+
+    t->_hook.callback(t, t->_thunk);
+
+#if CLICK_STATS >= 2
+    t->_owner->_timer_cycles += click_get_cycles() - start_cycles;
+    t->_owner->_timer_calls++;
+#endif
+}
+
+void
+RouterThread::timer_insert(Timer *t)
+{
+    uint64_t tick = timer_tick(t->_expiry);
+    if (tick < _timer_tick)
+	tick = _timer_tick;
+
+    // Find the lowest level whose slots cover the timer's tick.
+    uint64_t diff = tick ^ _timer_tick;
+    int level = 0;
+    while (level < timer_wheel_levels
+	   && (diff >> ((level + 1) * timer_wheel_bits)) != 0)
+	++level;
+
+    if (level == timer_wheel_levels)
+	timer_link(t, &_timer_overflow);
+    else {
+	int slot = (tick >> (level * timer_wheel_bits)) & (timer_wheel_size - 1);
+	timer_link(t, &_timer_wheel[level][slot]);
+	_timer_wheel_used[level][slot >> 5] |= 1U << (slot & 31);
+    }
+}
+
+int
+RouterThread::timer_wheel_next(int level, int slot)
+{
+    // Return the first nonempty slot at or after 'slot' in 'level', or -1.
+    // Bits in _timer_wheel_used may be stale (unschedule() doesn't clear
+    // them), so clear them here as we go.
+    uint32_t *used = _timer_wheel_used[level];
+    for (int w = slot >> 5; w < timer_wheel_size / 32; ++w) {
+	uint32_t bits = used[w];
+	if (w == (slot >> 5))
+	    bits &= ~0U << (slot & 31);
+	while (bits) {
+	    int s = (w << 5) + ffs_lsb(bits) - 1;
+	    if (_timer_wheel[level][s])
+		return s;
+	    used[w] &= ~(1U << (s & 31));
+	    bits &= bits - 1;
+	}
+    }
+    return -1;
+}
+
+uint64_t
+RouterThread::timer_next_tick()
+{
+    // Return the next tick after _timer_tick at which a wheel slot needs
+    // attention, or ~0 if there is none.  A hit at a lower level always
+    // precedes any hit at a higher level.
+    for (int level = 0; level < timer_wheel_levels; ++level) {
+	int shift = level * timer_wheel_bits;
+	int slot = (_timer_tick >> shift) & (timer_wheel_size - 1);
+	if (slot + 1 < timer_wheel_size
+	    && (slot = timer_wheel_next(level, slot + 1)) >= 0)
+	    return ((_timer_tick >> (shift + timer_wheel_bits)) << (shift + timer_wheel_bits))
+		| ((uint64_t) slot << shift);
+    }
+    if (_timer_overflow) {
+	int shift = timer_wheel_levels * timer_wheel_bits;
+	return ((_timer_tick >> shift) + 1) << shift;
+    }
+    return ~(uint64_t) 0;
+}
+
+void
+RouterThread::timer_cascade(Timer **head)
+{
+    // Reinsert the timers in 'head' relative to the current _timer_tick;
+    // they will move to lower levels.
+    Timer *t = *head;
+    *head = 0;
+    while (t) {
+	Timer *next = t->_next;
+	timer_insert(t);
+	t = next;
+    }
+}
+
+static int
+timer_expiry_compar(const void *a, const void *b, void *)
+{
+    const Timestamp &ta = (*reinterpret_cast<Timer * const *>(a))->expiry();
+    const Timestamp &tb = (*reinterpret_cast<Timer * const *>(b))->expiry();
+    return (ta < tb ? -1 : (tb < ta ? 1 : 0));
+}
+
+void
+RouterThread::timer_collect()
+{
+    // Advance the wheel to _timer_check, moving expired timers onto
+    // _timer_runlist in expiry order.
+    uint64_t now_tick = timer_tick(_timer_check);
+    assert(!_timer_runchunk.size());
+    while (1) {
+	Timer **pp = &_timer_wheel[0][_timer_tick & (timer_wheel_size - 1)];
+	while (Timer *t = *pp)
+	    if (t->_expiry <= _timer_check) {
+		timer_unlink(t);
+		_timer_runchunk.push_back(t);
+	    } else
+		pp = &t->_next;
+
+	if (_timer_tick >= now_tick)
+	    break;
+	uint64_t next_tick = timer_next_tick();
+	if (next_tick > now_tick) {
+	    // nothing is stored between here and now_tick
+	    _timer_tick = now_tick;
+	    break;
+	}
+
+	// cascade higher levels whose slots begin at next_tick
+	_timer_tick = next_tick;
+	int shift = timer_wheel_levels * timer_wheel_bits;
+	if ((_timer_tick & ((((uint64_t) 1) << shift) - 1)) == 0)
+	    timer_cascade(&_timer_overflow);
+	for (int level = timer_wheel_levels - 1; level > 0; --level) {
+	    shift = level * timer_wheel_bits;
+	    if ((_timer_tick & ((((uint64_t) 1) << shift) - 1)) == 0)
+		timer_cascade(&_timer_wheel[level][(_timer_tick >> shift) & (timer_wheel_size - 1)]);
+	}
+    }
+
+    // Timers within a tick arrive unordered; sort them.
+    if (_timer_runchunk.size() > 1)
+	click_qsort(_timer_runchunk.begin(), _timer_runchunk.size(), sizeof(Timer *), timer_expiry_compar);
+    Timer **tail = &_timer_runlist;
+    while (*tail)
+	tail = &(*tail)->_next;
+    for (Timer **tp = _timer_runchunk.begin(); tp != _timer_runchunk.end(); ++tp) {
+	timer_link(*tp, tail);
+	tail = &(*tp)->_next;
+    }
+    _timer_runchunk.clear();
+}
+
+void
+RouterThread::set_timer_expiry()
+{
+    // Set _timer_expiry to a lower bound on the earliest expiry of any
+    // scheduled timer.  The bound is exact when the earliest timer is in the
+    // lowest level of the wheel.
+    Timestamp e;
+    int slot = timer_wheel_next(0, _timer_tick & (timer_wheel_size - 1));
+    if (slot >= 0) {
+	for (Timer *t = _timer_wheel[0][slot]; t; t = t->_next)
+	    if (!e || t->_expiry < e)
+		e = t->_expiry;
+    } else {
+	uint64_t tick = timer_next_tick();
+	if (tick != ~(uint64_t) 0) {
+	    uint32_t frac = tick & ((1 << timer_tick_shift) - 1);
+	    e = Timestamp::make_usec((Timestamp::seconds_type) (tick >> timer_tick_shift),
+				     (frac * 1000000) >> timer_tick_shift);
+	}
+    }
+    _timer_expiry = e;
+}
+
+void
+RouterThread::run_timers()
+{
+    if (!attempt_lock_timers())
+	return;
+    if (_master->_master_paused == 0 && _timer_expiry && !_master->_stopper) {
+	_timer_check = Timestamp::now();
+
+	if (_timer_expiry <= _timer_check) {
+	    timer_collect();
+
+	    if (Timer *t = _timer_runlist) {
+		// potentially adjust timer stride
+		Timestamp adj_expiry = t->_expiry + Timer::adjustment();
+		if (adj_expiry <= _timer_check) {
+		    _timer_count = 0;
+		    if (_timer_stride > 1)
+			_timer_stride = (_timer_stride * 4) / 5;
+		} else if (++_timer_count >= 12) {
+		    _timer_count = 0;
+		    if (++_timer_stride >= _master->_max_timer_stride)
+			_timer_stride = _master->_max_timer_stride;
+		}
+	    }
+
+	    // Actually run timers.  Only timers that had expired when we
+	    // collected them run, so a timer that reschedules itself into
+	    // the past cannot starve the others.  Callbacks may unschedule
+	    // or reschedule run-list timers, removing them from the list.
+	    // Callbacks run unlocked, so other threads scheduling timers here
+	    // never wait for them; Master::pause() waits for _timer_running
+	    // to clear instead.
+	    _timer_running = true;
+	    while (Timer *t = _timer_runlist) {
+		if (_master->_stopper || _master->_master_paused > 0)
+		    break;
+		timer_unlink(t);
+		unlock_timers();
+		run_one_timer(t);
+		lock_timers();
+	    }
+
+	    // reschedule unrun timers if stopped early
+	    while (Timer *t = _timer_runlist) {
+		timer_unlink(t);
+		timer_insert(t);
+	    }
+	    _timer_running = false;
+
+	    set_timer_expiry();
+	}
+    }
+    unlock_timers();
+}
+
+void
+RouterThread::unschedule_router_timers(Router *r)
+{
+    lock_idle_timers();
+    assert(!_timer_runlist);
+    int nslots = timer_wheel_levels * timer_wheel_size;
+    for (int i = 0; i <= nslots; ++i) {
+	Timer **head = (i < nslots ? &_timer_wheel[0][0] + i : &_timer_overflow);
+	for (Timer *t = *head, *next; t; t = next) {
+	    next = t->_next;
+	    if (t->router() == r) {
+		timer_unlink(t);
+		t->_owner = 0;
+		t->_thread = 0;
+	    }
+	}
+    }
+    set_timer_expiry();
+    unlock_timers();
+}
+
 #if CLICK_DEBUG_SCHEDULING
 String
 RouterThread::thread_state_name(int ts)
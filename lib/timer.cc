@@ -192,69 +192,109 @@ Timer::task_hook(Timer *, void *thunk)
 
 
 Timer::Timer()
-    : _schedpos1(0), _thunk(0), _owner(0)
+    : _pprev(0), _thunk(0), _owner(0), _thread(0)
 {
     _hook.callback = empty_hook;
 }
 
 Timer::Timer(TimerCallback f, void *user_data)
-    : _schedpos1(0), _thunk(user_data), _owner(0)
+    : _pprev(0), _thunk(user_data), _owner(0), _thread(0)
 {
     _hook.callback = f;
 }
 
 Timer::Timer(Element* element)
-    : _schedpos1(0), _thunk(element), _owner(0)
+    : _pprev(0), _thunk(element), _owner(0), _thread(0)
 {
     _hook.callback = element_hook;
 }
 
 Timer::Timer(Task* task)
-    : _schedpos1(0), _thunk(task), _owner(0)
+    : _pprev(0), _thunk(task), _owner(0), _thread(0)
 {
     _hook.callback = task_hook;
 }
 
+void
+Timer::initialize(Element *owner)
+{
+    assert(!initialized() || _owner->router() == owner->router());
+    _owner = owner;
+    if (!_thread)
+	_thread = owner->master()->thread(0);
+}
+
 void
 Timer::initialize(Router *router)
 {
     initialize(router->root_element());
 }
 
+RouterThread *
+Timer::lock_thread()
+{
+    // Another thread may move the timer between our reading _thread and
+    // locking that thread's timers, so check again once locked.
+    while (RouterThread *thread = _thread) {
+	thread->lock_timers();
+	if (thread == _thread)
+	    return thread;
+	thread->unlock_timers();
+    }
+    return 0;
+}
+
 void
 Timer::schedule_at(const Timestamp& when)
 {
-    // acquire lock, unschedule
     assert(_owner && initialized());
-    Master* master = _owner->master();
-    master->lock_timers();
+
+    // the timer moves to the driver thread scheduling it, if any
+    RouterThread *to = _thread;
+    if (!to->current_thread_is_running()) {
+	Master *master = _owner->master();
+	for (int i = 0; i < master->nthreads(); i++)
+	    if (master->thread(i)->current_thread_is_running()) {
+		to = master->thread(i);
+		break;
+	    }
+    }
+
+    // acquire lock, unschedule
+  retry:
+    RouterThread *thread = lock_thread();
+    if (_pprev)
+	RouterThread::timer_unlink(this);
+    if (thread != to) {
+	// The timer is on no wheel until we lock the new thread's timers;
+	// if someone else scheduled it meanwhile, start over.
+	_thread = to;
+	thread->unlock_timers();
+	thread = lock_thread();
+	if (thread != to) {
+	    thread->unlock_timers();
+	    goto retry;
+	}
+	if (_pprev)
+	    RouterThread::timer_unlink(this);
+    }
 
     // set expiration timer
     _expiry = when;
 
-    // manipulate list; this is essentially a "decrease-key" operation
-    // any reschedule removes a timer from the runchunk (XXX -- even backwards
-    // reschedulings)
-    int old_schedpos1 = _schedpos1;
-    if (_schedpos1 <= 0) {
-	if (_schedpos1 < 0)
-	    master->_timer_runchunk[-_schedpos1 - 1] = 0;
-	_schedpos1 = master->_timer_heap.size() + 1;
-	master->_timer_heap.push_back(this);
-    }
-    master->check_timer_expiry(this);
-    change_heap(master->_timer_heap.begin(), master->_timer_heap.end(),
-		master->_timer_heap.begin() + _schedpos1 - 1,
-		Master::timer_less(), Master::timer_place(master->_timer_heap.begin()));
-    if (old_schedpos1 == 1 || _schedpos1 == 1)
-	master->set_timer_expiry();
+    // move the timer to its new wheel slot; any reschedule removes a timer
+    // from the run list (XXX -- even backwards reschedulings)
+    thread->check_timer_expiry(this);
+    thread->timer_insert(this);
 
-    // if we changed the timeout, wake up the first thread
-    if (_schedpos1 == 1)
-	master->_threads[2]->wake();
+    // if we changed the timeout, wake up the thread
+    if (!thread->_timer_expiry || _expiry < thread->_timer_expiry) {
+	thread->_timer_expiry = _expiry;
+	thread->wake();
+    }
 
     // done
-    master->unlock_timers();
+    thread->unlock_timers();
 }
 
 void
@@ -268,22 +308,14 @@ Timer::unschedule()
 {
     if (!scheduled())
 	return;
-    Master* master = _owner->master();
-    master->lock_timers();
-    int old_schedpos1 = _schedpos1;
-    if (_schedpos1 > 0) {
-	remove_heap(master->_timer_heap.begin(), master->_timer_heap.end(),
-		    master->_timer_heap.begin() + _schedpos1 - 1,
-		    Master::timer_less(), Master::timer_place(master->_timer_heap.begin()));
-	master->_timer_heap.pop_back();
-	if (old_schedpos1 == 1)
-	    master->set_timer_expiry();
-    } else if (_schedpos1 < 0)
-	master->_timer_runchunk[-_schedpos1 - 1] = 0;
-    _schedpos1 = 0;
-    master->unlock_timers();
+    if (RouterThread *thread = lock_thread()) {
+	// The thread's expiry time may now be early; run_timers() will fix it.
+	if (_pprev)
+	    RouterThread::timer_unlink(this);
+	thread->unlock_timers();
+    }
 }
 
-// list-related functions in master.cc
+// list-related functions in routerthread.cc
 
 CLICK_ENDDECLS
@@ -656,7 +656,8 @@ AC_DEFUN([CLICK_CHECK_SIGNED_SHIFT], [
 
 dnl
 dnl CLICK_CHECK_INTEGER_BUILTINS
-dnl Checks whether '__builtin_clz' and '__builtin_clzll' exist.
+dnl Checks whether '__builtin_clz', '__builtin_ffs', '__builtin_popcountll',
+dnl and friends exist.
 dnl
 
 AC_DEFUN([CLICK_CHECK_INTEGER_BUILTINS], [
@@ -691,6 +692,11 @@ AC_DEFUN([CLICK_CHECK_INTEGER_BUILTINS], [
     if test $ac_cv_have___builtin_ffsll = yes; then
 	AC_DEFINE([HAVE___BUILTIN_FFSLL], [1], [Define if you have the __builtin_ffsll function.])
     fi
+    AC_CACHE_CHECK([for __builtin_popcountll], [ac_cv_have___builtin_popcountll],
+	 [AC_COMPILE_IFELSE([AC_LANG_PROGRAM([[volatile long long x = 11;]], [[int y = __builtin_popcountll(x);]])], [ac_cv_have___builtin_popcountll=yes], [ac_cv_have___builtin_popcountll=no])])
+    if test $ac_cv_have___builtin_popcountll = yes; then
+	AC_DEFINE([HAVE___BUILTIN_POPCOUNTLL], [1], [Define if you have the __builtin_popcountll function.])
+    fi
 
     AC_CHECK_HEADERS(strings.h)
     AC_CHECK_FUNCS(ffs ffsl ffsll)